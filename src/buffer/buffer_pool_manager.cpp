@@ -13,6 +13,7 @@
 #include "buffer/buffer_pool_manager.h"
 #include <list>
 #include <unordered_map>
+#include <utility>
 #include "include/common/logger.h"
 
 namespace bustub {
@@ -42,7 +43,7 @@ Page *BufferPoolManager::FetchPageImpl(page_id_t page_id) {
   // 2.     If R is dirty, write it back to the disk.
   // 3.     Delete R from the page table and insert P.
   // 4.     Update P's metadata, read in the page content from disk, and then return a pointer to P.
-  std::lock_guard<std::mutex> gard(latch_);
+  std::unique_lock<std::mutex> gard(latch_);
   auto it = page_table_.find(page_id);
   Page *page = nullptr;
   frame_id_t frame_id = 0;
@@ -50,6 +51,9 @@ Page *BufferPoolManager::FetchPageImpl(page_id_t page_id) {
   if (it != page_table_.end()) {
     frame_id = it->second;
     page = &pages_[frame_id];
+    if (page->pin_count_ == 0 && !page->is_dirty_) {
+      ResetRecLSN(page);
+    }
     // 增加pin_count;然后返回
     // page->WLatch();
     page->pin_count_++;
@@ -75,10 +79,39 @@ Page *BufferPoolManager::FetchPageImpl(page_id_t page_id) {
   disk_manager_->ReadPage(page_id, page->data_);
   page->is_dirty_ = false;
   page->pin_count_ = 1;
+  ResetRecLSN(page);
   // page->WUnlatch();
+  if (!page_load_hook_) {
+    return page;
+  }
+  // 页面刚从磁盘读入，其他线程只能在页锁上等待hook处理完
+  PageLoadHook hook = page_load_hook_;
+  page_load_hook_calls_++;
+  page->WLatch();
+  gard.unlock();
+  lsn_t rec_lsn;
+  int64_t rec_offset;
+  bool changed = hook(page, &rec_lsn, &rec_offset);
+  gard.lock();
+  if (changed) {
+    page->is_dirty_ = true;
+    page->rec_lsn_ = rec_lsn;
+    page->rec_offset_ = rec_offset;
+  }
+  if (--page_load_hook_calls_ == 0) {
+    page_load_hook_cv_.notify_all();
+  }
+  gard.unlock();
+  page->WUnlatch();
   return page;
 }
 
+void BufferPoolManager::SetPageLoadHook(PageLoadHook hook) {
+  std::unique_lock<std::mutex> gard(latch_);
+  page_load_hook_ = std::move(hook);
+  page_load_hook_cv_.wait(gard, [this] { return page_load_hook_calls_ == 0; });
+}
+
 bool BufferPoolManager::UnpinPageImpl(page_id_t page_id, bool is_dirty) {
   std::lock_guard<std::mutex> gard(latch_);
   auto it = page_table_.find(page_id);
@@ -106,6 +139,9 @@ bool BufferPoolManager::FlushPageImpl(page_id_t page_id) {
     auto frame_id = it->second;
     Page *page = &pages_[frame_id];
     // page->RLatch();
+    if (page->is_dirty_ && log_manager_ != nullptr && enable_logging) {
+      log_manager_->Flush(page->GetLSN());
+    }
     page->is_dirty_ = false;
     disk_manager_->WritePage(page_id, page->GetData());
     // page->RUnlatch();
@@ -119,26 +155,45 @@ Page *BufferPoolManager::FindFrame(frame_id_t *frame_id) {
   if (free_list_.empty()) {
     size_t size = replacer_->Size();
     bool not_found = true;
+    bool wal = log_manager_ != nullptr && enable_logging;
+    lsn_t persistent_lsn = wal ? log_manager_->GetPersistentLSN() : INVALID_LSN;
+    // the unpinned dirty frame with the smallest LSN among those the log has not caught up with yet
+    frame_id_t log_bound_frame = -1;
     // 寻找一个没有pin住的页面
     for (size_t i = 0; i < size; i++) {
       if (replacer_->Victim(frame_id)) {
         page = &pages_[*frame_id];
-        // page->RLatch();
         if (page->pin_count_ <= 0) {
-          not_found = false;
-          // 解除在map中的映射
-          page_table_.erase(page->GetPageId());
-          // page->RUnlatch();
-          break;
+          if (!wal || !page->is_dirty_ || page->GetLSN() <= persistent_lsn) {
+            not_found = false;
+            // 解除在map中的映射
+            page_table_.erase(page->GetPageId());
+            break;
+          }
+          // Writing this page out would need a log flush first, start one in the background and keep looking.
+          if (log_bound_frame == -1) {
+            log_manager_->RequestFlush();
+          }
+          if (log_bound_frame == -1 || page->GetLSN() < pages_[log_bound_frame].GetLSN()) {
+            log_bound_frame = *frame_id;
+          }
         }
         // 否则将弹出的frame_id重新插入
         replacer_->Unpin(*frame_id);
-        //page->RUnlatch();
-
       } else {
         LOG_ERROR("Victim fail");
       }
     }
+    if (not_found && log_bound_frame != -1) {
+      // Every unpinned frame is ahead of the log, wait for the one that needs the shortest flush.
+      eviction_log_waits_++;
+      *frame_id = log_bound_frame;
+      page = &pages_[*frame_id];
+      log_manager_->Flush(page->GetLSN());
+      replacer_->Pin(*frame_id);
+      page_table_.erase(page->GetPageId());
+      not_found = false;
+    }
     // 所有页面都被pin住
     if (not_found) {
       return nullptr;
@@ -181,6 +236,7 @@ Page *BufferPoolManager::NewPageImpl(page_id_t *page_id) {
   page->ResetMemory();
   page->is_dirty_ = false;
   page->pin_count_ = 1;
+  ResetRecLSN(page);
   if (page_id != nullptr) {
     *page_id = page_id_;
   }
@@ -230,4 +286,65 @@ void BufferPoolManager::FlushAllPagesImpl() {
   // You can do it!
 }
 
+void BufferPoolManager::ResetRecLSN(Page *page) {
+  // Nobody holds the page, so any change made to it from now on is logged at or after the log manager's next record.
+  // Changes made while logging is off are covered by redoing the log from its start.
+  if (log_manager_ != nullptr && enable_logging) {
+    page->rec_offset_ = log_manager_->GetNextOffset();
+    page->rec_lsn_ = log_manager_->GetNextLSN();
+  } else {
+    page->rec_offset_ = 0;
+    page->rec_lsn_ = INVALID_LSN;
+  }
+}
+
+void BufferPoolManager::GetDirtyPageTable(std::vector<std::pair<page_id_t, lsn_t>> *dirty_pages,
+                                          int64_t *redo_offset) {
+  std::lock_guard<std::mutex> gard(latch_);
+  dirty_pages->clear();
+  *redo_offset = -1;
+  for (auto it : page_table_) {
+    Page *page = &pages_[it.second];
+    if (!page->is_dirty_ && page->pin_count_ == 0) {
+      continue;
+    }
+    dirty_pages->emplace_back(it.first, page->rec_lsn_);
+    if (*redo_offset == -1 || page->rec_offset_ < *redo_offset) {
+      *redo_offset = page->rec_offset_;
+    }
+  }
+}
+
+bool BufferPoolManager::WriteBackPage(page_id_t page_id) {
+  Page *page = nullptr;
+  {
+    std::lock_guard<std::mutex> gard(latch_);
+    auto it = page_table_.find(page_id);
+    if (it == page_table_.end()) {
+      return false;
+    }
+    page = &pages_[it->second];
+    if (!page->is_dirty_) {
+      return true;
+    }
+    // Keep the frame from being evicted (and written by someone else) while we write it.
+    page->pin_count_++;
+  }
+
+  page->RLatch();
+  if (log_manager_ != nullptr && enable_logging) {
+    log_manager_->Flush(page->GetLSN());
+  }
+  disk_manager_->WritePage(page_id, page->GetData());
+  {
+    // Writers hold the write latch while they change the page, so the image on disk has every change made so far.
+    // Whoever still has it pinned after a change marks it dirty again on unpin.
+    std::lock_guard<std::mutex> gard(latch_);
+    page->is_dirty_ = false;
+  }
+  page->RUnlatch();
+  UnpinPageImpl(page_id, false);
+  return true;
+}
+
 }  // namespace bustub
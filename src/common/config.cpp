@@ -18,6 +18,18 @@ std::atomic<bool> enable_logging(false);
 
 std::chrono::duration<int64_t> log_timeout = std::chrono::seconds(1);
 
+std::chrono::milliseconds async_commit_window = std::chrono::milliseconds(10);
+
+std::atomic<int> checkpoint_flush_rate(1000);
+
+std::chrono::milliseconds gc_interval = std::chrono::milliseconds(10);
+
+std::chrono::microseconds gc_time_slice = std::chrono::microseconds(1000);
+
+std::atomic<bool> enable_latch_stats(false);
+
+std::atomic<bool> enable_optimistic_crabbing(true);
+
 std::chrono::milliseconds cycle_detection_interval = std::chrono::milliseconds(50);
 
 }  // namespace bustub
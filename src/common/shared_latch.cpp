@@ -0,0 +1,112 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// shared_latch.cpp
+//
+// Identification: src/common/shared_latch.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "common/shared_latch.h"
+
+#include <climits>
+#include <thread>  // NOLINT
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace bustub {
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "the futex is the latch word itself");
+
+namespace {
+
+/** Wait a little before retrying: first spin on the core, then give it up to the thread holding the latch. */
+inline void Backoff(int spins) {
+  if (spins < LATCH_SPIN_COUNT / 4) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+  } else {
+    std::this_thread::yield();
+  }
+}
+
+}  // namespace
+
+void SharedLatch::WLockSlow() {
+  if (enable_latch_stats) {
+    contentions_.fetch_add(1, std::memory_order_relaxed);
+  }
+  for (int spins = 0;; spins++) {
+    uint32_t state = state_.load(std::memory_order_relaxed);
+    if ((state & (WRITER | READERS)) == 0) {
+      // taking the latch clears WRITER_WAITING, writers still waiting set it again
+      if (state_.compare_exchange_weak(state, WRITER, std::memory_order_acquire)) {
+        return;
+      }
+      continue;
+    }
+    if ((state & WRITER_WAITING) == 0) {
+      // hold off new readers
+      state_.fetch_or(WRITER_WAITING, std::memory_order_relaxed);
+      continue;
+    }
+    if (spins < LATCH_SPIN_COUNT) {
+      Backoff(spins);
+      continue;
+    }
+    Park(state);
+  }
+}
+
+void SharedLatch::RLockSlow() {
+  if (enable_latch_stats) {
+    contentions_.fetch_add(1, std::memory_order_relaxed);
+  }
+  for (int spins = 0;; spins++) {
+    uint32_t state = state_.load(std::memory_order_relaxed);
+    if ((state & (WRITER | WRITER_WAITING)) == 0) {
+      if (state_.compare_exchange_weak(state, state + 1, std::memory_order_acquire)) {
+        return;
+      }
+      continue;
+    }
+    if (spins < LATCH_SPIN_COUNT) {
+      Backoff(spins);
+      continue;
+    }
+    Park(state);
+  }
+}
+
+void SharedLatch::Park(uint32_t state) {
+  if (enable_latch_stats) {
+    parks_.fetch_add(1, std::memory_order_relaxed);
+  }
+  // A releasing thread changes the word before it looks at waiters_, and we count ourselves in before the kernel
+  // compares the word with state: either it sees us waiting and wakes us, or we see the word has changed.
+  waiters_.fetch_add(1);
+#ifdef __linux__
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(&state_), FUTEX_WAIT_PRIVATE, state, nullptr, nullptr, 0);
+#else
+  if (state_.load() == state) {
+    std::this_thread::yield();
+  }
+#endif
+  waiters_.fetch_sub(1);
+}
+
+void SharedLatch::Wake() {
+#ifdef __linux__
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(&state_), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#endif
+}
+
+}  // namespace bustub
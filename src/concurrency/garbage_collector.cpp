@@ -0,0 +1,47 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// garbage_collector.cpp
+//
+// Identification: src/concurrency/garbage_collector.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "concurrency/garbage_collector.h"
+
+#include <chrono>  // NOLINT
+
+namespace bustub {
+
+GarbageCollector::GarbageCollector(TransactionManager *transaction_manager)
+    : transaction_manager_(transaction_manager) {
+  collector_ = new std::thread(&GarbageCollector::RunGarbageCollector, this);
+}
+
+GarbageCollector::~GarbageCollector() {
+  {
+    std::lock_guard<std::mutex> guard(latch_);
+    stop_ = true;
+    cv_.notify_one();
+  }
+  collector_->join();
+  delete collector_;
+}
+
+void GarbageCollector::RunGarbageCollector() {
+  std::unique_lock<std::mutex> latch(latch_);
+  while (!cv_.wait_for(latch, gc_interval, [this] { return stop_; })) {
+    latch.unlock();
+    // Work in batches and look at the clock in between, a batch is short enough to overshoot the slice by little.
+    auto deadline = std::chrono::steady_clock::now() + gc_time_slice;
+    while (transaction_manager_->CollectGarbage(GC_BATCH_SIZE) == GC_BATCH_SIZE &&
+           std::chrono::steady_clock::now() < deadline) {
+    }
+    latch.lock();
+  }
+}
+
+}  // namespace bustub
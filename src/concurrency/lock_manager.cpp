@@ -12,48 +12,613 @@
 
 #include "concurrency/lock_manager.h"
 
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
 namespace bustub {
 
 bool LockManager::LockShared(Transaction *txn, const RID &rid) {
+  if (txn->GetState() == TransactionState::ABORTED) {
+    return false;
+  }
+  if (txn->GetIsolationLevel() == IsolationLevel::READ_UNCOMMITTED) {
+    AbortTransaction(txn, AbortReason::LOCKSHARED_ON_READ_UNCOMMITTED);
+  }
+  if (txn->GetState() == TransactionState::SHRINKING) {
+    AbortTransaction(txn, AbortReason::LOCK_ON_SHRINKING);
+  }
+  if (txn->IsSharedLocked(rid) || txn->IsExclusiveLocked(rid)) {
+    return true;
+  }
+
+  LockTableStripe *stripe = GetStripe(rid);
+  std::unique_lock<std::mutex> latch(stripe->latch_);
+  LockRequestQueue &queue = stripe->lock_table_[rid];
+  auto request = queue.request_queue_.emplace(queue.request_queue_.end(), txn, LockMode::SHARED);
+  if (!WaitForGrant(txn, &queue, request, WaitSite{&stripe->latch_, stripe, rid, INVALID_TABLE_OID}, &latch)) {
+    return false;
+  }
   txn->GetSharedLockSet()->emplace(rid);
   return true;
 }
 
 bool LockManager::LockExclusive(Transaction *txn, const RID &rid) {
+  if (txn->GetState() == TransactionState::ABORTED) {
+    return false;
+  }
+  if (txn->GetState() == TransactionState::SHRINKING) {
+    AbortTransaction(txn, AbortReason::LOCK_ON_SHRINKING);
+  }
+  if (txn->IsExclusiveLocked(rid)) {
+    return true;
+  }
+  // a second request of our own would outlive the unlock, the shared one is upgraded in place
+  if (txn->IsSharedLocked(rid)) {
+    return LockUpgrade(txn, rid);
+  }
+
+  LockTableStripe *stripe = GetStripe(rid);
+  std::unique_lock<std::mutex> latch(stripe->latch_);
+  LockRequestQueue &queue = stripe->lock_table_[rid];
+  auto request = queue.request_queue_.emplace(queue.request_queue_.end(), txn, LockMode::EXCLUSIVE);
+  if (!WaitForGrant(txn, &queue, request, WaitSite{&stripe->latch_, stripe, rid, INVALID_TABLE_OID}, &latch)) {
+    return false;
+  }
   txn->GetExclusiveLockSet()->emplace(rid);
   return true;
 }
 
 bool LockManager::LockUpgrade(Transaction *txn, const RID &rid) {
+  if (txn->GetState() == TransactionState::ABORTED) {
+    return false;
+  }
+  if (txn->GetState() == TransactionState::SHRINKING) {
+    AbortTransaction(txn, AbortReason::LOCK_ON_SHRINKING);
+  }
+  if (txn->IsExclusiveLocked(rid)) {
+    return true;
+  }
+  if (!txn->IsSharedLocked(rid)) {
+    return false;
+  }
+
+  LockTableStripe *stripe = GetStripe(rid);
+  std::unique_lock<std::mutex> latch(stripe->latch_);
+  bool upgraded = UpgradeRequest(txn, &stripe->lock_table_[rid], LockMode::EXCLUSIVE,
+                                 WaitSite{&stripe->latch_, stripe, rid, INVALID_TABLE_OID}, &latch);
   txn->GetSharedLockSet()->erase(rid);
+  if (!upgraded) {
+    return false;
+  }
   txn->GetExclusiveLockSet()->emplace(rid);
   return true;
 }
 
+bool LockManager::LockInstant(Transaction *txn, const RID &rid) {
+  if (txn->GetState() == TransactionState::ABORTED) {
+    return false;
+  }
+  if (txn->GetState() == TransactionState::SHRINKING) {
+    AbortTransaction(txn, AbortReason::LOCK_ON_SHRINKING);
+  }
+  if (txn->IsExclusiveLocked(rid)) {
+    return true;
+  }
+
+  LockTableStripe *stripe = GetStripe(rid);
+  std::unique_lock<std::mutex> latch(stripe->latch_);
+  LockRequestQueue &queue = stripe->lock_table_[rid];
+  auto request = queue.request_queue_.emplace(queue.request_queue_.end(), txn, LockMode::EXCLUSIVE);
+  if (!WaitForGrant(txn, &queue, request, WaitSite{&stripe->latch_, stripe, rid, INVALID_TABLE_OID}, &latch)) {
+    return false;
+  }
+  // the lock is let go of right away, it is not in the lock sets and does not end the growing phase
+  queue.request_queue_.erase(request);
+  if (queue.request_queue_.empty()) {
+    stripe->lock_table_.erase(rid);
+  } else {
+    ForgetBlocker(queue, txn->GetTransactionId());
+    queue.cv_.notify_all();
+  }
+  return true;
+}
+
 bool LockManager::Unlock(Transaction *txn, const RID &rid) {
+  bool exclusive = txn->IsExclusiveLocked(rid);
+  if (!exclusive && !txn->IsSharedLocked(rid)) {
+    return false;
+  }
   txn->GetSharedLockSet()->erase(rid);
   txn->GetExclusiveLockSet()->erase(rid);
+  UpdateStateOnUnlock(txn, exclusive ? LockMode::EXCLUSIVE : LockMode::SHARED);
+
+  return RemoveRowRequest(txn, rid);
+}
+
+bool LockManager::LockTable(Transaction *txn, table_oid_t oid, LockMode lock_mode) {
+  if (txn->GetState() == TransactionState::ABORTED) {
+    return false;
+  }
+  LockMode held;
+  bool locked = txn->GetTableLockMode(oid, &held);
+  if (locked && Covers(held, lock_mode)) {
+    return true;
+  }
+  if (txn->GetIsolationLevel() == IsolationLevel::READ_UNCOMMITTED &&
+      (lock_mode == LockMode::SHARED || lock_mode == LockMode::INTENTION_SHARED ||
+       lock_mode == LockMode::SHARED_INTENTION_EXCLUSIVE)) {
+    AbortTransaction(txn, AbortReason::LOCKSHARED_ON_READ_UNCOMMITTED);
+  }
+  if (txn->GetState() == TransactionState::SHRINKING) {
+    AbortTransaction(txn, AbortReason::LOCK_ON_SHRINKING);
+  }
+
+  std::unique_lock<std::mutex> latch(table_latch_);
+  LockRequestQueue &queue = table_lock_table_[oid];
+  WaitSite site{&table_latch_, nullptr, RID(), oid};
+  if (locked) {
+    // the weakest mode covering both, only SHARED and INTENTION_EXCLUSIVE add up to something new
+    LockMode upgraded = Covers(lock_mode, held) ? lock_mode : LockMode::SHARED_INTENTION_EXCLUSIVE;
+    bool granted = UpgradeRequest(txn, &queue, upgraded, site, &latch);
+    txn->GetTableLockSet()->erase(oid);
+    if (!granted) {
+      return false;
+    }
+    txn->GetTableLockSet()->emplace(oid, upgraded);
+    return true;
+  }
+  auto request = queue.request_queue_.emplace(queue.request_queue_.end(), txn, lock_mode);
+  if (!WaitForGrant(txn, &queue, request, site, &latch)) {
+    return false;
+  }
+  txn->GetTableLockSet()->emplace(oid, lock_mode);
+  return true;
+}
+
+bool LockManager::UnlockTable(Transaction *txn, table_oid_t oid) {
+  LockMode held;
+  if (!txn->GetTableLockMode(oid, &held)) {
+    return false;
+  }
+  txn->GetTableLockSet()->erase(oid);
+  txn->GetTableRowLockSet()->erase(oid);
+  UpdateStateOnUnlock(txn, held);
+
+  std::lock_guard<std::mutex> guard(table_latch_);
+  auto queue = table_lock_table_.find(oid);
+  if (queue == table_lock_table_.end()) {
+    return false;
+  }
+  RemoveRequest(txn, &queue->second);
+  if (queue->second.request_queue_.empty()) {
+    table_lock_table_.erase(queue);
+  }
+  return true;
+}
+
+bool LockManager::EscalateLocks(Transaction *txn, table_oid_t oid, bool exclusive) {
+  std::vector<RID> rids;
+  auto rows = txn->GetTableRowLockSet()->find(oid);
+  if (rows != txn->GetTableRowLockSet()->end()) {
+    rids = std::move(rows->second);
+    txn->GetTableRowLockSet()->erase(rows);
+  }
+  for (const RID &rid : rids) {
+    exclusive = exclusive || txn->IsExclusiveLocked(rid);
+  }
+  // The table is locked before any row lock goes, so the rows stay covered all along.
+  if (!LockTable(txn, oid, exclusive ? LockMode::EXCLUSIVE : LockMode::SHARED)) {
+    return false;
+  }
+  for (const RID &rid : rids) {
+    if (txn->GetSharedLockSet()->erase(rid) + txn->GetExclusiveLockSet()->erase(rid) > 0) {
+      RemoveRowRequest(txn, rid);
+    }
+  }
+  return true;
+}
+
+bool LockManager::Covers(LockMode held, LockMode requested) {
+  if (held == requested || held == LockMode::EXCLUSIVE || requested == LockMode::INTENTION_SHARED) {
+    return true;
+  }
+  if (held == LockMode::SHARED_INTENTION_EXCLUSIVE) {
+    return requested == LockMode::SHARED || requested == LockMode::INTENTION_EXCLUSIVE;
+  }
+  return false;
+}
+
+LockManager::LockTableStripe *LockManager::GetStripe(const RID &rid) {
+  // Slot numbers repeat on every page, mix the page id in before picking the stripe.
+  auto hash = static_cast<uint64_t>(rid.Get()) * 0x9E3779B97F4A7C15ULL;
+  return &stripes_[(hash >> 32) % stripes_.size()];
+}
+
+bool LockManager::WaitForGrant(Transaction *txn, LockRequestQueue *queue, std::list<LockRequest>::iterator request,
+                               const WaitSite &site, std::unique_lock<std::mutex> *latch) {
+  bool registered = false;
+  std::chrono::steady_clock::time_point wait_start;
+  while (txn->GetState() != TransactionState::ABORTED && !IsGrantable(*queue, request)) {
+    if (!registered) {
+      // only the requests that wait are profiled, a free lock does not read the clock
+      wait_start = std::chrono::steady_clock::now();
+      if (site.stripe_ != nullptr) {
+        stats_.RecordContention(site.rid_);
+      } else {
+        stats_.RecordContention(site.oid_);
+      }
+      std::lock_guard<std::mutex> guard(latch_);
+      WaitSite &waiting = waiting_[txn->GetTransactionId()];
+      waiting = site;
+      waiting.txn_ = txn;
+      registered = true;
+    }
+    // The requests in the way may have changed since the last time around.
+    std::vector<txn_id_t> victims;
+    if (deadlock_policy_ == DeadlockPolicy::DETECTION) {
+      DetectDeadlock(txn, *queue, request, &victims);
+    } else {
+      PreventDeadlock(txn, *queue, request, &victims);
+    }
+    if (!victims.empty()) {
+      // The victims may wait on other queues, whose latches must not be taken while holding this one.
+      latch->unlock();
+      for (txn_id_t txn_id : victims) {
+        WakeUp(txn_id);
+      }
+      latch->lock();
+      continue;
+    }
+    // An abort that came before the registration found nobody to wake up.
+    if (txn->GetState() == TransactionState::ABORTED) {
+      break;
+    }
+    queue->cv_.wait(*latch);
+  }
+  if (registered) {
+    stats_.RecordWait(request->lock_mode_, std::chrono::duration_cast<std::chrono::microseconds>(
+                                               std::chrono::steady_clock::now() - wait_start));
+    std::lock_guard<std::mutex> guard(latch_);
+    waiting_.erase(txn->GetTransactionId());
+    waits_for_.erase(txn->GetTransactionId());
+  }
+  if (txn->GetState() == TransactionState::ABORTED) {
+    queue->request_queue_.erase(request);
+    ForgetBlocker(*queue, txn->GetTransactionId());
+    // whoever waited behind the request may go ahead now
+    queue->cv_.notify_all();
+    return false;
+  }
+  request->granted_ = true;
+  return true;
+}
+
+void LockManager::DetectDeadlock(Transaction *txn, const LockRequestQueue &queue,
+                                 std::list<LockRequest>::iterator request, std::vector<txn_id_t> *victims) {
+  std::vector<const LockRequest *> blockers;
+  GetBlockers(queue, request, &blockers);
+  std::lock_guard<std::mutex> guard(latch_);
+  auto &edges = waits_for_[txn->GetTransactionId()];
+  edges.clear();
+  for (const LockRequest *blocker : blockers) {
+    if (std::find(edges.begin(), edges.end(), blocker->txn_id_) == edges.end()) {
+      edges.push_back(blocker->txn_id_);
+    }
+  }
+
+  // The graph had no cycle before, so a new one has to go through the edges of txn and can be found from txn.
+  std::vector<txn_id_t> path;
+  std::unordered_set<txn_id_t> on_path;
+  std::unordered_set<txn_id_t> visited;
+  if (!FindCycle(waits_for_, txn->GetTransactionId(), &path, &on_path, &visited)) {
+    return;
+  }
+  auto cycle = std::find(path.begin(), path.end(), path.back());
+  txn_id_t victim = *std::max_element(cycle, path.end());
+  auto waiting = waiting_.find(victim);
+  if (waiting == waiting_.end()) {
+    return;
+  }
+  waiting->second.txn_->SetState(TransactionState::ABORTED);
+  stats_.RecordAbort(AbortReason::DEADLOCK);
+  waits_for_.erase(victim);
+  if (victim != txn->GetTransactionId()) {
+    victims->push_back(victim);
+  }
+}
+
+void LockManager::PreventDeadlock(Transaction *txn, const LockRequestQueue &queue,
+                                  std::list<LockRequest>::iterator request, std::vector<txn_id_t> *victims) {
+  std::vector<const LockRequest *> blockers;
+  GetBlockers(queue, request, &blockers);
+  for (const LockRequest *blocker : blockers) {
+    if (deadlock_policy_ == DeadlockPolicy::WAIT_DIE) {
+      if (blocker->txn_id_ < txn->GetTransactionId()) {
+        txn->SetState(TransactionState::ABORTED);
+        stats_.RecordAbort(AbortReason::DEADLOCK);
+        return;
+      }
+    } else if (blocker->txn_id_ > txn->GetTransactionId() &&
+               blocker->txn_->GetState() == TransactionState::GROWING) {
+      // A shrinking transaction takes no more locks, so it cannot be part of a deadlock and is left to finish.
+      blocker->txn_->SetState(TransactionState::ABORTED);
+      stats_.RecordAbort(AbortReason::DEADLOCK);
+      victims->push_back(blocker->txn_id_);
+    }
+  }
+}
+
+void LockManager::WakeUp(txn_id_t txn_id) {
+  WaitSite site;
+  {
+    std::lock_guard<std::mutex> guard(latch_);
+    auto waiting = waiting_.find(txn_id);
+    if (waiting == waiting_.end()) {
+      return;
+    }
+    site = waiting->second;
+  }
+  // The queue may be gone by now, it is looked up again under its latch.
+  std::lock_guard<std::mutex> guard(*site.latch_);
+  if (site.stripe_ != nullptr) {
+    auto queue = site.stripe_->lock_table_.find(site.rid_);
+    if (queue != site.stripe_->lock_table_.end()) {
+      queue->second.cv_.notify_all();
+    }
+  } else {
+    auto queue = table_lock_table_.find(site.oid_);
+    if (queue != table_lock_table_.end()) {
+      queue->second.cv_.notify_all();
+    }
+  }
+}
+
+void LockManager::GetBlockers(const LockRequestQueue &queue, std::list<LockRequest>::iterator request,
+                              std::vector<const LockRequest *> *blockers) {
+  bool ahead = true;
+  for (auto it = queue.request_queue_.begin(); it != queue.request_queue_.end(); it++) {
+    if (it == request) {
+      ahead = false;
+      continue;
+    }
+    if ((ahead || it->granted_) && it->txn_id_ != request->txn_id_ &&
+        !AreCompatible(it->lock_mode_, request->lock_mode_)) {
+      blockers->push_back(&*it);
+    }
+  }
+}
+
+bool LockManager::IsGrantable(const LockRequestQueue &queue, std::list<LockRequest>::iterator request) {
+  bool ahead = true;
+  for (auto it = queue.request_queue_.begin(); it != queue.request_queue_.end(); it++) {
+    if (it == request) {
+      ahead = false;
+      continue;
+    }
+    // a transaction does not wait for itself, LockInstant may ask for a row it holds a shared lock on
+    if ((ahead || it->granted_) && it->txn_id_ != request->txn_id_ &&
+        !AreCompatible(it->lock_mode_, request->lock_mode_)) {
+      return false;
+    }
+  }
   return true;
 }
 
-void LockManager::AddEdge(txn_id_t t1, txn_id_t t2) {}
+bool LockManager::AreCompatible(LockMode mode1, LockMode mode2) {
+  // indexed by LockMode: SHARED, EXCLUSIVE, INTENTION_SHARED, INTENTION_EXCLUSIVE, SHARED_INTENTION_EXCLUSIVE
+  static constexpr bool COMPATIBLE[5][5] = {{true, false, true, false, false},
+                                            {false, false, false, false, false},
+                                            {true, false, true, true, true},
+                                            {false, false, true, true, false},
+                                            {false, false, true, false, false}};
+  return COMPATIBLE[static_cast<int>(mode1)][static_cast<int>(mode2)];
+}
 
-void LockManager::RemoveEdge(txn_id_t t1, txn_id_t t2) {}
+bool LockManager::UpgradeRequest(Transaction *txn, LockRequestQueue *queue, LockMode lock_mode, const WaitSite &site,
+                                 std::unique_lock<std::mutex> *latch) {
+  if (queue->upgrading_) {
+    AbortTransaction(txn, AbortReason::UPGRADE_CONFLICT);
+  }
+  stats_.RecordUpgrade(site.stripe_ == nullptr);
+  // Trade the granted request for one that goes ahead of everyone still waiting. It is granted once the other holders
+  // are compatible with it.
+  auto &requests = queue->request_queue_;
+  for (auto it = requests.begin(); it != requests.end(); it++) {
+    if (it->txn_id_ == txn->GetTransactionId()) {
+      requests.erase(it);
+      break;
+    }
+  }
+  auto position = requests.begin();
+  while (position != requests.end() && position->granted_) {
+    position++;
+  }
+  auto request = requests.emplace(position, txn, lock_mode);
+  queue->upgrading_ = true;
+  bool granted = WaitForGrant(txn, queue, request, site, latch);
+  queue->upgrading_ = false;
+  return granted;
+}
 
-bool LockManager::HasCycle(txn_id_t *txn_id) { return false; }
+bool LockManager::RemoveRowRequest(Transaction *txn, const RID &rid) {
+  LockTableStripe *stripe = GetStripe(rid);
+  std::lock_guard<std::mutex> guard(stripe->latch_);
+  auto queue = stripe->lock_table_.find(rid);
+  if (queue == stripe->lock_table_.end()) {
+    return false;
+  }
+  RemoveRequest(txn, &queue->second);
+  if (queue->second.request_queue_.empty()) {
+    // nobody waits on the queue, otherwise their request would still be in it
+    stripe->lock_table_.erase(queue);
+  }
+  return true;
+}
 
-std::vector<std::pair<txn_id_t, txn_id_t>> LockManager::GetEdgeList() { return {}; }
+void LockManager::RemoveRequest(Transaction *txn, LockRequestQueue *queue) {
+  auto &requests = queue->request_queue_;
+  for (auto it = requests.begin(); it != requests.end(); it++) {
+    if (it->txn_id_ == txn->GetTransactionId()) {
+      requests.erase(it);
+      break;
+    }
+  }
+  if (!requests.empty()) {
+    ForgetBlocker(*queue, txn->GetTransactionId());
+    queue->cv_.notify_all();
+  }
+}
+
+void LockManager::ForgetBlocker(const LockRequestQueue &queue, txn_id_t txn_id) {
+  if (deadlock_policy_ != DeadlockPolicy::DETECTION) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(latch_);
+  for (const auto &request : queue.request_queue_) {
+    auto edges = waits_for_.find(request.txn_id_);
+    if (!request.granted_ && edges != waits_for_.end()) {
+      edges->second.erase(std::remove(edges->second.begin(), edges->second.end(), txn_id), edges->second.end());
+    }
+  }
+}
+
+void LockManager::UpdateStateOnUnlock(Transaction *txn, LockMode lock_mode) {
+  // Strict 2PL: the first release ends the growing phase. READ_COMMITTED gives up its read locks right after reading,
+  // which does not count as shrinking.
+  bool read_lock = lock_mode == LockMode::SHARED || lock_mode == LockMode::INTENTION_SHARED;
+  if (txn->GetState() == TransactionState::GROWING &&
+      !(read_lock && txn->GetIsolationLevel() == IsolationLevel::READ_COMMITTED)) {
+    txn->SetState(TransactionState::SHRINKING);
+  }
+}
+
+void LockManager::AbortTransaction(Transaction *txn, AbortReason reason) {
+  txn->SetState(TransactionState::ABORTED);
+  stats_.RecordAbort(reason);
+  throw TransactionAbortException(txn->GetTransactionId(), reason);
+}
+
+void LockManager::AddEdge(txn_id_t t1, txn_id_t t2) {
+  std::lock_guard<std::mutex> guard(latch_);
+  auto &edges = waits_for_[t1];
+  if (std::find(edges.begin(), edges.end(), t2) == edges.end()) {
+    edges.push_back(t2);
+  }
+}
+
+void LockManager::RemoveEdge(txn_id_t t1, txn_id_t t2) {
+  std::lock_guard<std::mutex> guard(latch_);
+  auto edges = waits_for_.find(t1);
+  if (edges == waits_for_.end()) {
+    return;
+  }
+  edges->second.erase(std::remove(edges->second.begin(), edges->second.end(), t2), edges->second.end());
+  if (edges->second.empty()) {
+    waits_for_.erase(edges);
+  }
+}
+
+bool LockManager::HasCycle(txn_id_t *txn_id) {
+  std::lock_guard<std::mutex> guard(latch_);
+  return FindVictim(&waits_for_, txn_id);
+}
+
+bool LockManager::FindVictim(WaitsForGraph *graph, txn_id_t *txn_id) {
+  // Search from the oldest transaction on and follow the older transaction first, so the same graph always gives the
+  // same victim.
+  std::vector<txn_id_t> sources;
+  for (auto &edges : *graph) {
+    sources.push_back(edges.first);
+    std::sort(edges.second.begin(), edges.second.end());
+  }
+  std::sort(sources.begin(), sources.end());
+  std::unordered_set<txn_id_t> visited;
+  for (txn_id_t source : sources) {
+    std::vector<txn_id_t> path;
+    std::unordered_set<txn_id_t> on_path;
+    if (visited.count(source) == 0 && FindCycle(*graph, source, &path, &on_path, &visited)) {
+      // the cycle starts where the path first reaches the node it ends at
+      auto cycle = std::find(path.begin(), path.end(), path.back());
+      *txn_id = *std::max_element(cycle, path.end());
+      return true;
+    }
+  }
+  return false;
+}
+
+bool LockManager::FindCycle(const WaitsForGraph &graph, txn_id_t txn_id, std::vector<txn_id_t> *path,
+                            std::unordered_set<txn_id_t> *on_path, std::unordered_set<txn_id_t> *visited) {
+  path->push_back(txn_id);
+  if (on_path->count(txn_id) != 0) {
+    return true;
+  }
+  if (visited->count(txn_id) != 0) {
+    path->pop_back();
+    return false;
+  }
+  visited->insert(txn_id);
+  on_path->insert(txn_id);
+  auto edges = graph.find(txn_id);
+  if (edges != graph.end()) {
+    for (txn_id_t next : edges->second) {
+      if (FindCycle(graph, next, path, on_path, visited)) {
+        return true;
+      }
+    }
+  }
+  on_path->erase(txn_id);
+  path->pop_back();
+  return false;
+}
+
+std::vector<std::pair<txn_id_t, txn_id_t>> LockManager::GetEdgeList() {
+  std::lock_guard<std::mutex> guard(latch_);
+  std::vector<std::pair<txn_id_t, txn_id_t>> edge_list;
+  for (const auto &edges : waits_for_) {
+    for (txn_id_t t2 : edges.second) {
+      edge_list.emplace_back(edges.first, t2);
+    }
+  }
+  return edge_list;
+}
 
 void LockManager::RunCycleDetection() {
   while (enable_cycle_detection_) {
     std::this_thread::sleep_for(cycle_detection_interval);
+    // Waiters look for a cycle as they block, this only catches the cycles closed by a request that moved ahead of
+    // them, like an upgrade, before they were woken up to see it.
+    WaitsForGraph graph;
     {
-      std::unique_lock<std::mutex> l(latch_);
-      // TODO(student): remove the continue and add your cycle detection and abort code here
-      continue;
+      std::lock_guard<std::mutex> guard(latch_);
+      if (waits_for_.empty()) {
+        continue;
+      }
+      graph = waits_for_;
+    }
+    std::vector<txn_id_t> victims;
+    txn_id_t victim;
+    while (FindVictim(&graph, &victim)) {
+      {
+        std::lock_guard<std::mutex> guard(latch_);
+        auto waiting = waiting_.find(victim);
+        if (waiting != waiting_.end()) {
+          waiting->second.txn_->SetState(TransactionState::ABORTED);
+          stats_.RecordAbort(AbortReason::DEADLOCK);
+          waits_for_.erase(victim);
+          victims.push_back(victim);
+        }
+      }
+      graph.erase(victim);
+      for (auto &waits : graph) {
+        waits.second.erase(std::remove(waits.second.begin(), waits.second.end(), victim), waits.second.end());
+      }
+    }
+    for (txn_id_t txn_id : victims) {
+      WakeUp(txn_id);
     }
   }
 }
@@ -0,0 +1,106 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lock_stats.cpp
+//
+// Identification: src/concurrency/lock_stats.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "concurrency/lock_stats.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace bustub {
+
+namespace {
+
+const char *const LOCK_MODE_NAMES[] = {"SHARED", "EXCLUSIVE", "INTENTION_SHARED", "INTENTION_EXCLUSIVE",
+                                       "SHARED_INTENTION_EXCLUSIVE"};
+const char *const ABORT_REASON_NAMES[] = {"LOCK_ON_SHRINKING", "UNLOCK_ON_SHRINKING", "UPGRADE_CONFLICT", "DEADLOCK",
+                                          "LOCKSHARED_ON_READ_UNCOMMITTED"};
+
+}  // namespace
+
+void LockStats::RecordWait(LockMode mode, std::chrono::microseconds wait) {
+  auto us = static_cast<uint64_t>(std::max<int64_t>(wait.count(), 0));
+  // the number of bits of us: 0 for 0us, b for [2^(b-1), 2^b)
+  int bucket = us == 0 ? 0 : 64 - __builtin_clzll(us);
+  bucket = std::min(bucket, NUM_WAIT_BUCKETS - 1);
+  waits_[static_cast<int>(mode)][bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t LockStats::GetWaitCount(LockMode mode) {
+  uint64_t count = 0;
+  for (const auto &bucket : waits_[static_cast<int>(mode)]) {
+    count += bucket.load(std::memory_order_relaxed);
+  }
+  return count;
+}
+
+std::chrono::microseconds LockStats::GetWaitPercentile(LockMode mode, double percentile) {
+  uint64_t count = GetWaitCount(mode);
+  if (count == 0) {
+    return std::chrono::microseconds(0);
+  }
+  auto rank = std::min(static_cast<uint64_t>(percentile / 100 * count), count - 1);
+  uint64_t seen = 0;
+  for (int bucket = 0; bucket < NUM_WAIT_BUCKETS; bucket++) {
+    seen += waits_[static_cast<int>(mode)][bucket].load(std::memory_order_relaxed);
+    if (seen > rank || bucket == NUM_WAIT_BUCKETS - 1) {
+      return std::chrono::microseconds(bucket == 0 ? 1 : int64_t{1} << bucket);
+    }
+  }
+  return std::chrono::microseconds(0);
+}
+
+std::string LockStats::ToString() {
+  std::stringstream os;
+  os << "lock waits:\n";
+  for (int mode = 0; mode < NUM_LOCK_MODES; mode++) {
+    auto lock_mode = static_cast<LockMode>(mode);
+    uint64_t count = GetWaitCount(lock_mode);
+    if (count == 0) {
+      continue;
+    }
+    os << "  " << LOCK_MODE_NAMES[mode] << ": " << count << " waits, p50 < "
+       << GetWaitPercentile(lock_mode, 50).count() << "us, p99 < " << GetWaitPercentile(lock_mode, 99).count()
+       << "us, max < " << GetWaitPercentile(lock_mode, 100).count() << "us\n";
+  }
+  os << "upgrades: " << GetUpgradeCount(false) << " rows, " << GetUpgradeCount(true) << " tables\n";
+  os << "aborts:";
+  for (int reason = 0; reason < NUM_ABORT_REASONS; reason++) {
+    os << " " << ABORT_REASON_NAMES[reason] << " " << GetAbortCount(static_cast<AbortReason>(reason));
+  }
+  os << "\nhot rows:";
+  for (const auto &row : GetHotRows()) {
+    os << " (" << row.first.GetPageId() << ", " << row.first.GetSlotNum() << ") " << row.second;
+  }
+  os << "\nhot tables:";
+  for (const auto &table : GetHotTables()) {
+    os << " " << table.first << " " << table.second;
+  }
+  os << "\n";
+  return os.str();
+}
+
+void LockStats::Reset() {
+  for (auto &mode : waits_) {
+    for (auto &bucket : mode) {
+      bucket = 0;
+    }
+  }
+  row_upgrades_ = 0;
+  table_upgrades_ = 0;
+  for (auto &reason : aborts_) {
+    reason = 0;
+  }
+  hot_rows_.Clear();
+  hot_tables_.Clear();
+}
+
+}  // namespace bustub
@@ -12,68 +12,126 @@
 
 #include "concurrency/transaction_manager.h"
 
-#include <unordered_map>
+#include <algorithm>
+#include <deque>
+#include <functional>
 #include <unordered_set>
+#include <vector>
 
 #include "catalog/catalog.h"
 #include "storage/table/table_heap.h"
 
 namespace bustub {
 
-std::unordered_map<txn_id_t, Transaction *> TransactionManager::txn_map = {};
+TransactionManager::~TransactionManager() {
+  for (auto txn : txn_pool_) {
+    delete txn;
+  }
+  // the tables left must not unregister from a transaction manager that is gone
+  for (auto table : garbage_tables_) {
+    table->SetGarbageOwner(nullptr);
+  }
+}
 
 Transaction *TransactionManager::Begin(Transaction *txn, IsolationLevel isolation_level) {
-  // Acquire the global transaction latch in shared mode.
-  global_txn_latch_.RLock();
-
   if (txn == nullptr) {
-    txn = new Transaction(next_txn_id_++, isolation_level);
+    {
+      std::lock_guard<std::mutex> guard(txn_pool_latch_);
+      if (!txn_pool_.empty()) {
+        txn = txn_pool_.back();
+        txn_pool_.pop_back();
+      }
+    }
+    if (txn == nullptr) {
+      txn = new Transaction(next_txn_id_++, isolation_level);
+    } else {
+      txn->Reset(next_txn_id_++, isolation_level);
+    }
+    txn->SetAsyncCommit(async_commit_);
   }
 
-  txn_map[txn->GetTransactionId()] = txn;
+  // Register the transaction before its first record, so that a checkpoint either sees it or comes before it.
+  if (enable_logging) {
+    txn->SetFirstLogOffset(log_manager_->GetNextOffset());
+  }
+  // The snapshot is taken together with the registration, so GetOldestSnapshot never misses it.
+  active_txns_.Register(txn->GetTransactionId(), txn, [&] { txn->SetBeginTimestamp(last_commit_ts_); });
+  if (enable_logging) {
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::BEGIN);
+    txn->SetPrevLSN(log_manager_->AppendLogRecord(&log_record));
+  }
   return txn;
 }
 
 void TransactionManager::Commit(Transaction *txn) {
+  if (txn->GetIsolationLevel() == IsolationLevel::OPTIMISTIC && !InstallWrites(txn)) {
+    Abort(txn);
+    return;
+  }
   txn->SetState(TransactionState::COMMITTED);
 
   // Perform all deletes before we commit.
   auto write_set = txn->GetWriteSet();
-  while (!write_set->empty()) {
-    auto &item = write_set->back();
-    auto table = item.table_;
-    if (item.wtype_ == WType::DELETE) {
-      // Note that this also releases the lock when holding the page latch.
-      table->ApplyDelete(item.rid_, txn);
+  for (auto item = write_set->rbegin(); item != write_set->rend(); item++) {
+    if (item->wtype_ == WType::DELETE) {
+      item->table_->ApplyDelete(item->rid_, txn);
+    }
+  }
+
+  // The commit is durable once its log record is on disk; only then may other transactions see the effects.
+  // An asynchronous commit returns once the record is buffered and the flush thread writes it out within
+  // async_commit_window. The log is flushed in order, so a durable commit also makes every commit before it durable.
+  if (enable_logging) {
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::COMMIT);
+    lsn_t lsn = log_manager_->AppendLogRecord(&log_record);
+    txn->SetPrevLSN(lsn);
+    if (txn->IsAsyncCommit()) {
+      log_manager_->FlushLazily(lsn);
+    } else {
+      log_manager_->Flush(lsn);
+    }
+  }
+  active_txns_.Unregister(txn->GetTransactionId());
+
+  // Show the writes to the snapshots. Commits are stamped one at a time, so a snapshot taken meanwhile sees either all
+  // the writes of a commit or none.
+  if (!write_set->empty()) {
+    std::lock_guard<std::mutex> guard(commit_latch_);
+    txn->SetCommitTimestamp(last_commit_ts_ + 1);
+    for (const auto &item : *write_set) {
+      item.table_->CommitVersions(item.rid_, txn);
+      if (garbage_tables_.insert(item.table_).second) {
+        item.table_->SetGarbageOwner(this);
+      }
+    }
+    last_commit_ts_ = txn->GetCommitTimestamp();
+  }
+  // Unless a snapshot older than the commit runs, which takes SNAPSHOT or OPTIMISTIC transactions, nobody reads the
+  // versions the writes replaced. The transaction drops those of its own rows right away, still under its locks.
+  if (!write_set->empty()) {
+    timestamp_t oldest_ts = GetOldestSnapshot();
+    if (oldest_ts >= txn->GetCommitTimestamp()) {
+      for (const auto &item : *write_set) {
+        item.table_->PruneVersions(item.rid_, oldest_ts, item.wtype_ == WType::DELETE);
+      }
     }
-    write_set->pop_back();
   }
   write_set->clear();
+  txn->GetReadSet()->clear();
 
   // Release all the locks.
   ReleaseLocks(txn);
-  // Release the global transaction latch.
-  global_txn_latch_.RUnlock();
 }
 
 void TransactionManager::Abort(Transaction *txn) {
   txn->SetState(TransactionState::ABORTED);
-  // Rollback before releasing the lock.
+  // Rollback before releasing the lock. An optimistic transaction has written nothing, its buffered writes just go.
   auto table_write_set = txn->GetWriteSet();
-  while (!table_write_set->empty()) {
-    auto &item = table_write_set->back();
-    auto table = item.table_;
-    if (item.wtype_ == WType::DELETE) {
-      table->RollbackDelete(item.rid_, txn);
-    } else if (item.wtype_ == WType::INSERT) {
-      // Note that this also releases the lock when holding the page latch.
-      table->ApplyDelete(item.rid_, txn);
-    } else if (item.wtype_ == WType::UPDATE) {
-      table->UpdateTuple(item.tuple_, item.rid_, txn);
-    }
-    table_write_set->pop_back();
+  if (txn->GetIsolationLevel() != IsolationLevel::OPTIMISTIC) {
+    RollbackWrites(txn);
   }
   table_write_set->clear();
+  txn->GetReadSet()->clear();
   // Rollback index updates
   auto index_write_set = txn->GetIndexWriteSet();
   while (!index_write_set->empty()) {
@@ -100,14 +158,160 @@ void TransactionManager::Abort(Transaction *txn) {
   table_write_set->clear();
   index_write_set->clear();
 
+  if (enable_logging) {
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::ABORT);
+    txn->SetPrevLSN(log_manager_->AppendLogRecord(&log_record));
+  }
+  active_txns_.Unregister(txn->GetTransactionId());
+
   // Release all the locks.
   ReleaseLocks(txn);
-  // Release the global transaction latch.
-  global_txn_latch_.RUnlock();
 }
 
-void TransactionManager::BlockAllTransactions() { global_txn_latch_.WLock(); }
+void TransactionManager::Recycle(Transaction *txn) {
+  {
+    std::lock_guard<std::mutex> guard(txn_pool_latch_);
+    if (txn_pool_.size() < TXN_POOL_SIZE) {
+      txn_pool_.push_back(txn);
+      return;
+    }
+  }
+  delete txn;
+}
+
+void TransactionManager::SkipTransactionIds(txn_id_t txn_id) {
+  txn_id_t next = next_txn_id_;
+  while (next <= txn_id && !next_txn_id_.compare_exchange_weak(next, txn_id + 1)) {
+  }
+}
+
+int64_t TransactionManager::GetActiveTransactionTable(std::vector<std::pair<txn_id_t, lsn_t>> *active_txns) {
+  active_txns->clear();
+  int64_t undo_offset = -1;
+  active_txns_.ForEach([&](txn_id_t txn_id, Transaction *txn) {
+    active_txns->emplace_back(txn_id, txn->GetPrevLSN());
+    if (undo_offset == -1 || txn->GetFirstLogOffset() < undo_offset) {
+      undo_offset = txn->GetFirstLogOffset();
+    }
+  });
+  return undo_offset;
+}
+
+bool TransactionManager::InstallWrites(Transaction *txn) {
+  if (txn->GetState() == TransactionState::ABORTED) {
+    return false;
+  }
+  std::deque<TableWriteRecord> writes;
+  writes.swap(*txn->GetWriteSet());
+  // Lock the rows in (table, rid) order, so that committing optimistic transactions do not deadlock one another.
+  std::vector<std::pair<TableHeap *, RID>> rows;
+  for (const auto &write : writes) {
+    if (write.wtype_ != WType::INSERT) {
+      rows.emplace_back(write.table_, write.rid_);
+    }
+  }
+  std::sort(rows.begin(), rows.end(), [](const auto &a, const auto &b) {
+    if (a.first != b.first) {
+      return std::less<TableHeap *>()(a.first, b.first);
+    }
+    return a.second.Get() < b.second.Get();
+  });
+  bool valid = true;
+  for (const auto &row : rows) {
+    valid = valid && row.first->LockForWrite(row.second, txn);
+  }
+  {
+    std::lock_guard<std::mutex> guard(validation_latch_);
+    for (const auto &read : *txn->GetReadSet()) {
+      valid = valid && read.table_->ValidateRead(read.rid_, read.version_, txn);
+    }
+    if (!valid) {
+      txn->SetState(TransactionState::ABORTED);
+      return false;
+    }
+    // Only a validated transaction is committed, and the table heaps write through for it.
+    txn->SetState(TransactionState::COMMITTED);
+    for (const auto &write : writes) {
+      if (!valid) {
+        break;
+      }
+      if (write.wtype_ == WType::INSERT) {
+        RID rid;
+        valid = write.table_->InsertTuple(write.tuple_, &rid, txn);
+      } else if (write.wtype_ == WType::DELETE) {
+        valid = write.table_->MarkDelete(write.rid_, txn);
+      } else if (write.wtype_ == WType::UPDATE) {
+        valid = write.table_->UpdateTuple(write.tuple_, write.rid_, txn);
+      }
+    }
+  }
+  if (!valid) {
+    txn->SetState(TransactionState::ABORTED);
+    RollbackWrites(txn);
+  }
+  return valid;
+}
+
+void TransactionManager::RollbackWrites(Transaction *txn) {
+  auto table_write_set = txn->GetWriteSet();
+  while (!table_write_set->empty()) {
+    auto &item = table_write_set->back();
+    auto table = item.table_;
+    if (item.wtype_ == WType::DELETE) {
+      table->RollbackDelete(item.rid_, txn);
+    } else if (item.wtype_ == WType::INSERT) {
+      table->ApplyDelete(item.rid_, txn);
+    } else if (item.wtype_ == WType::UPDATE) {
+      table->UpdateTuple(item.tuple_, item.rid_, txn);
+    }
+    table_write_set->pop_back();
+  }
+}
+
+timestamp_t TransactionManager::GetOldestSnapshot() {
+  // Read before looking at the transactions: one that registers in a shard already visited takes its snapshot later,
+  // and so at or after oldest_ts.
+  timestamp_t oldest_ts = last_commit_ts_;
+  active_txns_.ForEach([&](txn_id_t /*txn_id*/, Transaction *txn) {
+    IsolationLevel isolation_level = txn->GetIsolationLevel();
+    if (isolation_level == IsolationLevel::SNAPSHOT || isolation_level == IsolationLevel::OPTIMISTIC) {
+      oldest_ts = std::min(oldest_ts, txn->GetBeginTimestamp());
+    }
+  });
+  return oldest_ts;
+}
+
+size_t TransactionManager::CollectGarbage(size_t max_rows) {
+  std::lock_guard<std::mutex> gc_guard(gc_latch_);
+  timestamp_t oldest_ts = GetOldestSnapshot();
+  std::vector<TableHeap *> tables;
+  {
+    std::lock_guard<std::mutex> guard(commit_latch_);
+    tables.assign(garbage_tables_.begin(), garbage_tables_.end());
+  }
+  size_t rows = 0;
+  for (auto table : tables) {
+    if (rows == max_rows) {
+      break;
+    }
+    rows += table->CollectGarbage(oldest_ts, max_rows - rows);
+  }
+  // commits queue their versions under commit_latch_, so a table dropped here has none left
+  std::lock_guard<std::mutex> guard(commit_latch_);
+  for (auto table : tables) {
+    if (!table->HasGarbage()) {
+      garbage_tables_.erase(table);
+      table->SetGarbageOwner(nullptr);
+    }
+  }
+  return rows;
+}
 
-void TransactionManager::ResumeTransactions() { global_txn_latch_.WUnlock(); }
+void TransactionManager::UnregisterTable(TableHeap *table) {
+  std::lock_guard<std::mutex> gc_guard(gc_latch_);
+  std::lock_guard<std::mutex> guard(commit_latch_);
+  garbage_tables_.erase(table);
+  table->SetGarbageOwner(nullptr);
+}
 
 }  // namespace bustub
@@ -0,0 +1,61 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// transaction_registry.cpp
+//
+// Identification: src/concurrency/transaction_registry.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "concurrency/transaction_registry.h"
+
+#include <algorithm>
+
+namespace bustub {
+
+TransactionRegistry::TransactionRegistry(size_t num_shards) : shards_(std::max<size_t>(num_shards, 1)) {}
+
+void TransactionRegistry::Register(txn_id_t txn_id, Transaction *txn, const std::function<void()> &on_register) {
+  Shard *shard = GetShard(txn_id);
+  std::lock_guard<std::mutex> guard(shard->latch_);
+  if (on_register != nullptr) {
+    on_register();
+  }
+  shard->txns_[txn_id] = txn;
+}
+
+void TransactionRegistry::Unregister(txn_id_t txn_id) {
+  Shard *shard = GetShard(txn_id);
+  std::lock_guard<std::mutex> guard(shard->latch_);
+  shard->txns_.erase(txn_id);
+}
+
+Transaction *TransactionRegistry::Find(txn_id_t txn_id) {
+  Shard *shard = GetShard(txn_id);
+  std::lock_guard<std::mutex> guard(shard->latch_);
+  auto txn = shard->txns_.find(txn_id);
+  return txn == shard->txns_.end() ? nullptr : txn->second;
+}
+
+void TransactionRegistry::ForEach(const std::function<void(txn_id_t, Transaction *)> &visit) {
+  for (auto &shard : shards_) {
+    std::lock_guard<std::mutex> guard(shard.latch_);
+    for (const auto &entry : shard.txns_) {
+      visit(entry.first, entry.second);
+    }
+  }
+}
+
+size_t TransactionRegistry::Size() {
+  size_t size = 0;
+  for (auto &shard : shards_) {
+    std::lock_guard<std::mutex> guard(shard.latch_);
+    size += shard.txns_.size();
+  }
+  return size;
+}
+
+}  // namespace bustub
@@ -12,9 +12,14 @@
 
 #pragma once
 
+#include <atomic>
+#include <condition_variable>  // NOLINT
+#include <functional>
 #include <list>
 #include <mutex>  // NOLINT
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "buffer/lru_replacer.h"
 #include "recovery/log_manager.h"
@@ -31,6 +36,12 @@ class BufferPoolManager {
   enum class CallbackType { BEFORE, AFTER };
   using bufferpool_callback_fn = void (*)(enum CallbackType, const page_id_t page_id);
 
+  /**
+   * Called whenever FetchPage reads a page from disk, with the page pinned and write latched but without the buffer
+   * pool latch. Returns true if it changed the page, and then sets the LSN and log offset of the oldest change.
+   */
+  using PageLoadHook = std::function<bool(Page *page, lsn_t *rec_lsn, int64_t *rec_offset)>;
+
   /**
    * Creates a new BufferPoolManager.
    * @param pool_size the size of the buffer pool
@@ -97,6 +108,36 @@ class BufferPoolManager {
   /** @return size of the buffer pool */
   size_t GetPoolSize() { return pool_size_; }
 
+  /**
+   * Take a snapshot of the dirty page table for a checkpoint. Pinned pages are included even when they are not marked
+   * dirty yet, since their holders may have logged changes that they have not unpinned.
+   * @param[out] dirty_pages (page_id, rec_lsn) of every page that may differ from its disk image
+   * @param[out] redo_offset smallest log offset redo has to start from for these pages, -1 if there are none
+   */
+  void GetDirtyPageTable(std::vector<std::pair<page_id_t, lsn_t>> *dirty_pages, int64_t *redo_offset);
+
+  /**
+   * Write a dirty page back to disk without holding the buffer pool latch during the I/O, so that other threads keep
+   * fetching and evicting pages meanwhile. The page is pinned and read latched while it is written, and the log is
+   * flushed up to the page LSN first.
+   * @param page_id id of the page to write back
+   * @return false if the page is not in the buffer pool
+   */
+  bool WriteBackPage(page_id_t page_id);
+
+  /** @return the log manager of the buffer pool, nullptr if there is none */
+  LogManager *GetLogManager() { return log_manager_; }
+
+  /** @return how many times eviction found no victim that could be written without waiting for a log flush */
+  size_t GetEvictionLogWaits() { return eviction_log_waits_; }
+
+  /**
+   * Install or remove the hook that sees every page read from disk, see PageLoadHook. Fetching the same page again
+   * waits on the page latch until the hook is done with it.
+   * @param hook the new hook, nullptr to remove it; returns once no call of the previous hook is running any more
+   */
+  void SetPageLoadHook(PageLoadHook hook);
+
  protected:
   /**
    * Grading function. Do not modify!
@@ -117,6 +158,14 @@ class BufferPoolManager {
    * @return the requested page
    */
   Page *FetchPageImpl(page_id_t page_id);
+
+  /**
+   * Find a frame for a new page, from the free list first and then from the replacer. With logging on, a dirty page may
+   * only be written once the log is persistent up to its LSN, so frames that can be written right away are preferred;
+   * the others trigger a background log flush. Only if every unpinned frame is ahead of the log does this wait for it.
+   * @param[out] frame_id the frame found
+   * @return the page of the frame, nullptr if every frame is pinned
+   */
   Page *FindFrame(frame_id_t *frame_id);
   /**
    * Unpin the target page from the buffer pool.
@@ -152,6 +201,9 @@ class BufferPoolManager {
    */
   void FlushAllPagesImpl();
 
+  /** Reset the recovery LSN of a page that is about to be handed out while nobody holds it and it is clean. */
+  void ResetRecLSN(Page *page);
+
   /** Number of pages in the buffer pool. */
   size_t pool_size_;
   /** Array of buffer pool pages. */
@@ -159,13 +211,20 @@ class BufferPoolManager {
   /** Pointer to the disk manager. */
   DiskManager *disk_manager_ __attribute__((__unused__));
   /** Pointer to the log manager. */
-  LogManager *log_manager_ __attribute__((__unused__));
+  LogManager *log_manager_;
   /** Page table for keeping track of buffer pool pages. */
   std::unordered_map<page_id_t, frame_id_t> page_table_;
   /** Replacer to find unpinned pages for replacement. */
   Replacer *replacer_;
   /** List of free pages. */
   std::list<frame_id_t> free_list_;
+  /** Number of evictions that had to wait for the log to be flushed. */
+  std::atomic<size_t> eviction_log_waits_{0};
+  /** Hook for pages read from disk, and the number of its calls still running, both guarded by latch_. */
+  PageLoadHook page_load_hook_;
+  size_t page_load_hook_calls_{0};
+  /** Notified when a hook call returns. */
+  std::condition_variable page_load_hook_cv_;
   /** This latch protects shared data structures. We recommend updating this comment to describe what it protects. */
   std::mutex latch_;
 };
@@ -14,6 +14,7 @@
 
 #include "buffer/buffer_pool_manager.h"
 #include "common/config.h"
+#include "concurrency/garbage_collector.h"
 #include "concurrency/lock_manager.h"
 #include "recovery/checkpoint_manager.h"
 #include "recovery/log_manager.h"
@@ -40,9 +41,13 @@ class BustubInstance {
 
     // checkpoints
     checkpoint_manager_ = new CheckpointManager(transaction_manager_, log_manager_, buffer_pool_manager_);
+
+    // Row versions held back by snapshots are collected in the background.
+    garbage_collector_ = new GarbageCollector(transaction_manager_);
   }
 
   ~BustubInstance() {
+    delete garbage_collector_;
     if (enable_logging) {
       log_manager_->StopFlushThread();
     }
@@ -60,6 +65,7 @@ class BustubInstance {
   TransactionManager *transaction_manager_;
   LogManager *log_manager_;
   CheckpointManager *checkpoint_manager_;
+  GarbageCollector *garbage_collector_;
 };
 
 }  // namespace bustub
@@ -27,19 +27,49 @@ extern std::atomic<bool> enable_logging;
 /** If ENABLE_LOGGING is true, the log should be flushed to disk every LOG_TIMEOUT. */
 extern std::chrono::duration<int64_t> log_timeout;
 
+/** An asynchronous commit reaches the disk at most ASYNC_COMMIT_WINDOW after it returns. */
+extern std::chrono::milliseconds async_commit_window;
+
+/** The checkpoint writer writes back at most CHECKPOINT_FLUSH_RATE dirty pages per second, 0 means no limit. */
+extern std::atomic<int> checkpoint_flush_rate;
+
+/** The garbage collector wakes up every GC_INTERVAL and then works for at most GC_TIME_SLICE. */
+extern std::chrono::milliseconds gc_interval;
+extern std::chrono::microseconds gc_time_slice;
+
+/** True if SharedLatch should count how often its latches are contended. */
+extern std::atomic<bool> enable_latch_stats;
+
+/** True if B+ tree writes first descend with read latches and write latch only the leaf, see BPlusTree. */
+extern std::atomic<bool> enable_optimistic_crabbing;
+
 static constexpr int INVALID_PAGE_ID = -1;                                    // invalid page id
 static constexpr int INVALID_TXN_ID = -1;                                     // invalid transaction id
 static constexpr int INVALID_LSN = -1;                                        // invalid log sequence number
+static constexpr int INVALID_TIMESTAMP = -1;                                  // invalid commit timestamp
 static constexpr int HEADER_PAGE_ID = 0;                                      // the header page id
 static constexpr int PAGE_SIZE = 4096;                                        // size of a data page in byte
 static constexpr int BUFFER_POOL_SIZE = 10;                                   // size of buffer pool
 static constexpr int LOG_BUFFER_SIZE = ((BUFFER_POOL_SIZE + 1) * PAGE_SIZE);  // size of a log buffer in byte
+static constexpr int LOG_SEGMENT_SIZE = 16 * 1024 * 1024;                     // size of a log segment file in byte
+static constexpr int LOG_SEGMENT_SPARES = 4;                                  // recycled log segments kept
 static constexpr int BUCKET_SIZE = 50;                                        // size of extendible hash bucket
+static constexpr int LOCK_TABLE_STRIPES = 64;                                 // partitions of the lock table
+static constexpr int LOCK_ESCALATION_THRESHOLD = 5000;                        // row locks per table before escalation
+static constexpr int LOCK_STATS_TOP_K = 16;                                   // hottest rows and tables tracked
+static constexpr int GC_BATCH_SIZE = 256;                                     // rows pruned per look at the clock
+static constexpr int LATCH_SPIN_COUNT = 64;                                   // latch retries before parking
+static constexpr int TXN_POOL_SIZE = 64;                                      // recycled transaction objects kept
+static constexpr int TXN_REGISTRY_SHARDS = 16;                                // partitions of the transaction registry
+static constexpr int TXN_PAGE_SET_SIZE = 16;                                  // latched index pages kept inline
+static constexpr int TXN_DELETED_PAGE_SET_SIZE = 4;                           // deleted index pages kept inline
+static constexpr int TXN_LOCK_SET_SIZE = 8;                                   // row locks of each mode kept inline
 
 using frame_id_t = int32_t;    // frame id type
 using page_id_t = int32_t;     // page id type
 using txn_id_t = int32_t;      // transaction id type
 using lsn_t = int32_t;         // log sequence number type
+using timestamp_t = int64_t;   // commit timestamp type
 using slot_offset_t = size_t;  // slot offset type
 using oid_t = uint16_t;
 
@@ -0,0 +1,168 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// inline_vector.h
+//
+// Identification: src/include/common/inline_vector.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstring>
+#include <functional>
+#include <type_traits>
+#include <unordered_map>
+
+#include "common/macros.h"
+
+namespace bustub {
+
+/**
+ * InlineVector is a vector that keeps its first N elements inside the object itself, and only allocates once it grows
+ * past them. Clear keeps the memory, so a vector that is reused does not allocate again either.
+ *
+ * The elements are moved around with memcpy, so they have to be trivially copyable.
+ */
+template <typename T, size_t N>
+class InlineVector {
+  static_assert(std::is_trivially_copyable<T>::value, "InlineVector moves its elements with memcpy");
+
+ public:
+  InlineVector() = default;
+
+  ~InlineVector() {
+    if (data_ != inline_) {
+      delete[] data_;
+    }
+  }
+
+  DISALLOW_COPY_AND_MOVE(InlineVector);
+
+  void push_back(const T &item) {
+    if (size_ == capacity_) {
+      Grow();
+    }
+    data_[size_++] = item;
+  }
+
+  void pop_back() { size_--; }
+
+  T &back() { return data_[size_ - 1]; }
+
+  T &operator[](size_t i) { return data_[i]; }
+
+  T *begin() { return data_; }
+
+  T *end() { return data_ + size_; }
+
+  size_t size() const { return size_; }
+
+  bool empty() const { return size_ == 0; }
+
+  /** Remove all the elements, keeping the memory. */
+  void clear() { size_ = 0; }
+
+ private:
+  void Grow() {
+    T *grown = new T[capacity_ * 2];
+    memcpy(static_cast<void *>(grown), static_cast<const void *>(data_), size_ * sizeof(T));
+    if (data_ != inline_) {
+      delete[] data_;
+    }
+    data_ = grown;
+    capacity_ *= 2;
+  }
+
+  T inline_[N];
+  T *data_{inline_};
+  size_t size_{0};
+  size_t capacity_{N};
+};
+
+/**
+ * InlineSet is a set kept in an InlineVector. While it is small it is searched element by element; once it outgrows
+ * its inline capacity it also keeps a hash index of the positions. Erasing moves the last element into the gap, so
+ * the order of the elements is not kept.
+ */
+template <typename T, size_t N, typename Hash = std::hash<T>>
+class InlineSet {
+ public:
+  InlineSet() = default;
+
+  DISALLOW_COPY_AND_MOVE(InlineSet);
+
+  /** @return true if item was inserted, false if the set held it already */
+  bool emplace(const T &item) {
+    if (find(item) != end()) {
+      return false;
+    }
+    items_.push_back(item);
+    if (!index_.empty()) {
+      index_.emplace(item, items_.size() - 1);
+    } else if (items_.size() > N) {
+      for (size_t i = 0; i < items_.size(); i++) {
+        index_.emplace(items_[i], i);
+      }
+    }
+    return true;
+  }
+
+  /** @return the number of items erased, 0 or 1 */
+  size_t erase(const T &item) {
+    T *found = find(item);
+    if (found == end()) {
+      return 0;
+    }
+    T *last = &items_.back();
+    if (!index_.empty()) {
+      index_[*last] = found - begin();
+      index_.erase(item);
+    }
+    *found = *last;
+    items_.pop_back();
+    return 1;
+  }
+
+  /** @return a pointer to item in the set, end() if it is not in the set */
+  T *find(const T &item) {
+    if (!index_.empty()) {
+      auto position = index_.find(item);
+      return position == index_.end() ? end() : begin() + position->second;
+    }
+    for (T *i = begin(); i != end(); i++) {
+      if (*i == item) {
+        return i;
+      }
+    }
+    return end();
+  }
+
+  size_t count(const T &item) { return find(item) == end() ? 0 : 1; }
+
+  T &back() { return items_.back(); }
+
+  T *begin() { return items_.begin(); }
+
+  T *end() { return items_.end(); }
+
+  size_t size() const { return items_.size(); }
+
+  bool empty() const { return items_.empty(); }
+
+  /** Remove all the items, keeping the memory of the vector. */
+  void clear() {
+    items_.clear();
+    index_.clear();
+  }
+
+ private:
+  InlineVector<T, N> items_;
+  /** The position of each item in items_, only kept once the set has outgrown N items. */
+  std::unordered_map<T, size_t, Hash> index_;
+};
+
+}  // namespace bustub
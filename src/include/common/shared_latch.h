@@ -0,0 +1,108 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// shared_latch.h
+//
+// Identification: src/include/common/shared_latch.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "common/config.h"
+#include "common/macros.h"
+
+namespace bustub {
+
+/**
+ * SharedLatch is a reader-writer latch kept in a single atomic word: the number of readers, a bit for the writer
+ * holding it and a bit for a writer waiting for it. Latching and unlatching it uncontended is one atomic instruction.
+ *
+ * A thread that cannot take the latch retries LATCH_SPIN_COUNT times, spinning at first and then yielding the core,
+ * and then parks on the word (a futex on Linux) until the latch changes hands. Writers are preferred: once a writer
+ * waits, new readers wait behind it.
+ *
+ * With enable_latch_stats set, the latch counts the acquisitions that had to wait and the times a thread parked.
+ */
+class SharedLatch {
+ public:
+  SharedLatch() = default;
+
+  DISALLOW_COPY(SharedLatch);
+
+  /**
+   * Acquire a write latch.
+   */
+  void WLock() {
+    uint32_t state = 0;
+    if (!state_.compare_exchange_strong(state, WRITER, std::memory_order_acquire)) {
+      WLockSlow();
+    }
+  }
+
+  /**
+   * Release a write latch.
+   */
+  void WUnlock() {
+    state_.fetch_and(~WRITER);
+    if (waiters_.load() > 0) {
+      Wake();
+    }
+  }
+
+  /**
+   * Acquire a read latch.
+   */
+  void RLock() {
+    uint32_t state = state_.load(std::memory_order_relaxed);
+    if ((state & (WRITER | WRITER_WAITING)) != 0 ||
+        !state_.compare_exchange_weak(state, state + 1, std::memory_order_acquire)) {
+      RLockSlow();
+    }
+  }
+
+  /**
+   * Release a read latch.
+   */
+  void RUnlock() {
+    // only a writer waits for the readers to leave
+    uint32_t state = state_.fetch_sub(1);
+    if ((state & READERS) == 1 && waiters_.load() > 0) {
+      Wake();
+    }
+  }
+
+  /** @return the number of acquisitions that could not take the latch right away, counted with enable_latch_stats */
+  uint32_t GetContentionCount() const { return contentions_.load(std::memory_order_relaxed); }
+
+  /** @return the number of times a thread parked on the latch, counted with enable_latch_stats */
+  uint32_t GetParkCount() const { return parks_.load(std::memory_order_relaxed); }
+
+ private:
+  static constexpr uint32_t WRITER = 1U << 31;
+  static constexpr uint32_t WRITER_WAITING = 1U << 30;
+  static constexpr uint32_t READERS = WRITER_WAITING - 1;
+
+  void WLockSlow();
+  void RLockSlow();
+
+  /** Sleep until the latch word is no longer state, or a thread releasing the latch wakes us. */
+  void Park(uint32_t state);
+
+  /** Wake every thread parked on the latch. */
+  void Wake();
+
+  std::atomic<uint32_t> state_{0};
+  /** The number of threads parked, so that releasing an uncontended latch skips the wake up. */
+  std::atomic<uint32_t> waiters_{0};
+  std::atomic<uint32_t> contentions_{0};
+  std::atomic<uint32_t> parks_{0};
+};
+
+}  // namespace bustub
@@ -0,0 +1,50 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// garbage_collector.h
+//
+// Identification: src/include/concurrency/garbage_collector.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <condition_variable>  // NOLINT
+#include <mutex>               // NOLINT
+#include <thread>              // NOLINT
+
+#include "concurrency/transaction_manager.h"
+
+namespace bustub {
+
+/**
+ * GarbageCollector prunes, in the background, the row versions that no running snapshot needs any more, and gives the
+ * slots of the rows deleted for good back to their pages (see TransactionManager::CollectGarbage).
+ *
+ * It runs alongside the transactions at a bounded share of one core: it wakes up every gc_interval and stops once it
+ * has worked for gc_time_slice, whether or not garbage is left. Every BustubInstance runs one from startup to shutdown.
+ */
+class GarbageCollector {
+ public:
+  explicit GarbageCollector(TransactionManager *transaction_manager);
+
+  ~GarbageCollector();
+
+ private:
+  /** Body of the collector thread. */
+  void RunGarbageCollector();
+
+  TransactionManager *transaction_manager_;
+  /** Tells the collector to exit. */
+  bool stop_{false};
+  /** Protects stop_. */
+  std::mutex latch_;
+  /** Wakes the collector up to exit. */
+  std::condition_variable cv_;
+  std::thread *collector_;
+};
+
+}  // namespace bustub
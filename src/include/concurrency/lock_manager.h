@@ -18,10 +18,12 @@
 #include <memory>
 #include <mutex>  // NOLINT
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include "common/rid.h"
+#include "concurrency/lock_stats.h"
 #include "concurrency/transaction.h"
 
 namespace bustub {
@@ -29,16 +31,36 @@ namespace bustub {
 class TransactionManager;
 
 /**
- * LockManager handles transactions asking for locks on records.
+ * How the lock manager deals with deadlocks. The prevention policies order transactions by their id, a smaller id
+ * being older, and never let a younger transaction wait for an older one.
  */
-class LockManager {
-  enum class LockMode { SHARED, EXCLUSIVE };
+enum class DeadlockPolicy {
+  /**
+   * Let deadlocks happen: a transaction about to wait aborts the youngest transaction of the cycle of waits it closes,
+   * and a background thread catches the cycles that slip through.
+   */
+  DETECTION,
+  /** An older transaction aborts the younger ones in its way, a younger one waits for an older one. */
+  WOUND_WAIT,
+  /** An older transaction waits for younger ones, a younger one aborts instead of waiting for an older one. */
+  WAIT_DIE
+};
 
+/**
+ * LockManager handles transactions asking for locks on records and on tables.
+ *
+ * Tables are locked with multiple granularity: a transaction that locks rows holds the matching intention lock on
+ * their table, so one that needs the whole table can lock it SHARED or EXCLUSIVE and then skip the row locks.
+ */
+class LockManager {
   class LockRequest {
    public:
-    LockRequest(txn_id_t txn_id, LockMode lock_mode) : txn_id_(txn_id), lock_mode_(lock_mode), granted_(false) {}
+    LockRequest(Transaction *txn, LockMode lock_mode)
+        : txn_id_(txn->GetTransactionId()), txn_(txn), lock_mode_(lock_mode), granted_(false) {}
 
     txn_id_t txn_id_;
+    /** The requesting transaction, which a deadlock policy may abort. */
+    Transaction *txn_;
     LockMode lock_mode_;
     bool granted_;
   };
@@ -50,23 +72,57 @@ class LockManager {
     bool upgrading_ = false;
   };
 
+  /**
+   * One partition of the lock table. A RID always hashes to the same stripe, and its queue is only touched under the
+   * latch of that stripe, so transactions locking RIDs of different stripes never wait for each other's latch.
+   */
+  class LockTableStripe {
+   public:
+    std::mutex latch_;
+    std::unordered_map<RID, LockRequestQueue> lock_table_;
+  };
+
+  /** The queue a transaction waits on, so that it can be woken up if it gets aborted meanwhile. */
+  class WaitSite {
+   public:
+    /** The latch guarding the queue. */
+    std::mutex *latch_;
+    /** The stripe holding the queue of rid_, nullptr for the queue of table oid_. */
+    LockTableStripe *stripe_;
+    RID rid_;
+    table_oid_t oid_;
+    /** The waiting transaction. */
+    Transaction *txn_{nullptr};
+  };
+
  public:
   /**
-   * Creates a new lock manager configured for the deadlock detection policy.
+   * Creates a new lock manager. Only the deadlock detection policy runs the cycle detection thread.
+   * @param deadlock_policy how deadlocks are dealt with
+   * @param num_stripes number of partitions of the lock table, 1 puts every RID under a single latch
    */
-  LockManager() {
-    enable_cycle_detection_ = true;
-    cycle_detection_thread_ = new std::thread(&LockManager::RunCycleDetection, this);
-    LOG_INFO("Cycle detection thread launched");
+  explicit LockManager(DeadlockPolicy deadlock_policy = DeadlockPolicy::DETECTION,
+                       size_t num_stripes = LOCK_TABLE_STRIPES)
+      : deadlock_policy_(deadlock_policy), stripes_(std::max<size_t>(num_stripes, 1)) {
+    enable_cycle_detection_ = deadlock_policy_ == DeadlockPolicy::DETECTION;
+    if (enable_cycle_detection_) {
+      cycle_detection_thread_ = new std::thread(&LockManager::RunCycleDetection, this);
+      LOG_INFO("Cycle detection thread launched");
+    }
   }
 
   ~LockManager() {
-    enable_cycle_detection_ = false;
-    cycle_detection_thread_->join();
-    delete cycle_detection_thread_;
-    LOG_INFO("Cycle detection thread stopped");
+    if (cycle_detection_thread_ != nullptr) {
+      enable_cycle_detection_ = false;
+      cycle_detection_thread_->join();
+      delete cycle_detection_thread_;
+      LOG_INFO("Cycle detection thread stopped");
+    }
   }
 
+  /** @return the deadlock policy of this lock manager */
+  inline DeadlockPolicy GetDeadlockPolicy() const { return deadlock_policy_; }
+
   /*
    * [LOCK_NOTE]: For all locking functions, we:
    * 1. return false if the transaction is aborted; and
@@ -99,6 +155,16 @@ class LockManager {
    */
   bool LockUpgrade(Transaction *txn, const RID &rid);
 
+  /**
+   * Wait until RID could be locked in exclusive mode, but do not keep the lock: it is let go of as soon as it is
+   * granted, without moving txn into the shrinking phase. An insert into a B+tree index uses this to wait for the scans
+   * holding a lock on the gap it inserts into. Otherwise as [LOCK_NOTE].
+   * @param txn the transaction requesting the lock
+   * @param rid the RID to be locked for an instant
+   * @return true if the lock could be granted, false otherwise
+   */
+  bool LockInstant(Transaction *txn, const RID &rid);
+
   /**
    * Release the lock held by the transaction.
    * @param txn the transaction releasing the lock, it should actually hold the lock
@@ -107,6 +173,52 @@ class LockManager {
    */
   bool Unlock(Transaction *txn, const RID &rid);
 
+  /**
+   * Acquire a lock on a table. A transaction that already holds a lock on the table has it upgraded to the weakest
+   * mode covering both, e.g. SHARED and INTENTION_EXCLUSIVE become SHARED_INTENTION_EXCLUSIVE. Otherwise as
+   * [LOCK_NOTE].
+   * @param txn the transaction requesting the lock
+   * @param oid the table to be locked
+   * @param lock_mode the mode to lock the table in
+   * @return true if the lock is granted, false otherwise
+   */
+  bool LockTable(Transaction *txn, table_oid_t oid, LockMode lock_mode);
+
+  /**
+   * Release the table lock held by the transaction.
+   * @param txn the transaction releasing the lock, it should actually hold the lock
+   * @param oid the table that is locked by the transaction
+   * @return true if the unlock is successful, false otherwise
+   */
+  bool UnlockTable(Transaction *txn, table_oid_t oid);
+
+  /**
+   * Escalate the row locks txn holds on a table to a single table lock: lock the table SHARED, or EXCLUSIVE if any of
+   * the rows is locked exclusively or exclusive is set, then release the row locks, which the table lock covers from
+   * then on. Only the rows in the table row lock set of txn are known to belong to the table.
+   * @param txn the transaction holding the row locks
+   * @param oid the table the rows belong to
+   * @param exclusive true if txn is about to write the table
+   * @return true if the table lock is granted, false otherwise
+   */
+  bool EscalateLocks(Transaction *txn, table_oid_t oid, bool exclusive);
+
+  /** @return number of row locks a transaction may hold on one table before they are escalated, 0 if never */
+  inline size_t GetEscalationThreshold() const { return escalation_threshold_; }
+
+  /** @param threshold number of row locks a transaction may hold on one table before they are escalated, 0 if never */
+  inline void SetEscalationThreshold(size_t threshold) { escalation_threshold_ = threshold; }
+
+  /** @return the contention profile of this lock manager, which can be read and reset while it runs */
+  inline LockStats *GetStats() { return &stats_; }
+
+  /**
+   * @param held the mode a table is locked in
+   * @param requested the mode of a lock request
+   * @return true if holding the lock in mode held implies holding it in mode requested
+   */
+  static bool Covers(LockMode held, LockMode requested);
+
   /*** Graph API ***/
   /**
    * Adds edge t1->t2
@@ -128,18 +240,110 @@ class LockManager {
   /** @return the set of all edges in the graph, used for testing only! */
   std::vector<std::pair<txn_id_t, txn_id_t>> GetEdgeList();
 
-  /** Runs cycle detection in the background. */
+  /** Runs cycle detection on the waits-for graph in the background, as a fallback to the detection on waiting. */
   void RunCycleDetection();
 
  private:
+  /** Waits-for graph, the transactions each transaction waits for. */
+  using WaitsForGraph = std::unordered_map<txn_id_t, std::vector<txn_id_t>>;
+
+  /** @return the stripe of the lock table holding the queue of rid */
+  LockTableStripe *GetStripe(const RID &rid);
+
+  /**
+   * Wait until the request of txn can be granted and grant it, applying the deadlock policy while it cannot.
+   * @param request the request of txn, already in queue
+   * @param site where queue is, its latch is held in latch
+   * @return false if txn was aborted while waiting, its request has been removed then
+   */
+  bool WaitForGrant(Transaction *txn, LockRequestQueue *queue, std::list<LockRequest>::iterator request,
+                    const WaitSite &site, std::unique_lock<std::mutex> *latch);
+
+  /**
+   * Apply wound-wait or wait-die to a request that cannot be granted: abort txn for wait-die if any of the requests in
+   * its way is older, or abort the younger growing transactions in its way for wound-wait.
+   * @param[out] victims the transactions aborted by wound-wait, which have to be woken up
+   */
+  void PreventDeadlock(Transaction *txn, const LockRequestQueue &queue, std::list<LockRequest>::iterator request,
+                       std::vector<txn_id_t> *victims);
+
+  /**
+   * Point the waits-for edges of txn at the requests now in the way of its request, and abort the youngest transaction
+   * of the cycle this closes, if any.
+   * @param[out] victims the transaction aborted if it is not txn, which has to be woken up
+   */
+  void DetectDeadlock(Transaction *txn, const LockRequestQueue &queue, std::list<LockRequest>::iterator request,
+                      std::vector<txn_id_t> *victims);
+
+  /** Wake up txn_id if it is waiting for a lock, no latch may be held. */
+  void WakeUp(txn_id_t txn_id);
+
+  /**
+   * @param[out] blockers the requests of other transactions that keep the request from being granted
+   */
+  static void GetBlockers(const LockRequestQueue &queue, std::list<LockRequest>::iterator request,
+                          std::vector<const LockRequest *> *blockers);
+
+  /** HasCycle on the given graph, which the caller guards. */
+  static bool FindVictim(WaitsForGraph *graph, txn_id_t *txn_id);
+
+  /** DFS for FindVictim, true once a cycle is found, which is then on the path from its first node on. */
+  static bool FindCycle(const WaitsForGraph &graph, txn_id_t txn_id, std::vector<txn_id_t> *path,
+                        std::unordered_set<txn_id_t> *on_path, std::unordered_set<txn_id_t> *visited);
+
+  /**
+   * @return true if the request can be granted, i.e. it is compatible with every granted request and, as requests are
+   * granted in FIFO order, with every request waiting ahead of it
+   */
+  static bool IsGrantable(const LockRequestQueue &queue, std::list<LockRequest>::iterator request);
+
+  /** @return true if two transactions may hold locks in these modes on the same object at once */
+  static bool AreCompatible(LockMode mode1, LockMode mode2);
+
+  /**
+   * Replace the granted request of txn with one in lock_mode that waits ahead of every other waiting request, and wait
+   * for it to be granted. Aborts if another transaction is upgrading on the same queue already.
+   * @return false if txn was aborted while waiting, it holds no lock on the queue any more then
+   */
+  bool UpgradeRequest(Transaction *txn, LockRequestQueue *queue, LockMode lock_mode, const WaitSite &site,
+                      std::unique_lock<std::mutex> *latch);
+
+  /**
+   * Remove the request of txn for rid from the lock table, leaving the lock sets of txn alone.
+   * @return false if rid is not locked
+   */
+  bool RemoveRowRequest(Transaction *txn, const RID &rid);
+
+  /** Remove the request of txn from queue and wake up the waiters. */
+  void RemoveRequest(Transaction *txn, LockRequestQueue *queue);
+
+  /** Drop the waits-for edges from the waiters of queue to txn_id, whose request has left it. */
+  void ForgetBlocker(const LockRequestQueue &queue, txn_id_t txn_id);
+
+  /** Move a growing transaction into the shrinking phase when it gives up a lock of this mode. */
+  static void UpdateStateOnUnlock(Transaction *txn, LockMode lock_mode);
+
+  /** Abort txn for reason and throw. */
+  [[noreturn]] void AbortTransaction(Transaction *txn, AbortReason reason);
+
+  DeadlockPolicy deadlock_policy_;
+
+  /** Guards the waits-for graph and waiting_. */
   std::mutex latch_;
   std::atomic<bool> enable_cycle_detection_;
-  std::thread *cycle_detection_thread_;
+  std::thread *cycle_detection_thread_{nullptr};
+  /** Where each waiting transaction waits. */
+  std::unordered_map<txn_id_t, WaitSite> waiting_;
 
-  /** Lock table for lock requests. */
-  std::unordered_map<RID, LockRequestQueue> lock_table_;
-  /** Waits-for graph representation. */
-  std::unordered_map<txn_id_t, std::vector<txn_id_t>> waits_for_;
+  /** Lock table for lock requests, partitioned by the hash of the RID. */
+  std::vector<LockTableStripe> stripes_;
+  /** Lock requests on tables. A transaction asks for a table lock at most once per mode, so one latch suffices. */
+  std::mutex table_latch_;
+  std::unordered_map<table_oid_t, LockRequestQueue> table_lock_table_;
+  std::atomic<size_t> escalation_threshold_{LOCK_ESCALATION_THRESHOLD};
+  /** Waits-for graph representation, kept up to date by the waiting transactions. */
+  WaitsForGraph waits_for_;
+  LockStats stats_;
 };
 
 }  // namespace bustub
@@ -0,0 +1,160 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lock_stats.h
+//
+// Identification: src/include/concurrency/lock_stats.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <mutex>   // NOLINT
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common/config.h"
+#include "common/rid.h"
+#include "concurrency/transaction.h"
+
+namespace bustub {
+
+/**
+ * HotSpotSketch finds the keys seen most often in a stream with a fixed number of counters (the Space-Saving
+ * algorithm): a key without a counter takes over the smallest one. A key seen more than 1/k of the time always has a
+ * counter, and its count overestimates by at most the count it took over.
+ */
+template <typename Key>
+class HotSpotSketch {
+ public:
+  explicit HotSpotSketch(size_t num_counters) : num_counters_(num_counters) {}
+
+  void Add(const Key &key) {
+    std::lock_guard<std::mutex> guard(latch_);
+    Counter *smallest = nullptr;
+    for (auto &counter : counters_) {
+      if (counter.key_ == key) {
+        counter.count_++;
+        return;
+      }
+      if (smallest == nullptr || counter.count_ < smallest->count_) {
+        smallest = &counter;
+      }
+    }
+    if (counters_.size() < num_counters_) {
+      counters_.push_back({key, 1});
+      return;
+    }
+    smallest->key_ = key;
+    smallest->count_++;
+  }
+
+  /** @return the keys with a counter and their counts, most seen first */
+  std::vector<std::pair<Key, uint64_t>> GetTop() {
+    std::vector<std::pair<Key, uint64_t>> top;
+    {
+      std::lock_guard<std::mutex> guard(latch_);
+      for (const auto &counter : counters_) {
+        top.emplace_back(counter.key_, counter.count_);
+      }
+    }
+    std::stable_sort(top.begin(), top.end(), [](const auto &a, const auto &b) { return a.second > b.second; });
+    return top;
+  }
+
+  void Clear() {
+    std::lock_guard<std::mutex> guard(latch_);
+    counters_.clear();
+  }
+
+ private:
+  struct Counter {
+    Key key_;
+    uint64_t count_;
+  };
+
+  size_t num_counters_;
+  std::mutex latch_;
+  std::vector<Counter> counters_;
+};
+
+/**
+ * LockStats profiles the contention on the locks of a LockManager: how long requests wait for a lock in each mode,
+ * how many locks are upgraded, why transactions abort, and which rows and tables are waited for the most.
+ *
+ * Only the requests that have to wait are timed and sketched, and everything else is a relaxed counter, so granting a
+ * free lock costs nothing extra and the stats can stay on.
+ */
+class LockStats {
+ public:
+  /** Wait times are kept in power of two buckets of microseconds: bucket 0 is under 1us, bucket b under 2^b us. */
+  static constexpr int NUM_WAIT_BUCKETS = 32;
+  static constexpr int NUM_LOCK_MODES = 5;
+  static constexpr int NUM_ABORT_REASONS = 5;
+
+  LockStats() : hot_rows_(LOCK_STATS_TOP_K), hot_tables_(LOCK_STATS_TOP_K) {}
+
+  /** Count a request for a row lock that had to wait. */
+  void RecordContention(const RID &rid) { hot_rows_.Add(rid); }
+
+  /** Count a request for a table lock that had to wait. */
+  void RecordContention(table_oid_t oid) { hot_tables_.Add(oid); }
+
+  /** Count how long a request in mode waited, whether it was granted or aborted in the end. */
+  void RecordWait(LockMode mode, std::chrono::microseconds wait);
+
+  void RecordUpgrade(bool table) { (table ? table_upgrades_ : row_upgrades_).fetch_add(1, std::memory_order_relaxed); }
+
+  void RecordAbort(AbortReason reason) {
+    aborts_[static_cast<int>(reason)].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /** @return the number of requests in mode that waited */
+  uint64_t GetWaitCount(LockMode mode);
+
+  /**
+   * @param mode the lock mode
+   * @param percentile between 0 and 100
+   * @return an upper bound of the wait time of that percentile of the requests in mode that waited, 0 if none did
+   */
+  std::chrono::microseconds GetWaitPercentile(LockMode mode, double percentile);
+
+  /** @return the number of upgrades of row locks, or of table locks */
+  uint64_t GetUpgradeCount(bool table) {
+    return (table ? table_upgrades_ : row_upgrades_).load(std::memory_order_relaxed);
+  }
+
+  /** @return the number of transactions the lock manager aborted for reason */
+  uint64_t GetAbortCount(AbortReason reason) {
+    return aborts_[static_cast<int>(reason)].load(std::memory_order_relaxed);
+  }
+
+  /** @return the rows waited for the most, with the number of waits, most waited for first */
+  std::vector<std::pair<RID, uint64_t>> GetHotRows() { return hot_rows_.GetTop(); }
+
+  /** @return the tables waited for the most, with the number of waits, most waited for first */
+  std::vector<std::pair<table_oid_t, uint64_t>> GetHotTables() { return hot_tables_.GetTop(); }
+
+  /** @return a readable dump of the stats */
+  std::string ToString();
+
+  /** Start counting from zero. */
+  void Reset();
+
+ private:
+  std::atomic<uint64_t> waits_[NUM_LOCK_MODES][NUM_WAIT_BUCKETS]{};
+  std::atomic<uint64_t> row_upgrades_{0};
+  std::atomic<uint64_t> table_upgrades_{0};
+  std::atomic<uint64_t> aborts_[NUM_ABORT_REASONS]{};
+  HotSpotSketch<RID> hot_rows_;
+  HotSpotSketch<table_oid_t> hot_tables_;
+};
+
+}  // namespace bustub
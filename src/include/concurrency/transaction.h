@@ -14,12 +14,13 @@
 
 #include <atomic>
 #include <deque>
-#include <memory>
 #include <string>
 #include <thread>  // NOLINT
-#include <unordered_set>
+#include <unordered_map>
+#include <vector>
 
 #include "common/config.h"
+#include "common/inline_vector.h"
 #include "common/logger.h"
 #include "storage/page/page.h"
 #include "storage/table/tuple.h"
@@ -44,9 +45,22 @@ namespace bustub {
 enum class TransactionState { GROWING, SHRINKING, COMMITTED, ABORTED };
 
 /**
- * Transaction isolation level.
+ * Transaction isolation level. SERIALIZABLE locks rows like REPEATABLE_READ, and on top of that locks the key ranges
+ * it reads through a B+tree index, so that no other transaction can insert a phantom into them (see BPlusTreeIndex).
+ *
+ * SNAPSHOT reads every row as of the start of the transaction without locking it, and
+ * aborts a write to a row that another transaction wrote after that start.
+ *
+ * OPTIMISTIC takes no locks while it runs: it reads the newest committed version of each row and buffers its writes.
+ * Commit validates that no row it read has changed since and installs the writes, or aborts the transaction instead.
+ */
+enum class IsolationLevel { READ_UNCOMMITTED, REPEATABLE_READ, READ_COMMITTED, SNAPSHOT, OPTIMISTIC, SERIALIZABLE };
+
+/**
+ * Lock modes. Rows are only locked SHARED or EXCLUSIVE, tables may also be locked with the intention modes, which
+ * announce row locks of the same kind underneath (SHARED_INTENTION_EXCLUSIVE is SHARED plus INTENTION_EXCLUSIVE).
  */
-enum class IsolationLevel { READ_UNCOMMITTED, REPEATABLE_READ, READ_COMMITTED };
+enum class LockMode { SHARED, EXCLUSIVE, INTENTION_SHARED, INTENTION_EXCLUSIVE, SHARED_INTENTION_EXCLUSIVE };
 
 /**
  * Type of write operation.
@@ -58,6 +72,9 @@ class Catalog;
 using table_oid_t = uint32_t;
 using index_oid_t = uint32_t;
 
+/** Marks a table heap that does not belong to a table of the catalog, its rows are locked without table locks. */
+static constexpr table_oid_t INVALID_TABLE_OID = static_cast<table_oid_t>(-1);
+
 /**
  * WriteRecord tracks information related to a write.
  */
@@ -68,12 +85,29 @@ class TableWriteRecord {
 
   RID rid_;
   WType wtype_;
-  /** The tuple is only used for the update operation. */
+  /**
+   * The tuple is only used for the update operation, it is the old tuple. A write buffered by an OPTIMISTIC
+   * transaction holds the new tuple instead, also for an insert, whose rid is only known once it is installed.
+   */
   Tuple tuple_;
   /** The table heap specifies which table this write record is for. */
   TableHeap *table_;
 };
 
+/**
+ * ReadRecord tracks a row read by an OPTIMISTIC transaction, which validates it at commit.
+ */
+class TableReadRecord {
+ public:
+  TableReadRecord(RID rid, timestamp_t version, TableHeap *table) : rid_(rid), version_(version), table_(table) {}
+
+  RID rid_;
+  /** The commit timestamp of the newest write to the row that the read saw, 0 if no write is kept for the row. */
+  timestamp_t version_;
+  /** The table heap specifies which table this read record is for. */
+  TableHeap *table_;
+};
+
 /**
  * WriteRecord tracks information related to a write.
  */
@@ -148,25 +182,49 @@ class TransactionAbortException : public std::exception {
  */
 class Transaction {
  public:
+  /** The sets of a short transaction fit into the transaction object, see InlineVector. */
+  using PageSet = InlineVector<Page *, TXN_PAGE_SET_SIZE>;
+  using DeletedPageSet = InlineSet<page_id_t, TXN_DELETED_PAGE_SET_SIZE>;
+  using LockSet = InlineSet<RID, TXN_LOCK_SET_SIZE>;
+
   explicit Transaction(txn_id_t txn_id, IsolationLevel isolation_level = IsolationLevel::REPEATABLE_READ)
       : state_(TransactionState::GROWING),
         isolation_level_(isolation_level),
         thread_id_(std::this_thread::get_id()),
         txn_id_(txn_id),
-        prev_lsn_(INVALID_LSN),
-        shared_lock_set_{new std::unordered_set<RID>},
-        exclusive_lock_set_{new std::unordered_set<RID>} {
-    // Initialize the sets that will be tracked.
-    table_write_set_ = std::make_shared<std::deque<TableWriteRecord>>();
-    index_write_set_ = std::make_shared<std::deque<IndexWriteRecord>>();
-    page_set_ = std::make_shared<std::deque<bustub::Page *>>();
-    deleted_page_set_ = std::make_shared<std::unordered_set<page_id_t>>();
-  }
+        prev_lsn_(INVALID_LSN) {}
 
   ~Transaction() = default;
 
   DISALLOW_COPY(Transaction);
 
+  /**
+   * Start over as a new transaction. The sets are emptied but keep their memory, which is how TransactionManager
+   * recycles transaction objects without allocating.
+   * @param txn_id the id of the new transaction
+   * @param isolation_level its isolation level
+   */
+  void Reset(txn_id_t txn_id, IsolationLevel isolation_level) {
+    state_ = TransactionState::GROWING;
+    isolation_level_ = isolation_level;
+    thread_id_ = std::this_thread::get_id();
+    txn_id_ = txn_id;
+    prev_lsn_ = INVALID_LSN;
+    first_log_offset_ = 0;
+    async_commit_ = false;
+    begin_ts_ = 0;
+    commit_ts_ = INVALID_TIMESTAMP;
+    table_write_set_.clear();
+    table_read_set_.clear();
+    index_write_set_.clear();
+    page_set_.clear();
+    deleted_page_set_.clear();
+    shared_lock_set_.clear();
+    exclusive_lock_set_.clear();
+    table_lock_set_.clear();
+    table_row_lock_set_.clear();
+  }
+
   /** @return the id of the thread running the transaction */
   inline std::thread::id GetThreadId() const { return thread_id_; }
 
@@ -177,20 +235,23 @@ class Transaction {
   inline IsolationLevel GetIsolationLevel() const { return isolation_level_; }
 
   /** @return the list of table write records of this transaction */
-  inline std::shared_ptr<std::deque<TableWriteRecord>> GetWriteSet() { return table_write_set_; }
+  inline std::deque<TableWriteRecord> *GetWriteSet() { return &table_write_set_; }
+
+  /** @return the list of table read records of this transaction, only kept for an OPTIMISTIC transaction */
+  inline std::deque<TableReadRecord> *GetReadSet() { return &table_read_set_; }
 
   /** @return the list of index write records of this transaction */
-  inline std::shared_ptr<std::deque<IndexWriteRecord>> GetIndexWriteSet() { return index_write_set_; }
+  inline std::deque<IndexWriteRecord> *GetIndexWriteSet() { return &index_write_set_; }
 
   /** @return the page set */
-  inline std::shared_ptr<std::deque<Page *>> GetPageSet() { return page_set_; }
+  inline PageSet *GetPageSet() { return &page_set_; }
 
   /**
    * Adds a tuple write record into the table write set.
    * @param write_record write record to be added
    */
   inline void AppendTableWriteRecord(const TableWriteRecord &write_record) {
-    table_write_set_->push_back(write_record);
+    table_write_set_.push_back(write_record);
   }
 
   /**
@@ -198,35 +259,55 @@ class Transaction {
    * @param write_record write record to be added
    */
   inline void AppendTableWriteRecord(const IndexWriteRecord &write_record) {
-    index_write_set_->push_back(write_record);
+    index_write_set_.push_back(write_record);
   }
 
   /**
    * Adds a page into the page set.
    * @param page page to be added
    */
-  inline void AddIntoPageSet(Page *page) { page_set_->push_back(page); }
+  inline void AddIntoPageSet(Page *page) { page_set_.push_back(page); }
 
   /** @return the deleted page set */
-  inline std::shared_ptr<std::unordered_set<page_id_t>> GetDeletedPageSet() { return deleted_page_set_; }
+  inline DeletedPageSet *GetDeletedPageSet() { return &deleted_page_set_; }
 
   /**
    * Adds a page to the deleted page set.
    * @param page_id id of the page to be marked as deleted
    */
-  inline void AddIntoDeletedPageSet(page_id_t page_id) { deleted_page_set_->insert(page_id); }
+  inline void AddIntoDeletedPageSet(page_id_t page_id) { deleted_page_set_.emplace(page_id); }
 
   /** @return the set of resources under a shared lock */
-  inline std::shared_ptr<std::unordered_set<RID>> GetSharedLockSet() { return shared_lock_set_; }
+  inline LockSet *GetSharedLockSet() { return &shared_lock_set_; }
 
   /** @return the set of resources under an exclusive lock */
-  inline std::shared_ptr<std::unordered_set<RID>> GetExclusiveLockSet() { return exclusive_lock_set_; }
+  inline LockSet *GetExclusiveLockSet() { return &exclusive_lock_set_; }
+
+  /** @return the tables locked by this transaction and the mode of each lock */
+  inline std::unordered_map<table_oid_t, LockMode> *GetTableLockSet() { return &table_lock_set_; }
+
+  /** @return the rows locked by this transaction under each of its table locks, for lock escalation */
+  inline std::unordered_map<table_oid_t, std::vector<RID>> *GetTableRowLockSet() { return &table_row_lock_set_; }
+
+  /**
+   * @param oid the table
+   * @param[out] lock_mode the mode the table is locked in
+   * @return true if the table is locked by this transaction
+   */
+  bool GetTableLockMode(table_oid_t oid, LockMode *lock_mode) {
+    auto lock = table_lock_set_.find(oid);
+    if (lock == table_lock_set_.end()) {
+      return false;
+    }
+    *lock_mode = lock->second;
+    return true;
+  }
 
   /** @return true if rid is shared locked by this transaction */
-  bool IsSharedLocked(const RID &rid) { return shared_lock_set_->find(rid) != shared_lock_set_->end(); }
+  bool IsSharedLocked(const RID &rid) { return shared_lock_set_.find(rid) != shared_lock_set_.end(); }
 
   /** @return true if rid is exclusively locked by this transaction */
-  bool IsExclusiveLocked(const RID &rid) { return exclusive_lock_set_->find(rid) != exclusive_lock_set_->end(); }
+  bool IsExclusiveLocked(const RID &rid) { return exclusive_lock_set_.find(rid) != exclusive_lock_set_.end(); }
 
   /** @return the current state of the transaction */
   inline TransactionState GetState() { return state_; }
@@ -246,6 +327,42 @@ class Transaction {
    */
   inline void SetPrevLSN(lsn_t prev_lsn) { prev_lsn_ = prev_lsn; }
 
+  /** @return the log offset at or before the first record of this transaction */
+  inline int64_t GetFirstLogOffset() { return first_log_offset_; }
+
+  /**
+   * Set the log offset at or before the first record of this transaction.
+   * @param offset the log offset
+   */
+  inline void SetFirstLogOffset(int64_t offset) { first_log_offset_ = offset; }
+
+  /** @return the commit timestamp of the last commit before this transaction began, which its snapshot sees */
+  inline timestamp_t GetBeginTimestamp() { return begin_ts_; }
+
+  /**
+   * Set the snapshot of the transaction.
+   * @param begin_ts the commit timestamp of the last commit before the transaction began
+   */
+  inline void SetBeginTimestamp(timestamp_t begin_ts) { begin_ts_ = begin_ts; }
+
+  /** @return the commit timestamp of this transaction, INVALID_TIMESTAMP until it commits */
+  inline timestamp_t GetCommitTimestamp() { return commit_ts_; }
+
+  /**
+   * Set the commit timestamp of the transaction.
+   * @param commit_ts the commit timestamp
+   */
+  inline void SetCommitTimestamp(timestamp_t commit_ts) { commit_ts_ = commit_ts; }
+
+  /** @return true if the commit of this transaction does not wait for its COMMIT record to reach the disk */
+  inline bool IsAsyncCommit() { return async_commit_; }
+
+  /**
+   * Choose between a durable and an asynchronous commit for this transaction.
+   * @param async_commit true to return from Commit as soon as the COMMIT record is in the log buffer
+   */
+  inline void SetAsyncCommit(bool async_commit) { async_commit_ = async_commit; }
+
  private:
   /** The current transaction state. */
   TransactionState state_;
@@ -256,22 +373,36 @@ class Transaction {
   /** The ID of this transaction. */
   txn_id_t txn_id_;
 
-  /** The undo set of table tuples. */
-  std::shared_ptr<std::deque<TableWriteRecord>> table_write_set_;
+  /** The undo set of table tuples, or the buffered writes of an OPTIMISTIC transaction. */
+  std::deque<TableWriteRecord> table_write_set_;
+  /** The rows read by an OPTIMISTIC transaction. */
+  std::deque<TableReadRecord> table_read_set_;
   /** The undo set of indexes. */
-  std::shared_ptr<std::deque<IndexWriteRecord>> index_write_set_;
+  std::deque<IndexWriteRecord> index_write_set_;
   /** The LSN of the last record written by the transaction. */
   lsn_t prev_lsn_;
+  /** A log offset at or before the first record written by the transaction, recovery reads its records from there. */
+  int64_t first_log_offset_{0};
+  /** Whether the commit may be lost if the system crashes within async_commit_window after it. */
+  bool async_commit_{false};
+  /** The snapshot of the transaction, it sees the commits with a timestamp up to this one. */
+  timestamp_t begin_ts_{0};
+  /** The commit timestamp, the versions written by the transaction carry it once it commits. */
+  timestamp_t commit_ts_{INVALID_TIMESTAMP};
 
   /** Concurrent index: the pages that were latched during index operation. */
-  std::shared_ptr<std::deque<Page *>> page_set_;
+  PageSet page_set_;
   /** Concurrent index: the page IDs that were deleted during index operation.*/
-  std::shared_ptr<std::unordered_set<page_id_t>> deleted_page_set_;
+  DeletedPageSet deleted_page_set_;
 
   /** LockManager: the set of shared-locked tuples held by this transaction. */
-  std::shared_ptr<std::unordered_set<RID>> shared_lock_set_;
+  LockSet shared_lock_set_;
   /** LockManager: the set of exclusive-locked tuples held by this transaction. */
-  std::shared_ptr<std::unordered_set<RID>> exclusive_lock_set_;
+  LockSet exclusive_lock_set_;
+  /** LockManager: the tables locked by this transaction. */
+  std::unordered_map<table_oid_t, LockMode> table_lock_set_;
+  /** LockManager: the row locks taken under each table lock, only tracked for the table heaps of catalog tables. */
+  std::unordered_map<table_oid_t, std::vector<RID>> table_row_lock_set_;
 };
 
 }  // namespace bustub
@@ -13,16 +13,20 @@
 #pragma once
 
 #include <atomic>
-#include <unordered_map>
+#include <mutex>  // NOLINT
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "common/config.h"
 #include "concurrency/lock_manager.h"
 #include "concurrency/transaction.h"
+#include "concurrency/transaction_registry.h"
 #include "recovery/log_manager.h"
 
 namespace bustub {
 class LockManager;
+class TableHeap;
 
 /**
  * TransactionManager keeps track of all the transactions running in the system.
@@ -32,22 +36,29 @@ class TransactionManager {
   explicit TransactionManager(LockManager *lock_manager, LogManager *log_manager = nullptr)
       : lock_manager_(lock_manager), log_manager_(log_manager) {}
 
-  ~TransactionManager() = default;
+  ~TransactionManager();
 
   /**
    * Begins a new transaction.
-   * @param txn an optional transaction object to be initialized, otherwise a new transaction is created.
+   * @param txn an optional transaction object to be initialized, otherwise a recycled or a new transaction is used.
    * @param isolation_level an optional isolation level of the transaction.
    * @return an initialized transaction
    */
   Transaction *Begin(Transaction *txn = nullptr, IsolationLevel isolation_level = IsolationLevel::REPEATABLE_READ);
 
   /**
-   * Commits a transaction.
+   * Commits a transaction. Unless the transaction asked for an asynchronous commit, this waits for the COMMIT record
+   * to reach the disk. An OPTIMISTIC transaction whose reads fail validation aborts instead, and is left ABORTED.
    * @param txn the transaction to commit
    */
   void Commit(Transaction *txn);
 
+  /**
+   * Set whether transactions created by Begin commit asynchronously, see Transaction::SetAsyncCommit.
+   * @param async_commit the default commit mode of new transactions
+   */
+  inline void SetAsyncCommit(bool async_commit) { async_commit_ = async_commit; }
+
   /**
    * Aborts a transaction
    * @param txn the transaction to abort
@@ -55,54 +66,111 @@ class TransactionManager {
   void Abort(Transaction *txn);
 
   /**
-   * Global list of running transactions
+   * Hand a finished transaction back, instead of deleting it, so that Begin can reuse the object and the memory of its
+   * sets. Up to TXN_POOL_SIZE transactions are kept, the rest are deleted.
+   * @param txn a committed or aborted transaction created by Begin, which the caller must not use any more
    */
+  void Recycle(Transaction *txn);
 
-  /** The transaction map is a global list of all the running transactions in the system. */
-  static std::unordered_map<txn_id_t, Transaction *> txn_map;
+  /**
+   * Hand out only transaction ids above txn_id from now on. A restarted database must not reuse the ids in its log,
+   * or the records of a new transaction would be taken for those of an old one by the next recovery.
+   * @param txn_id the largest transaction id in use
+   */
+  void SkipTransactionIds(txn_id_t txn_id);
 
   /**
-   * Locates and returns the transaction with the given transaction ID.
-   * @param txn_id the id of the transaction to be found, it must exist!
-   * @return the transaction with the given transaction id
+   * Locates and returns the running transaction with the given transaction ID.
+   * @param txn_id the id of the transaction to be found
+   * @return the transaction with the given transaction id, nullptr once it has committed or aborted
    */
-  static Transaction *GetTransaction(txn_id_t txn_id) {
-    assert(TransactionManager::txn_map.find(txn_id) != TransactionManager::txn_map.end());
-    auto *res = TransactionManager::txn_map[txn_id];
-    assert(res != nullptr);
-    return res;
-  }
+  Transaction *GetTransaction(txn_id_t txn_id) { return active_txns_.Find(txn_id); }
 
-  /** Prevents all transactions from performing operations, used for checkpointing. */
-  void BlockAllTransactions();
+  /**
+   * Take a snapshot of the active transaction table for a checkpoint.
+   * @param[out] active_txns (txn_id, last_lsn) of every transaction that has not logged its commit or abort yet
+   * @return a log offset at or before the first record of each of those transactions, -1 if there are none
+   */
+  int64_t GetActiveTransactionTable(std::vector<std::pair<txn_id_t, lsn_t>> *active_txns);
 
-  /** Resumes all transactions, used for checkpointing. */
-  void ResumeTransactions();
+  /**
+   * @return the begin timestamp of the oldest running SNAPSHOT or OPTIMISTIC transaction, or the last commit timestamp
+   * if there is none; every snapshot sees the writes committed up to it, and validation only needs newer ones
+   */
+  timestamp_t GetOldestSnapshot();
+
+  /**
+   * Prune the row versions that no snapshot needs any more from the tables written by the committed transactions.
+   * @param max_rows the most rows to prune
+   * @return the number of rows pruned, less than max_rows once nothing is left to prune
+   */
+  size_t CollectGarbage(size_t max_rows);
+
+  /**
+   * Forget a table that goes away with versions still waiting to be collected. Waits for a CollectGarbage that may be
+   * working on the table.
+   * @param table the table, called from its destructor
+   */
+  void UnregisterTable(TableHeap *table);
 
  private:
+  /**
+   * Validate the reads of an OPTIMISTIC transaction and install its buffered writes. The rows to write are locked
+   * first, so no transaction changes them between the validation and the writes. The transaction only turns COMMITTED
+   * once its reads are validated.
+   * @return false if the transaction has to abort, the writes installed so far are rolled back
+   */
+  bool InstallWrites(Transaction *txn);
+
+  /** Undo the writes of txn to the table heaps, newest first. */
+  void RollbackWrites(Transaction *txn);
+
   /**
    * Releases all the locks held by the given transaction.
    * @param txn the transaction whose locks should be released
    */
   void ReleaseLocks(Transaction *txn) {
-    std::unordered_set<RID> lock_set;
-    for (auto item : *txn->GetExclusiveLockSet()) {
-      lock_set.emplace(item);
+    // Unlock takes each row out of the lock sets, so they are drained without copying them
+    auto exclusive_lock_set = txn->GetExclusiveLockSet();
+    while (!exclusive_lock_set->empty()) {
+      RID rid = exclusive_lock_set->back();
+      lock_manager_->Unlock(txn, rid);
     }
-    for (auto item : *txn->GetSharedLockSet()) {
-      lock_set.emplace(item);
+    auto shared_lock_set = txn->GetSharedLockSet();
+    while (!shared_lock_set->empty()) {
+      RID rid = shared_lock_set->back();
+      lock_manager_->Unlock(txn, rid);
     }
-    for (auto locked_rid : lock_set) {
-      lock_manager_->Unlock(txn, locked_rid);
+    // the table locks go last, they cover the row locks
+    auto table_lock_set = txn->GetTableLockSet();
+    while (!table_lock_set->empty()) {
+      lock_manager_->UnlockTable(txn, table_lock_set->begin()->first);
     }
   }
 
   std::atomic<txn_id_t> next_txn_id_{0};
+  /** The commit mode of the transactions created by Begin. */
+  std::atomic<bool> async_commit_{false};
+  /** Transactions of this manager that have begun but not logged their end yet. */
+  TransactionRegistry active_txns_;
+  /** Commit timestamp of the last commit whose writes the snapshots see. */
+  std::atomic<timestamp_t> last_commit_ts_{0};
+  /** Serializes stamping the writes of commits with their commit timestamps, also guards garbage_tables_. */
+  std::mutex commit_latch_;
+  /** Tables with committed row versions that CollectGarbage has not pruned yet. */
+  std::unordered_set<TableHeap *> garbage_tables_;
+  /**
+   * Serializes CollectGarbage with UnregisterTable. Once a table has left garbage_tables_, no collection still works
+   * on it, so the table may go. Commits never take it.
+   */
+  std::mutex gc_latch_;
+  /** Serializes the validation and the writes of committing OPTIMISTIC transactions. */
+  std::mutex validation_latch_;
+  /** Finished transactions kept for reuse by Begin, guarded by txn_pool_latch_. */
+  std::vector<Transaction *> txn_pool_;
+  std::mutex txn_pool_latch_;
   LockManager *lock_manager_ __attribute__((__unused__));
-  LogManager *log_manager_ __attribute__((__unused__));
-
-  /** The global transaction latch is used for checkpointing. */
-  ReaderWriterLatch global_txn_latch_;
+  LogManager *log_manager_;
 };
 
 }  // namespace bustub
@@ -0,0 +1,88 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// transaction_registry.h
+//
+// Identification: src/include/concurrency/transaction_registry.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <functional>
+#include <mutex>  // NOLINT
+#include <unordered_map>
+#include <vector>
+
+#include "common/config.h"
+#include "common/macros.h"
+
+namespace bustub {
+
+class Transaction;
+
+/**
+ * TransactionRegistry maps the ids of the running transactions of a TransactionManager to their objects.
+ *
+ * The map is split into shards by transaction id, each under its own latch, so that transactions beginning and ending
+ * at the same time rarely wait for each other. A transaction is registered when it begins and unregistered once it has
+ * logged its end, so the registry only ever holds running transactions.
+ */
+class TransactionRegistry {
+ public:
+  /**
+   * @param num_shards number of partitions of the map, 1 puts every transaction under a single latch
+   */
+  explicit TransactionRegistry(size_t num_shards = TXN_REGISTRY_SHARDS);
+
+  DISALLOW_COPY_AND_MOVE(TransactionRegistry);
+
+  /**
+   * Register a transaction. The registering callback runs under the latch of its shard, so that whatever it sets up
+   * is visible to every ForEach that finds the transaction, and ForEach calls that miss it ran entirely before it.
+   * @param txn_id the id of the transaction
+   * @param txn the transaction
+   * @param on_register if not nullptr, called under the latch before the transaction becomes visible
+   */
+  void Register(txn_id_t txn_id, Transaction *txn, const std::function<void()> &on_register = nullptr);
+
+  /**
+   * Unregister a transaction.
+   * @param txn_id the id of the transaction
+   */
+  void Unregister(txn_id_t txn_id);
+
+  /**
+   * @param txn_id the id of the transaction
+   * @return the transaction, nullptr if it is not running
+   */
+  Transaction *Find(txn_id_t txn_id);
+
+  /**
+   * Visit every registered transaction. The shards are visited one at a time, so transactions registered or
+   * unregistered meanwhile may or may not be visited.
+   * @param visit called for each transaction, under the latch of its shard
+   */
+  void ForEach(const std::function<void(txn_id_t, Transaction *)> &visit);
+
+  /** @return the number of registered transactions */
+  size_t Size();
+
+ private:
+  /** One partition of the registry. Shards are cache line aligned so that their latches do not share a line. */
+  class alignas(64) Shard {
+   public:
+    std::mutex latch_;
+    std::unordered_map<txn_id_t, Transaction *> txns_;
+  };
+
+  /** @return the shard of txn_id; ids are handed out in sequence, so consecutive transactions use different shards */
+  Shard *GetShard(txn_id_t txn_id) { return &shards_[static_cast<size_t>(txn_id) % shards_.size()]; }
+
+  std::vector<Shard> shards_;
+};
+
+}  // namespace bustub
@@ -12,6 +12,13 @@
 
 #pragma once
 
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
 #include "buffer/buffer_pool_manager.h"
 #include "concurrency/transaction_manager.h"
 #include "recovery/log_manager.h"
@@ -19,25 +26,51 @@
 namespace bustub {
 
 /**
- * CheckpointManager creates consistent checkpoints by blocking all other transactions temporarily.
+ * CheckpointManager takes fuzzy ARIES checkpoints. Transactions keep running while a checkpoint is taken: it only logs
+ * the active transaction table and the dirty page table, and a background writer then writes the dirty pages back at
+ * a throttled rate (see checkpoint_flush_rate). Recovery starts redo at the smallest recLSN of the dirty page table.
  */
 class CheckpointManager {
  public:
   CheckpointManager(TransactionManager *transaction_manager, LogManager *log_manager,
-                    BufferPoolManager *buffer_pool_manager)
-      : transaction_manager_(transaction_manager),
-        log_manager_(log_manager),
-        buffer_pool_manager_(buffer_pool_manager) {}
+                    BufferPoolManager *buffer_pool_manager);
 
-  ~CheckpointManager() = default;
+  ~CheckpointManager();
 
+  /**
+   * Log a BEGINCHECKPOINT record followed by an ENDCHECKPOINT record with the active transaction table and the dirty
+   * page table, point the master record at the checkpoint, recycle the log segments recovery no longer needs and hand
+   * the dirty pages to the background writer.
+   */
   void BeginCheckpoint();
+
+  /** Wait for the background writer to write back the dirty pages of the last checkpoint. */
   void EndCheckpoint();
 
  private:
-  TransactionManager *transaction_manager_ __attribute__((__unused__));
-  LogManager *log_manager_ __attribute__((__unused__));
-  BufferPoolManager *buffer_pool_manager_ __attribute__((__unused__));
+  /** Body of the background writer thread. */
+  void RunPageWriter();
+
+  /** Queue the pages of a dirty page table for the background writer. */
+  void QueuePages(const std::vector<std::pair<page_id_t, lsn_t>> &dirty_pages);
+
+  TransactionManager *transaction_manager_;
+  LogManager *log_manager_;
+  BufferPoolManager *buffer_pool_manager_;
+
+  /** Pages the background writer still has to write back. */
+  std::deque<page_id_t> pages_to_write_;
+  /** True while the background writer is writing a page it took from pages_to_write_. */
+  bool writing_{false};
+  /** Tells the background writer to exit. */
+  bool stop_{false};
+  /** Protects pages_to_write_, writing_ and stop_. */
+  std::mutex latch_;
+  /** Wakes the background writer up. */
+  std::condition_variable cv_;
+  /** Notified whenever the background writer finishes a page. */
+  std::condition_variable written_cv_;
+  std::thread *page_writer_;
 };
 
 }  // namespace bustub
@@ -13,11 +13,14 @@
 #pragma once
 
 #include <algorithm>
+#include <chrono>              // NOLINT
 #include <condition_variable>  // NOLINT
 #include <future>              // NOLINT
 #include <mutex>               // NOLINT
+#include <thread>              // NOLINT
 
 #include "recovery/log_record.h"
+#include "recovery/log_shipper.h"
 #include "storage/disk/disk_manager.h"
 
 namespace bustub {
@@ -29,9 +32,10 @@ namespace bustub {
 class LogManager {
  public:
   explicit LogManager(DiskManager *disk_manager)
-      : next_lsn_(0), persistent_lsn_(INVALID_LSN), disk_manager_(disk_manager) {
+      : next_lsn_(0), persistent_lsn_(INVALID_LSN), next_offset_(0), disk_manager_(disk_manager) {
     log_buffer_ = new char[LOG_BUFFER_SIZE];
     flush_buffer_ = new char[LOG_BUFFER_SIZE];
+    FindLogEnd();
   }
 
   ~LogManager() {
@@ -46,29 +50,94 @@ class LogManager {
 
   lsn_t AppendLogRecord(LogRecord *log_record);
 
+  /**
+   * Block until every log record up to and including lsn is persistent, forcing a flush if it is not yet.
+   * Returns immediately when the flush thread is not running.
+   * @param lsn the log sequence number that has to reach the disk
+   */
+  void Flush(lsn_t lsn);
+
+  /**
+   * Make sure every log record up to and including lsn reaches the disk within async_commit_window, without waiting
+   * for it. Used by asynchronous commits.
+   * @param lsn the log sequence number that has to reach the disk
+   */
+  void FlushLazily(lsn_t lsn);
+
+  /** Wake the flush thread up to write the log buffer out now, without waiting for it. */
+  void RequestFlush();
+
+  /**
+   * Point the master record at a checkpoint, see DiskManager::WriteMasterRecord. The checkpoint's end record must be
+   * persistent already.
+   * @param offset log offset at or before the BEGINCHECKPOINT record
+   */
+  inline void WriteMasterRecord(int64_t offset) { disk_manager_->WriteMasterRecord(offset); }
+
+  /**
+   * Recycle the log segments that only hold records before offset, see DiskManager::RecycleLog.
+   * @param offset the oldest log offset that recovery may still read
+   */
+  inline void RecycleLog(int64_t offset) { disk_manager_->RecycleLog(offset); }
+
+  /**
+   * Report every flush to a log shipper from now on, nullptr to stop shipping. Must not be changed while the flush
+   * thread is running.
+   * @param log_shipper the shipper streaming the log to a follower
+   */
+  inline void SetLogShipper(LogShipper *log_shipper) { log_shipper_ = log_shipper; }
+
   inline lsn_t GetNextLSN() { return next_lsn_; }
+  /** @return the offset in the log file at which the next appended record will be written */
+  inline int64_t GetNextOffset() { return next_offset_; }
   inline lsn_t GetPersistentLSN() { return persistent_lsn_; }
   inline void SetPersistentLSN(lsn_t lsn) { persistent_lsn_ = lsn; }
   inline char *GetLogBuffer() { return log_buffer_; }
 
  private:
-  // TODO(students): you may add your own member variables
+  /**
+   * Scan the log from the last checkpoint (or from its oldest segment) to the last record with a consecutive LSN, so
+   * that appends continue after it and LSNs keep growing across restarts. Recycled segments still hold stale records
+   * of lower LSNs, which end the scan.
+   */
+  void FindLogEnd();
+
+  /**
+   * Swap the log buffer with the flush buffer and write the latter out. The latch is released during the write so that
+   * appends can continue into the fresh buffer.
+   * @param latch the held latch_
+   */
+  void FlushBuffer(std::unique_lock<std::mutex> *latch);
 
   /** The atomic counter which records the next log sequence number. */
   std::atomic<lsn_t> next_lsn_;
   /** The log records before and including the persistent lsn have been written to disk. */
   std::atomic<lsn_t> persistent_lsn_;
+  /** The log file offset of the next record, counting the bytes still sitting in the buffers. */
+  std::atomic<int64_t> next_offset_;
 
   char *log_buffer_;
   char *flush_buffer_;
-
+  /** Number of bytes used in log_buffer_. */
+  int log_buffer_offset_{0};
+  /** Set when someone is waiting for the buffer to be written out before the timeout fires. */
+  bool need_flush_{false};
+  /** Set when the buffer holds an asynchronous commit, which has to be written out by flush_deadline_. */
+  bool lazy_flush_{false};
+  std::chrono::steady_clock::time_point flush_deadline_;
+
+  /** Protects the buffers, the offset and the flush requests. */
   std::mutex latch_;
 
-  std::thread *flush_thread_ __attribute__((__unused__));
+  std::thread *flush_thread_{nullptr};
 
+  /** Wakes the flush thread up. */
   std::condition_variable cv_;
+  /** Notified whenever a flush completes, for appenders waiting on space and for Flush() callers. */
+  std::condition_variable flushed_cv_;
 
-  DiskManager *disk_manager_ __attribute__((__unused__));
+  DiskManager *disk_manager_;
+  LogShipper *log_shipper_{nullptr};
 };
 
 }  // namespace bustub
@@ -0,0 +1,71 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// log_reader.h
+//
+// Identification: src/include/recovery/log_reader.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+
+#include "common/macros.h"
+#include "storage/disk/disk_manager.h"
+
+namespace bustub {
+
+/**
+ * LogReader maps the log segments into memory for recovery, so records are read in place instead of being copied
+ * through a buffer.
+ *
+ * The segments are mapped side by side into one reserved address range, so the log looks like a single array from the
+ * oldest segment to the end of the log as it was when the reader was created, and records that straddle two segments
+ * need no special handling. Reading moves a read-ahead window along so that the kernel fetches the log ahead of redo.
+ * The returned bytes stay valid for as long as the reader lives, and any number of threads may read concurrently.
+ */
+class LogReader {
+ public:
+  /**
+   * Map the log of the disk manager. No checkpoint may recycle segments while the reader is in use.
+   * @param disk_manager the disk manager holding the log
+   */
+  explicit LogReader(DiskManager *disk_manager);
+
+  ~LogReader();
+
+  DISALLOW_COPY_AND_MOVE(LogReader);
+
+  /** @return the offset of the first mapped log byte */
+  inline int64_t GetStart() const { return start_; }
+
+  /** @return the offset just past the last mapped log byte */
+  inline int64_t GetEnd() const { return end_; }
+
+  /**
+   * Look up the record at offset, without copying it.
+   * @param offset log offset of the record
+   * @param[out] size size of the record
+   * @return the bytes of the record, nullptr if offset is outside the mapped log or does not hold a complete record
+   */
+  const char *GetRecord(int64_t offset, int32_t *size);
+
+ private:
+  /** Ask the kernel for the log ahead of offset if the read-ahead window does not reach far enough any more. */
+  void ReadAhead(int64_t offset);
+
+  /** Start of the reserved address range, which maps log offset start_, the start of a segment. */
+  char *base_{nullptr};
+  /** Size of the reserved address range. */
+  size_t span_{0};
+  int64_t start_{0};
+  int64_t end_{0};
+  /** Offset up to which the kernel has been asked to read ahead. */
+  std::atomic<int64_t> read_ahead_end_{0};
+};
+
+}  // namespace bustub
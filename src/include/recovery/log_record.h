@@ -14,6 +14,8 @@
 
 #include <cassert>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "common/config.h"
 #include "storage/table/tuple.h"
@@ -32,6 +34,20 @@ enum class LogRecordType {
   ABORT,
   /** Creating a new page in the table heap. */
   NEWPAGE,
+  /** Update that only carries the byte ranges that changed between the old and the new tuple. */
+  DELTAUPDATE,
+  /** Start of a fuzzy checkpoint. */
+  BEGINCHECKPOINT,
+  /** End of a fuzzy checkpoint, carrying the active transaction table and the dirty page table. */
+  ENDCHECKPOINT,
+  /** Entries inserted into the array of a B+ tree page, shifting the entries behind them. */
+  BTREE_INSERT,
+  /** Entries removed from the array of a B+ tree page. */
+  BTREE_DELETE,
+  /** Bytes of a B+ tree page (or of the header page holding the root page ids) overwritten in place. */
+  BTREE_UPDATE,
+  /** Compensation of a change undone during recovery, carrying the change that reverted it. */
+  CLR,
 };
 
 /**
@@ -54,13 +70,60 @@ enum class LogRecordType {
  * | HEADER | tuple_rid | tuple_size | old_tuple_data | tuple_size | new_tuple_data |
  *-----------------------------------------------------------------------------------
  * For new page type log record
- *--------------------------
- * | HEADER | prev_page_id |
- *--------------------------
+ *-------------------------------------
+ * | HEADER | prev_page_id | page_id |
+ *-------------------------------------
+ * For delta update type log record
+ *----------------------------------------------------------------
+ * | HEADER | tuple_rid | old_size | new_size | range_count | ... |
+ *----------------------------------------------------------------
+ * followed by range_count changed ranges, each laid out as
+ *---------------------------------------------------------------
+ * | offset | old_length | new_length | old_bytes | new_bytes |
+ *---------------------------------------------------------------
+ * Offsets are positions inside the tuple data. Only the last range may have old_length != new_length, in which case
+ * it runs to the end of both the old and the new tuple. Everything outside the ranges is identical in both images,
+ * so the record can rebuild the new tuple from the old one (redo) and the old tuple from the new one (undo).
+ * For begin checkpoint type log record
+ *------------
+ * | HEADER |
+ *------------
+ * For end checkpoint type log record (prevLSN is the LSN of the matching begin checkpoint record)
+ *------------------------------------------------------------------------------------------------
+ * | HEADER | redo_lsn | redo_offset | undo_offset | txn_count | txn_table | page_count | page_table |
+ *------------------------------------------------------------------------------------------------
+ * txn_table holds (txn_id, last_lsn) of every active transaction and page_table holds (page_id, rec_lsn) of every
+ * dirty page. Redo starts at redo_lsn, found at redo_offset in the log. undo_offset is at or before the first record
+ * of every active transaction, so scanning from there rebuilds the whole undo chain of each loser.
+ * For B+ tree insert and delete type log records (BTREE_INSERT, BTREE_DELETE)
+ *----------------------------------------------------------------------------------------------------------
+ * | HEADER | page_id | array_offset | entry_size | index | entry_count | name_length | index_name | entries |
+ *----------------------------------------------------------------------------------------------------------
+ * array_offset is where the entry array starts in the page, so the record can be redone without knowing the key
+ * type. The entries are the ones inserted, or the ones removed (for undo).
+ * For B+ tree update type log record (BTREE_UPDATE)
+ *-------------------------------------------------------------
+ * | HEADER | page_id | offset | length | old_bytes | new_bytes |
+ *-------------------------------------------------------------
+ * Redo of all of these is page-oriented. Undo is not: the insert or removal of a key in a leaf carries the name of its
+ * index and is undone by key through that tree, descending from the root, as other transactions may have moved the
+ * entry to another page since. Splits, merges, redistributions and root changes are logged as a sequence of records
+ * without an index name, one per page changed, and end in a CLR without an action that makes undo skip them (a
+ * nested top action). Only a structure change cut short by a crash is undone page by page, which is exact as its pages
+ * stay latched until it ends.
+ * For compensation log record (CLR)
+ *---------------------------------------------------------
+ * | HEADER | undo_next_lsn | action_type | action_payload |
+ *---------------------------------------------------------
+ * action_payload is laid out like the payload of a record of action_type, one of the page changes above, or empty for
+ * an action_type of INVALID. Redo applies the action like such a record. Undo never reverts a CLR but continues at
+ * undo_next_lsn, the record before the one the CLR compensates, so a change is undone only once however often
+ * recovery is interrupted.
  */
 class LogRecord {
   friend class LogManager;
   friend class LogRecovery;
+  friend class LogReader;
 
  public:
   LogRecord() = default;
@@ -85,15 +148,19 @@ class LogRecord {
     size_ = HEADER_SIZE + sizeof(RID) + sizeof(int32_t) + tuple.GetLength();
   }
 
-  // constructor for UPDATE type
+  // constructor for UPDATE/DELTAUPDATE type
   LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type, const RID &update_rid,
             const Tuple &old_tuple, const Tuple &new_tuple)
-      : txn_id_(txn_id),
-        prev_lsn_(prev_lsn),
-        log_record_type_(log_record_type),
-        update_rid_(update_rid),
-        old_tuple_(old_tuple),
-        new_tuple_(new_tuple) {
+      : txn_id_(txn_id), prev_lsn_(prev_lsn), log_record_type_(log_record_type), update_rid_(update_rid) {
+    if (log_record_type == LogRecordType::DELTAUPDATE) {
+      // only the changed byte ranges are kept, the tuples themselves are not copied
+      EncodeDelta(old_tuple, new_tuple, &update_delta_);
+      size_ = HEADER_SIZE + sizeof(RID) + update_delta_.size();
+      return;
+    }
+    assert(log_record_type == LogRecordType::UPDATE);
+    old_tuple_ = old_tuple;
+    new_tuple_ = new_tuple;
     // calculate log record size
     size_ = HEADER_SIZE + sizeof(RID) + old_tuple.GetLength() + new_tuple.GetLength() + 2 * sizeof(int32_t);
   }
@@ -110,6 +177,56 @@ class LogRecord {
     size_ = HEADER_SIZE + sizeof(page_id_t) * 2;
   }
 
+  // constructor for ENDCHECKPOINT type
+  LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type, lsn_t redo_lsn, int64_t redo_offset,
+            int64_t undo_offset, std::vector<std::pair<txn_id_t, lsn_t>> active_txn_table,
+            std::vector<std::pair<page_id_t, lsn_t>> dirty_page_table)
+      : txn_id_(txn_id),
+        prev_lsn_(prev_lsn),
+        log_record_type_(log_record_type),
+        redo_lsn_(redo_lsn),
+        redo_offset_(redo_offset),
+        undo_offset_(undo_offset),
+        active_txn_table_(std::move(active_txn_table)),
+        dirty_page_table_(std::move(dirty_page_table)) {
+    assert(log_record_type == LogRecordType::ENDCHECKPOINT);
+    size_ = HEADER_SIZE + sizeof(lsn_t) + 2 * sizeof(int64_t) + 2 * sizeof(int32_t) +
+            active_txn_table_.size() * (sizeof(txn_id_t) + sizeof(lsn_t)) +
+            dirty_page_table_.size() * (sizeof(page_id_t) + sizeof(lsn_t));
+  }
+
+  // constructor for BTREE_INSERT/BTREE_DELETE type, index_name is empty for the changes undone page by page
+  LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type, page_id_t page_id, int32_t array_offset,
+            int32_t entry_size, int32_t index, int32_t entry_count, const char *entries, std::string index_name = "")
+      : txn_id_(txn_id),
+        prev_lsn_(prev_lsn),
+        log_record_type_(log_record_type),
+        page_id_(page_id),
+        btree_offset_(array_offset),
+        btree_entry_size_(entry_size),
+        btree_index_(index),
+        btree_count_(entry_count),
+        btree_data_(entries, entries + entry_size * entry_count),
+        btree_index_name_(std::move(index_name)) {
+    assert(log_record_type == LogRecordType::BTREE_INSERT || log_record_type == LogRecordType::BTREE_DELETE);
+    size_ = HEADER_SIZE + sizeof(page_id_t) + 5 * sizeof(int32_t) + btree_index_name_.size() + btree_data_.size();
+  }
+
+  // constructor for BTREE_UPDATE type
+  LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type, page_id_t page_id, int32_t offset,
+            int32_t length, const char *old_data, const char *new_data)
+      : txn_id_(txn_id),
+        prev_lsn_(prev_lsn),
+        log_record_type_(log_record_type),
+        page_id_(page_id),
+        btree_offset_(offset),
+        btree_count_(length),
+        btree_data_(old_data, old_data + length) {
+    assert(log_record_type == LogRecordType::BTREE_UPDATE);
+    btree_data_.insert(btree_data_.end(), new_data, new_data + length);
+    size_ = HEADER_SIZE + sizeof(page_id_t) + 2 * sizeof(int32_t) + btree_data_.size();
+  }
+
   ~LogRecord() = default;
 
   inline Tuple &GetDeleteTuple() { return delete_tuple_; }
@@ -126,8 +243,16 @@ class LogRecord {
 
   inline RID &GetUpdateRID() { return update_rid_; }
 
+  inline const std::vector<char> &GetUpdateDelta() { return update_delta_; }
+
   inline page_id_t GetNewPageRecord() { return prev_page_id_; }
 
+  inline lsn_t GetRedoLSN() { return redo_lsn_; }
+
+  inline const std::vector<std::pair<txn_id_t, lsn_t>> &GetActiveTxnTable() { return active_txn_table_; }
+
+  inline const std::vector<std::pair<page_id_t, lsn_t>> &GetDirtyPageTable() { return dirty_page_table_; }
+
   inline int32_t GetSize() { return size_; }
 
   inline lsn_t GetLSN() { return lsn_; }
@@ -138,6 +263,53 @@ class LogRecord {
 
   inline LogRecordType &GetLogRecordType() { return log_record_type_; }
 
+  /** @return the type of the page change the record applies, for a CLR the type of the change it carries */
+  inline LogRecordType GetActionType() {
+    return log_record_type_ == LogRecordType::CLR ? action_type_ : log_record_type_;
+  }
+
+  inline lsn_t GetUndoNextLSN() { return undo_next_lsn_; }
+
+  /**
+   * Turn a record of the change that reverts an undone one into its CLR.
+   * @param undo_next_lsn LSN of the record before the undone one in the same transaction
+   */
+  inline void MakeCompensation(lsn_t undo_next_lsn) {
+    assert(log_record_type_ != LogRecordType::CLR);
+    action_type_ = log_record_type_;
+    log_record_type_ = LogRecordType::CLR;
+    undo_next_lsn_ = undo_next_lsn;
+    size_ += sizeof(lsn_t) + sizeof(LogRecordType);
+  }
+
+  /** @return true for the records of changes to B+ tree pages */
+  inline bool IsBPlusTreeRecord() {
+    LogRecordType type = GetActionType();
+    return type == LogRecordType::BTREE_INSERT || type == LogRecordType::BTREE_DELETE ||
+           type == LogRecordType::BTREE_UPDATE;
+  }
+
+  /** @return true for the insert or removal of a key in a leaf, which is undone by key through its index */
+  inline bool IsUndoneByKey() { return IsBPlusTreeRecord() && !btree_index_name_.empty(); }
+
+  /**
+   * Encode the difference between two images of a tuple in the DELTAUPDATE payload format.
+   * @param old_tuple the tuple before the update
+   * @param new_tuple the tuple after the update
+   * @param[out] delta the encoded payload (everything after tuple_rid)
+   */
+  static void EncodeDelta(const Tuple &old_tuple, const Tuple &new_tuple, std::vector<char> *delta);
+
+  /**
+   * Rebuild one image of a tuple from the other one and a DELTAUPDATE payload.
+   * @param delta the encoded payload
+   * @param base the tuple image currently stored in the table page
+   * @param redo true to go from the old image to the new one, false to go from the new image back to the old one
+   * @param[out] result the rebuilt tuple
+   * @return false if base does not have the size the delta expects
+   */
+  static bool ApplyDelta(const std::vector<char> &delta, const Tuple &base, bool redo, Tuple *result);
+
   // For debug purpose
   inline std::string ToString() const {
     std::ostringstream os;
@@ -176,6 +348,32 @@ class LogRecord {
   // case4: for new page operation
   page_id_t prev_page_id_{INVALID_PAGE_ID};
   page_id_t page_id_{INVALID_PAGE_ID};
+
+  // case5: for delta update operation, shares update_rid_ with case3
+  std::vector<char> update_delta_;
+
+  // case6: for end checkpoint operation
+  lsn_t redo_lsn_{INVALID_LSN};
+  int64_t redo_offset_{0};
+  int64_t undo_offset_{0};
+  std::vector<std::pair<txn_id_t, lsn_t>> active_txn_table_;
+  std::vector<std::pair<page_id_t, lsn_t>> dirty_page_table_;
+
+  // case7: for B+ tree page operations on page page_id_
+  // BTREE_INSERT/BTREE_DELETE: start of the entry array, BTREE_UPDATE: first byte overwritten
+  int32_t btree_offset_{0};
+  int32_t btree_entry_size_{0};
+  int32_t btree_index_{0};
+  // number of entries, or of bytes for BTREE_UPDATE
+  int32_t btree_count_{0};
+  // the entries, or the old bytes followed by the new ones for BTREE_UPDATE
+  std::vector<char> btree_data_;
+  // BTREE_INSERT/BTREE_DELETE: the index to undo the change by key in, empty to undo it page by page
+  std::string btree_index_name_;
+
+  // case8: for compensation log records, the fields of the change the record carries are one of the cases above
+  lsn_t undo_next_lsn_{INVALID_LSN};
+  LogRecordType action_type_{LogRecordType::INVALID};
   static const int HEADER_SIZE = 20;
 };  // namespace bustub
 
@@ -13,45 +13,245 @@
 #pragma once
 
 #include <algorithm>
-#include <mutex>  // NOLINT
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>   // NOLINT
+#include <string>
+#include <thread>  // NOLINT
 #include <unordered_map>
+#include <vector>
 
 #include "buffer/buffer_pool_manager.h"
 #include "concurrency/lock_manager.h"
+#include "concurrency/transaction_manager.h"
+#include "recovery/log_reader.h"
 #include "recovery/log_record.h"
+#include "storage/page/b_plus_tree_page.h"
+#include "storage/page/table_page.h"
 
 namespace bustub {
 
 /**
  * Read log file from disk, redo and undo.
+ *
+ * Redo is done in parallel: the calling thread reads the log, builds the undo tables, and hands every record to the
+ * redo worker that owns the page it changes. A page always belongs to the same worker, so the records of a page are
+ * applied in LSN order while different pages are redone concurrently. Undo runs after all the workers have drained.
+ *
+ * StartInstantRestart is the alternative to Redo and Undo for opening the database without waiting for recovery, see
+ * there.
  */
 class LogRecovery {
  public:
-  LogRecovery(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager)
-      : disk_manager_(disk_manager), buffer_pool_manager_(buffer_pool_manager), offset_(0) {
-    log_buffer_ = new char[LOG_BUFFER_SIZE];
-  }
+  /**
+   * @param disk_manager the disk manager holding the log
+   * @param buffer_pool_manager the buffer pool the pages are recovered in
+   * @param redo_workers number of redo worker threads, 1 redoes every record on the calling thread
+   */
+  LogRecovery(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager,
+              size_t redo_workers = std::thread::hardware_concurrency())
+      : disk_manager_(disk_manager),
+        buffer_pool_manager_(buffer_pool_manager),
+        redo_workers_(std::max<size_t>(redo_workers, 1)) {}
 
-  ~LogRecovery() {
-    delete[] log_buffer_;
-    log_buffer_ = nullptr;
-  }
+  ~LogRecovery() { WaitForRestart(); }
 
   void Redo();
   void Undo();
-  bool DeserializeLogRecord(const char *data, LogRecord *log_record);
+
+  /**
+   * Let undo revert the leaf changes of a B+ tree by key through the tree. Every index with changes in the log must be
+   * registered before Undo, or StartInstantRestart, is called.
+   */
+  void RegisterIndex(BPlusTreeUndo *index) { indexes_[index->GetIndexName()] = index; }
+
+  /**
+   * Deserialize the log record at data.
+   * @param data the serialized record
+   * @param[out] log_record the record
+   * @param copy false to leave the tuples of the record pointing into data instead of copying them, data must then
+   * outlive log_record
+   * @return false if data does not hold a valid record
+   */
+  bool DeserializeLogRecord(const char *data, LogRecord *log_record, bool copy = true);
+
+  /**
+   * Redo the complete log records at the start of data on top of the current pages, checking each against its page
+   * LSN. Used by a log-shipping follower that keeps redoing the primary's log as it arrives, so there is no checkpoint
+   * to start from and nothing is undone.
+   * @param data log bytes starting at a record boundary
+   * @param size number of bytes in data
+   * @param[out] last_lsn LSN of the last record redone, unchanged if data does not hold a complete record
+   * @return number of bytes redone, an incomplete record at the end of data is left for the next call
+   */
+  size_t RedoLog(const char *data, size_t size, lsn_t *last_lsn);
+
+  /**
+   * Recover while the database is already in use. A single analysis pass over the log builds the undo tables and an
+   * index of the records each page needs redone, without touching any page. From then on the buffer pool redoes a page
+   * the first time it is read, before anyone else sees it, and a background thread redoes the pages nobody asked for
+   * and finally undoes the losers. Until then the rows of the losers are locked exclusively by a recovery transaction.
+   * With logging on, the undo logs a CLR for every change it reverts and an ABORT record for every loser.
+   *
+   * Call this on a buffer pool that has not read any page yet, instead of Redo and Undo. No checkpoint may be taken
+   * before WaitForRestart returns, as the pages that still wait for redo are not in the dirty page table.
+   * @param transaction_manager the transaction manager of the database, runs the recovery transaction
+   * @param lock_manager its lock manager
+   */
+  void StartInstantRestart(TransactionManager *transaction_manager, LockManager *lock_manager);
+
+  /** Wait for the background redo and undo of StartInstantRestart, returns right away if none is running. */
+  void WaitForRestart();
+
+  /** @return number of pages still waiting for redo after StartInstantRestart */
+  size_t GetPendingRedoPages();
 
  private:
-  DiskManager *disk_manager_ __attribute__((__unused__));
-  BufferPoolManager *buffer_pool_manager_ __attribute__((__unused__));
+  /** A log record to redo on one of the pages it changes. */
+  struct RedoTask {
+    std::shared_ptr<LogRecord> log_record_;
+    page_id_t page_id_;
+  };
+
+  /** Bounded queue of batches of redo tasks for one worker. */
+  struct RedoQueue {
+    std::deque<std::vector<RedoTask>> batches_;
+    /** Set once the log has been read completely. */
+    bool closed_{false};
+    std::mutex latch_;
+    /** Notified whenever a batch is pushed or popped, or the queue is closed. */
+    std::condition_variable cv_;
+  };
+
+  /** Hand a batch to a worker, waiting while its queue is full. */
+  void PushRedoBatch(RedoQueue *queue, std::vector<RedoTask> *batch);
+
+  /** Body of a redo worker thread. */
+  void RunRedoWorker(RedoQueue *queue);
+
+  /**
+   * @param log_record the record
+   * @param[out] page_ids the pages the record changes, room for two
+   * @return number of pages, 0 for records that change none
+   */
+  static int GetRedoPages(LogRecord *log_record, page_id_t *page_ids);
+
+  /** Deserialize a tuple, copying it or leaving it pointing into data. */
+  static void DeserializeTuple(const char *data, Tuple *tuple, bool copy);
+
+  /**
+   * Read the log record at the given offset from the mapped log, any thread may call this. The tuples of the record
+   * point into the mapping, which stays until the next scan of the log.
+   * @param[in,out] offset the log offset of the record, moved past the record on success
+   * @param[out] log_record the record
+   * @return false at the end of the log
+   */
+  bool ReadLogRecord(int64_t *offset, LogRecord *log_record);
+
+  /**
+   * Read the log from the last checkpoint (or the beginning) to its end and build active_txn_ and lsn_mapping_.
+   * @param visit called in log order for every record and page the record may have to be redone on, with the log
+   * offset of the record
+   */
+  void ScanLog(const std::function<void(const std::shared_ptr<LogRecord> &, int64_t, page_id_t)> &visit);
+
+  /**
+   * Locate the end record of the checkpoint the master record points at.
+   * @param[out] checkpoint the ENDCHECKPOINT record
+   * @return false if there is no complete checkpoint in the log
+   */
+  bool FindCheckpoint(LogRecord *checkpoint);
+
+  /**
+   * Check the record against the redo start point and the dirty page table of the checkpoint. The page LSN still
+   * decides whether a record that passes this check is missing from the page.
+   * @return false if the change is known to be on disk already
+   */
+  bool NeedsRedo(page_id_t page_id, lsn_t lsn);
+
+  /**
+   * Reapply a log record to one of the pages it changes if the page LSN shows it is missing.
+   * @param log_record the record
+   * @param page_id the page to redo the record on, a NEWPAGE record changes both the new and the previous page
+   */
+  void RedoLogRecord(LogRecord *log_record, page_id_t page_id);
+
+  /**
+   * Reapply a log record to a page the caller has fetched and write latched, if the page LSN shows it is missing.
+   * @return true if the page changed
+   */
+  bool ApplyRedo(LogRecord *log_record, TablePage *page, page_id_t page_id);
+
+  /** ApplyRedo for the records of B+ tree pages, which are applied by byte offset without knowing the key type. */
+  bool ApplyBPlusTreeRedo(LogRecord *log_record, Page *page);
+
+  /** PageLoadHook of an instant restart: redo the records indexed for the page, if any are left. */
+  bool RedoPage(Page *page, lsn_t *rec_lsn, int64_t *rec_offset);
+
+  /** Body of the instant restart thread: redo every page still in redo_index_, undo the losers, release their rows. */
+  void RunRestart(TransactionManager *transaction_manager);
+
+  /** @return the row a record of a table page changes, false for records that do not change a row */
+  static bool GetRecordRID(LogRecord *log_record, RID *rid);
+
+  /** Fetch a page for redo, waiting for a frame if the other workers hold all of them. */
+  Page *FetchRedoPage(page_id_t page_id);
+  /**
+   * Undo a loser from lsn on, following its undo chain.
+   * @param lsn the record to start at
+   * @param[in,out] last_lsn see UndoLogRecord
+   * @param structure_only stop at the first record that is not part of a B+ tree structure change
+   * @return the LSN undo stopped at, INVALID_LSN once the whole transaction is undone
+   */
+  lsn_t UndoTransaction(lsn_t lsn, lsn_t *last_lsn, bool structure_only);
+  /**
+   * Reverse the effect of a single log record of a transaction that did not finish.
+   * @param[in,out] last_lsn the last LSN of the transaction, the CLR of the undo is logged after it; nullptr to undo
+   * without logging
+   */
+  void UndoLogRecord(LogRecord *log_record, lsn_t *last_lsn);
+  /**
+   * UndoLogRecord for the records of B+ tree pages. The changes of a key are undone through its index, the pages of a
+   * structure change cut short by the crash are put back as they were.
+   */
+  void UndoBPlusTreeRecord(LogRecord *log_record, lsn_t *last_lsn);
+  /**
+   * Log the change that reverted log_record as a CLR and stamp the write latched page with it. Does nothing if the
+   * undo is not logged, or if compensation is left INVALID because there was nothing to revert.
+   */
+  void LogCompensation(LogRecord *log_record, LogRecord *compensation, Page *page, lsn_t *last_lsn);
+
+  DiskManager *disk_manager_;
+  BufferPoolManager *buffer_pool_manager_;
+  size_t redo_workers_;
 
   /** Maintain active transactions and its corresponding latest lsn. */
   std::unordered_map<txn_id_t, lsn_t> active_txn_;
   /** Mapping the log sequence number to log file offset for undos. */
-  std::unordered_map<lsn_t, int> lsn_mapping_;
+  std::unordered_map<lsn_t, int64_t> lsn_mapping_;
+  /** The B+ trees undo reverts leaf changes in, by name. */
+  std::unordered_map<std::string, BPlusTreeUndo *> indexes_;
+  /** Largest transaction id in the records of the last scan. */
+  txn_id_t max_txn_id_{INVALID_TXN_ID};
+
+  /** Records before redo_lsn_ are on disk already. */
+  lsn_t redo_lsn_{INVALID_LSN};
+  /** LSN of the BEGINCHECKPOINT record of the checkpoint recovery starts from. */
+  lsn_t checkpoint_lsn_{INVALID_LSN};
+  /** Dirty page table (page_id -> rec_lsn) of that checkpoint. */
+  std::unordered_map<page_id_t, lsn_t> dirty_page_table_;
+
+  /** Offsets of the records each page still needs redone during an instant restart, in log order. */
+  std::unordered_map<page_id_t, std::vector<int64_t>> redo_index_;
+  std::mutex redo_index_latch_;
+  /** Holds the rows of the losers until the instant restart has undone them. */
+  Transaction *restart_txn_{nullptr};
+  std::thread *restart_thread_{nullptr};
 
-  int offset_ __attribute__((__unused__));
-  char *log_buffer_;
+  /** The log as it was at the start of the last scan, the records read from it point into it. */
+  std::unique_ptr<LogReader> log_reader_;
 };
 
 }  // namespace bustub
@@ -0,0 +1,93 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// log_replica.h
+//
+// Identification: src/include/recovery/log_replica.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>              // NOLINT
+#include <condition_variable>  // NOLINT
+#include <mutex>               // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "recovery/log_recovery.h"
+
+namespace bustub {
+
+/**
+ * LogReplica keeps a follower instance up to date with a primary by redoing the log its LogShipper streams.
+ *
+ * The follower's pages are rebuilt from the primary's log alone, starting from an empty database, with the same redo
+ * logic as crash recovery. Read-only transactions on the follower see every change up to GetAppliedLSN(). Nothing is
+ * undone, so changes of transactions that are still running on the primary are visible too, and those of aborted
+ * transactions until their rollback records arrive. The follower must not write.
+ */
+class LogReplica {
+ public:
+  /**
+   * Start following a primary. The replica keeps trying to connect until the primary listens, and reconnects if the
+   * primary goes away.
+   * @param disk_manager the follower's disk manager
+   * @param buffer_pool_manager the follower's buffer pool
+   * @param socket_path the socket the primary's LogShipper listens on
+   */
+  LogReplica(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager, std::string socket_path);
+
+  ~LogReplica();
+
+  /** @return the LSN of the last log record redone on the follower */
+  inline lsn_t GetAppliedLSN() { return applied_lsn_; }
+
+  /**
+   * Wait until the follower has redone the log up to and including lsn.
+   * @param lsn the LSN to wait for
+   * @param timeout how long to wait at most
+   * @return false on timeout
+   */
+  bool WaitForLSN(lsn_t lsn, std::chrono::milliseconds timeout);
+
+  /** @return the time between the primary flushing the most recently redone log and the follower redoing it */
+  std::chrono::microseconds GetReplayLag();
+
+  /** @return the largest replay lag seen so far */
+  std::chrono::microseconds GetMaxReplayLag();
+
+ private:
+  /** Body of the replica thread: connect, then receive and redo frames. */
+  void RunReplica();
+
+  /** Receive exactly size bytes, @return false if the primary went away or the replica is stopping. */
+  bool Receive(char *data, size_t size);
+
+  LogRecovery log_recovery_;
+  std::string socket_path_;
+  int fd_{-1};
+
+  /** Log offset of the next byte expected from the primary, -1 before the first frame. */
+  int64_t next_offset_{-1};
+  /** Received bytes that do not make a complete log record yet. */
+  std::vector<char> pending_;
+
+  std::atomic<lsn_t> applied_lsn_{INVALID_LSN};
+  std::atomic<bool> stop_{false};
+  /** Replay lags, guarded by latch_. */
+  std::chrono::microseconds replay_lag_{0};
+  std::chrono::microseconds max_replay_lag_{0};
+
+  std::mutex latch_;
+  /** Notified whenever applied_lsn_ moves. */
+  std::condition_variable applied_cv_;
+  std::thread *replica_thread_;
+};
+
+}  // namespace bustub
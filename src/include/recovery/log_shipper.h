@@ -0,0 +1,88 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// log_shipper.h
+//
+// Identification: src/include/recovery/log_shipper.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+#include <utility>
+
+#include "storage/disk/disk_manager.h"
+
+namespace bustub {
+
+/**
+ * Header of every frame a LogShipper sends, followed by size bytes of log.
+ */
+struct LogShipFrame {
+  /** Log offset of the first byte in the frame. */
+  int64_t offset_;
+  /** steady_clock time (in nanoseconds) at which the bytes became persistent on the primary, for measuring lag. */
+  int64_t flush_time_;
+  int32_t size_;
+};
+
+/**
+ * LogShipper streams the primary's persistent log to a follower (see LogReplica) over a Unix-domain socket.
+ *
+ * The log manager reports every flush, and the shipper thread sends whatever the follower has not seen yet straight
+ * from the log segments, so a slow follower never holds up the log flushes. A follower that connects first receives the
+ * log from its oldest segment. Only one follower is served at a time; a follower must connect before the primary
+ * recycles any log segment, since it has no other way to get the pages those records built.
+ */
+class LogShipper {
+ public:
+  /**
+   * Start listening for a follower.
+   * @param disk_manager the disk manager holding the primary's log
+   * @param socket_path path of the Unix-domain socket to listen on, replaced if it exists
+   */
+  LogShipper(DiskManager *disk_manager, std::string socket_path);
+
+  ~LogShipper();
+
+  /**
+   * Called by the log manager once a flush reaches the disk.
+   * @param end_offset offset just past the last persistent log byte
+   */
+  void Ship(int64_t end_offset);
+
+ private:
+  /** Body of the shipper thread: accept a follower, then send it the log as it becomes persistent. */
+  void RunShipper();
+
+  /** Send the whole buffer, @return false if the follower went away. */
+  bool Send(const char *data, size_t size);
+
+  DiskManager *disk_manager_;
+  std::string socket_path_;
+  int listen_fd_{-1};
+  int client_fd_{-1};
+
+  /** Offset just past the last byte sent to the follower, only used by the shipper thread. */
+  int64_t sent_offset_{0};
+  /** Offset just past the last persistent log byte. */
+  int64_t persistent_offset_;
+  /** (end offset, flush time) of the flushes whose bytes have not all been sent yet. */
+  std::deque<std::pair<int64_t, int64_t>> flushes_;
+  bool stop_{false};
+
+  /** Protects persistent_offset_, flushes_ and stop_. */
+  std::mutex latch_;
+  std::condition_variable cv_;
+  std::thread *shipper_thread_;
+};
+
+}  // namespace bustub
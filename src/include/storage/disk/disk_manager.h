@@ -15,7 +15,11 @@
 #include <atomic>
 #include <fstream>
 #include <future>  // NOLINT
+#include <map>
+#include <memory>
+#include <mutex>  // NOLINT
 #include <string>
+#include <vector>
 
 #include "common/config.h"
 
@@ -24,6 +28,11 @@ namespace bustub {
 /**
  * DiskManager takes care of the allocation and deallocation of pages within a database. It performs the reading and
  * writing of pages to and from disk, providing a logical file layer within the context of a database management system.
+ *
+ * The log is split into segment files of LOG_SEGMENT_SIZE bytes named <db>.log.<n>, segment n holding the log offsets
+ * [n * LOG_SEGMENT_SIZE, (n + 1) * LOG_SEGMENT_SIZE). Log offsets keep growing across segments, so a reader can go
+ * straight to the segment holding any offset. Segments that are no longer needed after a checkpoint are renamed to
+ * <db>.log.spare.<n> and reused for the next segment instead of allocating a fresh file.
  */
 class DiskManager {
  public:
@@ -55,20 +64,54 @@ class DiskManager {
   void ReadPage(page_id_t page_id, char *page_data);
 
   /**
-   * Flush the entire log buffer into disk.
+   * Flush the entire log buffer into disk, appending it at the end of the log.
    * @param log_data raw log data
    * @param size size of log entry
    */
   void WriteLog(char *log_data, int size);
 
   /**
-   * Read a log entry from the log file.
+   * Read a log entry from the log. Bytes past the end of the log are zeroed.
    * @param[out] log_data output buffer
    * @param size size of the log entry
-   * @param offset offset of the log entry in the file
-   * @return true if the read was successful, false otherwise
+   * @param offset offset of the log entry in the log
+   * @return false if offset is past the end of the log or in a segment that has been recycled
    */
-  bool ReadLog(char *log_data, int size, int offset);
+  bool ReadLog(char *log_data, int size, int64_t offset);
+
+  /** @return the offset just past the end of the log */
+  int64_t GetLogSize();
+
+  /** @return the offset of the oldest log segment that has not been recycled */
+  int64_t GetLogStart();
+
+  /**
+   * Set the end of the log, the next WriteLog appends there. A reused segment still holds the bytes of the segment it
+   * used to be, so after a restart the end of the log is only known once the log manager has scanned its tail.
+   * @param offset offset just past the last valid log record
+   */
+  void SetLogEnd(int64_t offset);
+
+  /**
+   * Recycle every log segment that ends at or before offset. Up to LOG_SEGMENT_SPARES of them are kept as spares for
+   * future segments, the rest are removed. The segment holding the end of the log is never recycled.
+   * @param offset the oldest log offset that is still needed
+   */
+  void RecycleLog(int64_t offset);
+
+  /**
+   * Persist the log offset of the last complete checkpoint (the ARIES master record). The record is replaced
+   * atomically, so a crash leaves either the old or the new checkpoint behind.
+   * @param offset log offset at or before the BEGINCHECKPOINT record of the checkpoint
+   */
+  void WriteMasterRecord(int64_t offset);
+
+  /**
+   * Read the master record written by WriteMasterRecord.
+   * @param[out] offset log offset of the last complete checkpoint
+   * @return false if no checkpoint has been taken for this log
+   */
+  bool ReadMasterRecord(int64_t *offset);
 
   /**
    * Allocate a page on disk.
@@ -76,6 +119,13 @@ class DiskManager {
    */
   page_id_t AllocatePage();
 
+  /**
+   * Make sure AllocatePage never hands out page_id again. Recovery calls this for every page in the log, as pages that
+   * were allocated but never written are not in the db file.
+   * @param page_id a page id in use
+   */
+  void ReservePageId(page_id_t page_id);
+
   /**
    * Deallocate a page on disk.
    * @param page_id id of the page to deallocate
@@ -97,16 +147,37 @@ class DiskManager {
    */
   inline void SetFlushLogFuture(std::future<void> *f) { flush_log_f_ = f; }
 
+  /** @return the name of the file holding log segment segment_no, for readers that map the log */
+  std::string GetSegmentName(int64_t segment_no);
+
   /** Checks if the non-blocking flush future was set. */
   inline bool HasFlushLogFuture() { return flush_log_f_ != nullptr; }
 
  private:
-  int GetFileSize(const std::string &file_name);
-  // stream to write log file
-  std::fstream log_io_;
+  int64_t GetFileSize(const std::string &file_name);
+  /**
+   * Look a log segment up in the segment index, opening its file on first use. Must be called with log_io_latch_ held.
+   * @param segment_no number of the segment
+   * @param create whether to create a missing segment, reusing a spare file if there is one
+   * @return the segment's stream, nullptr if it does not exist and create is false
+   */
+  std::fstream *GetLogSegment(int64_t segment_no, bool create);
+  // base name of the log segment files
   std::string log_name_;
+  // segment index: live log segments by segment number, streams are opened lazily
+  std::map<int64_t, std::unique_ptr<std::fstream>> log_segments_;
+  // recycled segment files waiting to be reused
+  std::vector<std::string> spare_segments_;
+  // offset just past the end of the log
+  int64_t log_end_{0};
+  // serializes log I/O and protects the segment index
+  std::mutex log_io_latch_;
+  // file holding the master record
+  std::string master_name_;
   // stream to write db file
   std::fstream db_io_;
+  // serializes page I/O, which may be issued outside of the buffer pool latch
+  std::mutex db_io_latch_;
   std::string file_name_;
   std::atomic<page_id_t> next_page_id_;
   int num_flushes_;
@@ -14,6 +14,7 @@
 #include <string>
 #include <vector>
 
+#include "common/shared_latch.h"
 #include "concurrency/transaction.h"
 #include "storage/index/index_iterator.h"
 #include "storage/page/b_plus_tree_internal_page.h"
@@ -32,9 +33,15 @@ namespace bustub {
  * (2) support insert & remove
  * (3) The structure should shrink and grow dynamically
  * (4) Implement index iterator for range scan
+ *
+ * With enable_optimistic_crabbing, an insert or remove first descends with read latches and write latches only the
+ * leaf. Only if the leaf would split or merge does it start over from the root, write latching the pages it may change.
+ *
+ * Under a logged transaction the insert or removal of the key in its leaf is logged to be undone by key, and the
+ * splits, merges and root changes around it as nested top actions that are only ever redone, see LogRecord.
  */
 INDEX_TEMPLATE_ARGUMENTS
-class BPlusTree {
+class BPlusTree : public BPlusTreeUndo {
   using InternalPage = BPlusTreeInternalPage<KeyType, page_id_t, KeyComparator>;
   using LeafPage = BPlusTreeLeafPage<KeyType, ValueType, KeyComparator>;
 
@@ -54,6 +61,15 @@ class BPlusTree {
   // return the value associated with a given key
   bool GetValue(const KeyType &key, std::vector<ValueType> *result, Transaction *transaction = nullptr);
 
+  // read the root page id of an index that already exists from the header page
+  bool LoadRootPageId() override;
+
+  const std::string &GetIndexName() const override { return index_name_; }
+
+  void UndoInsert(const char *entry, Transaction *transaction, lsn_t undo_next_lsn) override;
+
+  void UndoRemove(const char *entry, Transaction *transaction, lsn_t undo_next_lsn) override;
+
   // index iterator
   INDEXITERATOR_TYPE begin();
   INDEXITERATOR_TYPE Begin(const KeyType &key);
@@ -110,6 +126,18 @@ class BPlusTree {
   void UnLock(bool is_write,Page *page);
   void UnLock(bool exclusive,page_id_t pageId);
   BPlusTreePage *FetchPage(page_id_t page_id);
+
+  /**
+   * Find the leaf page of key with read latches and write latch only the leaf, added to the page set of transaction.
+   * @return the leaf, nullptr with nothing latched if the operation could split or merge it, or the root is a leaf
+   */
+  B_PLUS_TREE_LEAF_PAGE_TYPE *FindLeafPageOptimistic(const KeyType &key, Operate_Type operate,
+                                                     Transaction *transaction);
+
+  /** Insert and Remove, logged for whatever the caller set BPlusTreePage::log_context to. */
+  bool InsertImpl(const KeyType &key, const ValueType &value, Transaction *transaction);
+  void RemoveImpl(const KeyType &key, Transaction *transaction);
+
   void StartNewTree(const KeyType &key, const ValueType &value);
 
   bool InsertIntoLeaf(const KeyType &key, const ValueType &value, Transaction *transaction = nullptr);
@@ -148,7 +176,7 @@ class BPlusTree {
   KeyComparator comparator_;
   int leaf_max_size_;
   int internal_max_size_;
-  ReaderWriterLatch mutex_;
+  SharedLatch mutex_;
   static thread_local int root_lock_count;
 };
 
@@ -15,6 +15,7 @@
 #include <string>
 #include <vector>
 
+#include "concurrency/lock_manager.h"
 #include "storage/index/b_plus_tree.h"
 #include "storage/index/index.h"
 
@@ -22,10 +23,22 @@ namespace bustub {
 
 #define BPLUSTREE_INDEX_TYPE BPlusTreeIndex<KeyType, ValueType, KeyComparator>
 
+/**
+ * BPlusTreeIndex is an index on a B+tree.
+ *
+ * Given a lock manager, the index locks key ranges for SERIALIZABLE transactions with next-key locking: the lock on the
+ * RID of a key also covers the gap between that key and the one before it, and a lock on an RID made up for the index
+ * covers the gap after its last key. A scan locks the keys it reads in shared mode together with the key after them,
+ * and an insert waits until it could lock the key after its own in exclusive mode, so no phantom can appear inside a
+ * scanned range while inserts outside of it go ahead. The locks are row locks held until the transaction ends. Only
+ * SERIALIZABLE scans lock ranges, but the inserts and deletes of every lock-based isolation level respect them;
+ * SNAPSHOT and OPTIMISTIC transactions take no locks while they run and write without waiting. A transaction aborted
+ * while it waits for a lock gets a TransactionAbortException, as from the lock manager.
+ */
 INDEX_TEMPLATE_ARGUMENTS
 class BPlusTreeIndex : public Index {
  public:
-  BPlusTreeIndex(IndexMetadata *metadata, BufferPoolManager *buffer_pool_manager);
+  BPlusTreeIndex(IndexMetadata *metadata, BufferPoolManager *buffer_pool_manager, LockManager *lock_manager = nullptr);
 
   void InsertEntry(const Tuple &key, RID rid, Transaction *transaction) override;
 
@@ -33,6 +46,12 @@ class BPlusTreeIndex : public Index {
 
   void ScanKey(const Tuple &key, std::vector<RID> *result, Transaction *transaction) override;
 
+  /**
+   * Scan the keys between start_key and end_key, both included.
+   * @param[out] result the RIDs of the keys in the range, in key order
+   */
+  void ScanRange(const Tuple &start_key, const Tuple &end_key, std::vector<RID> *result, Transaction *transaction);
+
   INDEXITERATOR_TYPE GetBeginIterator();
 
   INDEXITERATOR_TYPE GetBeginIterator(const KeyType &key);
@@ -40,10 +59,55 @@ class BPlusTreeIndex : public Index {
   INDEXITERATOR_TYPE GetEndIterator();
 
  protected:
+  /** @return true if the index locks the key ranges transaction reads */
+  bool LocksKeyRanges(Transaction *transaction) const {
+    return lock_manager_ != nullptr && transaction != nullptr &&
+           transaction->GetIsolationLevel() == IsolationLevel::SERIALIZABLE;
+  }
+
+  /**
+   * @return true if the writes of transaction lock key ranges. Writes lock at every lock-based isolation level, or
+   * they would put phantoms into the ranges of SERIALIZABLE scans. Rolling back an aborted transaction takes no locks.
+   */
+  bool LocksWrites(Transaction *transaction) const {
+    return lock_manager_ != nullptr && transaction != nullptr &&
+           transaction->GetState() != TransactionState::ABORTED &&
+           transaction->GetIsolationLevel() != IsolationLevel::SNAPSHOT &&
+           transaction->GetIsolationLevel() != IsolationLevel::OPTIMISTIC;
+  }
+
+  /**
+   * Collect the RIDs of the keys between start and end, both included, and the RID of the first key after end, which
+   * is end_of_index_ past the last key.
+   */
+  void CollectRange(const KeyType &start, const KeyType &end, std::vector<RID> *rids, RID *next);
+
+  /**
+   * Lock the keys between start and end and the gap after them, in exclusive or shared mode, until the range stops
+   * changing under the locks.
+   * @param[out] result the RIDs of the keys in the range
+   * @return false if the transaction was aborted while waiting for a lock
+   */
+  bool LockKeyRange(const KeyType &start, const KeyType &end, bool exclusive, std::vector<RID> *result,
+                    Transaction *transaction);
+
+  /**
+   * Wait until no other transaction holds a lock on the gap key goes into.
+   * @return false if the transaction was aborted while waiting
+   */
+  bool WaitForGap(const KeyType &key, Transaction *transaction);
+
+  /** Report that transaction was aborted while it waited for a lock. */
+  [[noreturn]] void ThrowAbort(Transaction *transaction);
+
   // comparator for key
   KeyComparator comparator_;
   // container
   BPlusTree<KeyType, ValueType, KeyComparator> container_;
+  // locks the key ranges of SERIALIZABLE transactions, nullptr to lock nothing
+  LockManager *lock_manager_;
+  // the RID locked for the gap after the last key
+  RID end_of_index_;
 };
 
 }  // namespace bustub
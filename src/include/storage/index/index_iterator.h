@@ -37,6 +37,8 @@ class IndexIterator {
   bool operator!=(const IndexIterator &itr) const { return (itr.leaf_ != leaf_) || (index_ != itr.index_); }
 
  private:
+  /** Move on to the first entry of the next leaf once index_ is past the last entry of leaf_. */
+  void MoveToNextLeafIfDone();
  void UnlockAndUnPin() ;
   // add your own private member variables here
   int index_;
@@ -67,6 +67,12 @@ class BPlusTreeInternalPage : public BPlusTreePage {
                          BufferPoolManager *buffer_pool_manager);
 
  private:
+  /** Insert count items at index, logged like every change to the page. */
+  inline void InsertItems(int index, const MappingType *items, int count) {
+    InsertEntries(OffsetOf(array), sizeof(MappingType), index, items, count);
+  }
+  /** Remove count items at index, logged like every change to the page. */
+  inline void RemoveItems(int index, int count) { RemoveEntries(OffsetOf(array), sizeof(MappingType), index, count); }
   void CopyNFrom(MappingType *items, int size, BufferPoolManager *buffer_pool_manager);
   void CopyLastFrom(const MappingType &pair, BufferPoolManager *buffer_pool_manager);
   void CopyFirstFrom(const MappingType &pair, BufferPoolManager *buffer_pool_manager);
@@ -66,6 +66,14 @@ class BPlusTreeLeafPage : public BPlusTreePage {
                          BufferPoolManager *buffer_pool_manager);
 
  private:
+  /** Insert count items at index, logged like every change to the page, by key for the insert of a key. */
+  inline void InsertItems(int index, const MappingType *items, int count, bool by_key = false) {
+    InsertEntries(OffsetOf(array), sizeof(MappingType), index, items, count, by_key);
+  }
+  /** Remove count items at index, logged like every change to the page, by key for the removal of a key. */
+  inline void RemoveItems(int index, int count, bool by_key = false) {
+    RemoveEntries(OffsetOf(array), sizeof(MappingType), index, count, by_key);
+  }
   void CopyNFrom(MappingType *items, int size);
   void CopyLastFrom(const MappingType &item);
   void CopyFirstFrom(const MappingType &item);
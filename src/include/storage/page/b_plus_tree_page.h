@@ -16,6 +16,7 @@
 #include <string>
 
 #include "buffer/buffer_pool_manager.h"
+#include "concurrency/transaction.h"
 #include "storage/index/generic_key.h"
 
 namespace bustub {
@@ -30,6 +31,48 @@ namespace bustub {
 enum class IndexPageType { INVALID_INDEX_PAGE = 0, LEAF_PAGE, INTERNAL_PAGE };
 enum class Operate_Type{OP_READ=0,OP_DELETE,OP_INSERT};
 
+/**
+ * The log manager and transaction that the changes a thread makes to B+ tree pages are logged for. BPlusTree sets it
+ * for the duration of an insert or a remove while logging is on.
+ */
+struct BPlusTreeLogContext {
+  LogManager *log_manager_;
+  Transaction *txn_;
+  /** Name of the tree, logged with the insert or removal of a key in a leaf so that undo can find the key again. */
+  const std::string *index_name_;
+  /** Set while recovery undoes a change by key, the change that reverts it is then logged as a CLR. */
+  bool compensating_;
+  /** Where undo continues after the CLR, the record before the one being undone. */
+  lsn_t undo_next_lsn_;
+};
+
+/**
+ * A B+ tree as recovery sees it. The insert or removal of a key in a leaf is undone through the tree, by key, since
+ * the entry may sit on another page by the time it is undone. Recovery does not know the key type, so it hands over
+ * the entry as the bytes logged for it.
+ */
+class BPlusTreeUndo {
+ public:
+  virtual ~BPlusTreeUndo() = default;
+
+  /** @return the name of the tree, which the records of its leaf changes carry */
+  virtual const std::string &GetIndexName() const = 0;
+
+  /** Read the root page id from the header page, which recovery may have changed. */
+  virtual bool LoadRootPageId() = 0;
+
+  /**
+   * Remove the entry of a key inserted by a transaction being rolled back, logging the removal as a CLR.
+   * @param entry the key and value as laid out in a leaf
+   * @param transaction the transaction the undo is logged for
+   * @param undo_next_lsn the record before the undone insert
+   */
+  virtual void UndoInsert(const char *entry, Transaction *transaction, lsn_t undo_next_lsn) = 0;
+
+  /** Put back the entry of a key removed by a transaction being rolled back, see UndoInsert. */
+  virtual void UndoRemove(const char *entry, Transaction *transaction, lsn_t undo_next_lsn) = 0;
+};
+
 /**
  * Both internal and leaf page are inherited from this page.
  *
@@ -75,7 +118,66 @@ class BPlusTreePage {
   void SetLSN(lsn_t lsn = INVALID_LSN);
   bool IsSafe(Operate_Type operate);
 
+  /** Where the changes this thread makes to B+ tree pages are logged, nullptr while they are not logged. */
+  static thread_local BPlusTreeLogContext *log_context;
+
+  /**
+   * Insert count entries at index of the entry array, moving the entries from index on back, and grow the size.
+   * Works on raw page data, so recovery can apply a BTREE_INSERT record without knowing the key type.
+   * @param data the page data
+   * @param array_offset where the entry array starts in the page
+   * @param entry_size size of one entry
+   * @param index position of the first new entry
+   * @param entries the new entries
+   * @param count number of new entries
+   */
+  static void ApplyInsert(char *data, int array_offset, int entry_size, int index, const char *entries, int count);
+
+  /** Remove count entries at index of the entry array and shrink the size, the counterpart of ApplyInsert. */
+  static void ApplyRemove(char *data, int array_offset, int entry_size, int index, int count);
+
+  /**
+   * Start a split, merge, redistribution or root change, logged as a nested top action.
+   * @return where the structure change starts in the log, to hand to EndStructureChange
+   */
+  static lsn_t BeginStructureChange();
+
+  /**
+   * End the structure change that started at begin_lsn with a CLR that makes undo skip it. Once complete it stays,
+   * whether the transaction commits or not, since other transactions may have used the new structure since.
+   */
+  static void EndStructureChange(lsn_t begin_lsn);
+
+ protected:
+  /**
+   * Every change to a B+ tree page goes through one of these, which log it while log_context is set. A split, merge,
+   * redistribution or root change thus ends up in the log as one record per page it changes.
+   */
+  /**
+   * Insert entries into the entry array, see ApplyInsert, logged as BTREE_INSERT.
+   * @param by_key true for the insert of a key into a leaf, which undo reverts by key instead of on this page
+   */
+  void InsertEntries(int array_offset, int entry_size, int index, const void *entries, int count,
+                     bool by_key = false);
+  /** Remove entries from the entry array, see ApplyRemove, logged as BTREE_DELETE. */
+  void RemoveEntries(int array_offset, int entry_size, int index, int count, bool by_key = false);
+  /** Overwrite size bytes at offset from the start of the page, logged as BTREE_UPDATE. */
+  void WriteBytes(int offset, const void *data, int size);
+  /** Log size bytes at offset as changed from old_data to what the page holds now, after a write of several fields. */
+  void LogUpdate(int offset, const char *old_data, int size);
+  /** Set up the header of a new page without logging it, Init logs the whole header at once. */
+  void InitHeader(IndexPageType page_type, page_id_t page_id, page_id_t parent_id, int max_size);
+  /** @return offset of a field of this page from the start of the page */
+  inline int OffsetOf(const void *field) const {
+    return static_cast<int>(reinterpret_cast<const char *>(field) - reinterpret_cast<const char *>(this));
+  }
+
  private:
+  /** Append a record for a change to this page and stamp the page with its LSN. */
+  void AppendLogRecord(LogRecord *log_record);
+  /** Log a change to the entry array, by key (or as the CLR of an undo by key) or to be undone on this page. */
+  void LogEntries(LogRecordType log_record_type, int array_offset, int entry_size, int index, int count, bool by_key);
+
   // member variable, attributes that both internal and leaf page share
   // 页的类型:内部页和叶子页
   IndexPageType page_type_ __attribute__((__unused__));
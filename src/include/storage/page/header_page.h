@@ -22,9 +22,10 @@ namespace bustub {
  * 32 bytes) and their corresponding root_id
  *
  * Format (size in byte):
- *  -----------------------------------------------------------------
- * | RecordCount (4) | Entry_1 name (32) | Entry_1 root_id (4) | ... |
- *  -----------------------------------------------------------------
+ *  ---------------------------------------------------------------------------
+ * | RecordCount (4) | LSN (4) | Entry_1 name (32) | Entry_1 root_id (4) | ... |
+ *  ---------------------------------------------------------------------------
+ * The LSN sits where every page keeps it, so root changes are logged and redone like the changes of other pages.
  */
 class HeaderPage : public Page {
  public:
@@ -47,5 +48,8 @@ class HeaderPage : public Page {
   int FindRecord(const std::string &name);
 
   void SetRecordCount(int record_count);
+
+  /** Offset of the first record, past the record count and the LSN. */
+  static constexpr int RECORDS_OFFSET = 8;
 };
 }  // namespace bustub
@@ -16,7 +16,7 @@
 #include <iostream>
 
 #include "common/config.h"
-#include "common/rwlatch.h"
+#include "common/shared_latch.h"
 
 namespace bustub {
 
@@ -86,8 +86,12 @@ class Page {
   int pin_count_ = 0;
   /** True if the page is dirty, i.e. it is different from its corresponding page on disk. */
   bool is_dirty_ = false;
+  /** Recovery LSN, no log record older than this one has modified the page since it was last clean. */
+  lsn_t rec_lsn_ = INVALID_LSN;
+  /** Log offset at or before the record with rec_lsn_. */
+  int64_t rec_offset_ = 0;
   /** Page latch. */
-  ReaderWriterLatch rwlatch_;
+  SharedLatch rwlatch_;
 };
 
 }  // namespace bustub
@@ -13,6 +13,7 @@
 #pragma once
 
 #include <cstring>
+#include <functional>
 
 #include "common/rid.h"
 #include "concurrency/lock_manager.h"
@@ -49,7 +50,7 @@ class TablePage : public Page {
    * @param page_size the size of this table page
    * @param prev_page_id the previous table page ID
    * @param log_manager the log manager in use
-   * @param txn the transaction that this page is created in
+   * @param txn the transaction that this page is created in, nullptr to create it without logging
    */
   void Init(page_id_t page_id, uint32_t page_size, page_id_t prev_page_id, LogManager *log_manager, Transaction *txn);
 
@@ -77,7 +78,7 @@ class TablePage : public Page {
    * @param tuple tuple to insert
    * @param[out] rid rid of the inserted tuple
    * @param txn transaction performing the insert
-   * @param lock_manager the lock manager
+   * @param lock_manager the lock manager, nullptr if a lock on the table covers the row
    * @param log_manager the log manager
    * @return true if the insert is successful (i.e. there is enough space)
    */
@@ -87,7 +88,7 @@ class TablePage : public Page {
    * Mark a tuple as deleted. This does not actually delete the tuple.
    * @param rid rid of the tuple to mark as deleted
    * @param txn transaction performing the delete
-   * @param lock_manager the lock manager
+   * @param lock_manager the lock manager, nullptr if a lock on the table covers the row
    * @param log_manager the log manager
    * @return true if marking the tuple as deleted is successful (i.e the tuple exists)
    */
@@ -99,7 +100,7 @@ class TablePage : public Page {
    * @param[out] old_tuple old value of the tuple
    * @param rid rid of the tuple
    * @param txn transaction performing the update
-   * @param lock_manager the lock manager
+   * @param lock_manager the lock manager, nullptr if a lock on the table covers the row
    * @param log_manager the log manager
    * @return true if updating the tuple succeeded
    */
@@ -117,25 +118,51 @@ class TablePage : public Page {
    * @param rid rid of the tuple to read
    * @param[out] tuple the tuple that was read
    * @param txn transaction performing the read
-   * @param lock_manager the lock manager
+   * @param lock_manager the lock manager, nullptr if a lock on the table covers the row
    * @return true if the read is successful (i.e. the tuple exists)
    */
   bool GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, LockManager *lock_manager);
 
+  /**
+   * Read the newest version of a tuple without locking it, also if it is marked deleted. For snapshot reads, which
+   * find the version they see from there.
+   * @param rid rid of the tuple to read
+   * @param[out] tuple the tuple that was read
+   * @param[out] deleted true if the tuple is marked deleted
+   * @return false if the slot holds no tuple
+   */
+  bool ReadTuple(const RID &rid, Tuple *tuple, bool *deleted);
+
+  /**
+   * @param rid rid of a tuple
+   * @return true if the slot of rid holds a tuple that is not marked deleted
+   */
+  bool HasTuple(const RID &rid);
+
   /** @return the rid of the first tuple in this page */
 
   /**
    * @param[out] first_rid the RID of the first tuple in this page
+   * @param every_slot true to return the first slot, whether it holds a tuple or not
    * @return true if the first tuple exists, false otherwise
    */
-  bool GetFirstTupleRid(RID *first_rid);
+  bool GetFirstTupleRid(RID *first_rid, bool every_slot = false);
 
   /**
    * @param cur_rid the RID of the current tuple
    * @param[out] next_rid the RID of the tuple following the current tuple
+   * @param every_slot true to return the next slot, whether it holds a tuple or not
    * @return true if the next tuple exists, false otherwise
    */
-  bool GetNextTupleRid(const RID &cur_rid, RID *next_rid);
+  bool GetNextTupleRid(const RID &cur_rid, RID *next_rid, bool every_slot = false);
+
+  /**
+   * Give the empty slots at the end of the slot array back to the free space. The slot an insert picks does not
+   * change, it takes the first empty slot either way, so this is not logged.
+   * @param can_reclaim tells whether the slot of a rid may go, nullptr if every empty slot may
+   * @return the number of slots reclaimed
+   */
+  uint32_t ReclaimSlots(const std::function<bool(const RID &)> &can_reclaim = nullptr);
 
  private:
   static_assert(sizeof(page_id_t) == 4);
@@ -190,9 +217,18 @@ class TablePage : public Page {
     memcpy(GetData() + OFFSET_TUPLE_SIZE + SIZE_TUPLE * slot_num, &size, sizeof(uint32_t));
   }
 
+  /**
+   * @return true if the changes of txn are logged and locked. Recovery passes no transaction, it redoes and undoes
+   * changes on the page alone and logs its compensation itself.
+   */
+  static bool IsLogged(Transaction *txn) { return enable_logging && txn != nullptr; }
+
   /** @return true if the tuple is deleted or empty */
   static bool IsDeleted(uint32_t tuple_size) { return static_cast<bool>(tuple_size & DELETE_MASK) || tuple_size == 0; }
 
+  /** Copy the tuple of rid, which has the given size without the deleted flag, into tuple. */
+  void CopyTuple(const RID &rid, uint32_t tuple_size, Tuple *tuple);
+
   /** @return tuple size with the deleted flag set */
   static uint32_t SetDeletedFlag(uint32_t tuple_size) { return static_cast<uint32_t>(tuple_size | DELETE_MASK); }
 
@@ -12,23 +12,35 @@
 
 #pragma once
 
+#include <atomic>
+
 #include "buffer/buffer_pool_manager.h"
 #include "recovery/log_manager.h"
 #include "storage/page/table_page.h"
 #include "storage/table/table_iterator.h"
 #include "storage/table/tuple.h"
+#include "storage/table/version_store.h"
 
 namespace bustub {
 
+class TransactionManager;
+
 /**
  * TableHeap represents a physical table on disk.
  * This is just a doubly-linked list of pages.
+ *
+ * Every write keeps the version of the row it replaces in the version store of the heap, and SNAPSHOT transactions
+ * read the rows through it without taking any locks.
+ *
+ * An OPTIMISTIC transaction reads the newest committed versions the same way, and its writes only go to its write set
+ * until TransactionManager::Commit validates the reads (ValidateRead) and installs them.
  */
 class TableHeap {
   friend class TableIterator;
 
  public:
-  ~TableHeap() = default;
+  /** Leaves the garbage collection of the transaction manager, if it still has versions of the table to prune. */
+  ~TableHeap();
 
   /**
    * Create a table heap without a transaction. (open table)
@@ -36,9 +48,10 @@ class TableHeap {
    * @param lock_manager the lock manager
    * @param log_manager the log manager
    * @param first_page_id the id of the first page
+   * @param table_oid the table of the catalog the heap stores, rows are locked under intention locks on it
    */
   TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_manager, LogManager *log_manager,
-            page_id_t first_page_id);
+            page_id_t first_page_id, table_oid_t table_oid = INVALID_TABLE_OID);
 
   /**
    * Create a table heap with a transaction. (create table)
@@ -46,9 +59,10 @@ class TableHeap {
    * @param lock_manager the lock manager
    * @param log_manager the log manager
    * @param txn the creating transaction
+   * @param table_oid the table of the catalog the heap stores, rows are locked under intention locks on it
    */
   TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_manager, LogManager *log_manager,
-            Transaction *txn);
+            Transaction *txn, table_oid_t table_oid = INVALID_TABLE_OID);
 
   /**
    * Insert a tuple into the table. If the tuple is too large (>= page_size), return false.
@@ -90,6 +104,42 @@ class TableHeap {
    */
   void RollbackDelete(const RID &rid, Transaction *txn);
 
+  /**
+   * Called on commit to let the snapshots taken from now on see the writes of txn to a row.
+   * @param rid rid of a tuple written by txn
+   * @param txn the committing transaction, its commit timestamp is set
+   */
+  void CommitVersions(const RID &rid, Transaction *txn);
+
+  /**
+   * Prune the versions replaced by writes that every snapshot sees, and give the slots of the rows that are gone for
+   * good back to the free space of their pages.
+   * @param oldest_ts the begin timestamp of the oldest running snapshot
+   * @param max_rows the most rows to prune
+   * @return the number of rows pruned, less than max_rows once nothing is left to prune
+   */
+  size_t CollectGarbage(timestamp_t oldest_ts, size_t max_rows);
+
+  /**
+   * CollectGarbage for a single row, which the transaction that just committed wrote.
+   * @param rid rid of a tuple written by the committed transaction
+   * @param oldest_ts the begin timestamp of the oldest running snapshot
+   * @param deleted true if the write deleted the row, so that its slot may be given back
+   */
+  void PruneVersions(const RID &rid, timestamp_t oldest_ts, bool deleted);
+
+  /**
+   * Set the transaction manager that waits to collect the garbage of this table, see ~TableHeap.
+   * @param txn_manager the transaction manager, nullptr once it no longer knows the table
+   */
+  void SetGarbageOwner(TransactionManager *txn_manager) { garbage_owner_ = txn_manager; }
+
+  /** @return true if committed writes wait for CollectGarbage */
+  bool HasGarbage() { return version_store_.HasCommittedVersions(); }
+
+  /** @return the number of replaced row versions kept for snapshots */
+  size_t GetVersionCount() { return version_store_.GetVersionCount(); }
+
   /**
    * Read a tuple from the table.
    * @param rid rid of the tuple to read
@@ -105,14 +155,92 @@ class TableHeap {
   /** @return the end iterator of this table */
   TableIterator End();
 
+  /**
+   * Lock a row an OPTIMISTIC transaction is about to install a write to, before its reads are validated.
+   * @return false if the lock was not granted
+   */
+  bool LockForWrite(const RID &rid, Transaction *txn);
+
+  /**
+   * Validate a read of an OPTIMISTIC transaction.
+   * @param rid the row read
+   * @param version the commit timestamp of the newest write to the row that the read saw
+   * @param txn the validating transaction
+   * @return true if no other transaction has written the row since
+   */
+  bool ValidateRead(const RID &rid, timestamp_t version, Transaction *txn);
+
   /** @return the id of the first page of this table */
   inline page_id_t GetFirstPageId() const { return first_page_id_; }
 
  private:
+  /**
+   * Take the intention lock on the table that goes with locking a row, unless the transaction holds a table lock that
+   * covers the row already. Once the transaction holds as many row locks on the table as the escalation threshold of
+   * the lock manager, they are escalated to a table lock instead. Called before any page is latched, as the table lock
+   * may have to wait.
+   * @param txn the transaction about to access a row
+   * @param exclusive true if the row is about to be written
+   * @return the lock manager to lock the row with, nullptr if the row needs no lock of its own
+   */
+  LockManager *GetRowLockManager(Transaction *txn, bool exclusive);
+
+  /**
+   * GetTuple for a scan. The iterator finds a row under the page latch but reads it after, as the read may wait for a
+   * lock, so a row deleted meanwhile is skipped instead of aborting the transaction.
+   * @return false if there is no row at rid for txn
+   */
+  bool ScanTuple(const RID &rid, Tuple *tuple, Transaction *txn) { return GetTuple(rid, tuple, txn, true); }
+
+  /** GetTuple, which only aborts txn for a row that is not there if skip_missing is false. */
+  bool GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, bool skip_missing);
+
+  /**
+   * GetTuple for SNAPSHOT and OPTIMISTIC transactions: read the version of the row a snapshot sees, without locking
+   * it. An OPTIMISTIC transaction reads the newest committed version, or its own buffered write, and records the read.
+   */
+  bool GetVersionedTuple(const RID &rid, Tuple *tuple, Transaction *txn);
+
+  /** @return true if txn buffers a write instead of making it, see TableHeap */
+  static bool BuffersWrites(Transaction *txn) {
+    return txn->GetIsolationLevel() == IsolationLevel::OPTIMISTIC && txn->GetState() == TransactionState::GROWING;
+  }
+
+  /**
+   * Lock a row before its page is latched, so that no transaction waits for a row lock while it holds a latch the
+   * holder of the lock may need. The page then finds the row locked already. This also makes sure that the check of a
+   * SNAPSHOT write for a conflict, under the latch, sees every write to the row before its own.
+   * @param lock_manager the lock manager to lock the row with, nullptr if the row needs no lock of its own
+   * @param exclusive true if the row is about to be written
+   * @return false if the lock was not granted
+   */
+  bool LockRow(Transaction *txn, const RID &rid, LockManager *lock_manager, bool exclusive);
+
+  /** @return true if txn reads the rows as of its snapshot */
+  static bool ReadsSnapshot(Transaction *txn) {
+    return txn != nullptr && txn->GetIsolationLevel() == IsolationLevel::SNAPSHOT;
+  }
+
+  /** @return true if txn reads the rows through the version store, without locks */
+  static bool ReadsVersions(Transaction *txn) {
+    return ReadsSnapshot(txn) || (txn != nullptr && txn->GetIsolationLevel() == IsolationLevel::OPTIMISTIC);
+  }
+
+  /**
+   * Count a row lock towards the escalation threshold if txn took it just now.
+   * @param was_locked true if txn had locked the row before
+   */
+  void TrackRowLock(Transaction *txn, const RID &rid, bool was_locked);
+
   BufferPoolManager *buffer_pool_manager_;
   LockManager *lock_manager_;
   LogManager *log_manager_;
   page_id_t first_page_id_{};
+  table_oid_t table_oid_;
+  /** The versions of the rows replaced by writes. */
+  VersionStore version_store_;
+  /** The transaction manager that waits to collect the garbage of this table, nullptr if none. */
+  std::atomic<TransactionManager *> garbage_owner_{nullptr};
 };
 
 }  // namespace bustub
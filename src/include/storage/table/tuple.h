@@ -63,6 +63,9 @@ class Tuple {
   // deserialize tuple data(deep copy)
   void DeserializeFrom(const char *storage);
 
+  // point at serialized tuple data without copying it(shallow), storage must outlive the tuple
+  void ViewFrom(const char *storage);
+
   // return RID of current tuple
   inline RID GetRid() const { return rid_; }
 
@@ -0,0 +1,162 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// version_store.h
+//
+// Identification: src/include/storage/table/version_store.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <deque>
+#include <mutex>  // NOLINT
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "common/config.h"
+#include "common/rid.h"
+#include "storage/table/tuple.h"
+
+namespace bustub {
+
+/**
+ * VersionStore keeps the versions of the rows of a table heap that writes have replaced, so that a snapshot can still
+ * read them.
+ *
+ * The page always holds the newest version of a row. For every write the store keeps the version it replaced, tagged
+ * with the writing transaction and, once that commits, its commit timestamp. Reading a row as of a snapshot starts
+ * from the page and undoes, newest first, the writes the snapshot does not see.
+ *
+ * A write records the version it replaces while it holds the write latch of the page, and a snapshot read looks the
+ * row up while it holds the read latch, so a reader never finds a new version on the page without its record here.
+ *
+ * Once every running snapshot sees a committed write, nobody undoes it any more and Prune drops its record. The
+ * committed writes are queued in commit order, so pruning only visits the rows that have something to drop.
+ */
+class VersionStore {
+ public:
+  /**
+   * Record the version of a row that a write replaces.
+   * @param rid the row
+   * @param tuple the version replaced, nullptr if the write inserts the row
+   * @param txn_id the writing transaction
+   */
+  void PushVersion(const RID &rid, const Tuple *tuple, txn_id_t txn_id);
+
+  /**
+   * Forget the version recorded for the newest write to a row, which its transaction has rolled back.
+   * @param rid the row
+   * @param txn_id the transaction rolling back
+   */
+  void PopVersion(const RID &rid, txn_id_t txn_id);
+
+  /**
+   * Stamp the versions of a row replaced by a transaction with its commit timestamp.
+   * @param rid the row
+   * @param txn_id the committing transaction
+   * @param commit_ts its commit timestamp
+   */
+  void CommitVersions(const RID &rid, txn_id_t txn_id, timestamp_t commit_ts);
+
+  /**
+   * @param rid the row about to be written
+   * @param txn_id the writing transaction
+   * @param begin_ts the snapshot of the writing transaction
+   * @return true if another transaction wrote the row and has not committed yet or committed after begin_ts
+   */
+  bool HasWriteConflict(const RID &rid, txn_id_t txn_id, timestamp_t begin_ts);
+
+  /**
+   * Find the version of a row a snapshot sees.
+   * @param rid the row
+   * @param txn_id the reading transaction, which sees its own writes
+   * @param begin_ts the snapshot, which sees the writes committed up to it
+   * @param[out] tuple the version seen, if it is not the one on the page
+   * @param[out] exists false if the row did not exist in the snapshot
+   * @param[out] write_ts if not nullptr, the commit timestamp of the newest write the snapshot sees, 0 if none is kept
+   * @return false if the snapshot sees the version on the page
+   */
+  bool GetVisibleVersion(const RID &rid, txn_id_t txn_id, timestamp_t begin_ts, Tuple *tuple, bool *exists,
+                         timestamp_t *write_ts = nullptr);
+
+  /**
+   * @param rid a row read before
+   * @param txn_id the reading transaction
+   * @param write_ts the commit timestamp of the newest write to the row that the read saw
+   * @return true if another transaction wrote the row since: it has not committed yet, or it committed after write_ts
+   */
+  bool HasChangedSince(const RID &rid, txn_id_t txn_id, timestamp_t write_ts);
+
+  /**
+   * Drop the versions replaced by writes that every snapshot sees.
+   * @param oldest_ts the begin timestamp of the oldest running snapshot
+   * @param max_rows the most rows to prune
+   * @param[out] pruned the rows left without any version
+   * @return the number of rows pruned, less than max_rows once nothing is left to prune
+   */
+  size_t Prune(timestamp_t oldest_ts, size_t max_rows, std::vector<RID> *pruned);
+
+  /**
+   * Prune a single row, for a transaction that drops the versions of its own writes as it commits. The row stays
+   * queued, Prune finds nothing left to drop once it gets to it.
+   * @param rid the row
+   * @param oldest_ts the begin timestamp of the oldest running snapshot
+   * @return true if the row is left without any version
+   */
+  bool PruneRow(const RID &rid, timestamp_t oldest_ts);
+
+  /** @return true if a row has versions kept for it */
+  bool HasVersions(const RID &rid);
+
+  /** @return true if committed writes wait to be pruned */
+  bool HasCommittedVersions();
+
+  /** @return the number of versions kept */
+  size_t GetVersionCount();
+
+ private:
+  /** A version of a row, as it was before a write. */
+  class TupleVersion {
+   public:
+    TupleVersion(const Tuple *tuple, txn_id_t txn_id)
+        : exists_(tuple != nullptr), txn_id_(txn_id), commit_ts_(INVALID_TIMESTAMP) {
+      if (exists_) {
+        tuple_ = *tuple;
+      }
+    }
+
+    /** True if the row existed before the write. */
+    bool exists_;
+    Tuple tuple_;
+    /** The transaction that wrote over this version. */
+    txn_id_t txn_id_;
+    /** The commit timestamp of that transaction, INVALID_TIMESTAMP while it is running. */
+    timestamp_t commit_ts_;
+  };
+
+  /**
+   * Drop the versions of a row replaced by writes that every snapshot sees, the row goes once it has none left.
+   * @return true if the row is left without any version
+   */
+  bool DropVisibleVersions(std::unordered_map<RID, std::deque<TupleVersion>>::iterator versions,
+                           timestamp_t oldest_ts);
+
+  /** @return true if the write over version is visible to the snapshot begin_ts of txn_id */
+  static bool IsVisible(const TupleVersion &version, txn_id_t txn_id, timestamp_t begin_ts) {
+    return version.txn_id_ == txn_id || (version.commit_ts_ != INVALID_TIMESTAMP && version.commit_ts_ <= begin_ts);
+  }
+
+  std::mutex latch_;
+  /** The versions of each row, oldest first. */
+  std::unordered_map<RID, std::deque<TupleVersion>> versions_;
+  /** The rows written by commits, with the commit timestamp, in commit order. */
+  std::deque<std::pair<timestamp_t, RID>> committed_;
+  size_t version_count_{0};
+};
+
+}  // namespace bustub
@@ -12,7 +12,50 @@
 
 #include "recovery/log_manager.h"
 
+#include <algorithm>
+#include <cstring>
+
 namespace bustub {
+
+void LogManager::FindLogEnd() {
+  int64_t offset;
+  if (!disk_manager_->ReadMasterRecord(&offset)) {
+    offset = disk_manager_->GetLogStart();
+  }
+  int64_t log_size = disk_manager_->GetLogSize();
+  // the log buffer is not in use yet, borrow it as the read window
+  int64_t window_offset = -1;
+  lsn_t last_lsn = INVALID_LSN;
+  while (true) {
+    if (window_offset == -1 || offset + LogRecord::HEADER_SIZE > window_offset + LOG_BUFFER_SIZE) {
+      if (!disk_manager_->ReadLog(log_buffer_, LOG_BUFFER_SIZE, offset)) {
+        break;
+      }
+      window_offset = offset;
+    }
+    const char *pos = log_buffer_ + (offset - window_offset);
+    int32_t size;
+    lsn_t lsn;
+    memcpy(&size, pos, sizeof(int32_t));
+    memcpy(&lsn, pos + 4, sizeof(lsn_t));
+    // a torn record at the very end of the log is dropped as well
+    if (size < LogRecord::HEADER_SIZE || size > LOG_BUFFER_SIZE || offset + size > log_size || lsn == INVALID_LSN ||
+        (last_lsn != INVALID_LSN && lsn != last_lsn + 1)) {
+      break;
+    }
+    last_lsn = lsn;
+    offset += size;
+  }
+  if (last_lsn == INVALID_LSN) {
+    // nothing valid after the starting point, begin a fresh log there
+    offset = std::max<int64_t>(offset, disk_manager_->GetLogStart());
+  }
+  disk_manager_->SetLogEnd(offset);
+  next_offset_ = offset;
+  next_lsn_ = last_lsn + 1;
+  persistent_lsn_ = last_lsn;
+}
+
 /*
  * set enable_logging = true
  * Start a separate thread to execute flush to disk operation periodically
@@ -22,33 +65,214 @@ namespace bustub {
  *
  * This thread runs forever until system shutdown/StopFlushThread
  */
-void LogManager::RunFlushThread() {}
+void LogManager::RunFlushThread() {
+  if (enable_logging) {
+    return;
+  }
+  enable_logging = true;
+  flush_thread_ = new std::thread([this] {
+    std::unique_lock<std::mutex> latch(latch_);
+    while (enable_logging) {
+      auto deadline = std::chrono::steady_clock::now() + log_timeout;
+      if (lazy_flush_) {
+        deadline = std::min(deadline, flush_deadline_);
+      }
+      // An asynchronous commit with an earlier deadline wakes us up to wait for that deadline instead.
+      cv_.wait_until(latch, deadline, [this, &deadline] {
+        return need_flush_ || !enable_logging || (lazy_flush_ && flush_deadline_ < deadline);
+      });
+      if (need_flush_ || !enable_logging || std::chrono::steady_clock::now() >= deadline) {
+        FlushBuffer(&latch);
+      }
+    }
+    // Whatever was appended while we were shutting down still has to reach the disk.
+    FlushBuffer(&latch);
+  });
+}
 
 /*
  * Stop and join the flush thread, set enable_logging = false
  */
-void LogManager::StopFlushThread() {}
+void LogManager::StopFlushThread() {
+  if (flush_thread_ == nullptr) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> guard(latch_);
+    enable_logging = false;
+    cv_.notify_one();
+  }
+  flush_thread_->join();
+  delete flush_thread_;
+  flush_thread_ = nullptr;
+}
+
+void LogManager::FlushBuffer(std::unique_lock<std::mutex> *latch) {
+  need_flush_ = false;
+  // every asynchronous commit so far is in the buffer being written out
+  lazy_flush_ = false;
+  if (log_buffer_offset_ == 0) {
+    flushed_cv_.notify_all();
+    return;
+  }
+  std::swap(log_buffer_, flush_buffer_);
+  int size = log_buffer_offset_;
+  lsn_t last_lsn = next_lsn_ - 1;
+  int64_t end_offset = next_offset_;
+  log_buffer_offset_ = 0;
+  // Appenders waiting for space can continue into the fresh buffer while we write.
+  flushed_cv_.notify_all();
+
+  latch->unlock();
+  disk_manager_->WriteLog(flush_buffer_, size);
+  if (log_shipper_ != nullptr) {
+    log_shipper_->Ship(end_offset);
+  }
+  latch->lock();
+
+  persistent_lsn_ = last_lsn;
+  flushed_cv_.notify_all();
+}
+
+void LogManager::Flush(lsn_t lsn) {
+  std::unique_lock<std::mutex> latch(latch_);
+  while (enable_logging && persistent_lsn_ < lsn) {
+    need_flush_ = true;
+    cv_.notify_one();
+    flushed_cv_.wait(latch);
+  }
+}
+
+void LogManager::FlushLazily(lsn_t lsn) {
+  std::lock_guard<std::mutex> guard(latch_);
+  // an earlier asynchronous commit already set a deadline that covers this one
+  if (!enable_logging || persistent_lsn_ >= lsn || lazy_flush_) {
+    return;
+  }
+  lazy_flush_ = true;
+  flush_deadline_ = std::chrono::steady_clock::now() + async_commit_window;
+  cv_.notify_one();
+}
+
+void LogManager::RequestFlush() {
+  std::lock_guard<std::mutex> guard(latch_);
+  need_flush_ = true;
+  cv_.notify_one();
+}
 
 /*
  * append a log record into log buffer
  * you MUST set the log record's lsn within this method
  * @return: lsn that is assigned to this log record
- *
- *
- * example below
- * // First, serialize the must have fields(20 bytes in total)
- * log_record.lsn_ = next_lsn_++;
- * memcpy(log_buffer_ + offset_, &log_record, 20);
- * int pos = offset_ + 20;
- *
- * if (log_record.log_record_type_ == LogRecordType::INSERT) {
- *    memcpy(log_buffer_ + pos, &log_record.insert_rid_, sizeof(RID));
- *    pos += sizeof(RID);
- *    // we have provided serialize function for tuple class
- *    log_record.insert_tuple_.SerializeTo(log_buffer_ + pos);
- *  }
- *
  */
-lsn_t LogManager::AppendLogRecord(LogRecord *log_record) { return INVALID_LSN; }
+lsn_t LogManager::AppendLogRecord(LogRecord *log_record) {
+  BUSTUB_ASSERT(log_record->size_ <= LOG_BUFFER_SIZE, "Log record does not fit into the log buffer.");
+  std::unique_lock<std::mutex> latch(latch_);
+  // Wait for the flush thread to hand us an empty buffer if this record does not fit.
+  while (log_buffer_offset_ + log_record->size_ > LOG_BUFFER_SIZE) {
+    need_flush_ = true;
+    cv_.notify_one();
+    flushed_cv_.wait(latch);
+  }
+
+  // First, serialize the must have fields (20 bytes in total).
+  log_record->lsn_ = next_lsn_++;
+  char *pos = log_buffer_ + log_buffer_offset_;
+  memcpy(pos, &log_record->size_, sizeof(int32_t));
+  memcpy(pos + 4, &log_record->lsn_, sizeof(lsn_t));
+  memcpy(pos + 8, &log_record->txn_id_, sizeof(txn_id_t));
+  memcpy(pos + 12, &log_record->prev_lsn_, sizeof(lsn_t));
+  memcpy(pos + 16, &log_record->log_record_type_, sizeof(LogRecordType));
+  pos += LogRecord::HEADER_SIZE;
+
+  // A CLR is followed by the payload of the change it carries.
+  LogRecordType payload_type = log_record->log_record_type_;
+  if (payload_type == LogRecordType::CLR) {
+    memcpy(pos, &log_record->undo_next_lsn_, sizeof(lsn_t));
+    memcpy(pos + sizeof(lsn_t), &log_record->action_type_, sizeof(LogRecordType));
+    pos += sizeof(lsn_t) + sizeof(LogRecordType);
+    payload_type = log_record->action_type_;
+  }
+  switch (payload_type) {
+    case LogRecordType::INSERT:
+      memcpy(pos, &log_record->insert_rid_, sizeof(RID));
+      log_record->insert_tuple_.SerializeTo(pos + sizeof(RID));
+      break;
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      memcpy(pos, &log_record->delete_rid_, sizeof(RID));
+      log_record->delete_tuple_.SerializeTo(pos + sizeof(RID));
+      break;
+    case LogRecordType::UPDATE:
+      memcpy(pos, &log_record->update_rid_, sizeof(RID));
+      pos += sizeof(RID);
+      log_record->old_tuple_.SerializeTo(pos);
+      pos += sizeof(int32_t) + log_record->old_tuple_.GetLength();
+      log_record->new_tuple_.SerializeTo(pos);
+      break;
+    case LogRecordType::DELTAUPDATE:
+      memcpy(pos, &log_record->update_rid_, sizeof(RID));
+      memcpy(pos + sizeof(RID), log_record->update_delta_.data(), log_record->update_delta_.size());
+      break;
+    case LogRecordType::NEWPAGE:
+      memcpy(pos, &log_record->prev_page_id_, sizeof(page_id_t));
+      memcpy(pos + sizeof(page_id_t), &log_record->page_id_, sizeof(page_id_t));
+      break;
+    case LogRecordType::ENDCHECKPOINT: {
+      memcpy(pos, &log_record->redo_lsn_, sizeof(lsn_t));
+      pos += sizeof(lsn_t);
+      memcpy(pos, &log_record->redo_offset_, sizeof(int64_t));
+      pos += sizeof(int64_t);
+      memcpy(pos, &log_record->undo_offset_, sizeof(int64_t));
+      pos += sizeof(int64_t);
+      auto txn_count = static_cast<int32_t>(log_record->active_txn_table_.size());
+      memcpy(pos, &txn_count, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      for (const auto &txn : log_record->active_txn_table_) {
+        memcpy(pos, &txn.first, sizeof(txn_id_t));
+        memcpy(pos + sizeof(txn_id_t), &txn.second, sizeof(lsn_t));
+        pos += sizeof(txn_id_t) + sizeof(lsn_t);
+      }
+      auto page_count = static_cast<int32_t>(log_record->dirty_page_table_.size());
+      memcpy(pos, &page_count, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      for (const auto &page : log_record->dirty_page_table_) {
+        memcpy(pos, &page.first, sizeof(page_id_t));
+        memcpy(pos + sizeof(page_id_t), &page.second, sizeof(lsn_t));
+        pos += sizeof(page_id_t) + sizeof(lsn_t);
+      }
+      break;
+    }
+    case LogRecordType::BTREE_INSERT:
+    case LogRecordType::BTREE_DELETE: {
+      memcpy(pos, &log_record->page_id_, sizeof(page_id_t));
+      pos += sizeof(page_id_t);
+      memcpy(pos, &log_record->btree_offset_, sizeof(int32_t));
+      memcpy(pos + 4, &log_record->btree_entry_size_, sizeof(int32_t));
+      memcpy(pos + 8, &log_record->btree_index_, sizeof(int32_t));
+      memcpy(pos + 12, &log_record->btree_count_, sizeof(int32_t));
+      auto name_length = static_cast<int32_t>(log_record->btree_index_name_.size());
+      memcpy(pos + 16, &name_length, sizeof(int32_t));
+      pos += 20;
+      memcpy(pos, log_record->btree_index_name_.data(), name_length);
+      memcpy(pos + name_length, log_record->btree_data_.data(), log_record->btree_data_.size());
+      break;
+    }
+    case LogRecordType::BTREE_UPDATE:
+      memcpy(pos, &log_record->page_id_, sizeof(page_id_t));
+      pos += sizeof(page_id_t);
+      memcpy(pos, &log_record->btree_offset_, sizeof(int32_t));
+      memcpy(pos + 4, &log_record->btree_count_, sizeof(int32_t));
+      memcpy(pos + 8, log_record->btree_data_.data(), log_record->btree_data_.size());
+      break;
+    default:
+      // BEGIN/COMMIT/ABORT/BEGINCHECKPOINT and a CLR without an action only carry the header.
+      break;
+  }
+  log_buffer_offset_ += log_record->size_;
+  next_offset_ += log_record->size_;
+  return log_record->lsn_;
+}
 
 }  // namespace bustub
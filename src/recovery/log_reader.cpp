@@ -0,0 +1,121 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// log_reader.cpp
+//
+// Identification: src/recovery/log_reader.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "recovery/log_reader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include "common/exception.h"
+#include "common/logger.h"
+#include "recovery/log_record.h"
+
+namespace bustub {
+
+namespace {
+
+/** How far ahead of the reading position the kernel is asked to have the log in memory. */
+constexpr int64_t LOG_READ_AHEAD_SIZE = 8 * 1024 * 1024;
+
+}  // namespace
+
+LogReader::LogReader(DiskManager *disk_manager) {
+  start_ = disk_manager->GetLogStart();
+  end_ = disk_manager->GetLogSize();
+  if (end_ <= start_) {
+    end_ = start_;
+    return;
+  }
+  int64_t first_segment = start_ / LOG_SEGMENT_SIZE;
+  int64_t last_segment = (end_ - 1) / LOG_SEGMENT_SIZE;
+  span_ = static_cast<size_t>(last_segment - first_segment + 1) * LOG_SEGMENT_SIZE;
+  void *base = mmap(nullptr, span_, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (base == MAP_FAILED) {
+    throw Exception("can't reserve address space for the log");
+  }
+  base_ = static_cast<char *>(base);
+
+  for (int64_t segment_no = first_segment; segment_no <= last_segment; segment_no++) {
+    int64_t segment_start = segment_no * LOG_SEGMENT_SIZE;
+    std::string name = disk_manager->GetSegmentName(segment_no);
+    int fd = open(name.c_str(), O_RDONLY);
+    struct stat stat_buf;
+    if (fd == -1 || fstat(fd, &stat_buf) != 0 || stat_buf.st_size == 0) {
+      // a missing segment ends the log, nothing after it can be reached
+      if (fd != -1) {
+        close(fd);
+      }
+      end_ = std::min(end_, segment_start);
+      break;
+    }
+    // Map only what the file holds, touching the reservation past a file's end would fault.
+    auto length = static_cast<size_t>(std::min<int64_t>(stat_buf.st_size, LOG_SEGMENT_SIZE));
+    void *segment = mmap(base_ + (segment_start - start_), length, PROT_READ, MAP_SHARED | MAP_FIXED, fd, 0);
+    close(fd);
+    if (segment == MAP_FAILED) {
+      munmap(base_, span_);
+      throw Exception("can't map log segment");
+    }
+    if (length < static_cast<size_t>(LOG_SEGMENT_SIZE)) {
+      end_ = std::min<int64_t>(end_, segment_start + static_cast<int64_t>(length));
+    }
+  }
+  madvise(base_, span_, MADV_SEQUENTIAL);
+  read_ahead_end_ = start_;
+}
+
+LogReader::~LogReader() {
+  if (base_ != nullptr) {
+    munmap(base_, span_);
+  }
+}
+
+const char *LogReader::GetRecord(int64_t offset, int32_t *size) {
+  if (offset < start_ || offset + LogRecord::HEADER_SIZE > end_) {
+    return nullptr;
+  }
+  ReadAhead(offset);
+  const char *data = base_ + (offset - start_);
+  memcpy(size, data, sizeof(int32_t));
+  if (*size < LogRecord::HEADER_SIZE || *size > LOG_BUFFER_SIZE || offset + *size > end_) {
+    return nullptr;
+  }
+  return data;
+}
+
+void LogReader::ReadAhead(int64_t offset) {
+  int64_t read_ahead_end = read_ahead_end_.load(std::memory_order_relaxed);
+  // refill once half of the window has been used up
+  if (offset + LOG_READ_AHEAD_SIZE / 2 < read_ahead_end || read_ahead_end >= end_) {
+    return;
+  }
+  int64_t from = std::max(read_ahead_end, offset);
+  int64_t to = std::min(from + LOG_READ_AHEAD_SIZE, end_);
+  if (!read_ahead_end_.compare_exchange_strong(read_ahead_end, to)) {
+    // another reader moved the window meanwhile
+    return;
+  }
+  // madvise wants a page aligned address
+  auto page_size = static_cast<int64_t>(sysconf(_SC_PAGESIZE));
+  int64_t aligned = (from - start_) / page_size * page_size;
+  if (madvise(base_ + aligned, to - start_ - aligned, MADV_WILLNEED) != 0) {
+    LOG_DEBUG("log read-ahead failed");
+  }
+}
+
+}  // namespace bustub
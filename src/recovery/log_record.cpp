@@ -0,0 +1,146 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// log_record.cpp
+//
+// Identification: src/recovery/log_record.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "recovery/log_record.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "common/macros.h"
+
+namespace bustub {
+
+namespace {
+
+/** A run of equal bytes shorter than a range header is cheaper to log than to split the range around it. */
+constexpr uint32_t DELTA_MERGE_GAP = 3 * sizeof(uint32_t);
+
+struct DeltaRange {
+  uint32_t offset_;
+  uint32_t old_length_;
+  uint32_t new_length_;
+};
+
+inline void AppendUInt32(std::vector<char> *buf, uint32_t value) {
+  const char *bytes = reinterpret_cast<const char *>(&value);
+  buf->insert(buf->end(), bytes, bytes + sizeof(uint32_t));
+}
+
+inline uint32_t ReadUInt32(const char *data) {
+  uint32_t value;
+  memcpy(&value, data, sizeof(uint32_t));
+  return value;
+}
+
+}  // namespace
+
+void LogRecord::EncodeDelta(const Tuple &old_tuple, const Tuple &new_tuple, std::vector<char> *delta) {
+  const char *old_data = old_tuple.GetData();
+  const char *new_data = new_tuple.GetData();
+  uint32_t old_size = old_tuple.GetLength();
+  uint32_t new_size = new_tuple.GetLength();
+  uint32_t common = std::min(old_size, new_size);
+
+  // Collect the differing ranges of the common prefix, folding short equal runs into their neighbours.
+  std::vector<DeltaRange> ranges;
+  uint32_t i = 0;
+  while (i < common) {
+    if (old_data[i] == new_data[i]) {
+      i++;
+      continue;
+    }
+    uint32_t start = i;
+    uint32_t end = i + 1;
+    for (uint32_t j = i + 1; j < common; j++) {
+      if (old_data[j] != new_data[j]) {
+        end = j + 1;
+      } else if (j + 1 - end >= DELTA_MERGE_GAP) {
+        break;
+      }
+    }
+    ranges.push_back({start, end - start, end - start});
+    i = end;
+  }
+
+  // A change of size is logged as a single trailing range that covers the tail of both images.
+  if (old_size != new_size) {
+    uint32_t tail = common;
+    if (!ranges.empty() && common - (ranges.back().offset_ + ranges.back().old_length_) < DELTA_MERGE_GAP) {
+      tail = ranges.back().offset_;
+      ranges.pop_back();
+    }
+    ranges.push_back({tail, old_size - tail, new_size - tail});
+  }
+
+  delta->clear();
+  AppendUInt32(delta, old_size);
+  AppendUInt32(delta, new_size);
+  AppendUInt32(delta, static_cast<uint32_t>(ranges.size()));
+  for (const auto &range : ranges) {
+    AppendUInt32(delta, range.offset_);
+    AppendUInt32(delta, range.old_length_);
+    AppendUInt32(delta, range.new_length_);
+    delta->insert(delta->end(), old_data + range.offset_, old_data + range.offset_ + range.old_length_);
+    delta->insert(delta->end(), new_data + range.offset_, new_data + range.offset_ + range.new_length_);
+  }
+}
+
+bool LogRecord::ApplyDelta(const std::vector<char> &delta, const Tuple &base, bool redo, Tuple *result) {
+  const char *pos = delta.data();
+  uint32_t old_size = ReadUInt32(pos);
+  uint32_t new_size = ReadUInt32(pos + sizeof(uint32_t));
+  uint32_t range_count = ReadUInt32(pos + 2 * sizeof(uint32_t));
+  pos += 3 * sizeof(uint32_t);
+
+  uint32_t base_size = redo ? old_size : new_size;
+  uint32_t result_size = redo ? new_size : old_size;
+  if (base.GetLength() != base_size) {
+    return false;
+  }
+
+  // Build the rebuilt tuple in its serialized form (size followed by data), then deserialize it.
+  std::vector<char> buf(sizeof(uint32_t) + result_size);
+  memcpy(buf.data(), &result_size, sizeof(uint32_t));
+  char *out = buf.data() + sizeof(uint32_t);
+  const char *base_data = base.GetData();
+  uint32_t in_offset = 0;
+  uint32_t out_offset = 0;
+  for (uint32_t r = 0; r < range_count; r++) {
+    uint32_t offset = ReadUInt32(pos);
+    uint32_t old_length = ReadUInt32(pos + sizeof(uint32_t));
+    uint32_t new_length = ReadUInt32(pos + 2 * sizeof(uint32_t));
+    const char *old_bytes = pos + 3 * sizeof(uint32_t);
+    const char *new_bytes = old_bytes + old_length;
+    pos = new_bytes + new_length;
+
+    // Copy the unchanged bytes before this range, then the replacement bytes.
+    memcpy(out + out_offset, base_data + in_offset, offset - in_offset);
+    out_offset += offset - in_offset;
+    if (redo) {
+      memcpy(out + out_offset, new_bytes, new_length);
+      out_offset += new_length;
+      in_offset = offset + old_length;
+    } else {
+      memcpy(out + out_offset, old_bytes, old_length);
+      out_offset += old_length;
+      in_offset = offset + new_length;
+    }
+  }
+  memcpy(out + out_offset, base_data + in_offset, base_size - in_offset);
+  out_offset += base_size - in_offset;
+  BUSTUB_ASSERT(out_offset == result_size, "Delta ranges do not cover the rebuilt tuple.");
+
+  result->DeserializeFrom(buf.data());
+  return true;
+}
+
+}  // namespace bustub
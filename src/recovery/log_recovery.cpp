@@ -12,29 +12,770 @@
 
 #include "recovery/log_recovery.h"
 
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "storage/page/b_plus_tree_page.h"
 #include "storage/page/table_page.h"
 
 namespace bustub {
+
+namespace {
+
+/** Number of redo tasks the reader collects for a worker before handing them over. */
+constexpr size_t REDO_BATCH_SIZE = 256;
+/** Number of batches a worker may have queued before the reader waits for it. */
+constexpr size_t REDO_QUEUE_DEPTH = 16;
+
+}  // namespace
+
 /*
  * deserialize a log record from log buffer
  * @return: true means deserialize succeed, otherwise can't deserialize cause
  * incomplete log record
  */
-bool LogRecovery::DeserializeLogRecord(const char *data, LogRecord *log_record) { return false; }
+bool LogRecovery::DeserializeLogRecord(const char *data, LogRecord *log_record, bool copy) {
+  memcpy(&log_record->size_, data, sizeof(int32_t));
+  memcpy(&log_record->lsn_, data + 4, sizeof(lsn_t));
+  memcpy(&log_record->txn_id_, data + 8, sizeof(txn_id_t));
+  memcpy(&log_record->prev_lsn_, data + 12, sizeof(lsn_t));
+  memcpy(&log_record->log_record_type_, data + 16, sizeof(LogRecordType));
+  // A zeroed or torn tail marks the end of the log.
+  if (log_record->size_ < LogRecord::HEADER_SIZE || log_record->lsn_ == INVALID_LSN ||
+      log_record->log_record_type_ <= LogRecordType::INVALID ||
+      log_record->log_record_type_ > LogRecordType::CLR) {
+    return false;
+  }
+
+  const char *pos = data + LogRecord::HEADER_SIZE;
+  LogRecordType payload_type = log_record->log_record_type_;
+  if (payload_type == LogRecordType::CLR) {
+    memcpy(&log_record->undo_next_lsn_, pos, sizeof(lsn_t));
+    memcpy(&log_record->action_type_, pos + sizeof(lsn_t), sizeof(LogRecordType));
+    pos += sizeof(lsn_t) + sizeof(LogRecordType);
+    payload_type = log_record->action_type_;
+    // a CLR without an action ends a nested top action
+    if (payload_type < LogRecordType::INVALID || payload_type >= LogRecordType::CLR) {
+      return false;
+    }
+  }
+  switch (payload_type) {
+    case LogRecordType::INSERT:
+      memcpy(&log_record->insert_rid_, pos, sizeof(RID));
+      DeserializeTuple(pos + sizeof(RID), &log_record->insert_tuple_, copy);
+      break;
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      memcpy(&log_record->delete_rid_, pos, sizeof(RID));
+      DeserializeTuple(pos + sizeof(RID), &log_record->delete_tuple_, copy);
+      break;
+    case LogRecordType::UPDATE:
+      memcpy(&log_record->update_rid_, pos, sizeof(RID));
+      pos += sizeof(RID);
+      DeserializeTuple(pos, &log_record->old_tuple_, copy);
+      pos += sizeof(int32_t) + log_record->old_tuple_.GetLength();
+      DeserializeTuple(pos, &log_record->new_tuple_, copy);
+      break;
+    case LogRecordType::DELTAUPDATE:
+      memcpy(&log_record->update_rid_, pos, sizeof(RID));
+      pos += sizeof(RID);
+      log_record->update_delta_.assign(pos, data + log_record->size_);
+      break;
+    case LogRecordType::NEWPAGE:
+      memcpy(&log_record->prev_page_id_, pos, sizeof(page_id_t));
+      memcpy(&log_record->page_id_, pos + sizeof(page_id_t), sizeof(page_id_t));
+      break;
+    case LogRecordType::ENDCHECKPOINT: {
+      memcpy(&log_record->redo_lsn_, pos, sizeof(lsn_t));
+      pos += sizeof(lsn_t);
+      memcpy(&log_record->redo_offset_, pos, sizeof(int64_t));
+      pos += sizeof(int64_t);
+      memcpy(&log_record->undo_offset_, pos, sizeof(int64_t));
+      pos += sizeof(int64_t);
+      int32_t txn_count;
+      memcpy(&txn_count, pos, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      log_record->active_txn_table_.resize(txn_count);
+      for (auto &txn : log_record->active_txn_table_) {
+        memcpy(&txn.first, pos, sizeof(txn_id_t));
+        memcpy(&txn.second, pos + sizeof(txn_id_t), sizeof(lsn_t));
+        pos += sizeof(txn_id_t) + sizeof(lsn_t);
+      }
+      int32_t page_count;
+      memcpy(&page_count, pos, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      log_record->dirty_page_table_.resize(page_count);
+      for (auto &page : log_record->dirty_page_table_) {
+        memcpy(&page.first, pos, sizeof(page_id_t));
+        memcpy(&page.second, pos + sizeof(page_id_t), sizeof(lsn_t));
+        pos += sizeof(page_id_t) + sizeof(lsn_t);
+      }
+      break;
+    }
+    case LogRecordType::BTREE_INSERT:
+    case LogRecordType::BTREE_DELETE: {
+      memcpy(&log_record->page_id_, pos, sizeof(page_id_t));
+      pos += sizeof(page_id_t);
+      memcpy(&log_record->btree_offset_, pos, sizeof(int32_t));
+      memcpy(&log_record->btree_entry_size_, pos + 4, sizeof(int32_t));
+      memcpy(&log_record->btree_index_, pos + 8, sizeof(int32_t));
+      memcpy(&log_record->btree_count_, pos + 12, sizeof(int32_t));
+      int32_t name_length;
+      memcpy(&name_length, pos + 16, sizeof(int32_t));
+      pos += 20;
+      log_record->btree_index_name_.assign(pos, name_length);
+      log_record->btree_data_.assign(pos + name_length, data + log_record->size_);
+      break;
+    }
+    case LogRecordType::BTREE_UPDATE:
+      memcpy(&log_record->page_id_, pos, sizeof(page_id_t));
+      pos += sizeof(page_id_t);
+      memcpy(&log_record->btree_offset_, pos, sizeof(int32_t));
+      memcpy(&log_record->btree_count_, pos + 4, sizeof(int32_t));
+      log_record->btree_data_.assign(pos + 8, data + log_record->size_);
+      break;
+    default:
+      break;
+  }
+  return true;
+}
+
+void LogRecovery::DeserializeTuple(const char *data, Tuple *tuple, bool copy) {
+  if (copy) {
+    tuple->DeserializeFrom(data);
+  } else {
+    tuple->ViewFrom(data);
+  }
+}
+
+bool LogRecovery::ReadLogRecord(int64_t *offset, LogRecord *log_record) {
+  int32_t size;
+  const char *data = log_reader_->GetRecord(*offset, &size);
+  if (data == nullptr || !DeserializeLogRecord(data, log_record, false)) {
+    return false;
+  }
+  *offset += size;
+  return true;
+}
+
+bool LogRecovery::FindCheckpoint(LogRecord *checkpoint) {
+  int64_t offset;
+  if (!disk_manager_->ReadMasterRecord(&offset)) {
+    return false;
+  }
+  // The master record points at or before the begin record, the end record follows it after some other records.
+  lsn_t last_lsn = INVALID_LSN;
+  while (ReadLogRecord(&offset, checkpoint)) {
+    if (last_lsn != INVALID_LSN && checkpoint->lsn_ != last_lsn + 1) {
+      break;
+    }
+    if (checkpoint->log_record_type_ == LogRecordType::ENDCHECKPOINT) {
+      return true;
+    }
+    last_lsn = checkpoint->lsn_;
+    *checkpoint = LogRecord();
+  }
+  return false;
+}
+
+bool LogRecovery::NeedsRedo(page_id_t page_id, lsn_t lsn) {
+  if (lsn < redo_lsn_) {
+    return false;
+  }
+  // A change logged before the checkpoint is on disk unless the page was in the dirty page table with an older
+  // rec_lsn. Pages dirtied after the checkpoint began are not in the table, so anything later is checked on the page.
+  if (lsn > checkpoint_lsn_) {
+    return true;
+  }
+  auto it = dirty_page_table_.find(page_id);
+  return it != dirty_page_table_.end() && lsn >= it->second;
+}
 
 /*
  *redo phase on TABLE PAGE level(table/table_page.h)
- *read log file from the beginning to end (you must prefetch log records into
+ *read log file from the last checkpoint (or the beginning) to end (you must prefetch log records into
  *log buffer to reduce unnecessary I/O operations), remember to compare page's
  *LSN with log_record's sequence number, and also build active_txn_ table &
  *lsn_mapping_ table
  */
-void LogRecovery::Redo() {}
+void LogRecovery::Redo() {
+  // With a single worker the records are redone right here, in log order.
+  std::vector<std::unique_ptr<RedoQueue>> queues;
+  std::vector<std::thread> workers;
+  std::vector<std::vector<RedoTask>> pending;
+  if (redo_workers_ > 1) {
+    for (size_t i = 0; i < redo_workers_; i++) {
+      queues.emplace_back(new RedoQueue);
+      pending.emplace_back();
+    }
+    for (size_t i = 0; i < redo_workers_; i++) {
+      workers.emplace_back(&LogRecovery::RunRedoWorker, this, queues[i].get());
+    }
+  }
+  ScanLog([&](const std::shared_ptr<LogRecord> &log_record, int64_t offset, page_id_t page_id) {
+    if (queues.empty()) {
+      RedoLogRecord(log_record.get(), page_id);
+      return;
+    }
+    size_t worker = static_cast<size_t>(page_id) % queues.size();
+    pending[worker].push_back({log_record, page_id});
+    if (pending[worker].size() >= REDO_BATCH_SIZE) {
+      PushRedoBatch(queues[worker].get(), &pending[worker]);
+    }
+  });
+
+  for (size_t i = 0; i < queues.size(); i++) {
+    if (!pending[i].empty()) {
+      PushRedoBatch(queues[i].get(), &pending[i]);
+    }
+    std::lock_guard<std::mutex> guard(queues[i]->latch_);
+    queues[i]->closed_ = true;
+    queues[i]->cv_.notify_all();
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+void LogRecovery::ScanLog(const std::function<void(const std::shared_ptr<LogRecord> &, int64_t, page_id_t)> &visit) {
+  active_txn_.clear();
+  lsn_mapping_.clear();
+  dirty_page_table_.clear();
+  max_txn_id_ = INVALID_TXN_ID;
+  redo_lsn_ = INVALID_LSN;
+  checkpoint_lsn_ = INVALID_LSN;
+  log_reader_ = std::make_unique<LogReader>(disk_manager_);
+
+  // Start from the last checkpoint if there is one. Scanning starts early enough to see both the oldest change that
+  // may be missing from disk and the first record of every transaction that was active at the checkpoint.
+  int64_t offset = disk_manager_->GetLogStart();
+  LogRecord checkpoint;
+  if (FindCheckpoint(&checkpoint)) {
+    redo_lsn_ = checkpoint.redo_lsn_;
+    checkpoint_lsn_ = checkpoint.prev_lsn_;
+    offset = std::min(checkpoint.redo_offset_, checkpoint.undo_offset_);
+    dirty_page_table_.insert(checkpoint.dirty_page_table_.begin(), checkpoint.dirty_page_table_.end());
+    active_txn_.insert(checkpoint.active_txn_table_.begin(), checkpoint.active_txn_table_.end());
+  }
+
+  // Reused log segments hold stale records past the end of the log, a gap in the LSNs marks the end.
+  lsn_t last_lsn = INVALID_LSN;
+  while (true) {
+    int64_t record_offset = offset;
+    auto log_record = std::make_shared<LogRecord>();
+    if (!ReadLogRecord(&offset, log_record.get()) || (last_lsn != INVALID_LSN && log_record->lsn_ != last_lsn + 1)) {
+      break;
+    }
+    last_lsn = log_record->lsn_;
+    lsn_mapping_[log_record->lsn_] = record_offset;
+    max_txn_id_ = std::max(max_txn_id_, log_record->txn_id_);
+    switch (log_record->log_record_type_) {
+      case LogRecordType::BEGINCHECKPOINT:
+      case LogRecordType::ENDCHECKPOINT:
+        continue;
+      case LogRecordType::COMMIT:
+      case LogRecordType::ABORT:
+        active_txn_.erase(log_record->txn_id_);
+        continue;
+      case LogRecordType::BEGIN:
+        active_txn_[log_record->txn_id_] = log_record->lsn_;
+        continue;
+      default:
+        active_txn_[log_record->txn_id_] = log_record->lsn_;
+        break;
+    }
+    page_id_t page_ids[2];
+    int page_count = GetRedoPages(log_record.get(), page_ids);
+    for (int i = 0; i < page_count; i++) {
+      // pages allocated after the last flush of the db file must not be handed out again
+      disk_manager_->ReservePageId(page_ids[i]);
+      if (NeedsRedo(page_ids[i], log_record->lsn_)) {
+        visit(log_record, record_offset, page_ids[i]);
+      }
+    }
+  }
+  dirty_page_table_.clear();
+}
+
+void LogRecovery::StartInstantRestart(TransactionManager *transaction_manager, LockManager *lock_manager) {
+  // Analysis: remember where the records of every page are instead of redoing them.
+  {
+    std::lock_guard<std::mutex> guard(redo_index_latch_);
+    redo_index_.clear();
+  }
+  ScanLog([this](const std::shared_ptr<LogRecord> &log_record, int64_t offset, page_id_t page_id) {
+    std::lock_guard<std::mutex> guard(redo_index_latch_);
+    redo_index_[page_id].push_back(offset);
+  });
+
+  // Lock the rows of the losers before anyone can get at them, their changes are still visible until undo.
+  transaction_manager->SkipTransactionIds(max_txn_id_);
+  restart_txn_ = transaction_manager->Begin();
+  for (const auto &txn : active_txn_) {
+    for (lsn_t lsn = txn.second; lsn != INVALID_LSN;) {
+      LogRecord log_record;
+      int64_t offset = lsn_mapping_.at(lsn);
+      [[maybe_unused]] bool ok = ReadLogRecord(&offset, &log_record);
+      BUSTUB_ASSERT(ok, "Undo chain points to a corrupted record.");
+      RID rid;
+      if (GetRecordRID(&log_record, &rid) && restart_txn_->GetExclusiveLockSet()->count(rid) == 0) {
+        lock_manager->LockExclusive(restart_txn_, rid);
+      }
+      // the changes a CLR compensated were undone by an earlier restart
+      lsn = log_record.log_record_type_ == LogRecordType::CLR ? log_record.undo_next_lsn_ : log_record.prev_lsn_;
+    }
+  }
+
+  buffer_pool_manager_->SetPageLoadHook(
+      [this](Page *page, lsn_t *rec_lsn, int64_t *rec_offset) { return RedoPage(page, rec_lsn, rec_offset); });
+  restart_thread_ = new std::thread(&LogRecovery::RunRestart, this, transaction_manager);
+}
+
+void LogRecovery::WaitForRestart() {
+  if (restart_thread_ != nullptr) {
+    restart_thread_->join();
+    delete restart_thread_;
+    restart_thread_ = nullptr;
+  }
+}
+
+size_t LogRecovery::GetPendingRedoPages() {
+  std::lock_guard<std::mutex> guard(redo_index_latch_);
+  return redo_index_.size();
+}
+
+void LogRecovery::RunRestart(TransactionManager *transaction_manager) {
+  std::vector<page_id_t> page_ids;
+  {
+    std::lock_guard<std::mutex> guard(redo_index_latch_);
+    for (const auto &entry : redo_index_) {
+      page_ids.push_back(entry.first);
+    }
+  }
+  // Loading a page redoes it, pages that were loaded in the meantime have nothing left to redo.
+  std::sort(page_ids.begin(), page_ids.end());
+  for (page_id_t page_id : page_ids) {
+    FetchRedoPage(page_id);
+    buffer_pool_manager_->UnpinPage(page_id, false);
+  }
+  Undo();
+  buffer_pool_manager_->SetPageLoadHook(nullptr);
+  transaction_manager->Commit(restart_txn_);
+  delete restart_txn_;
+  restart_txn_ = nullptr;
+}
+
+bool LogRecovery::RedoPage(Page *page, lsn_t *rec_lsn, int64_t *rec_offset) {
+  std::vector<int64_t> offsets;
+  {
+    std::lock_guard<std::mutex> guard(redo_index_latch_);
+    auto it = redo_index_.find(page->GetPageId());
+    if (it == redo_index_.end()) {
+      return false;
+    }
+    offsets = std::move(it->second);
+    redo_index_.erase(it);
+  }
+  bool changed = false;
+  for (int64_t offset : offsets) {
+    LogRecord log_record;
+    int64_t record_offset = offset;
+    [[maybe_unused]] bool ok = ReadLogRecord(&record_offset, &log_record);
+    BUSTUB_ASSERT(ok, "Redo index points to a corrupted record.");
+    if (ApplyRedo(&log_record, static_cast<TablePage *>(page), page->GetPageId()) && !changed) {
+      *rec_lsn = log_record.lsn_;
+      *rec_offset = offset;
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+size_t LogRecovery::RedoLog(const char *data, size_t size, lsn_t *last_lsn) {
+  size_t consumed = 0;
+  while (size - consumed >= static_cast<size_t>(LogRecord::HEADER_SIZE)) {
+    int32_t record_size;
+    memcpy(&record_size, data + consumed, sizeof(int32_t));
+    if (record_size < LogRecord::HEADER_SIZE || size - consumed < static_cast<size_t>(record_size)) {
+      break;
+    }
+    // the record is done with before data goes away, so its tuples can stay in data
+    LogRecord log_record;
+    if (!DeserializeLogRecord(data + consumed, &log_record, false)) {
+      break;
+    }
+    page_id_t page_ids[2];
+    int page_count = GetRedoPages(&log_record, page_ids);
+    for (int i = 0; i < page_count; i++) {
+      RedoLogRecord(&log_record, page_ids[i]);
+    }
+    *last_lsn = log_record.lsn_;
+    consumed += record_size;
+  }
+  return consumed;
+}
+
+int LogRecovery::GetRedoPages(LogRecord *log_record, page_id_t *page_ids) {
+  switch (log_record->GetActionType()) {
+    case LogRecordType::NEWPAGE:
+      page_ids[0] = log_record->page_id_;
+      if (log_record->prev_page_id_ == INVALID_PAGE_ID) {
+        return 1;
+      }
+      page_ids[1] = log_record->prev_page_id_;
+      return 2;
+    case LogRecordType::INSERT:
+      page_ids[0] = log_record->insert_rid_.GetPageId();
+      return 1;
+    case LogRecordType::UPDATE:
+    case LogRecordType::DELTAUPDATE:
+      page_ids[0] = log_record->update_rid_.GetPageId();
+      return 1;
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      page_ids[0] = log_record->delete_rid_.GetPageId();
+      return 1;
+    case LogRecordType::BTREE_INSERT:
+    case LogRecordType::BTREE_DELETE:
+    case LogRecordType::BTREE_UPDATE:
+      page_ids[0] = log_record->page_id_;
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+void LogRecovery::PushRedoBatch(RedoQueue *queue, std::vector<RedoTask> *batch) {
+  std::unique_lock<std::mutex> latch(queue->latch_);
+  queue->cv_.wait(latch, [queue] { return queue->batches_.size() < REDO_QUEUE_DEPTH; });
+  queue->batches_.push_back(std::move(*batch));
+  queue->cv_.notify_all();
+  batch->clear();
+}
+
+void LogRecovery::RunRedoWorker(RedoQueue *queue) {
+  while (true) {
+    std::vector<RedoTask> batch;
+    {
+      std::unique_lock<std::mutex> latch(queue->latch_);
+      queue->cv_.wait(latch, [queue] { return queue->closed_ || !queue->batches_.empty(); });
+      if (queue->batches_.empty()) {
+        return;
+      }
+      batch = std::move(queue->batches_.front());
+      queue->batches_.pop_front();
+      queue->cv_.notify_all();
+    }
+    for (auto &task : batch) {
+      RedoLogRecord(task.log_record_.get(), task.page_id_);
+    }
+  }
+}
+
+Page *LogRecovery::FetchRedoPage(page_id_t page_id) {
+  Page *page;
+  while ((page = buffer_pool_manager_->FetchPage(page_id)) == nullptr) {
+    std::this_thread::yield();
+  }
+  return page;
+}
 
 /*
  *undo phase on TABLE PAGE level(table/table_page.h)
  *iterate through active txn map and undo each operation
  */
-void LogRecovery::Undo() {}
+void LogRecovery::Undo() {
+  // An instant restart undoes with logging on. It logs a CLR for every change it undoes and an ABORT for every loser,
+  // so that a crash in the middle of undo, or after new transactions changed the same pages, undoes nothing twice.
+  LogManager *log_manager = enable_logging ? buffer_pool_manager_->GetLogManager() : nullptr;
+  // Undoing by key needs whole trees, so the structure changes the crash cut short go first, for every loser. They are
+  // the last records of their transactions.
+  std::unordered_map<txn_id_t, lsn_t> undo_next;
+  for (auto &txn : active_txn_) {
+    undo_next[txn.first] = UndoTransaction(txn.second, log_manager == nullptr ? nullptr : &txn.second, true);
+  }
+  for (auto &index : indexes_) {
+    index.second->LoadRootPageId();
+  }
+  for (auto &txn : active_txn_) {
+    UndoTransaction(undo_next[txn.first], log_manager == nullptr ? nullptr : &txn.second, false);
+    if (log_manager != nullptr) {
+      LogRecord abort_record(txn.first, txn.second, LogRecordType::ABORT);
+      log_manager->AppendLogRecord(&abort_record);
+    }
+  }
+  active_txn_.clear();
+  lsn_mapping_.clear();
+}
+
+lsn_t LogRecovery::UndoTransaction(lsn_t lsn, lsn_t *last_lsn, bool structure_only) {
+  while (lsn != INVALID_LSN) {
+    auto it = lsn_mapping_.find(lsn);
+    BUSTUB_ASSERT(it != lsn_mapping_.end(), "Undo chain points to a record that was never read.");
+    int64_t offset = it->second;
+    LogRecord log_record;
+    [[maybe_unused]] bool ok = ReadLogRecord(&offset, &log_record);
+    BUSTUB_ASSERT(ok, "Undo chain points to a corrupted record.");
+    if (log_record.log_record_type_ == LogRecordType::CLR) {
+      lsn = log_record.undo_next_lsn_;
+      continue;
+    }
+    if (structure_only && (!log_record.IsBPlusTreeRecord() || log_record.IsUndoneByKey())) {
+      return lsn;
+    }
+    UndoLogRecord(&log_record, last_lsn);
+    lsn = log_record.prev_lsn_;
+  }
+  return INVALID_LSN;
+}
+
+void LogRecovery::RedoLogRecord(LogRecord *log_record, page_id_t page_id) {
+  auto page = static_cast<TablePage *>(FetchRedoPage(page_id));
+  // A log-shipping follower redoes pages while read-only transactions read them.
+  page->WLatch();
+  bool dirty = ApplyRedo(log_record, page, page_id);
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(page_id, dirty);
+}
+
+bool LogRecovery::ApplyRedo(LogRecord *log_record, TablePage *page, page_id_t page_id) {
+  if (log_record->IsBPlusTreeRecord()) {
+    return ApplyBPlusTreeRedo(log_record, page);
+  }
+  if (log_record->GetActionType() == LogRecordType::NEWPAGE) {
+    if (page_id == log_record->page_id_) {
+      if (page->GetLSN() >= log_record->lsn_) {
+        return false;
+      }
+      page->Init(log_record->page_id_, PAGE_SIZE, log_record->prev_page_id_, nullptr, nullptr);
+      page->SetLSN(log_record->lsn_);
+      return true;
+    }
+    // Linking the previous page is idempotent, so it does not need an LSN check.
+    if (page->GetNextPageId() == log_record->page_id_) {
+      return false;
+    }
+    page->SetNextPageId(log_record->page_id_);
+    return true;
+  }
+
+  if (page->GetLSN() >= log_record->lsn_) {
+    return false;
+  }
+  switch (log_record->GetActionType()) {
+    case LogRecordType::INSERT: {
+      RID inserted_rid;
+      // The insert may have found room only after the garbage collector reclaimed empty slots, which is not logged.
+      if (!page->InsertTuple(log_record->insert_tuple_, &inserted_rid, nullptr, nullptr, nullptr)) {
+        page->ReclaimSlots();
+        page->InsertTuple(log_record->insert_tuple_, &inserted_rid, nullptr, nullptr, nullptr);
+      }
+      BUSTUB_ASSERT(inserted_rid == log_record->insert_rid_, "Redo of an insert landed in a different slot.");
+      break;
+    }
+    case LogRecordType::MARKDELETE:
+      page->MarkDelete(log_record->delete_rid_, nullptr, nullptr, nullptr);
+      break;
+    case LogRecordType::APPLYDELETE:
+      page->ApplyDelete(log_record->delete_rid_, nullptr, nullptr);
+      break;
+    case LogRecordType::ROLLBACKDELETE:
+      page->RollbackDelete(log_record->delete_rid_, nullptr, nullptr);
+      break;
+    case LogRecordType::UPDATE: {
+      Tuple old_tuple;
+      page->UpdateTuple(log_record->new_tuple_, &old_tuple, log_record->update_rid_, nullptr, nullptr, nullptr);
+      break;
+    }
+    case LogRecordType::DELTAUPDATE: {
+      Tuple old_tuple;
+      Tuple new_tuple;
+      page->GetTuple(log_record->update_rid_, &old_tuple, nullptr, nullptr);
+      [[maybe_unused]] bool ok = LogRecord::ApplyDelta(log_record->update_delta_, old_tuple, true, &new_tuple);
+      BUSTUB_ASSERT(ok, "Delta does not match the tuple on the page.");
+      page->UpdateTuple(new_tuple, &old_tuple, log_record->update_rid_, nullptr, nullptr, nullptr);
+      break;
+    }
+    default:
+      break;
+  }
+  page->SetLSN(log_record->lsn_);
+  return true;
+}
+
+bool LogRecovery::ApplyBPlusTreeRedo(LogRecord *log_record, Page *page) {
+  if (page->GetLSN() >= log_record->lsn_) {
+    return false;
+  }
+  char *data = page->GetData();
+  switch (log_record->GetActionType()) {
+    case LogRecordType::BTREE_INSERT:
+      BPlusTreePage::ApplyInsert(data, log_record->btree_offset_, log_record->btree_entry_size_,
+                                 log_record->btree_index_, log_record->btree_data_.data(), log_record->btree_count_);
+      break;
+    case LogRecordType::BTREE_DELETE:
+      BPlusTreePage::ApplyRemove(data, log_record->btree_offset_, log_record->btree_entry_size_,
+                                 log_record->btree_index_, log_record->btree_count_);
+      break;
+    case LogRecordType::BTREE_UPDATE:
+      memcpy(data + log_record->btree_offset_, log_record->btree_data_.data() + log_record->btree_count_,
+             log_record->btree_count_);
+      break;
+    default:
+      break;
+  }
+  page->SetLSN(log_record->lsn_);
+  return true;
+}
+
+void LogRecovery::UndoBPlusTreeRecord(LogRecord *log_record, lsn_t *last_lsn) {
+  if (log_record->IsUndoneByKey()) {
+    auto it = indexes_.find(log_record->btree_index_name_);
+    BUSTUB_ASSERT(it != indexes_.end(), "Undo of a B+ tree change needs its index registered.");
+    BUSTUB_ASSERT(log_record->btree_count_ == 1, "A key is inserted or removed one entry at a time.");
+    // the tree logs the undo for this stand-in of the loser
+    Transaction txn(log_record->txn_id_);
+    txn.SetPrevLSN(last_lsn == nullptr ? INVALID_LSN : *last_lsn);
+    if (log_record->log_record_type_ == LogRecordType::BTREE_INSERT) {
+      it->second->UndoInsert(log_record->btree_data_.data(), &txn, log_record->prev_lsn_);
+    } else {
+      it->second->UndoRemove(log_record->btree_data_.data(), &txn, log_record->prev_lsn_);
+    }
+    if (last_lsn != nullptr) {
+      *last_lsn = txn.GetPrevLSN();
+    }
+    return;
+  }
+
+  // A structure change that did not complete kept its pages latched, so they are as it left them.
+  page_id_t page_id = log_record->page_id_;
+  Page *page = buffer_pool_manager_->FetchPage(page_id);
+  page->WLatch();
+  char *data = page->GetData();
+  int entry_size = log_record->btree_entry_size_;
+  int count = log_record->btree_count_;
+  txn_id_t txn_id = log_record->txn_id_;
+  LogRecord compensation;
+  switch (log_record->log_record_type_) {
+    case LogRecordType::BTREE_INSERT:
+      BPlusTreePage::ApplyRemove(data, log_record->btree_offset_, entry_size, log_record->btree_index_, count);
+      compensation = LogRecord(txn_id, INVALID_LSN, LogRecordType::BTREE_DELETE, page_id, log_record->btree_offset_,
+                               entry_size, log_record->btree_index_, count, log_record->btree_data_.data());
+      break;
+    case LogRecordType::BTREE_DELETE:
+      BPlusTreePage::ApplyInsert(data, log_record->btree_offset_, entry_size, log_record->btree_index_,
+                                 log_record->btree_data_.data(), count);
+      compensation = LogRecord(txn_id, INVALID_LSN, LogRecordType::BTREE_INSERT, page_id, log_record->btree_offset_,
+                               entry_size, log_record->btree_index_, count, log_record->btree_data_.data());
+      break;
+    case LogRecordType::BTREE_UPDATE: {
+      // restore the old bytes but keep the page LSN, which an update of the whole header includes
+      lsn_t lsn = page->GetLSN();
+      memcpy(data + log_record->btree_offset_, log_record->btree_data_.data(), count);
+      page->SetLSN(lsn);
+      compensation = LogRecord(txn_id, INVALID_LSN, LogRecordType::BTREE_UPDATE, page_id, log_record->btree_offset_,
+                               count, log_record->btree_data_.data() + count, log_record->btree_data_.data());
+      break;
+    }
+    default:
+      break;
+  }
+  LogCompensation(log_record, &compensation, page, last_lsn);
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(page_id, true);
+}
+
+bool LogRecovery::GetRecordRID(LogRecord *log_record, RID *rid) {
+  switch (log_record->log_record_type_) {
+    case LogRecordType::INSERT:
+      *rid = log_record->insert_rid_;
+      return true;
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      *rid = log_record->delete_rid_;
+      return true;
+    case LogRecordType::UPDATE:
+    case LogRecordType::DELTAUPDATE:
+      *rid = log_record->update_rid_;
+      return true;
+    default:
+      return false;
+  }
+}
+
+void LogRecovery::LogCompensation(LogRecord *log_record, LogRecord *compensation, Page *page, lsn_t *last_lsn) {
+  if (last_lsn == nullptr || compensation->log_record_type_ == LogRecordType::INVALID) {
+    return;
+  }
+  compensation->prev_lsn_ = *last_lsn;
+  compensation->MakeCompensation(log_record->prev_lsn_);
+  *last_lsn = buffer_pool_manager_->GetLogManager()->AppendLogRecord(compensation);
+  page->SetLSN(*last_lsn);
+}
+
+void LogRecovery::UndoLogRecord(LogRecord *log_record, lsn_t *last_lsn) {
+  if (log_record->IsBPlusTreeRecord()) {
+    UndoBPlusTreeRecord(log_record, last_lsn);
+    return;
+  }
+  RID rid;
+  if (!GetRecordRID(log_record, &rid)) {
+    // BEGIN and NEWPAGE leave nothing behind that has to be reverted.
+    return;
+  }
+  auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
+  // An instant restart undoes while other transactions use the page.
+  page->WLatch();
+  // The change that reverts the record, as it turned out on the page, is what a CLR has to redo.
+  txn_id_t txn_id = log_record->txn_id_;
+  LogRecord compensation;
+  switch (log_record->log_record_type_) {
+    case LogRecordType::INSERT:
+      page->ApplyDelete(rid, nullptr, nullptr);
+      compensation = LogRecord(txn_id, INVALID_LSN, LogRecordType::APPLYDELETE, rid, log_record->insert_tuple_);
+      break;
+    case LogRecordType::MARKDELETE:
+      page->RollbackDelete(rid, nullptr, nullptr);
+      compensation = LogRecord(txn_id, INVALID_LSN, LogRecordType::ROLLBACKDELETE, rid, Tuple());
+      break;
+    case LogRecordType::APPLYDELETE: {
+      // the tuple may come back in another slot of the page
+      RID inserted_rid;
+      page->InsertTuple(log_record->delete_tuple_, &inserted_rid, nullptr, nullptr, nullptr);
+      compensation = LogRecord(txn_id, INVALID_LSN, LogRecordType::INSERT, inserted_rid, log_record->delete_tuple_);
+      break;
+    }
+    case LogRecordType::ROLLBACKDELETE:
+      page->MarkDelete(rid, nullptr, nullptr, nullptr);
+      compensation = LogRecord(txn_id, INVALID_LSN, LogRecordType::MARKDELETE, rid, Tuple());
+      break;
+    case LogRecordType::UPDATE: {
+      Tuple new_tuple;
+      page->UpdateTuple(log_record->old_tuple_, &new_tuple, rid, nullptr, nullptr, nullptr);
+      compensation = LogRecord(txn_id, INVALID_LSN, LogRecordType::UPDATE, rid, new_tuple, log_record->old_tuple_);
+      break;
+    }
+    case LogRecordType::DELTAUPDATE: {
+      Tuple new_tuple;
+      Tuple old_tuple;
+      page->GetTuple(rid, &new_tuple, nullptr, nullptr);
+      [[maybe_unused]] bool ok = LogRecord::ApplyDelta(log_record->update_delta_, new_tuple, false, &old_tuple);
+      BUSTUB_ASSERT(ok, "Delta does not match the tuple on the page.");
+      page->UpdateTuple(old_tuple, &new_tuple, rid, nullptr, nullptr, nullptr);
+      compensation = LogRecord(txn_id, INVALID_LSN, LogRecordType::DELTAUPDATE, rid, new_tuple, old_tuple);
+      break;
+    }
+    default:
+      break;
+  }
+  LogCompensation(log_record, &compensation, page, last_lsn);
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(rid.GetPageId(), true);
+}
 
 }  // namespace bustub
@@ -0,0 +1,157 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// log_replica.cpp
+//
+// Identification: src/recovery/log_replica.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "recovery/log_replica.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include "common/logger.h"
+#include "recovery/log_shipper.h"
+
+namespace bustub {
+
+namespace {
+
+/** How long the replica waits for the primary before checking whether it has to stop. */
+constexpr int REPLICA_POLL_MS = 100;
+/** Pause between two attempts to connect to the primary. */
+constexpr auto REPLICA_RETRY_INTERVAL = std::chrono::milliseconds(10);
+
+}  // namespace
+
+LogReplica::LogReplica(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager, std::string socket_path)
+    : log_recovery_(disk_manager, buffer_pool_manager, 1), socket_path_(std::move(socket_path)) {
+  replica_thread_ = new std::thread(&LogReplica::RunReplica, this);
+}
+
+LogReplica::~LogReplica() {
+  stop_ = true;
+  replica_thread_->join();
+  delete replica_thread_;
+}
+
+bool LogReplica::WaitForLSN(lsn_t lsn, std::chrono::milliseconds timeout) {
+  std::unique_lock<std::mutex> latch(latch_);
+  return applied_cv_.wait_for(latch, timeout, [this, lsn] { return applied_lsn_ >= lsn; });
+}
+
+std::chrono::microseconds LogReplica::GetReplayLag() {
+  std::lock_guard<std::mutex> guard(latch_);
+  return replay_lag_;
+}
+
+std::chrono::microseconds LogReplica::GetMaxReplayLag() {
+  std::lock_guard<std::mutex> guard(latch_);
+  return max_replay_lag_;
+}
+
+void LogReplica::RunReplica() {
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, socket_path_.c_str(), sizeof(addr.sun_path) - 1);
+  std::vector<char> data;
+  while (!stop_) {
+    if (fd_ == -1) {
+      fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+      if (fd_ != -1 && connect(fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+        close(fd_);
+        fd_ = -1;
+      }
+      if (fd_ == -1) {
+        std::this_thread::sleep_for(REPLICA_RETRY_INTERVAL);
+        continue;
+      }
+    }
+
+    LogShipFrame frame;
+    if (!Receive(reinterpret_cast<char *>(&frame), sizeof(frame)) || frame.size_ < 0) {
+      close(fd_);
+      fd_ = -1;
+      continue;
+    }
+    data.resize(frame.size_);
+    if (!Receive(data.data(), frame.size_)) {
+      close(fd_);
+      fd_ = -1;
+      continue;
+    }
+
+    // A primary that comes back sends its log again from the start, skip what has been redone already.
+    if (next_offset_ == -1) {
+      next_offset_ = frame.offset_;
+    }
+    int64_t frame_end = frame.offset_ + frame.size_;
+    if (frame.offset_ > next_offset_) {
+      LOG_DEBUG("gap in the shipped log");
+      close(fd_);
+      fd_ = -1;
+      continue;
+    }
+    if (frame_end <= next_offset_) {
+      continue;
+    }
+    pending_.insert(pending_.end(), data.begin() + (next_offset_ - frame.offset_), data.end());
+    next_offset_ = frame_end;
+
+    lsn_t last_lsn = INVALID_LSN;
+    size_t redone = log_recovery_.RedoLog(pending_.data(), pending_.size(), &last_lsn);
+    pending_.erase(pending_.begin(), pending_.begin() + redone);
+    if (last_lsn != INVALID_LSN) {
+      // both processes run on the same machine, so their steady clocks agree
+      auto flushed = std::chrono::nanoseconds(frame.flush_time_);
+      auto lag = std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now().time_since_epoch() - flushed);
+      std::lock_guard<std::mutex> guard(latch_);
+      applied_lsn_ = last_lsn;
+      replay_lag_ = lag;
+      max_replay_lag_ = std::max(max_replay_lag_, lag);
+      applied_cv_.notify_all();
+    }
+  }
+  if (fd_ != -1) {
+    close(fd_);
+    fd_ = -1;
+  }
+}
+
+bool LogReplica::Receive(char *data, size_t size) {
+  size_t received = 0;
+  while (received < size) {
+    if (stop_) {
+      return false;
+    }
+    pollfd replica_poll{fd_, POLLIN, 0};
+    int ready = poll(&replica_poll, 1, REPLICA_POLL_MS);
+    if (ready == 0 || (ready < 0 && errno == EINTR)) {
+      continue;
+    }
+    ssize_t count = ready < 0 ? -1 : recv(fd_, data + received, size - received, 0);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      return false;
+    }
+    received += count;
+  }
+  return true;
+}
+
+}  // namespace bustub
@@ -0,0 +1,163 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// log_shipper.cpp
+//
+// Identification: src/recovery/log_shipper.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "recovery/log_shipper.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>  // NOLINT
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "common/exception.h"
+#include "common/logger.h"
+
+namespace bustub {
+
+namespace {
+
+/** How long the shipper waits for a follower or for new log before checking whether it has to stop. */
+constexpr int SHIP_POLL_MS = 100;
+/** Flushes remembered for their flush times; older ones are dropped while no follower keeps up. */
+constexpr size_t SHIP_MAX_FLUSHES = 4096;
+
+inline int64_t NowNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace
+
+LogShipper::LogShipper(DiskManager *disk_manager, std::string socket_path)
+    : disk_manager_(disk_manager), socket_path_(std::move(socket_path)) {
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  if (socket_path_.size() >= sizeof(addr.sun_path)) {
+    throw Exception("socket path is too long");
+  }
+  strncpy(addr.sun_path, socket_path_.c_str(), sizeof(addr.sun_path) - 1);
+  listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(socket_path_.c_str());
+  if (listen_fd_ == -1 || bind(listen_fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+      listen(listen_fd_, 1) != 0) {
+    if (listen_fd_ != -1) {
+      close(listen_fd_);
+    }
+    throw Exception("can't listen on log shipping socket");
+  }
+  persistent_offset_ = disk_manager_->GetLogSize();
+  shipper_thread_ = new std::thread(&LogShipper::RunShipper, this);
+}
+
+LogShipper::~LogShipper() {
+  {
+    std::lock_guard<std::mutex> guard(latch_);
+    stop_ = true;
+    cv_.notify_one();
+  }
+  shipper_thread_->join();
+  delete shipper_thread_;
+  close(listen_fd_);
+  unlink(socket_path_.c_str());
+}
+
+void LogShipper::Ship(int64_t end_offset) {
+  std::lock_guard<std::mutex> guard(latch_);
+  persistent_offset_ = std::max(persistent_offset_, end_offset);
+  flushes_.emplace_back(end_offset, NowNanos());
+  if (flushes_.size() > SHIP_MAX_FLUSHES) {
+    flushes_.pop_front();
+  }
+  cv_.notify_one();
+}
+
+void LogShipper::RunShipper() {
+  std::vector<char> buf(LOG_BUFFER_SIZE);
+  while (true) {
+    if (client_fd_ == -1) {
+      {
+        std::lock_guard<std::mutex> guard(latch_);
+        if (stop_) {
+          break;
+        }
+      }
+      pollfd listen_poll{listen_fd_, POLLIN, 0};
+      if (poll(&listen_poll, 1, SHIP_POLL_MS) <= 0 || (client_fd_ = accept(listen_fd_, nullptr, nullptr)) == -1) {
+        continue;
+      }
+      // a new follower starts from the oldest log there is
+      sent_offset_ = disk_manager_->GetLogStart();
+    }
+
+    int64_t end_offset;
+    int64_t flush_time;
+    {
+      std::unique_lock<std::mutex> latch(latch_);
+      cv_.wait_for(latch, std::chrono::milliseconds(SHIP_POLL_MS),
+                   [this] { return stop_ || persistent_offset_ > sent_offset_; });
+      if (stop_) {
+        break;
+      }
+      if (persistent_offset_ <= sent_offset_) {
+        continue;
+      }
+      while (!flushes_.empty() && flushes_.front().first <= sent_offset_) {
+        flushes_.pop_front();
+      }
+      // A frame never spans two flushes, so it carries the flush time of all of its bytes.
+      end_offset = std::min<int64_t>(persistent_offset_, sent_offset_ + LOG_BUFFER_SIZE);
+      flush_time = NowNanos();
+      if (!flushes_.empty()) {
+        end_offset = std::min(end_offset, flushes_.front().first);
+        flush_time = flushes_.front().second;
+      }
+    }
+
+    LogShipFrame frame{sent_offset_, flush_time, static_cast<int32_t>(end_offset - sent_offset_)};
+    if (!disk_manager_->ReadLog(buf.data(), frame.size_, sent_offset_)) {
+      LOG_DEBUG("log to ship has been recycled");
+    } else if (Send(reinterpret_cast<const char *>(&frame), sizeof(frame)) && Send(buf.data(), frame.size_)) {
+      sent_offset_ = end_offset;
+      continue;
+    }
+    // the follower is gone or cannot be served any more, wait for the next one
+    close(client_fd_);
+    client_fd_ = -1;
+  }
+  if (client_fd_ != -1) {
+    close(client_fd_);
+    client_fd_ = -1;
+  }
+}
+
+bool LogShipper::Send(const char *data, size_t size) {
+  size_t sent = 0;
+  while (sent < size) {
+    ssize_t count = send(client_fd_, data + sent, size - sent, MSG_NOSIGNAL);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      return false;
+    }
+    sent += count;
+  }
+  return true;
+}
+
+}  // namespace bustub
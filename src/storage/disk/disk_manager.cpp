@@ -11,8 +11,11 @@
 //===----------------------------------------------------------------------===//
 
 #include <sys/stat.h>
+#include <algorithm>
 #include <cassert>
+#include <cstdio>
 #include <cstring>
+#include <filesystem>
 #include <iostream>
 #include <string>
 #include <thread>  // NOLINT
@@ -37,20 +40,7 @@ DiskManager::DiskManager(const std::string &db_file)
     return;
   }
   log_name_ = file_name_.substr(0, n) + ".log";
-
-  log_io_.open(log_name_, std::ios::binary | std::ios::in | std::ios::app | std::ios::out);
-  // directory or file does not exist
-  if (!log_io_.is_open()) {
-    log_io_.clear();
-    // create a new file
-    log_io_.open(log_name_, std::ios::binary | std::ios::trunc | std::ios::app | std::ios::out);
-    log_io_.close();
-    // reopen with original mode
-    log_io_.open(log_name_, std::ios::binary | std::ios::in | std::ios::app | std::ios::out);
-    if (!log_io_.is_open()) {
-      throw Exception("can't open dblog file");
-    }
-  }
+  master_name_ = file_name_.substr(0, n) + ".master";
 
   db_io_.open(db_file, std::ios::binary | std::ios::in | std::ios::out);
   // directory or file does not exist
@@ -66,6 +56,28 @@ DiskManager::DiskManager(const std::string &db_file)
     }
   }
   buffer_used = nullptr;
+  // pages already in the db file are in use, new ones go after them
+  next_page_id_ = static_cast<page_id_t>((std::max<int64_t>(GetFileSize(file_name_), 0) + PAGE_SIZE - 1) / PAGE_SIZE);
+
+  // Rebuild the segment index from the segment files left behind by earlier runs.
+  std::filesystem::path log_path(log_name_);
+  std::filesystem::path log_dir = log_path.has_parent_path() ? log_path.parent_path() : std::filesystem::path(".");
+  std::string segment_prefix = log_path.filename().string() + ".";
+  std::string spare_prefix = segment_prefix + "spare.";
+  std::error_code ec;
+  for (const auto &entry : std::filesystem::directory_iterator(log_dir, ec)) {
+    std::string name = entry.path().filename().string();
+    if (name.compare(0, spare_prefix.size(), spare_prefix) == 0) {
+      spare_segments_.push_back(entry.path().string());
+    } else if (name.compare(0, segment_prefix.size(), segment_prefix) == 0 && name.size() > segment_prefix.size() &&
+               name.find_first_not_of("0123456789", segment_prefix.size()) == std::string::npos) {
+      log_segments_.emplace(std::stoll(name.substr(segment_prefix.size())), nullptr);
+    }
+  }
+  if (!log_segments_.empty()) {
+    int64_t last = log_segments_.rbegin()->first;
+    log_end_ = last * LOG_SEGMENT_SIZE + std::max<int64_t>(GetFileSize(GetSegmentName(last)), 0);
+  }
 }
 
 /**
@@ -73,7 +85,12 @@ DiskManager::DiskManager(const std::string &db_file)
  */
 void DiskManager::ShutDown() {
   db_io_.close();
-  log_io_.close();
+  std::lock_guard<std::mutex> guard(log_io_latch_);
+  for (auto &segment : log_segments_) {
+    if (segment.second != nullptr) {
+      segment.second->close();
+    }
+  }
 }
 
 /**
@@ -81,6 +98,7 @@ void DiskManager::ShutDown() {
  */
 void DiskManager::WritePage(page_id_t page_id, const char *page_data) {
   size_t offset = static_cast<size_t>(page_id) * PAGE_SIZE;
+  std::lock_guard<std::mutex> guard(db_io_latch_);
   // set write cursor to offset
   num_writes_ += 1;
   db_io_.seekp(offset);
@@ -99,6 +117,7 @@ void DiskManager::WritePage(page_id_t page_id, const char *page_data) {
  */
 void DiskManager::ReadPage(page_id_t page_id, char *page_data) {
   int offset = page_id * PAGE_SIZE;
+  std::lock_guard<std::mutex> guard(db_io_latch_);
   // check if read beyond file length
   if (offset > GetFileSize(file_name_)) {
     LOG_DEBUG("I/O error reading past end of file");
@@ -143,45 +162,137 @@ void DiskManager::WriteLog(char *log_data, int size) {
   }
 
   num_flushes_ += 1;
-  // sequence write
-  log_io_.write(log_data, size);
-
-  // check for I/O error
-  if (log_io_.bad()) {
-    LOG_DEBUG("I/O error while writing log");
-    return;
+  std::lock_guard<std::mutex> guard(log_io_latch_);
+  // sequence write, a buffer may straddle two segments
+  int written = 0;
+  while (written < size) {
+    int64_t segment_offset = log_end_ % LOG_SEGMENT_SIZE;
+    int count = static_cast<int>(std::min<int64_t>(size - written, LOG_SEGMENT_SIZE - segment_offset));
+    std::fstream *segment = GetLogSegment(log_end_ / LOG_SEGMENT_SIZE, true);
+    if (segment == nullptr) {
+      LOG_DEBUG("can't open log segment");
+      return;
+    }
+    segment->seekp(segment_offset);
+    segment->write(log_data + written, count);
+    // check for I/O error
+    if (segment->bad()) {
+      LOG_DEBUG("I/O error while writing log");
+      return;
+    }
+    // needs to flush to keep disk file in sync
+    segment->flush();
+    written += count;
+    log_end_ += count;
   }
-  // needs to flush to keep disk file in sync
-  log_io_.flush();
   flush_log_ = false;
 }
 
 /**
  * Read the contents of the log into the given memory area
- * Always read from the beginning and perform sequence read
+ * Seek straight to the segment holding offset and perform sequence read
  * @return: false means already reach the end
  */
-bool DiskManager::ReadLog(char *log_data, int size, int offset) {
-  if (offset >= GetFileSize(log_name_)) {
-    // LOG_DEBUG("end of log file");
-    // LOG_DEBUG("file size is %d", GetFileSize(log_name_));
+bool DiskManager::ReadLog(char *log_data, int size, int64_t offset) {
+  std::lock_guard<std::mutex> guard(log_io_latch_);
+  if (offset >= log_end_ || log_segments_.empty() || offset < log_segments_.begin()->first * LOG_SEGMENT_SIZE) {
     return false;
   }
-  log_io_.seekp(offset);
-  log_io_.read(log_data, size);
+  int read_count = 0;
+  while (read_count < size && offset < log_end_) {
+    int64_t segment_offset = offset % LOG_SEGMENT_SIZE;
+    int count = static_cast<int>(
+        std::min<int64_t>({size - read_count, LOG_SEGMENT_SIZE - segment_offset, log_end_ - offset}));
+    std::fstream *segment = GetLogSegment(offset / LOG_SEGMENT_SIZE, false);
+    if (segment == nullptr) {
+      break;
+    }
+    segment->seekg(segment_offset);
+    segment->read(log_data + read_count, count);
+    if (segment->bad()) {
+      LOG_DEBUG("I/O error while reading log");
+      return false;
+    }
+    int got = segment->gcount();
+    read_count += got;
+    offset += got;
+    // if the segment file ends before reading "count"
+    if (got < count) {
+      segment->clear();
+      break;
+    }
+  }
+  memset(log_data + read_count, 0, size - read_count);
+  return true;
+}
 
-  if (log_io_.bad()) {
-    LOG_DEBUG("I/O error while reading log");
-    return false;
+int64_t DiskManager::GetLogSize() {
+  std::lock_guard<std::mutex> guard(log_io_latch_);
+  return log_end_;
+}
+
+int64_t DiskManager::GetLogStart() {
+  std::lock_guard<std::mutex> guard(log_io_latch_);
+  return log_segments_.empty() ? 0 : log_segments_.begin()->first * LOG_SEGMENT_SIZE;
+}
+
+void DiskManager::SetLogEnd(int64_t offset) {
+  std::lock_guard<std::mutex> guard(log_io_latch_);
+  log_end_ = offset;
+}
+
+/**
+ * Rename the segments that are entirely before offset to spare files, or remove them once enough spares are kept
+ */
+void DiskManager::RecycleLog(int64_t offset) {
+  std::lock_guard<std::mutex> guard(log_io_latch_);
+  while (!log_segments_.empty()) {
+    auto oldest = log_segments_.begin();
+    int64_t segment_end = (oldest->first + 1) * LOG_SEGMENT_SIZE;
+    // appends continue in the segment holding the end of the log
+    if (segment_end > offset || segment_end > log_end_) {
+      break;
+    }
+    if (oldest->second != nullptr) {
+      oldest->second->close();
+    }
+    std::string name = GetSegmentName(oldest->first);
+    if (spare_segments_.size() < static_cast<size_t>(LOG_SEGMENT_SPARES)) {
+      std::string spare_name = log_name_ + ".spare." + std::to_string(oldest->first);
+      if (std::rename(name.c_str(), spare_name.c_str()) == 0) {
+        spare_segments_.push_back(spare_name);
+      } else {
+        LOG_DEBUG("I/O error while recycling log segment");
+      }
+    } else {
+      std::remove(name.c_str());
+    }
+    log_segments_.erase(oldest);
   }
-  // if log file ends before reading "size"
-  int read_count = log_io_.gcount();
-  if (read_count < size) {
-    log_io_.clear();
-    memset(log_data + read_count, 0, size - read_count);
+}
+
+/**
+ * Write the master record into a temporary file and rename it over the old one
+ */
+void DiskManager::WriteMasterRecord(int64_t offset) {
+  std::string tmp_name = master_name_ + ".tmp";
+  std::ofstream master_io(tmp_name, std::ios::binary | std::ios::trunc | std::ios::out);
+  master_io.write(reinterpret_cast<const char *>(&offset), sizeof(int64_t));
+  master_io.close();
+  if (master_io.fail() || std::rename(tmp_name.c_str(), master_name_.c_str()) != 0) {
+    LOG_DEBUG("I/O error while writing master record");
   }
+}
 
-  return true;
+/**
+ * Read the master record, a master record that points past the end of the log belongs to an older log file
+ */
+bool DiskManager::ReadMasterRecord(int64_t *offset) {
+  std::ifstream master_io(master_name_, std::ios::binary | std::ios::in);
+  if (!master_io.is_open() || !master_io.read(reinterpret_cast<char *>(offset), sizeof(int64_t))) {
+    return false;
+  }
+  return *offset >= 0 && *offset < GetLogSize();
 }
 
 /**
@@ -190,6 +301,12 @@ bool DiskManager::ReadLog(char *log_data, int size, int offset) {
  */
 page_id_t DiskManager::AllocatePage() { return next_page_id_++; }
 
+void DiskManager::ReservePageId(page_id_t page_id) {
+  page_id_t next = next_page_id_;
+  while (next <= page_id && !next_page_id_.compare_exchange_weak(next, page_id + 1)) {
+  }
+}
+
 /**
  * Deallocate page (operations like drop index/table)
  * Need bitmap in header page for tracking pages
@@ -212,13 +329,44 @@ int DiskManager::GetNumWrites() const { return num_writes_; }
  */
 bool DiskManager::GetFlushState() const { return flush_log_; }
 
+std::string DiskManager::GetSegmentName(int64_t segment_no) { return log_name_ + "." + std::to_string(segment_no); }
+
+std::fstream *DiskManager::GetLogSegment(int64_t segment_no, bool create) {
+  auto it = log_segments_.find(segment_no);
+  if (it == log_segments_.end()) {
+    if (!create) {
+      return nullptr;
+    }
+    std::string name = GetSegmentName(segment_no);
+    if (!spare_segments_.empty()) {
+      // reuse an old segment file, its stale bytes are overwritten as the log grows
+      if (std::rename(spare_segments_.back().c_str(), name.c_str()) != 0) {
+        LOG_DEBUG("I/O error while reusing log segment");
+      }
+      spare_segments_.pop_back();
+    }
+    // create the file if the rename did not
+    std::ofstream(name, std::ios::binary | std::ios::app | std::ios::out).close();
+    it = log_segments_.emplace(segment_no, nullptr).first;
+  }
+  if (it->second == nullptr) {
+    it->second = std::make_unique<std::fstream>(GetSegmentName(segment_no),
+                                                std::ios::binary | std::ios::in | std::ios::out);
+    if (!it->second->is_open()) {
+      it->second = nullptr;
+      return nullptr;
+    }
+  }
+  return it->second.get();
+}
+
 /**
  * Private helper function to get disk file size
  */
-int DiskManager::GetFileSize(const std::string &file_name) {
+int64_t DiskManager::GetFileSize(const std::string &file_name) {
   struct stat stat_buf;
   int rc = stat(file_name.c_str(), &stat_buf);
-  return rc == 0 ? static_cast<int>(stat_buf.st_size) : -1;
+  return rc == 0 ? static_cast<int64_t>(stat_buf.st_size) : -1;
 }
 
 }  // namespace bustub
@@ -17,6 +17,32 @@
 #include "storage/page/header_page.h"
 
 namespace bustub {
+
+namespace {
+
+/**
+ * Logs the page changes of one insert or remove for its transaction, if logging is on and there is a transaction to
+ * log them for. While compensating, the change to the leaf is the CLR of an undo continuing at undo_next_lsn.
+ */
+class LogContextGuard {
+ public:
+  LogContextGuard(BufferPoolManager *buffer_pool_manager, Transaction *transaction, const std::string *index_name,
+                  bool compensating = false, lsn_t undo_next_lsn = INVALID_LSN)
+      : context_{buffer_pool_manager->GetLogManager(), transaction, index_name, compensating, undo_next_lsn},
+        previous_(BPlusTreePage::log_context) {
+    if (enable_logging && context_.log_manager_ != nullptr && transaction != nullptr) {
+      BPlusTreePage::log_context = &context_;
+    }
+  }
+  ~LogContextGuard() { BPlusTreePage::log_context = previous_; }
+
+ private:
+  BPlusTreeLogContext context_;
+  BPlusTreeLogContext *previous_;
+};
+
+}  // namespace
+
 INDEX_TEMPLATE_ARGUMENTS
 BPLUSTREE_TYPE::BPlusTree(std::string name, BufferPoolManager *buffer_pool_manager, const KeyComparator &comparator,
                           int leaf_max_size, int internal_max_size)
@@ -72,6 +98,25 @@ bool BPLUSTREE_TYPE::GetValue(const KeyType &key, std::vector<ValueType> *result
  */
 INDEX_TEMPLATE_ARGUMENTS
 bool BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value, Transaction *transaction) {
+  LogContextGuard log_guard(buffer_pool_manager_, transaction, &index_name_);
+  return InsertImpl(key, value, transaction);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::InsertImpl(const KeyType &key, const ValueType &value, Transaction *transaction) {
+  // 大部分插入不会引起分裂;只需要写锁叶子节点
+  if (enable_optimistic_crabbing && transaction != nullptr) {
+    B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_page = FindLeafPageOptimistic(key, Operate_Type::OP_INSERT, transaction);
+    if (leaf_page != nullptr) {
+      ValueType old_val;
+      bool inserted = !leaf_page->Lookup(key, &old_val, comparator_);
+      if (inserted) {
+        leaf_page->Insert(key, value, comparator_);
+      }
+      FreePagesInTransaction(true, transaction);
+      return inserted;
+    }
+  }
   LockRootPageId(true);
   // 如果是空的二叉树需要构建root节点
   if (IsEmpty()) {
@@ -99,8 +144,10 @@ void BPLUSTREE_TYPE::StartNewTree(const KeyType &key, const ValueType &value) {
   root_page_id_ = root_page_id;
   // 转换成Leaf页
   B_PLUS_TREE_LEAF_PAGE_TYPE *root_page = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page->GetData());
+  lsn_t begin_lsn = BPlusTreePage::BeginStructureChange();
   root_page->Init(root_page_id, INVALID_PAGE_ID, leaf_max_size_);
   UpdateRootPageId(1);
+  BPlusTreePage::EndStructureChange(begin_lsn);
   // 插入数据
   root_page->Insert(key, value, comparator_);
   buffer_pool_manager_->UnpinPage(root_page_id, true);
@@ -127,9 +174,11 @@ bool BPLUSTREE_TYPE::InsertIntoLeaf(const KeyType &key, const ValueType &value,
     int size = leaf_page->Insert(key, value, comparator_);
     //达到上限开始分裂页
     if (size == leaf_max_size_) {
+      lsn_t begin_lsn = BPlusTreePage::BeginStructureChange();
       B_PLUS_TREE_LEAF_PAGE_TYPE *recipent = Split(leaf_page,transaction);
       KeyType key = recipent->KeyAt(0);
       InsertIntoParent(leaf_page, key, recipent, transaction);
+      BPlusTreePage::EndStructureChange(begin_lsn);
     }
   }
   FreePagesInTransaction(true,transaction);
@@ -220,15 +269,30 @@ void BPLUSTREE_TYPE::InsertIntoParent(BPlusTreePage *old_node, const KeyType &ke
  */
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) {
+  LogContextGuard log_guard(buffer_pool_manager_, transaction, &index_name_);
+  RemoveImpl(key, transaction);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::RemoveImpl(const KeyType &key, Transaction *transaction) {
   if (IsEmpty()) {
     return;
   }
   // 先定位到叶子节点;然后从叶子节点中删除数据
-  B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_page = FindLeafPage(key, false,Operate_Type::OP_DELETE,transaction);
+  // 叶子节点不会合并时只需要写锁叶子节点
+  B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_page = nullptr;
+  if (enable_optimistic_crabbing && transaction != nullptr) {
+    leaf_page = FindLeafPageOptimistic(key, Operate_Type::OP_DELETE, transaction);
+  }
+  if (leaf_page == nullptr) {
+    leaf_page = FindLeafPage(key, false, Operate_Type::OP_DELETE, transaction);
+  }
   int size = leaf_page->RemoveAndDeleteRecord(key, comparator_);
   // 判断是否需要进行页面合并或者重组操作
   if (size < leaf_page->GetMinSize()) {
+    lsn_t begin_lsn = BPlusTreePage::BeginStructureChange();
     CoalesceOrRedistribute(leaf_page, transaction);
+    BPlusTreePage::EndStructureChange(begin_lsn);
   }
 
   FreePagesInTransaction(true,transaction);
@@ -482,6 +546,51 @@ B_PLUS_TREE_LEAF_PAGE_TYPE *BPLUSTREE_TYPE::FindLeafPage(const KeyType &key, boo
   return static_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page);
 }
 
+INDEX_TEMPLATE_ARGUMENTS
+B_PLUS_TREE_LEAF_PAGE_TYPE *BPLUSTREE_TYPE::FindLeafPageOptimistic(const KeyType &key, Operate_Type operate,
+                                                                   Transaction *transaction) {
+  LockRootPageId(false);
+  if (IsEmpty()) {
+    TryUnlockRootPageId(false);
+    return nullptr;
+  }
+  Page *page = buffer_pool_manager_->FetchPage(root_page_id_);
+  page->RLatch();
+  // 根节点的读锁挡住了新的根节点;可以释放root_page_id_的锁
+  TryUnlockRootPageId(false);
+  auto tree_page = reinterpret_cast<BPlusTreePage *>(page->GetData());
+  if (tree_page->IsLeafPage()) {
+    page->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+    return nullptr;
+  }
+  while (true) {
+    page_id_t child_id = static_cast<B_PLUS_TREE_INTERNAL_PAGE *>(tree_page)->Lookup(key, comparator_);
+    Page *child = buffer_pool_manager_->FetchPage(child_id);
+    child->RLatch();
+    auto child_page = reinterpret_cast<BPlusTreePage *>(child->GetData());
+    if (child_page->IsLeafPage()) {
+      // Splitting, merging or redistributing the leaf changes the parent, so while the parent is read latched the leaf
+      // stays the one of key and its latch can be traded for a write latch.
+      child->RUnlatch();
+      child->WLatch();
+      page->RUnlatch();
+      buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+      if (!child_page->IsSafe(operate)) {
+        child->WUnlatch();
+        buffer_pool_manager_->UnpinPage(child_id, false);
+        return nullptr;
+      }
+      transaction->AddIntoPageSet(child);
+      return static_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(child_page);
+    }
+    page->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+    page = child;
+    tree_page = child_page;
+  }
+}
+
 /**
  * 统一的Unping页操作
  */
@@ -519,16 +628,77 @@ void BPLUSTREE_TYPE::FreePagesInTransaction(bool is_write, Transaction *transact
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_TYPE::UpdateRootPageId(int insert_record) {
   HeaderPage *header_page = static_cast<HeaderPage *>(buffer_pool_manager_->FetchPage(HEADER_PAGE_ID));
-  if (insert_record != 0) {
-    // create a new record<index_name + root_page_id> in header_page
-    header_page->InsertRecord(index_name_, root_page_id_);
-  } else {
+  header_page->WLatch();
+  BPlusTreeLogContext *log_context = BPlusTreePage::log_context;
+  std::vector<char> old_data;
+  if (log_context != nullptr) {
+    old_data.assign(header_page->GetData(), header_page->GetData() + PAGE_SIZE);
+  }
+  // an index that is emptied and filled again already has its record
+  if (insert_record == 0 || !header_page->InsertRecord(index_name_, root_page_id_)) {
     // update root_page_id in header_page
     header_page->UpdateRecord(index_name_, root_page_id_);
   }
+  if (log_context != nullptr) {
+    // log the changed bytes, the LSN of the header page is left out as it has not changed yet
+    const char *new_data = header_page->GetData();
+    int begin = 0;
+    int end = PAGE_SIZE;
+    while (begin < end && old_data[begin] == new_data[begin]) {
+      begin++;
+    }
+    while (end > begin && old_data[end - 1] == new_data[end - 1]) {
+      end--;
+    }
+    if (begin < end) {
+      LogRecord log_record(log_context->txn_->GetTransactionId(), log_context->txn_->GetPrevLSN(),
+                           LogRecordType::BTREE_UPDATE, HEADER_PAGE_ID, begin, end - begin, old_data.data() + begin,
+                           new_data + begin);
+      lsn_t lsn = log_context->log_manager_->AppendLogRecord(&log_record);
+      log_context->txn_->SetPrevLSN(lsn);
+      header_page->SetLSN(lsn);
+    }
+  }
+  header_page->WUnlatch();
   buffer_pool_manager_->UnpinPage(HEADER_PAGE_ID, true);
 }
 
+/*
+ * Read the root page id of this index from the header page, for opening an index that already exists on disk
+ * @return: false if the header page has no record for this index
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::LoadRootPageId() {
+  mutex_.WLock();
+  HeaderPage *header_page = static_cast<HeaderPage *>(buffer_pool_manager_->FetchPage(HEADER_PAGE_ID));
+  header_page->RLatch();
+  bool found = header_page->GetRootId(index_name_, &root_page_id_);
+  if (!found) {
+    root_page_id_ = INVALID_PAGE_ID;
+  }
+  header_page->RUnlatch();
+  buffer_pool_manager_->UnpinPage(HEADER_PAGE_ID, false);
+  mutex_.WUnlock();
+  return found;
+}
+
+/*
+ * Undo the insert or removal of a key by a transaction being rolled back, wherever its entry is now. The change to
+ * the leaf is logged as a CLR, the structure changes it causes as nested top actions like those of any insert.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::UndoInsert(const char *entry, Transaction *transaction, lsn_t undo_next_lsn) {
+  LogContextGuard log_guard(buffer_pool_manager_, transaction, &index_name_, true, undo_next_lsn);
+  RemoveImpl(reinterpret_cast<const MappingType *>(entry)->first, transaction);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::UndoRemove(const char *entry, Transaction *transaction, lsn_t undo_next_lsn) {
+  LogContextGuard log_guard(buffer_pool_manager_, transaction, &index_name_, true, undo_next_lsn);
+  auto item = reinterpret_cast<const MappingType *>(entry);
+  InsertImpl(item->first, item->second, transaction);
+}
+
 /*
  * This method is used for test only
  * Read data from file and insert one by one
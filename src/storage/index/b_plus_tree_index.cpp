@@ -11,15 +11,20 @@
 
 #include "storage/index/b_plus_tree_index.h"
 
+#include <functional>
+
 namespace bustub {
 /*
  * Constructor
  */
 INDEX_TEMPLATE_ARGUMENTS
-BPLUSTREE_INDEX_TYPE::BPlusTreeIndex(IndexMetadata *metadata, BufferPoolManager *buffer_pool_manager)
+BPLUSTREE_INDEX_TYPE::BPlusTreeIndex(IndexMetadata *metadata, BufferPoolManager *buffer_pool_manager,
+                                     LockManager *lock_manager)
     : Index(metadata),
       comparator_(metadata->GetKeySchema()),
-      container_(metadata->GetName(), buffer_pool_manager, comparator_) {}
+      container_(metadata->GetName(), buffer_pool_manager, comparator_),
+      lock_manager_(lock_manager),
+      end_of_index_(INVALID_PAGE_ID, static_cast<uint32_t>(std::hash<std::string>()(metadata->GetName()))) {}
 
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_INDEX_TYPE::InsertEntry(const Tuple &key, RID rid, Transaction *transaction) {
@@ -27,7 +32,38 @@ void BPLUSTREE_INDEX_TYPE::InsertEntry(const Tuple &key, RID rid, Transaction *t
   KeyType index_key;
   index_key.SetFromKey(key);
 
+  if (!LocksWrites(transaction)) {
+    container_.Insert(index_key, rid, transaction);
+    return;
+  }
+  if (!lock_manager_->LockExclusive(transaction, rid) || !WaitForGap(index_key, transaction)) {
+    ThrowAbort(transaction);
+  }
   container_.Insert(index_key, rid, transaction);
+  // A scan that locks the gap from now on finds the new key and waits for its lock, but one may have locked it since
+  // we looked.
+  if (!WaitForGap(index_key, transaction)) {
+    container_.Remove(index_key, transaction);
+    ThrowAbort(transaction);
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_INDEX_TYPE::WaitForGap(const KeyType &key, Transaction *transaction) {
+  std::vector<RID> rids;
+  RID next;
+  CollectRange(key, key, &rids, &next);
+  while (true) {
+    if (!lock_manager_->LockInstant(transaction, next)) {
+      return false;
+    }
+    // a key may have come in while we waited, splitting the gap
+    RID waited_for = next;
+    CollectRange(key, key, &rids, &next);
+    if (next == waited_for) {
+      return true;
+    }
+  }
 }
 
 INDEX_TEMPLATE_ARGUMENTS
@@ -36,6 +72,11 @@ void BPLUSTREE_INDEX_TYPE::DeleteEntry(const Tuple &key, RID rid, Transaction *t
   KeyType index_key;
   index_key.SetFromKey(key);
 
+  // the gap of the key merges into the gap of the next one, both are locked until the transaction ends
+  std::vector<RID> rids;
+  if (LocksWrites(transaction) && !LockKeyRange(index_key, index_key, true, &rids, transaction)) {
+    ThrowAbort(transaction);
+  }
   container_.Remove(index_key, transaction);
 }
 
@@ -45,9 +86,80 @@ void BPLUSTREE_INDEX_TYPE::ScanKey(const Tuple &key, std::vector<RID> *result, T
   KeyType index_key;
   index_key.SetFromKey(key);
 
+  if (LocksKeyRanges(transaction)) {
+    // an absent key is locked through the gap it would go into
+    if (!LockKeyRange(index_key, index_key, false, result, transaction)) {
+      ThrowAbort(transaction);
+    }
+    return;
+  }
   container_.GetValue(index_key, result, transaction);
 }
 
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_INDEX_TYPE::ScanRange(const Tuple &start_key, const Tuple &end_key, std::vector<RID> *result,
+                                     Transaction *transaction) {
+  KeyType start;
+  start.SetFromKey(start_key);
+  KeyType end;
+  end.SetFromKey(end_key);
+
+  if (LocksKeyRanges(transaction)) {
+    if (!LockKeyRange(start, end, false, result, transaction)) {
+      ThrowAbort(transaction);
+    }
+    return;
+  }
+  RID next;
+  CollectRange(start, end, result, &next);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_INDEX_TYPE::ThrowAbort(Transaction *transaction) {
+  // the lock manager only lets a wait fail when it picks the transaction to break a deadlock
+  throw TransactionAbortException(transaction->GetTransactionId(), AbortReason::DEADLOCK);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_INDEX_TYPE::CollectRange(const KeyType &start, const KeyType &end, std::vector<RID> *rids, RID *next) {
+  rids->clear();
+  *next = end_of_index_;
+  // the iterator holds a leaf latch, let it go before waiting for any lock
+  for (auto it = container_.Begin(start); !it.isEnd(); ++it) {
+    if (comparator_((*it).first, end) > 0) {
+      *next = (*it).second;
+      return;
+    }
+    rids->push_back((*it).second);
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_INDEX_TYPE::LockKeyRange(const KeyType &start, const KeyType &end, bool exclusive,
+                                        std::vector<RID> *result, Transaction *transaction) {
+  RID next;
+  CollectRange(start, end, result, &next);
+  while (true) {
+    std::vector<RID> locked(*result);
+    RID locked_next = next;
+    locked.push_back(next);
+    for (const RID &rid : locked) {
+      bool granted = exclusive ? lock_manager_->LockExclusive(transaction, rid)
+                               : lock_manager_->LockShared(transaction, rid);
+      if (!granted) {
+        result->clear();
+        return false;
+      }
+    }
+    // keys that came in before the locks were granted are locked on the next round
+    locked.pop_back();
+    CollectRange(start, end, result, &next);
+    if (next == locked_next && *result == locked) {
+      return true;
+    }
+  }
+}
+
 INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE BPLUSTREE_INDEX_TYPE::GetBeginIterator() { return container_.begin(); }
 
@@ -13,7 +13,10 @@ namespace bustub {
  */
 INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE::IndexIterator(B_PLUS_TREE_LEAF_PAGE_TYPE *leaf, int index, BufferPoolManager *buffer_pool_manager)
-    : index_(index), leaf_(leaf), buffer_pool_manager_(buffer_pool_manager) {}
+    : index_(index), leaf_(leaf), buffer_pool_manager_(buffer_pool_manager) {
+  // a key past the last one of its leaf starts on the next leaf
+  MoveToNextLeafIfDone();
+}
 
 INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE::~IndexIterator() {
@@ -32,25 +35,26 @@ INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE &INDEXITERATOR_TYPE::operator++() {
   // std::cout<<"增加迭代器"<<std::endl;
   index_++;
+  MoveToNextLeafIfDone();
+  return *this;
+}
+INDEX_TEMPLATE_ARGUMENTS
+void INDEXITERATOR_TYPE::MoveToNextLeafIfDone() {
   //已经遍历完当前页
-  if ( index_ >= leaf_->GetSize()) {
+  while (leaf_ != nullptr && index_ >= leaf_->GetSize()) {
     page_id_t next_page_id = leaf_->GetNextPageId();
     UnlockAndUnPin();
+    index_ = 0;
     if (next_page_id == INVALID_PAGE_ID) {
-      // 释放最后一个被引用的页
-      // buffer_pool_manager_->UnpinPage(leaf_->GetPageId(), false);
-      index_ = 0;
       leaf_ = nullptr;
     } else {
-      // buffer_pool_manager_->UnpinPage(leaf_->GetPageId(), false);
       Page *next_page = buffer_pool_manager_->FetchPage(next_page_id);
       next_page->RLatch();
       leaf_ = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(next_page->GetData());
-      index_ = 0;
     }
   }
-  return *this;
 }
+
 INDEX_TEMPLATE_ARGUMENTS
 void INDEXITERATOR_TYPE::UnlockAndUnPin() {
     buffer_pool_manager_->FetchPage(leaf_->GetPageId())->RUnlatch();
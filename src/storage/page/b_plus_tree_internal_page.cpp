@@ -11,6 +11,7 @@
 
 #include "storage/page/b_plus_tree_internal_page.h"
 #include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <sstream>
 #include "common/exception.h"
@@ -27,11 +28,10 @@ namespace bustub {
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::Init(page_id_t page_id, page_id_t parent_id, int max_size) {
   // 初始化page的相关成员字段
-  SetPageType(IndexPageType::INTERNAL_PAGE);
-  SetSize(0);
-  SetPageId(page_id);
-  SetParentPageId(parent_id);
-  SetMaxSize(max_size);
+  char old_header[INTERNAL_PAGE_HEADER_SIZE];
+  memcpy(old_header, this, INTERNAL_PAGE_HEADER_SIZE);
+  InitHeader(IndexPageType::INTERNAL_PAGE, page_id, parent_id, max_size);
+  LogUpdate(0, old_header, INTERNAL_PAGE_HEADER_SIZE);
 }
 /*
  * Helper method to get/set the key associated with input "index"(a.k.a
@@ -53,7 +53,7 @@ KeyType B_PLUS_TREE_INTERNAL_PAGE_TYPE::KeyAt(int index) const {
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetKeyAt(int index, const KeyType &key) {
   assert(index >= 0 && index < GetSize());
-  array[index].first = key;
+  WriteBytes(OffsetOf(&array[index].first), &key, sizeof(KeyType));
 }
 
 /*
@@ -124,12 +124,11 @@ ValueType B_PLUS_TREE_INTERNAL_PAGE_TYPE::Lookup(const KeyType &key, const KeyCo
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::PopulateNewRoot(const ValueType &old_value, const KeyType &new_key,
                                                      const ValueType &new_value) {
-  array[0].second = old_value;
-  array[1].second = new_value;
-  array[1].first = new_key;
-  SetPageType(IndexPageType::INTERNAL_PAGE);
-  SetParentPageId(INVALID_PAGE_ID);
-  SetSize(2);
+  MappingType items[2];
+  items[0].second = old_value;
+  items[1].first = new_key;
+  items[1].second = new_value;
+  InsertItems(0, items, 2);
 }
 /*
  * Insert new_key & new_value pair right after the pair with its value ==
@@ -141,14 +140,8 @@ int B_PLUS_TREE_INTERNAL_PAGE_TYPE::InsertNodeAfter(const ValueType &old_value,
                                                     const ValueType &new_value) {
   // 先定位到old_value的位置
   int index = ValueIndex(old_value);
-  int end = GetSize();
-  // 将后面的元素向后移动
-  for (int i = end - 1; i > index; i--) {
-    array[i + 1] = array[i];
-  }
-  array[index + 1].first = new_key;
-  array[index + 1].second = new_value;
-  IncreaseSize(1);
+  MappingType item(new_key, new_value);
+  InsertItems(index + 1, &item, 1);
   return GetSize();
 }
 
@@ -164,7 +157,7 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveHalfTo(BPlusTreeInternalPage *recipient
   // 拷贝数据
   int size = GetSize();
   recipient->CopyNFrom(array + size / 2, size - size / 2, buffer_pool_manager);
-  SetSize(size / 2);
+  RemoveItems(size / 2, size - size / 2);
 }
 
 /* Copy entries into me, starting from {items} and copy {size} entries.
@@ -176,17 +169,15 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveHalfTo(BPlusTreeInternalPage *recipient
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::CopyNFrom(MappingType *items, int size, BufferPoolManager *buffer_pool_manager) {
+  // 拷贝数据
+  assert(GetSize() == 0);
+  InsertItems(0, items, size);
   for (int i = 0; i < size; i++) {
-    // 拷贝数据
-    MappingType temp = items[i];
-    array[i].first = temp.first;
-    array[i].second = temp.second;
     // 修改子节点的parent id
-    BPlusTreePage *page = reinterpret_cast<BPlusTreePage *>(buffer_pool_manager->FetchPage(temp.second)->GetData());
+    BPlusTreePage *page = reinterpret_cast<BPlusTreePage *>(buffer_pool_manager->FetchPage(items[i].second)->GetData());
     page->SetParentPageId(GetPageId());
-    buffer_pool_manager->UnpinPage(temp.second, true);
+    buffer_pool_manager->UnpinPage(items[i].second, true);
   }
-  SetSize(size);
 }
 
 /*****************************************************************************
@@ -200,15 +191,8 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::CopyNFrom(MappingType *items, int size, Buf
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::Remove(int index) {
   assert(index >= 0 && index < GetSize());
-  int size = GetSize();
-  // 用后面的数据覆盖前面的数据
-  while (index < size - 1) {
-    array[index].first = array[index + 1].first;
-    array[index].second = array[index + 1].second;
-    index++;
-  }
-  // 减少size
-  IncreaseSize(-1);
+  // 用后面的数据覆盖前面的数据, 并减少size
+  RemoveItems(index, 1);
 }
 
 /*
@@ -218,7 +202,7 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::Remove(int index) {
 INDEX_TEMPLATE_ARGUMENTS
 ValueType B_PLUS_TREE_INTERNAL_PAGE_TYPE::RemoveAndReturnOnlyChild() {
   ValueType res = array[0].second;
-  SetSize(0);
+  RemoveItems(0, GetSize());
   return res;
 }
 /*****************************************************************************
@@ -234,19 +218,12 @@ ValueType B_PLUS_TREE_INTERNAL_PAGE_TYPE::RemoveAndReturnOnlyChild() {
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveAllTo(BPlusTreeInternalPage *recipient, const KeyType &middle_key,
                                                BufferPoolManager *buffer_pool_manager) {
-  buffer_pool_manager->FetchPage(recipient->GetPageId());
-  buffer_pool_manager->FetchPage(GetPageId());
-
-  // 从父节点中删除middle_key
-  B_PLUS_TREE_INTERNAL_PAGE_TYPE *parent_page =
-      reinterpret_cast<B_PLUS_TREE_INTERNAL_PAGE_TYPE *>(buffer_pool_manager->FetchPage(GetParentPageId())->GetData());
-  parent_page->Remove(parent_page->ValueIndex(GetPageId()));
+  // middle_key从父节点中的删除由Coalesce负责
   SetKeyAt(0, middle_key);
   int offeset = recipient->GetSize();
-  buffer_pool_manager->UnpinPage(GetParentPageId(), false);
   // 拷贝数据
+  recipient->InsertItems(offeset, array, GetSize());
   for (int i = 0; i < GetSize(); i++) {
-    recipient->array[i + offeset] = array[i];
     // 修改子页的parent_page id
     BPlusTreePage *child_page =
         reinterpret_cast<BPlusTreePage *>(buffer_pool_manager->FetchPage(array[i].second)->GetData());
@@ -254,9 +231,8 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveAllTo(BPlusTreeInternalPage *recipient,
     buffer_pool_manager->UnpinPage(array[i].second, true);
   }
 
-  // 修改两个页中的KV键值对的数量
-  recipient->IncreaseSize(GetSize());
-  SetSize(0);
+  // 清空当前页
+  RemoveItems(0, GetSize());
   assert(recipient->GetSize() <= GetMaxSize());
 }
 
@@ -286,10 +262,8 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveFirstToEndOf(BPlusTreeInternalPage *rec
   child_page->SetParentPageId(recipient->GetPageId());
 
   // 移动KV键值对
-  int recipient_size = recipient->GetSize();
-  recipient->array[recipient_size].first = middle_key;
-  recipient->array[recipient_size].second = val;
-  recipient->IncreaseSize(1);
+  MappingType item(middle_key, val);
+  recipient->InsertItems(recipient->GetSize(), &item, 1);
   Remove(0);
   buffer_pool_manager->UnpinPage(val, true);
   buffer_pool_manager->UnpinPage(GetParentPageId(), true);
@@ -302,12 +276,9 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveFirstToEndOf(BPlusTreeInternalPage *rec
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::CopyLastFrom(const MappingType &pair, BufferPoolManager *buffer_pool_manager) {
   buffer_pool_manager->FetchPage(GetPageId());
-  int index = GetSize();
-  array[index].first = pair.first;
-  array[index].second = pair.second;
+  InsertItems(GetSize(), &pair, 1);
   BPlusTreePage *page = reinterpret_cast<BPlusTreePage *>(buffer_pool_manager->FetchPage(pair.second)->GetData());
   page->SetParentPageId(GetPageId());
-  IncreaseSize(1);
   buffer_pool_manager->UnpinPage(pair.second, true);
   buffer_pool_manager->UnpinPage(GetPageId(), true);
 }
@@ -334,14 +305,9 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveLastToFrontOf(BPlusTreeInternalPage *re
   child_page->SetParentPageId(recipient->GetPageId());
 
   // 移动KV键值对
-  int recipient_size = recipient->GetSize();
-  for (int i = recipient_size; i > 0; i--) {
-    recipient->array[i].first = recipient->array[i - 1].first;
-    recipient->array[i].second = recipient->array[i - 1].second;
-  }
-  recipient->array[1].first = middle_key;
-  recipient->array[0].second = val;
-  recipient->IncreaseSize(1);
+  MappingType item(recipient->array[0].first, val);
+  recipient->InsertItems(0, &item, 1);
+  recipient->SetKeyAt(1, middle_key);
   Remove(GetSize() - 1);
   buffer_pool_manager->UnpinPage(val, true);
   buffer_pool_manager->UnpinPage(GetParentPageId(), true);
@@ -9,6 +9,7 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <cstring>
 #include <sstream>
 
 #include "common/exception.h"
@@ -29,12 +30,11 @@ namespace bustub {
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::Init(page_id_t page_id, page_id_t parent_id, int max_size) {
-  SetPageType(IndexPageType::LEAF_PAGE);
-  SetSize(0);
-  SetPageId(page_id);
-  SetParentPageId(parent_id);
-  SetMaxSize(max_size);
+  char old_header[LEAF_PAGE_HEADER_SIZE];
+  memcpy(old_header, this, LEAF_PAGE_HEADER_SIZE);
+  InitHeader(IndexPageType::LEAF_PAGE, page_id, parent_id, max_size);
   next_page_id_ = INVALID_PAGE_ID;
+  LogUpdate(0, old_header, LEAF_PAGE_HEADER_SIZE);
 }
 
 /**
@@ -44,7 +44,9 @@ INDEX_TEMPLATE_ARGUMENTS
 page_id_t B_PLUS_TREE_LEAF_PAGE_TYPE::GetNextPageId() const { return next_page_id_; }
 
 INDEX_TEMPLATE_ARGUMENTS
-void B_PLUS_TREE_LEAF_PAGE_TYPE::SetNextPageId(page_id_t next_page_id) { next_page_id_ = next_page_id; }
+void B_PLUS_TREE_LEAF_PAGE_TYPE::SetNextPageId(page_id_t next_page_id) {
+  WriteBytes(OffsetOf(&next_page_id_), &next_page_id, sizeof(page_id_t));
+}
 
 /**
  * Helper method to find the first index i so that array[i].first >= key
@@ -104,12 +106,8 @@ int B_PLUS_TREE_LEAF_PAGE_TYPE::Insert(const KeyType &key, const ValueType &valu
   // 找到第一大于key的位置
   int index = KeyIndex(key, comparator);
   assert(index >= 0);
-  for (int i = GetSize() - 1; i >= index; i--) {
-    array[i + 1] = array[i];
-  }
-  array[index].first = key;
-  array[index].second = value;
-  IncreaseSize(1);
+  MappingType item(key, value);
+  InsertItems(index, &item, 1, true);
   return GetSize();
 }
 
@@ -127,7 +125,7 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveHalfTo(BPlusTreeLeafPage *recipient, Buffer
   recipient->SetNextPageId(next_page_id_);
   SetNextPageId(recipient->GetPageId());
   recipient->CopyNFrom(array + index, size - index);
-  SetSize(index);
+  RemoveItems(index, size - index);
 }
 
 /*
@@ -135,10 +133,8 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveHalfTo(BPlusTreeLeafPage *recipient, Buffer
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::CopyNFrom(MappingType *items, int size) {
-  for (int i = 0; i < size; i++) {
-    array[i] = items[i];
-  }
-  SetSize(size);
+  assert(GetSize() == 0);
+  InsertItems(0, items, size);
 }
 
 /*****************************************************************************
@@ -177,10 +173,7 @@ int B_PLUS_TREE_LEAF_PAGE_TYPE::RemoveAndDeleteRecord(const KeyType &key, const
     return index;
   }
   if (comparator(array[index].first, key) == 0) {
-    for (; index < GetSize() - 1; index++) {
-      array[index] = array[index + 1];
-    }
-    IncreaseSize(-1);
+    RemoveItems(index, 1, true);
   }
   return GetSize();
 }
@@ -196,15 +189,12 @@ INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveAllTo(BPlusTreeLeafPage *recipient, const KeyType &middle_key,
                                            BufferPoolManager *buffer_pool_manager) {
   // 更新sibling page
-  recipient->next_page_id_ = next_page_id_;
+  recipient->SetNextPageId(next_page_id_);
   int offset = recipient->GetSize();
   // 拷贝数据
   int size = GetSize();
-  for (int i = 0; i < size; i++) {
-    recipient->array[offset + i] = array[i];
-  }
-  recipient->IncreaseSize(size);
-  SetSize(0);
+  recipient->InsertItems(offset, array, size);
+  RemoveItems(0, size);
 }
 
 /*****************************************************************************
@@ -216,12 +206,8 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveAllTo(BPlusTreeLeafPage *recipient, const K
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveFirstToEndOf(BPlusTreeLeafPage *recipient, const KeyType &middle_key,
                                                   BufferPoolManager *buffer_pool_manager) {
-  int size = GetSize();
   recipient->CopyLastFrom(array[0]);
-  for (int i = 0; i < size - 1; i++) {
-    array[i] = array[i + 1];
-  }
-  IncreaseSize(-1);
+  RemoveItems(0, 1);
   // 修改父节点中的数据
   Page *page = buffer_pool_manager->FetchPage(GetParentPageId());
   B_PLUS_TREE_INTERNAL_PAGE *parent = reinterpret_cast<B_PLUS_TREE_INTERNAL_PAGE *>(page->GetData());
@@ -234,9 +220,7 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveFirstToEndOf(BPlusTreeLeafPage *recipient,
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::CopyLastFrom(const MappingType &item) {
-  int size = GetSize();
-  array[size] = item;
-  IncreaseSize(1);
+  InsertItems(GetSize(), &item, 1);
 }
 
 /*
@@ -246,7 +230,7 @@ INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveLastToFrontOf(BPlusTreeLeafPage *recipient, const KeyType &middle_key,
                                                    BufferPoolManager *buffer_pool_manager) {
   recipient->CopyFirstFrom(array[GetSize() - 1]);
-  IncreaseSize(-1);
+  RemoveItems(GetSize() - 1, 1);
   // 修改父节点中的数据
   Page *page = buffer_pool_manager->FetchPage(GetParentPageId());
   B_PLUS_TREE_INTERNAL_PAGE *parent = reinterpret_cast<B_PLUS_TREE_INTERNAL_PAGE *>(page->GetData());
@@ -259,11 +243,7 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveLastToFrontOf(BPlusTreeLeafPage *recipient,
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::CopyFirstFrom(const MappingType &item) {
-  for (int index = GetSize(); index > 0; index--) {
-    array[index] = array[index - 1];
-  }
-  array[0] = item;
-  IncreaseSize(1);
+  InsertItems(0, &item, 1);
 }
 
 template class BPlusTreeLeafPage<GenericKey<4>, RID, GenericComparator<4>>;
@@ -11,8 +11,13 @@
 
 #include "storage/page/b_plus_tree_page.h"
 
+#include <cstring>
+#include <vector>
+
 namespace bustub {
 
+thread_local BPlusTreeLogContext *BPlusTreePage::log_context = nullptr;
+
 /*
  * Helper methods to get/set page type
  * Page type enum class is defined in b_plus_tree_page.h
@@ -67,7 +72,9 @@ bool BPlusTreePage::IsSafe(Operate_Type operate){
  * Helper methods to get/set parent page id
  */
 page_id_t BPlusTreePage::GetParentPageId() const { return parent_page_id_; }
-void BPlusTreePage::SetParentPageId(page_id_t parent_page_id) { parent_page_id_ = parent_page_id; }
+void BPlusTreePage::SetParentPageId(page_id_t parent_page_id) {
+  WriteBytes(OffsetOf(&parent_page_id_), &parent_page_id, sizeof(page_id_t));
+}
 
 /*
  * Helper methods to get/set self page id
@@ -80,4 +87,105 @@ void BPlusTreePage::SetPageId(page_id_t page_id) { page_id_ = page_id; }
  */
 void BPlusTreePage::SetLSN(lsn_t lsn) { lsn_ = lsn; }
 
+/*
+ * Logged changes and the raw operations that recovery replays
+ */
+void BPlusTreePage::InitHeader(IndexPageType page_type, page_id_t page_id, page_id_t parent_id, int max_size) {
+  page_type_ = page_type;
+  size_ = 0;
+  max_size_ = max_size;
+  parent_page_id_ = parent_id;
+  page_id_ = page_id;
+}
+
+void BPlusTreePage::ApplyInsert(char *data, int array_offset, int entry_size, int index, const char *entries,
+                                int count) {
+  auto page = reinterpret_cast<BPlusTreePage *>(data);
+  char *array = data + array_offset;
+  memmove(array + (index + count) * entry_size, array + index * entry_size, (page->size_ - index) * entry_size);
+  memcpy(array + index * entry_size, entries, count * entry_size);
+  page->size_ += count;
+}
+
+void BPlusTreePage::ApplyRemove(char *data, int array_offset, int entry_size, int index, int count) {
+  auto page = reinterpret_cast<BPlusTreePage *>(data);
+  char *array = data + array_offset;
+  memmove(array + index * entry_size, array + (index + count) * entry_size,
+          (page->size_ - index - count) * entry_size);
+  page->size_ -= count;
+}
+
+lsn_t BPlusTreePage::BeginStructureChange() {
+  return log_context == nullptr ? INVALID_LSN : log_context->txn_->GetPrevLSN();
+}
+
+void BPlusTreePage::EndStructureChange(lsn_t begin_lsn) {
+  if (log_context == nullptr || log_context->txn_->GetPrevLSN() == begin_lsn) {
+    return;
+  }
+  LogRecord log_record(log_context->txn_->GetTransactionId(), log_context->txn_->GetPrevLSN(),
+                       LogRecordType::INVALID);
+  log_record.MakeCompensation(begin_lsn);
+  log_context->txn_->SetPrevLSN(log_context->log_manager_->AppendLogRecord(&log_record));
+}
+
+void BPlusTreePage::InsertEntries(int array_offset, int entry_size, int index, const void *entries, int count,
+                                  bool by_key) {
+  ApplyInsert(reinterpret_cast<char *>(this), array_offset, entry_size, index, static_cast<const char *>(entries),
+              count);
+  if (log_context != nullptr && count > 0) {
+    LogEntries(LogRecordType::BTREE_INSERT, array_offset, entry_size, index, count, by_key);
+  }
+}
+
+void BPlusTreePage::RemoveEntries(int array_offset, int entry_size, int index, int count, bool by_key) {
+  // the removed entries go into the record before they are overwritten, undo puts them back
+  if (log_context != nullptr && count > 0) {
+    LogEntries(LogRecordType::BTREE_DELETE, array_offset, entry_size, index, count, by_key);
+  }
+  ApplyRemove(reinterpret_cast<char *>(this), array_offset, entry_size, index, count);
+}
+
+void BPlusTreePage::LogEntries(LogRecordType log_record_type, int array_offset, int entry_size, int index, int count,
+                               bool by_key) {
+  LogRecord log_record(log_context->txn_->GetTransactionId(), log_context->txn_->GetPrevLSN(), log_record_type,
+                       page_id_, array_offset, entry_size, index, count,
+                       reinterpret_cast<char *>(this) + array_offset + index * entry_size,
+                       by_key ? *log_context->index_name_ : "");
+  if (by_key && log_context->compensating_) {
+    log_record.MakeCompensation(log_context->undo_next_lsn_);
+  }
+  AppendLogRecord(&log_record);
+}
+
+void BPlusTreePage::WriteBytes(int offset, const void *data, int size) {
+  char *dest = reinterpret_cast<char *>(this) + offset;
+  if (log_context == nullptr) {
+    memcpy(dest, data, size);
+    return;
+  }
+  if (memcmp(dest, data, size) == 0) {
+    return;
+  }
+  std::vector<char> old_data(dest, dest + size);
+  memcpy(dest, data, size);
+  LogUpdate(offset, old_data.data(), size);
+}
+
+void BPlusTreePage::LogUpdate(int offset, const char *old_data, int size) {
+  if (log_context == nullptr) {
+    return;
+  }
+  LogRecord log_record(log_context->txn_->GetTransactionId(), log_context->txn_->GetPrevLSN(),
+                       LogRecordType::BTREE_UPDATE, page_id_, offset, size, old_data,
+                       reinterpret_cast<char *>(this) + offset);
+  AppendLogRecord(&log_record);
+}
+
+void BPlusTreePage::AppendLogRecord(LogRecord *log_record) {
+  lsn_t lsn = log_context->log_manager_->AppendLogRecord(log_record);
+  log_context->txn_->SetPrevLSN(lsn);
+  lsn_ = lsn;
+}
+
 }  // namespace bustub
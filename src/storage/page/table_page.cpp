@@ -21,7 +21,7 @@ void TablePage::Init(page_id_t page_id, uint32_t page_size, page_id_t prev_page_
   // Set the page ID.
   memcpy(GetData(), &page_id, sizeof(page_id));
   // Log that we are creating a new page.
-  if (enable_logging) {
+  if (IsLogged(txn)) {
     LogRecord log_record =
         LogRecord(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::NEWPAGE, prev_page_id, page_id);
     lsn_t lsn = log_manager->AppendLogRecord(&log_record);
@@ -72,11 +72,13 @@ bool TablePage::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn, Lock
   }
 
   // Write the log record.
-  if (enable_logging) {
+  if (IsLogged(txn)) {
     BUSTUB_ASSERT(!txn->IsSharedLocked(*rid) && !txn->IsExclusiveLocked(*rid), "A new tuple should not be locked.");
-    // Acquire an exclusive lock on the new tuple.
-    bool locked = lock_manager->LockExclusive(txn, *rid);
-    BUSTUB_ASSERT(locked, "Locking a new tuple should always work.");
+    // Acquire an exclusive lock on the new tuple, unless a lock on the table covers it.
+    if (lock_manager != nullptr) {
+      bool locked = lock_manager->LockExclusive(txn, *rid);
+      BUSTUB_ASSERT(locked, "Locking a new tuple should always work.");
+    }
     LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::INSERT, *rid, tuple);
     lsn_t lsn = log_manager->AppendLogRecord(&log_record);
     SetLSN(lsn);
@@ -89,7 +91,7 @@ bool TablePage::MarkDelete(const RID &rid, Transaction *txn, LockManager *lock_m
   uint32_t slot_num = rid.GetSlotNum();
   // If the slot number is invalid, abort the transaction.
   if (slot_num >= GetTupleCount()) {
-    if (enable_logging) {
+    if (IsLogged(txn)) {
       txn->SetState(TransactionState::ABORTED);
     }
     return false;
@@ -98,20 +100,22 @@ bool TablePage::MarkDelete(const RID &rid, Transaction *txn, LockManager *lock_m
   uint32_t tuple_size = GetTupleSize(slot_num);
   // If the tuple is already deleted, abort the transaction.
   if (IsDeleted(tuple_size)) {
-    if (enable_logging) {
+    if (IsLogged(txn)) {
       txn->SetState(TransactionState::ABORTED);
     }
     return false;
   }
 
-  if (enable_logging) {
-    // Acquire an exclusive lock, upgrading from a shared lock if necessary.
-    if (txn->IsSharedLocked(rid)) {
-      if (!lock_manager->LockUpgrade(txn, rid)) {
+  if (IsLogged(txn)) {
+    // Acquire an exclusive lock, upgrading from a shared lock if necessary, unless a lock on the table covers the row.
+    if (lock_manager != nullptr) {
+      if (txn->IsSharedLocked(rid)) {
+        if (!lock_manager->LockUpgrade(txn, rid)) {
+          return false;
+        }
+      } else if (!txn->IsExclusiveLocked(rid) && !lock_manager->LockExclusive(txn, rid)) {
         return false;
       }
-    } else if (!txn->IsExclusiveLocked(rid) && !lock_manager->LockExclusive(txn, rid)) {
-      return false;
     }
     Tuple dummy_tuple;
     LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::MARKDELETE, rid, dummy_tuple);
@@ -133,7 +137,7 @@ bool TablePage::UpdateTuple(const Tuple &new_tuple, Tuple *old_tuple, const RID
   uint32_t slot_num = rid.GetSlotNum();
   // If the slot number is invalid, abort the transaction.
   if (slot_num >= GetTupleCount()) {
-    if (enable_logging) {
+    if (IsLogged(txn)) {
       txn->SetState(TransactionState::ABORTED);
     }
     return false;
@@ -141,7 +145,7 @@ bool TablePage::UpdateTuple(const Tuple &new_tuple, Tuple *old_tuple, const RID
   uint32_t tuple_size = GetTupleSize(slot_num);
   // If the tuple is deleted, abort the transaction.
   if (IsDeleted(tuple_size)) {
-    if (enable_logging) {
+    if (IsLogged(txn)) {
       txn->SetState(TransactionState::ABORTED);
     }
     return false;
@@ -162,16 +166,20 @@ bool TablePage::UpdateTuple(const Tuple &new_tuple, Tuple *old_tuple, const RID
   old_tuple->rid_ = rid;
   old_tuple->allocated_ = true;
 
-  if (enable_logging) {
-    // Acquire an exclusive lock, upgrading from shared if necessary.
-    if (txn->IsSharedLocked(rid)) {
-      if (!lock_manager->LockUpgrade(txn, rid)) {
+  if (IsLogged(txn)) {
+    // Acquire an exclusive lock, upgrading from shared if necessary, unless a lock on the table covers the row.
+    if (lock_manager != nullptr) {
+      if (txn->IsSharedLocked(rid)) {
+        if (!lock_manager->LockUpgrade(txn, rid)) {
+          return false;
+        }
+      } else if (!txn->IsExclusiveLocked(rid) && !lock_manager->LockExclusive(txn, rid)) {
         return false;
       }
-    } else if (!txn->IsExclusiveLocked(rid) && !lock_manager->LockExclusive(txn, rid)) {
-      return false;
     }
-    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::UPDATE, rid, *old_tuple, new_tuple);
+    // Only the changed byte ranges are logged, see the DELTAUPDATE format in log_record.h.
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::DELTAUPDATE, rid, *old_tuple,
+                         new_tuple);
     lsn_t lsn = log_manager->AppendLogRecord(&log_record);
     SetLSN(lsn);
     txn->SetPrevLSN(lsn);
@@ -217,7 +225,7 @@ void TablePage::ApplyDelete(const RID &rid, Transaction *txn, LogManager *log_ma
   delete_tuple.rid_ = rid;
   delete_tuple.allocated_ = true;
 
-  if (enable_logging) {
+  if (IsLogged(txn)) {
     BUSTUB_ASSERT(txn->IsExclusiveLocked(rid), "We must own the exclusive lock!");
 
     LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::APPLYDELETE, rid, delete_tuple);
@@ -246,7 +254,7 @@ void TablePage::ApplyDelete(const RID &rid, Transaction *txn, LogManager *log_ma
 
 void TablePage::RollbackDelete(const RID &rid, Transaction *txn, LogManager *log_manager) {
   // Log the rollback.
-  if (enable_logging) {
+  if (IsLogged(txn)) {
     BUSTUB_ASSERT(txn->IsExclusiveLocked(rid), "We must own an exclusive lock on the RID.");
     Tuple dummy_tuple;
     LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::ROLLBACKDELETE, rid, dummy_tuple);
@@ -270,7 +278,7 @@ bool TablePage::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, LockMan
   uint32_t slot_num = rid.GetSlotNum();
   // If somehow we have more slots than tuples, abort the transaction.
   if (slot_num >= GetTupleCount()) {
-    if (enable_logging) {
+    if (IsLogged(txn)) {
       txn->SetState(TransactionState::ABORTED);
     }
     return false;
@@ -279,21 +287,42 @@ bool TablePage::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, LockMan
   uint32_t tuple_size = GetTupleSize(slot_num);
   // If the tuple is deleted, abort the transaction.
   if (IsDeleted(tuple_size)) {
-    if (enable_logging) {
+    if (IsLogged(txn)) {
       txn->SetState(TransactionState::ABORTED);
     }
     return false;
   }
 
   // Otherwise we have a valid tuple, try to acquire at least a shared lock.
-  if (enable_logging) {
+  if (IsLogged(txn) && lock_manager != nullptr) {
     if (!txn->IsSharedLocked(rid) && !txn->IsExclusiveLocked(rid) && !lock_manager->LockShared(txn, rid)) {
       return false;
     }
   }
 
   // At this point, we have at least a shared lock on the RID. Copy the tuple data into our result.
-  uint32_t tuple_offset = GetTupleOffsetAtSlot(slot_num);
+  CopyTuple(rid, tuple_size, tuple);
+  return true;
+}
+
+bool TablePage::HasTuple(const RID &rid) {
+  uint32_t slot_num = rid.GetSlotNum();
+  return slot_num < GetTupleCount() && !IsDeleted(GetTupleSize(slot_num));
+}
+
+bool TablePage::ReadTuple(const RID &rid, Tuple *tuple, bool *deleted) {
+  uint32_t slot_num = rid.GetSlotNum();
+  if (slot_num >= GetTupleCount() || GetTupleSize(slot_num) == 0) {
+    return false;
+  }
+  uint32_t tuple_size = GetTupleSize(slot_num);
+  *deleted = IsDeleted(tuple_size);
+  CopyTuple(rid, UnsetDeletedFlag(tuple_size), tuple);
+  return true;
+}
+
+void TablePage::CopyTuple(const RID &rid, uint32_t tuple_size, Tuple *tuple) {
+  uint32_t tuple_offset = GetTupleOffsetAtSlot(rid.GetSlotNum());
   tuple->size_ = tuple_size;
   if (tuple->allocated_) {
     delete[] tuple->data_;
@@ -302,13 +331,12 @@ bool TablePage::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, LockMan
   memcpy(tuple->data_, GetData() + tuple_offset, tuple->size_);
   tuple->rid_ = rid;
   tuple->allocated_ = true;
-  return true;
 }
 
-bool TablePage::GetFirstTupleRid(RID *first_rid) {
+bool TablePage::GetFirstTupleRid(RID *first_rid, bool every_slot) {
   // Find and return the first valid tuple.
   for (uint32_t i = 0; i < GetTupleCount(); ++i) {
-    if (!IsDeleted(GetTupleSize(i))) {
+    if (every_slot || !IsDeleted(GetTupleSize(i))) {
       first_rid->Set(GetTablePageId(), i);
       return true;
     }
@@ -317,11 +345,11 @@ bool TablePage::GetFirstTupleRid(RID *first_rid) {
   return false;
 }
 
-bool TablePage::GetNextTupleRid(const RID &cur_rid, RID *next_rid) {
+bool TablePage::GetNextTupleRid(const RID &cur_rid, RID *next_rid, bool every_slot) {
   BUSTUB_ASSERT(cur_rid.GetPageId() == GetTablePageId(), "Wrong table!");
   // Find and return the first valid tuple after our current slot number.
   for (auto i = cur_rid.GetSlotNum() + 1; i < GetTupleCount(); ++i) {
-    if (!IsDeleted(GetTupleSize(i))) {
+    if (every_slot || !IsDeleted(GetTupleSize(i))) {
       next_rid->Set(GetTablePageId(), i);
       return true;
     }
@@ -330,4 +358,16 @@ bool TablePage::GetNextTupleRid(const RID &cur_rid, RID *next_rid) {
   next_rid->Set(INVALID_PAGE_ID, 0);
   return false;
 }
+
+uint32_t TablePage::ReclaimSlots(const std::function<bool(const RID &)> &can_reclaim) {
+  uint32_t tuple_count = GetTupleCount();
+  uint32_t slot_count = tuple_count;
+  while (slot_count > 0 && GetTupleSize(slot_count - 1) == 0 &&
+         (can_reclaim == nullptr || can_reclaim(RID(GetTablePageId(), slot_count - 1)))) {
+    slot_count--;
+  }
+  SetTupleCount(slot_count);
+  return tuple_count - slot_count;
+}
+
 }  // namespace bustub
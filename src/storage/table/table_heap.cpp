@@ -10,23 +10,31 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
 #include <cassert>
+#include <limits>
+#include <vector>
 
 #include "common/logger.h"
+#include "concurrency/transaction_manager.h"
 #include "storage/table/table_heap.h"
 
 namespace bustub {
 
 TableHeap::TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_manager, LogManager *log_manager,
-                     page_id_t first_page_id)
+                     page_id_t first_page_id, table_oid_t table_oid)
     : buffer_pool_manager_(buffer_pool_manager),
       lock_manager_(lock_manager),
       log_manager_(log_manager),
-      first_page_id_(first_page_id) {}
+      first_page_id_(first_page_id),
+      table_oid_(table_oid) {}
 
 TableHeap::TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_manager, LogManager *log_manager,
-                     Transaction *txn)
-    : buffer_pool_manager_(buffer_pool_manager), lock_manager_(lock_manager), log_manager_(log_manager) {
+                     Transaction *txn, table_oid_t table_oid)
+    : buffer_pool_manager_(buffer_pool_manager),
+      lock_manager_(lock_manager),
+      log_manager_(log_manager),
+      table_oid_(table_oid) {
   // Initialize the first table page.
   auto first_page = reinterpret_cast<TablePage *>(buffer_pool_manager_->NewPage(&first_page_id_));
   BUSTUB_ASSERT(first_page != nullptr, "Couldn't create a page for the table heap.");
@@ -36,12 +44,26 @@ TableHeap::TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_m
   buffer_pool_manager_->UnpinPage(first_page_id_, true);
 }
 
+TableHeap::~TableHeap() {
+  TransactionManager *garbage_owner = garbage_owner_;
+  if (garbage_owner != nullptr) {
+    garbage_owner->UnregisterTable(this);
+  }
+}
+
 bool TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) {
   if (tuple.size_ + 32 > PAGE_SIZE) {  // larger than one page size
     txn->SetState(TransactionState::ABORTED);
     return false;
   }
 
+  if (BuffersWrites(txn)) {
+    // the row gets its rid once the insert is installed
+    *rid = RID();
+    txn->GetWriteSet()->emplace_back(*rid, WType::INSERT, tuple, this);
+    return true;
+  }
+  LockManager *lock_manager = GetRowLockManager(txn, true);
   auto cur_page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(first_page_id_));
   if (cur_page == nullptr) {
     txn->SetState(TransactionState::ABORTED);
@@ -51,7 +73,7 @@ bool TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) {
   cur_page->WLatch();
   // Insert into the first page with enough space. If no such page exists, create a new page and insert into that.
   // INVARIANT: cur_page is WLatched if you leave the loop normally.
-  while (!cur_page->InsertTuple(tuple, rid, txn, lock_manager_, log_manager_)) {
+  while (!cur_page->InsertTuple(tuple, rid, txn, lock_manager, log_manager_)) {
     auto next_page_id = cur_page->GetNextPageId();
     // If the next page is a valid page,
     if (next_page_id != INVALID_PAGE_ID) {
@@ -81,10 +103,12 @@ bool TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) {
       cur_page = new_page;
     }
   }
+  version_store_.PushVersion(*rid, nullptr, txn->GetTransactionId());
   // This line has caused most of us to double-take and "whoa double unlatch".
   // We are not, in fact, double unlatching. See the invariant above.
   cur_page->WUnlatch();
   buffer_pool_manager_->UnpinPage(cur_page->GetTablePageId(), true);
+  TrackRowLock(txn, *rid, false);
   // Update the transaction's write set.
   txn->GetWriteSet()->emplace_back(*rid, WType::INSERT, Tuple{}, this);
   return true;
@@ -92,6 +116,15 @@ bool TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) {
 
 bool TableHeap::MarkDelete(const RID &rid, Transaction *txn) {
   // TODO(Amadou): remove empty page
+  if (BuffersWrites(txn)) {
+    txn->GetWriteSet()->emplace_back(rid, WType::DELETE, Tuple{}, this);
+    return true;
+  }
+  LockManager *lock_manager = GetRowLockManager(txn, true);
+  bool locked = txn->IsSharedLocked(rid) || txn->IsExclusiveLocked(rid);
+  if (!LockRow(txn, rid, lock_manager, true)) {
+    return false;
+  }
   // Find the page which contains the tuple.
   auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
   // If the page could not be found, then abort the transaction.
@@ -99,17 +132,42 @@ bool TableHeap::MarkDelete(const RID &rid, Transaction *txn) {
     txn->SetState(TransactionState::ABORTED);
     return false;
   }
-  // Otherwise, mark the tuple as deleted.
   page->WLatch();
-  page->MarkDelete(rid, txn, lock_manager_, log_manager_);
+  // Snapshot isolation: the first writer wins, a row written since the snapshot aborts the transaction.
+  if (ReadsSnapshot(txn) &&
+      version_store_.HasWriteConflict(rid, txn->GetTransactionId(), txn->GetBeginTimestamp())) {
+    txn->SetState(TransactionState::ABORTED);
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetTablePageId(), false);
+    TrackRowLock(txn, rid, locked);
+    return false;
+  }
+  // Otherwise, mark the tuple as deleted.
+  if (page->MarkDelete(rid, txn, lock_manager, log_manager_)) {
+    // the tuple stays on the page until the delete commits, marked deleted
+    Tuple old_tuple;
+    bool deleted;
+    page->ReadTuple(rid, &old_tuple, &deleted);
+    version_store_.PushVersion(rid, &old_tuple, txn->GetTransactionId());
+  }
   page->WUnlatch();
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
+  TrackRowLock(txn, rid, locked);
   // Update the transaction's write set.
   txn->GetWriteSet()->emplace_back(rid, WType::DELETE, Tuple{}, this);
   return true;
 }
 
 bool TableHeap::UpdateTuple(const Tuple &tuple, const RID &rid, Transaction *txn) {
+  if (BuffersWrites(txn)) {
+    txn->GetWriteSet()->emplace_back(rid, WType::UPDATE, tuple, this);
+    return true;
+  }
+  LockManager *lock_manager = GetRowLockManager(txn, true);
+  bool locked = txn->IsSharedLocked(rid) || txn->IsExclusiveLocked(rid);
+  if (!LockRow(txn, rid, lock_manager, true)) {
+    return false;
+  }
   // Find the page which contains the tuple.
   auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
   // If the page could not be found, then abort the transaction.
@@ -119,10 +177,24 @@ bool TableHeap::UpdateTuple(const Tuple &tuple, const RID &rid, Transaction *txn
   }
   // Update the tuple; but first save the old value for rollbacks.
   Tuple old_tuple;
+  bool is_updated = false;
   page->WLatch();
-  bool is_updated = page->UpdateTuple(tuple, &old_tuple, rid, txn, lock_manager_, log_manager_);
+  // Snapshot isolation: the first writer wins, a row written since the snapshot aborts the transaction.
+  if (ReadsSnapshot(txn) &&
+      version_store_.HasWriteConflict(rid, txn->GetTransactionId(), txn->GetBeginTimestamp())) {
+    txn->SetState(TransactionState::ABORTED);
+  } else {
+    is_updated = page->UpdateTuple(tuple, &old_tuple, rid, txn, lock_manager, log_manager_);
+  }
+  // An aborted transaction updates to roll back, which drops the version its update kept.
+  if (is_updated && txn->GetState() == TransactionState::ABORTED) {
+    version_store_.PopVersion(rid, txn->GetTransactionId());
+  } else if (is_updated) {
+    version_store_.PushVersion(rid, &old_tuple, txn->GetTransactionId());
+  }
   page->WUnlatch();
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), is_updated);
+  TrackRowLock(txn, rid, locked);
   // Update the transaction's write set.
   if (is_updated && txn->GetState() != TransactionState::ABORTED) {
     txn->GetWriteSet()->emplace_back(rid, WType::UPDATE, old_tuple, this);
@@ -137,7 +209,10 @@ void TableHeap::ApplyDelete(const RID &rid, Transaction *txn) {
   // Delete the tuple from the page.
   page->WLatch();
   page->ApplyDelete(rid, txn, log_manager_);
-  lock_manager_->Unlock(txn, rid);
+  // an aborted transaction rolls back an insert
+  if (txn->GetState() == TransactionState::ABORTED) {
+    version_store_.PopVersion(rid, txn->GetTransactionId());
+  }
   page->WUnlatch();
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
 }
@@ -149,11 +224,64 @@ void TableHeap::RollbackDelete(const RID &rid, Transaction *txn) {
   // Rollback the delete.
   page->WLatch();
   page->RollbackDelete(rid, txn, log_manager_);
+  version_store_.PopVersion(rid, txn->GetTransactionId());
   page->WUnlatch();
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
 }
 
-bool TableHeap::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn) {
+void TableHeap::CommitVersions(const RID &rid, Transaction *txn) {
+  version_store_.CommitVersions(rid, txn->GetTransactionId(), txn->GetCommitTimestamp());
+}
+
+size_t TableHeap::CollectGarbage(timestamp_t oldest_ts, size_t max_rows) {
+  std::vector<RID> pruned;
+  size_t rows = version_store_.Prune(oldest_ts, max_rows, &pruned);
+  std::vector<page_id_t> page_ids;
+  for (const auto &rid : pruned) {
+    page_ids.push_back(rid.GetPageId());
+  }
+  std::sort(page_ids.begin(), page_ids.end());
+  page_ids.erase(std::unique(page_ids.begin(), page_ids.end()), page_ids.end());
+  for (auto page_id : page_ids) {
+    auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(page_id));
+    if (page == nullptr) {
+      continue;
+    }
+    // A slot with versions stays, a snapshot scan may still find the row there. Inserts record a version under the
+    // write latch, so the check cannot miss one.
+    page->WLatch();
+    uint32_t reclaimed = page->ReclaimSlots([this](const RID &rid) { return !version_store_.HasVersions(rid); });
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(page_id, reclaimed > 0);
+  }
+  return rows;
+}
+
+void TableHeap::PruneVersions(const RID &rid, timestamp_t oldest_ts, bool deleted) {
+  if (!version_store_.PruneRow(rid, oldest_ts) || !deleted) {
+    return;
+  }
+  auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
+  if (page == nullptr) {
+    return;
+  }
+  page->WLatch();
+  uint32_t reclaimed = page->ReclaimSlots([this](const RID &slot) { return !version_store_.HasVersions(slot); });
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(rid.GetPageId(), reclaimed > 0);
+}
+
+bool TableHeap::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn) { return GetTuple(rid, tuple, txn, false); }
+
+bool TableHeap::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, bool skip_missing) {
+  if (ReadsVersions(txn)) {
+    return GetVersionedTuple(rid, tuple, txn);
+  }
+  LockManager *lock_manager = GetRowLockManager(txn, false);
+  bool locked = txn->IsSharedLocked(rid) || txn->IsExclusiveLocked(rid);
+  if (!LockRow(txn, rid, lock_manager, false)) {
+    return false;
+  }
   // Find the page which contains the tuple.
   auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
   // If the page could not be found, then abort the transaction.
@@ -163,12 +291,115 @@ bool TableHeap::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn) {
   }
   // Read the tuple from the page.
   page->RLatch();
-  bool res = page->GetTuple(rid, tuple, txn, lock_manager_);
+  bool res = (!skip_missing || page->HasTuple(rid)) && page->GetTuple(rid, tuple, txn, lock_manager);
+  // READ_COMMITTED only holds the shared lock for the duration of the read.
+  if (enable_logging && lock_manager != nullptr && !locked && txn->IsSharedLocked(rid) &&
+      txn->GetIsolationLevel() == IsolationLevel::READ_COMMITTED) {
+    lock_manager->Unlock(txn, rid);
+  }
   page->RUnlatch();
   buffer_pool_manager_->UnpinPage(rid.GetPageId(), false);
+  TrackRowLock(txn, rid, locked);
   return res;
 }
 
+bool TableHeap::GetVersionedTuple(const RID &rid, Tuple *tuple, Transaction *txn) {
+  bool optimistic = !ReadsSnapshot(txn);
+  if (optimistic) {
+    // the newest buffered write of the transaction to the row is what it reads
+    auto write_set = txn->GetWriteSet();
+    for (auto write = write_set->rbegin(); write != write_set->rend(); write++) {
+      if (write->table_ == this && write->rid_ == rid) {
+        if (write->wtype_ == WType::DELETE) {
+          return false;
+        }
+        *tuple = write->tuple_;
+        tuple->rid_ = write->rid_;
+        return true;
+      }
+    }
+  }
+  auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
+  if (page == nullptr) {
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
+  page->RLatch();
+  bool deleted = false;
+  bool res = page->ReadTuple(rid, tuple, &deleted) && !deleted;
+  Tuple version;
+  bool exists;
+  // an optimistic transaction sees every commit so far
+  timestamp_t begin_ts = optimistic ? std::numeric_limits<timestamp_t>::max() : txn->GetBeginTimestamp();
+  timestamp_t write_ts;
+  if (version_store_.GetVisibleVersion(rid, txn->GetTransactionId(), begin_ts, &version, &exists, &write_ts)) {
+    res = exists;
+    if (exists) {
+      *tuple = version;
+    }
+  }
+  page->RUnlatch();
+  buffer_pool_manager_->UnpinPage(rid.GetPageId(), false);
+  if (optimistic) {
+    txn->GetReadSet()->emplace_back(rid, write_ts, this);
+  }
+  return res;
+}
+
+LockManager *TableHeap::GetRowLockManager(Transaction *txn, bool exclusive) {
+  // dirty reads and snapshot reads take no locks at all
+  if (!exclusive && (txn->GetIsolationLevel() == IsolationLevel::READ_UNCOMMITTED || ReadsVersions(txn))) {
+    return nullptr;
+  }
+  if (!enable_logging || table_oid_ == INVALID_TABLE_OID) {
+    return lock_manager_;
+  }
+  LockMode held;
+  if (txn->GetTableLockMode(table_oid_, &held) &&
+      LockManager::Covers(held, exclusive ? LockMode::EXCLUSIVE : LockMode::SHARED)) {
+    return nullptr;
+  }
+  size_t threshold = lock_manager_->GetEscalationThreshold();
+  auto rows = txn->GetTableRowLockSet()->find(table_oid_);
+  if (threshold > 0 && rows != txn->GetTableRowLockSet()->end() && rows->second.size() >= threshold) {
+    return lock_manager_->EscalateLocks(txn, table_oid_, exclusive) ? nullptr : lock_manager_;
+  }
+  // an aborted transaction gets no lock here, and then none on the row either
+  lock_manager_->LockTable(txn, table_oid_, exclusive ? LockMode::INTENTION_EXCLUSIVE : LockMode::INTENTION_SHARED);
+  return lock_manager_;
+}
+
+bool TableHeap::LockRow(Transaction *txn, const RID &rid, LockManager *lock_manager, bool exclusive) {
+  // an aborted transaction writes to roll back, under the locks it holds
+  if (!enable_logging || lock_manager == nullptr || txn->IsExclusiveLocked(rid) ||
+      txn->GetState() == TransactionState::ABORTED) {
+    return true;
+  }
+  if (!exclusive) {
+    return txn->IsSharedLocked(rid) || lock_manager->LockShared(txn, rid);
+  }
+  return txn->IsSharedLocked(rid) ? lock_manager->LockUpgrade(txn, rid) : lock_manager->LockExclusive(txn, rid);
+}
+
+bool TableHeap::LockForWrite(const RID &rid, Transaction *txn) {
+  LockManager *lock_manager = GetRowLockManager(txn, true);
+  bool locked = txn->IsSharedLocked(rid) || txn->IsExclusiveLocked(rid);
+  bool granted = LockRow(txn, rid, lock_manager, true);
+  TrackRowLock(txn, rid, locked);
+  return granted;
+}
+
+bool TableHeap::ValidateRead(const RID &rid, timestamp_t version, Transaction *txn) {
+  return !version_store_.HasChangedSince(rid, txn->GetTransactionId(), version);
+}
+
+void TableHeap::TrackRowLock(Transaction *txn, const RID &rid, bool was_locked) {
+  if (enable_logging && table_oid_ != INVALID_TABLE_OID && !was_locked &&
+      (txn->IsSharedLocked(rid) || txn->IsExclusiveLocked(rid))) {
+    (*txn->GetTableRowLockSet())[table_oid_].push_back(rid);
+  }
+}
+
 TableIterator TableHeap::Begin(Transaction *txn) {
   // Start an iterator from the first page.
   // TODO(Wuwen): Hacky fix for now. Removing empty pages is a better way to handle this.
@@ -178,7 +409,7 @@ TableIterator TableHeap::Begin(Transaction *txn) {
     auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(page_id));
     page->RLatch();
     // If this fails because there is no tuple, then RID will be the default-constructed value, which means EOF.
-    auto found_tuple = page->GetFirstTupleRid(&rid);
+    auto found_tuple = page->GetFirstTupleRid(&rid, ReadsVersions(txn));
     page->RUnlatch();
     buffer_pool_manager_->UnpinPage(page_id, false);
     if (found_tuple) {
@@ -18,8 +18,9 @@ namespace bustub {
 
 TableIterator::TableIterator(TableHeap *table_heap, RID rid, Transaction *txn)
     : table_heap_(table_heap), tuple_(new Tuple(rid)), txn_(txn) {
-  if (rid.GetPageId() != INVALID_PAGE_ID) {
-    table_heap_->GetTuple(tuple_->rid_, tuple_, txn_);
+  // a snapshot starts at the first slot, which may hold no tuple it sees, and the first tuple may be gone already
+  if (rid.GetPageId() != INVALID_PAGE_ID && !table_heap_->ScanTuple(tuple_->rid_, tuple_, txn_)) {
+    ++(*this);
   }
 }
 
@@ -35,32 +36,36 @@ Tuple *TableIterator::operator->() {
 
 TableIterator &TableIterator::operator++() {
   BufferPoolManager *buffer_pool_manager = table_heap_->buffer_pool_manager_;
-  auto cur_page = static_cast<TablePage *>(buffer_pool_manager->FetchPage(tuple_->rid_.GetPageId()));
-  cur_page->RLatch();
-  assert(cur_page != nullptr);  // all pages are pinned
+  // A snapshot sees the tuples deleted after it was taken and not those inserted after it, so it has to look at every
+  // slot.
+  bool every_slot = TableHeap::ReadsVersions(txn_);
+  bool found = false;
+  while (!found) {
+    auto cur_page = static_cast<TablePage *>(buffer_pool_manager->FetchPage(tuple_->rid_.GetPageId()));
+    cur_page->RLatch();
+    assert(cur_page != nullptr);  // all pages are pinned
 
-  RID next_tuple_rid;
-  if (!cur_page->GetNextTupleRid(tuple_->rid_,
-                                 &next_tuple_rid)) {  // end of this page
-    while (cur_page->GetNextPageId() != INVALID_PAGE_ID) {
-      auto next_page = static_cast<TablePage *>(buffer_pool_manager->FetchPage(cur_page->GetNextPageId()));
-      cur_page->RUnlatch();
-      buffer_pool_manager->UnpinPage(cur_page->GetTablePageId(), false);
-      cur_page = next_page;
-      cur_page->RLatch();
-      if (cur_page->GetFirstTupleRid(&next_tuple_rid)) {
-        break;
+    RID next_tuple_rid;
+    if (!cur_page->GetNextTupleRid(tuple_->rid_, &next_tuple_rid, every_slot)) {  // end of this page
+      while (cur_page->GetNextPageId() != INVALID_PAGE_ID) {
+        auto next_page = static_cast<TablePage *>(buffer_pool_manager->FetchPage(cur_page->GetNextPageId()));
+        cur_page->RUnlatch();
+        buffer_pool_manager->UnpinPage(cur_page->GetTablePageId(), false);
+        cur_page = next_page;
+        cur_page->RLatch();
+        if (cur_page->GetFirstTupleRid(&next_tuple_rid, every_slot)) {
+          break;
+        }
       }
     }
-  }
-  tuple_->rid_ = next_tuple_rid;
+    tuple_->rid_ = next_tuple_rid;
+    // GetTuple may wait for a row lock, which must not happen under a latch
+    cur_page->RUnlatch();
+    buffer_pool_manager->UnpinPage(cur_page->GetTablePageId(), false);
 
-  if (*this != table_heap_->End()) {
-    table_heap_->GetTuple(tuple_->rid_, tuple_, txn_);
+    // a tuple deleted since the latch was released is skipped like one the snapshot does not see
+    found = *this == table_heap_->End() || table_heap_->ScanTuple(tuple_->rid_, tuple_, txn_);
   }
-  // release until copy the tuple
-  cur_page->RUnlatch();
-  buffer_pool_manager->UnpinPage(cur_page->GetTablePageId(), false);
   return *this;
 }
 
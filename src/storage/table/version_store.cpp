@@ -0,0 +1,161 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// version_store.cpp
+//
+// Identification: src/storage/table/version_store.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/table/version_store.h"
+
+#include <algorithm>
+
+namespace bustub {
+
+void VersionStore::PushVersion(const RID &rid, const Tuple *tuple, txn_id_t txn_id) {
+  std::lock_guard<std::mutex> guard(latch_);
+  versions_[rid].emplace_back(tuple, txn_id);
+  version_count_++;
+}
+
+void VersionStore::PopVersion(const RID &rid, txn_id_t txn_id) {
+  std::lock_guard<std::mutex> guard(latch_);
+  auto versions = versions_.find(rid);
+  if (versions == versions_.end() || versions->second.back().txn_id_ != txn_id) {
+    return;
+  }
+  versions->second.pop_back();
+  version_count_--;
+  if (versions->second.empty()) {
+    versions_.erase(versions);
+  }
+}
+
+void VersionStore::CommitVersions(const RID &rid, txn_id_t txn_id, timestamp_t commit_ts) {
+  std::lock_guard<std::mutex> guard(latch_);
+  auto versions = versions_.find(rid);
+  if (versions == versions_.end()) {
+    return;
+  }
+  // the writes of a transaction to a row are the newest ones, as it holds the row lock until now
+  for (auto version = versions->second.rbegin(); version != versions->second.rend(); version++) {
+    if (version->txn_id_ != txn_id) {
+      break;
+    }
+    version->commit_ts_ = commit_ts;
+  }
+  // commits are stamped one at a time, so the queue stays in commit order
+  committed_.emplace_back(commit_ts, rid);
+}
+
+bool VersionStore::HasWriteConflict(const RID &rid, txn_id_t txn_id, timestamp_t begin_ts) {
+  std::lock_guard<std::mutex> guard(latch_);
+  auto versions = versions_.find(rid);
+  return versions != versions_.end() && !IsVisible(versions->second.back(), txn_id, begin_ts);
+}
+
+bool VersionStore::GetVisibleVersion(const RID &rid, txn_id_t txn_id, timestamp_t begin_ts, Tuple *tuple,
+                                     bool *exists, timestamp_t *write_ts) {
+  std::lock_guard<std::mutex> guard(latch_);
+  if (write_ts != nullptr) {
+    *write_ts = 0;
+  }
+  auto versions = versions_.find(rid);
+  if (versions == versions_.end()) {
+    return false;
+  }
+  // Undo the writes the snapshot does not see, the version before the oldest of them is the one it sees.
+  auto &row_versions = versions->second;
+  auto version = row_versions.rbegin();
+  while (version != row_versions.rend() && !IsVisible(*version, txn_id, begin_ts)) {
+    version++;
+  }
+  if (write_ts != nullptr && version != row_versions.rend()) {
+    *write_ts = std::max<timestamp_t>(version->commit_ts_, 0);
+  }
+  if (version == row_versions.rbegin()) {
+    return false;
+  }
+  version--;
+  *exists = version->exists_;
+  if (*exists) {
+    *tuple = version->tuple_;
+  }
+  return true;
+}
+
+bool VersionStore::HasChangedSince(const RID &rid, txn_id_t txn_id, timestamp_t write_ts) {
+  std::lock_guard<std::mutex> guard(latch_);
+  auto versions = versions_.find(rid);
+  if (versions == versions_.end()) {
+    return false;
+  }
+  for (auto version = versions->second.rbegin(); version != versions->second.rend(); version++) {
+    if (version->commit_ts_ != INVALID_TIMESTAMP) {
+      return version->commit_ts_ > write_ts;
+    }
+    if (version->txn_id_ != txn_id) {
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t VersionStore::Prune(timestamp_t oldest_ts, size_t max_rows, std::vector<RID> *pruned) {
+  std::lock_guard<std::mutex> guard(latch_);
+  size_t rows = 0;
+  while (rows < max_rows && !committed_.empty() && committed_.front().first <= oldest_ts) {
+    RID rid = committed_.front().second;
+    committed_.pop_front();
+    rows++;
+    auto versions = versions_.find(rid);
+    if (versions != versions_.end() && DropVisibleVersions(versions, oldest_ts)) {
+      pruned->push_back(rid);
+    }
+  }
+  return rows;
+}
+
+bool VersionStore::PruneRow(const RID &rid, timestamp_t oldest_ts) {
+  std::lock_guard<std::mutex> guard(latch_);
+  auto versions = versions_.find(rid);
+  return versions == versions_.end() || DropVisibleVersions(versions, oldest_ts);
+}
+
+bool VersionStore::DropVisibleVersions(std::unordered_map<RID, std::deque<TupleVersion>>::iterator versions,
+                                       timestamp_t oldest_ts) {
+  // A snapshot reads the version replaced by the oldest write it does not see. Writes every snapshot sees are never
+  // undone, and the versions they replaced can go. Those writes are the oldest ones of the row.
+  auto &row_versions = versions->second;
+  while (!row_versions.empty() && row_versions.front().commit_ts_ != INVALID_TIMESTAMP &&
+         row_versions.front().commit_ts_ <= oldest_ts) {
+    row_versions.pop_front();
+    version_count_--;
+  }
+  if (!row_versions.empty()) {
+    return false;
+  }
+  versions_.erase(versions);
+  return true;
+}
+
+bool VersionStore::HasVersions(const RID &rid) {
+  std::lock_guard<std::mutex> guard(latch_);
+  return versions_.find(rid) != versions_.end();
+}
+
+bool VersionStore::HasCommittedVersions() {
+  std::lock_guard<std::mutex> guard(latch_);
+  return !committed_.empty();
+}
+
+size_t VersionStore::GetVersionCount() {
+  std::lock_guard<std::mutex> guard(latch_);
+  return version_count_;
+}
+
+}  // namespace bustub
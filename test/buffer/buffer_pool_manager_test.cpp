@@ -11,11 +11,15 @@
 //===----------------------------------------------------------------------===//
 
 #include "buffer/buffer_pool_manager.h"
+#include <chrono>  // NOLINT
 #include <cstdio>
+#include <filesystem>
 #include <random>
 #include <string>
+#include <thread>  // NOLINT
 #include "gtest/gtest.h"
 #include "include/common/logger.h"
+#include "recovery/log_manager.h"
 
 namespace bustub {
 
@@ -140,4 +144,81 @@ TEST(BufferPoolManagerTest, SampleTest) {
   delete disk_manager;
 }
 
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerTest, WALEvictionTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 3;
+  const char marker[] = "written";
+  auto original_timeout = log_timeout;
+  // Only the buffer pool asks for the log to be flushed.
+  log_timeout = std::chrono::seconds(100);
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *log_manager = new LogManager(disk_manager);
+  auto *bpm = new BufferPoolManager(buffer_pool_size, disk_manager, log_manager);
+  log_manager->RunFlushThread();
+
+  page_id_t page_ids[buffer_pool_size];
+  for (auto &page_id : page_ids) {
+    Page *page = bpm->NewPage(&page_id);
+    ASSERT_NE(nullptr, page);
+    std::memcpy(page->GetData() + 100, marker, sizeof(marker));
+  }
+  LogRecord flushed(0, INVALID_LSN, LogRecordType::BEGIN);
+  lsn_t flushed_lsn = log_manager->AppendLogRecord(&flushed);
+  log_manager->Flush(flushed_lsn);
+  LogRecord buffered(0, flushed_lsn, LogRecordType::COMMIT);
+  lsn_t buffered_lsn = log_manager->AppendLogRecord(&buffered);
+
+  // Scenario: the least recently used pages are ahead of the log, the most recently used one is not. Eviction picks
+  // the latter rather than waiting for the log.
+  bpm->FetchPage(page_ids[0])->SetLSN(buffered_lsn);
+  bpm->FetchPage(page_ids[1])->SetLSN(buffered_lsn);
+  bpm->FetchPage(page_ids[2])->SetLSN(flushed_lsn);
+  for (auto page_id : page_ids) {
+    EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+    EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+  }
+  page_id_t new_page_id;
+  Page *new_page = bpm->NewPage(&new_page_id);
+  ASSERT_NE(nullptr, new_page);
+  EXPECT_EQ(0U, bpm->GetEvictionLogWaits());
+  char buf[PAGE_SIZE] = {0};
+  disk_manager->ReadPage(page_ids[2], buf);
+  EXPECT_EQ(0, std::memcmp(buf + 100, marker, sizeof(marker)));
+
+  // Scenario: the skipped pages made the log flush in the background.
+  auto start = std::chrono::steady_clock::now();
+  while (log_manager->GetPersistentLSN() < buffered_lsn) {
+    ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(10));
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  // Scenario: every unpinned page is ahead of the log, so eviction has to wait for it.
+  LogRecord last(0, buffered_lsn, LogRecordType::COMMIT);
+  lsn_t last_lsn = log_manager->AppendLogRecord(&last);
+  new_page->SetLSN(last_lsn);
+  EXPECT_TRUE(bpm->UnpinPage(new_page_id, true));
+  for (int i = 0; i < 2; i++) {
+    bpm->FetchPage(page_ids[i])->SetLSN(last_lsn);
+    EXPECT_TRUE(bpm->UnpinPage(page_ids[i], true));
+  }
+  ASSERT_NE(nullptr, bpm->NewPage(&new_page_id));
+  EXPECT_EQ(1U, bpm->GetEvictionLogWaits());
+  EXPECT_GE(log_manager->GetPersistentLSN(), last_lsn);
+
+  log_manager->StopFlushThread();
+  disk_manager->ShutDown();
+  delete bpm;
+  delete log_manager;
+  delete disk_manager;
+  remove("test.db");
+  for (const auto &entry : std::filesystem::directory_iterator(".")) {
+    if (entry.path().filename().string().compare(0, 9, "test.log.") == 0) {
+      std::filesystem::remove(entry.path());
+    }
+  }
+  log_timeout = original_timeout;
+}
+
 }  // namespace bustub
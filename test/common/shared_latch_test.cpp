@@ -0,0 +1,139 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// shared_latch_test.cpp
+//
+// Identification: test/common/shared_latch_test.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <iostream>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "common/rwlatch.h"
+#include "common/shared_latch.h"
+#include "gtest/gtest.h"
+
+namespace bustub {
+
+// NOLINTNEXTLINE
+TEST(SharedLatchTest, BasicTest) {
+  const int num_threads = 16;
+  const int num_ops = 10000;
+  SharedLatch latch;
+  // written under the write latch in two halves, a reader must never see them apart
+  int64_t first = 0;
+  int64_t second = 0;
+  std::atomic<int> torn_reads{0};
+  std::vector<std::thread> threads;
+  for (int tid = 0; tid < num_threads; tid++) {
+    threads.emplace_back([&, tid] {
+      for (int i = 0; i < num_ops; i++) {
+        if ((tid + i) % 4 == 0) {
+          latch.WLock();
+          first++;
+          second++;
+          latch.WUnlock();
+        } else {
+          latch.RLock();
+          if (first != second) {
+            torn_reads++;
+          }
+          latch.RUnlock();
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(0, torn_reads);
+  EXPECT_EQ(num_threads * num_ops / 4, first);
+}
+
+// NOLINTNEXTLINE
+TEST(SharedLatchTest, WriterPreferenceTest) {
+  enable_latch_stats = true;
+  SharedLatch latch;
+  latch.RLock();
+  std::atomic<bool> written{false};
+  std::thread writer([&] {
+    latch.WLock();
+    written = true;
+    latch.WUnlock();
+  });
+  // the writer waits for the reader, and a new reader waits behind the writer
+  while (latch.GetParkCount() == 0) {
+    std::this_thread::yield();
+  }
+  std::thread reader([&] {
+    latch.RLock();
+    EXPECT_TRUE(written);
+    latch.RUnlock();
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(written);
+  latch.RUnlock();
+  writer.join();
+  reader.join();
+  EXPECT_TRUE(written);
+  EXPECT_EQ(2, latch.GetContentionCount());
+  enable_latch_stats = false;
+}
+
+template <typename Latch>
+double LatchThroughput(int num_threads, int write_percent, std::chrono::milliseconds duration) {
+  Latch latch;
+  int64_t value = 0;
+  std::atomic<bool> stop{false};
+  std::atomic<int64_t> ops{0};
+  std::vector<std::thread> threads;
+  for (int tid = 0; tid < num_threads; tid++) {
+    threads.emplace_back([&, tid] {
+      int64_t local_ops = 0;
+      uint32_t seed = tid + 1;
+      int64_t sum = 0;
+      while (!stop) {
+        seed = seed * 1103515245 + 12345;
+        if (static_cast<int>((seed >> 16) % 100) < write_percent) {
+          latch.WLock();
+          value++;
+          latch.WUnlock();
+        } else {
+          latch.RLock();
+          sum += value;
+          latch.RUnlock();
+        }
+        local_ops++;
+      }
+      ops += local_ops + (sum < 0 ? 1 : 0);
+    });
+  }
+  std::this_thread::sleep_for(duration);
+  stop = true;
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  return ops / std::chrono::duration<double>(duration).count();
+}
+
+// NOLINTNEXTLINE
+TEST(SharedLatchTest, DISABLED_SharedLatchBenchmark) {
+  const auto duration = std::chrono::milliseconds(500);
+  for (int write_percent : {0, 10}) {
+    for (int num_threads : {1, 2, 4, 8, 16, 32, 64}) {
+      double rw_latch = LatchThroughput<ReaderWriterLatch>(num_threads, write_percent, duration);
+      double shared_latch = LatchThroughput<SharedLatch>(num_threads, write_percent, duration);
+      std::cout << write_percent << "% writes, " << num_threads << " threads: ReaderWriterLatch " << rw_latch
+                << " ops/s, SharedLatch " << shared_latch << " ops/s" << std::endl;
+    }
+  }
+}
+
+}  // namespace bustub
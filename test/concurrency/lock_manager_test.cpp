@@ -2,13 +2,24 @@
  * lock_manager_test.cpp
  */
 
+#include <malloc.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <filesystem>
+#include <iostream>
 #include <random>
 #include <thread>  // NOLINT
+#include <vector>
 
 #include "common/config.h"
 #include "concurrency/lock_manager.h"
 #include "concurrency/transaction_manager.h"
 #include "gtest/gtest.h"
+#include "storage/index/b_plus_tree_index.h"
+#include "storage/table/table_heap.h"
+#include "type/value_factory.h"
 
 namespace bustub {
 
@@ -77,7 +88,7 @@ void BasicTest1() {
     delete txns[i];
   }
 }
-TEST(LockManagerTest, DISABLED_BasicTest) { BasicTest1(); }
+TEST(LockManagerTest, BasicTest) { BasicTest1(); }
 
 void TwoPLTest() {
   LockManager lock_mgr{};
@@ -123,7 +134,7 @@ void TwoPLTest() {
 
   delete txn;
 }
-TEST(LockManagerTest, DISABLED_TwoPLTest) { TwoPLTest(); }
+TEST(LockManagerTest, TwoPLTest) { TwoPLTest(); }
 
 void UpgradeTest() {
   LockManager lock_mgr{};
@@ -150,9 +161,632 @@ void UpgradeTest() {
   txn_mgr.Commit(&txn);
   CheckCommitted(&txn);
 }
-TEST(LockManagerTest, DISABLED_UpgradeLockTest) { UpgradeTest(); }
+TEST(LockManagerTest, UpgradeLockTest) { UpgradeTest(); }
+
+TEST(LockManagerTest, SharedThenExclusiveTest) {
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  RID rid{0, 0};
+
+  // Asking for an exclusive lock on a row we read upgrades the shared lock, commit has to leave nothing behind.
+  auto *txn = txn_mgr.Begin();
+  EXPECT_TRUE(lock_mgr.LockShared(txn, rid));
+  EXPECT_TRUE(lock_mgr.LockExclusive(txn, rid));
+  CheckTxnLockSize(txn, 0, 1);
+  txn_mgr.Commit(txn);
+
+  auto *other = txn_mgr.Begin();
+  EXPECT_TRUE(lock_mgr.LockExclusive(other, rid));
+  txn_mgr.Commit(other);
+
+  delete txn;
+  delete other;
+}
+
+TEST(LockManagerTest, IsolationLevelTest) {
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  RID rid{0, 0};
+
+  // READ_UNCOMMITTED reads without locks, asking for a shared lock aborts.
+  auto *dirty_reader = txn_mgr.Begin(nullptr, IsolationLevel::READ_UNCOMMITTED);
+  EXPECT_THROW(lock_mgr.LockShared(dirty_reader, rid), TransactionAbortException);
+  CheckAborted(dirty_reader);
+  txn_mgr.Abort(dirty_reader);
+
+  // READ_COMMITTED may let go of a shared lock and take it again.
+  auto *reader = txn_mgr.Begin(nullptr, IsolationLevel::READ_COMMITTED);
+  EXPECT_TRUE(lock_mgr.LockShared(reader, rid));
+  EXPECT_TRUE(lock_mgr.Unlock(reader, rid));
+  CheckGrowing(reader);
+  EXPECT_TRUE(lock_mgr.LockShared(reader, rid));
+  CheckTxnLockSize(reader, 1, 0);
+
+  // A writer waits for the reader, and a later reader waits behind the writer.
+  auto *writer = txn_mgr.Begin();
+  auto *late_reader = txn_mgr.Begin();
+  std::atomic<int> step{0};
+  std::thread write([&] {
+    EXPECT_TRUE(lock_mgr.LockExclusive(writer, rid));
+    EXPECT_EQ(1, step++);
+    txn_mgr.Commit(writer);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  std::thread read([&] {
+    EXPECT_TRUE(lock_mgr.LockShared(late_reader, rid));
+    EXPECT_EQ(2, step++);
+    txn_mgr.Commit(late_reader);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(0, step++);
+  txn_mgr.Commit(reader);
+  write.join();
+  read.join();
+  EXPECT_EQ(3, step);
+
+  delete dirty_reader;
+  delete reader;
+  delete writer;
+  delete late_reader;
+}
+
+TEST(LockManagerTest, LockStatsTest) {
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  LockStats *stats = lock_mgr.GetStats();
+  RID hot_rid{0, 1};
+  RID cold_rid{0, 2};
+
+  // free locks are not profiled
+  auto *holder = txn_mgr.Begin();
+  EXPECT_TRUE(lock_mgr.LockShared(holder, hot_rid));
+  EXPECT_TRUE(lock_mgr.LockExclusive(holder, cold_rid));
+  EXPECT_EQ(0, stats->GetWaitCount(LockMode::SHARED));
+  EXPECT_EQ(0, stats->GetWaitCount(LockMode::EXCLUSIVE));
+
+  // a waiting request is timed and its row counted, an upgrade is counted
+  EXPECT_TRUE(lock_mgr.LockUpgrade(holder, hot_rid));
+  EXPECT_EQ(1, stats->GetUpgradeCount(false));
+  auto *waiter = txn_mgr.Begin();
+  std::thread wait([&] {
+    EXPECT_TRUE(lock_mgr.LockShared(waiter, hot_rid));
+    txn_mgr.Commit(waiter);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  txn_mgr.Commit(holder);
+  wait.join();
+  EXPECT_EQ(1, stats->GetWaitCount(LockMode::SHARED));
+  EXPECT_LE(std::chrono::microseconds(32768), stats->GetWaitPercentile(LockMode::SHARED, 50));
+  auto hot_rows = stats->GetHotRows();
+  ASSERT_EQ(1, hot_rows.size());
+  EXPECT_EQ(hot_rid, hot_rows[0].first);
+  EXPECT_EQ(1, hot_rows[0].second);
+
+  // aborts are counted by reason
+  auto *shrinking = txn_mgr.Begin();
+  EXPECT_TRUE(lock_mgr.LockShared(shrinking, cold_rid));
+  EXPECT_TRUE(lock_mgr.Unlock(shrinking, cold_rid));
+  EXPECT_THROW(lock_mgr.LockShared(shrinking, cold_rid), TransactionAbortException);
+  txn_mgr.Abort(shrinking);
+  EXPECT_EQ(1, stats->GetAbortCount(AbortReason::LOCK_ON_SHRINKING));
+  EXPECT_EQ(0, stats->GetAbortCount(AbortReason::DEADLOCK));
+  EXPECT_NE(std::string::npos, stats->ToString().find("hot rows: (0, 1) 1"));
+
+  stats->Reset();
+  EXPECT_EQ(0, stats->GetWaitCount(LockMode::SHARED));
+  EXPECT_EQ(0, stats->GetAbortCount(AbortReason::LOCK_ON_SHRINKING));
+  EXPECT_TRUE(stats->GetHotRows().empty());
+  delete holder;
+  delete waiter;
+  delete shrinking;
+}
+
+TEST(LockManagerTest, TableLockTest) {
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  table_oid_t oid = 0;
+  auto check_table_lock = [&](Transaction *txn, LockMode lock_mode) {
+    LockMode held;
+    EXPECT_TRUE(txn->GetTableLockMode(oid, &held));
+    EXPECT_EQ(lock_mode, held);
+  };
+
+  // Intention locks do not conflict with each other.
+  auto *reader = txn_mgr.Begin();
+  auto *writer = txn_mgr.Begin();
+  EXPECT_TRUE(lock_mgr.LockTable(reader, oid, LockMode::INTENTION_SHARED));
+  EXPECT_TRUE(lock_mgr.LockTable(writer, oid, LockMode::INTENTION_EXCLUSIVE));
+  // A weaker request is covered by the lock held already.
+  EXPECT_TRUE(lock_mgr.LockTable(writer, oid, LockMode::INTENTION_SHARED));
+  check_table_lock(writer, LockMode::INTENTION_EXCLUSIVE);
+
+  // A scan locking the whole table waits for the writer, but not for the reader.
+  auto *scanner = txn_mgr.Begin();
+  std::atomic<bool> scanning{false};
+  std::thread scan([&] {
+    EXPECT_TRUE(lock_mgr.LockTable(scanner, oid, LockMode::SHARED));
+    scanning = true;
+    // Updating some of the scanned rows needs SHARED_INTENTION_EXCLUSIVE, which the reader does not block.
+    EXPECT_TRUE(lock_mgr.LockTable(scanner, oid, LockMode::INTENTION_EXCLUSIVE));
+    check_table_lock(scanner, LockMode::SHARED_INTENTION_EXCLUSIVE);
+    txn_mgr.Commit(scanner);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(scanning);
+  txn_mgr.Commit(writer);
+  scan.join();
+  EXPECT_TRUE(scanning);
+  CheckTxnLockSize(scanner, 0, 0);
+  EXPECT_TRUE(scanner->GetTableLockSet()->empty());
+
+  // Upgrading to EXCLUSIVE waits for the reader to leave.
+  auto *owner = txn_mgr.Begin();
+  EXPECT_TRUE(lock_mgr.LockTable(owner, oid, LockMode::INTENTION_EXCLUSIVE));
+  std::thread upgrade([&] {
+    EXPECT_TRUE(lock_mgr.LockTable(owner, oid, LockMode::EXCLUSIVE));
+    check_table_lock(owner, LockMode::EXCLUSIVE);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  check_table_lock(reader, LockMode::INTENTION_SHARED);
+  EXPECT_TRUE(lock_mgr.UnlockTable(reader, oid));
+  CheckShrinking(reader);
+  upgrade.join();
+  txn_mgr.Commit(reader);
+  txn_mgr.Commit(owner);
+
+  // READ_UNCOMMITTED never takes read locks.
+  auto *dirty_reader = txn_mgr.Begin(nullptr, IsolationLevel::READ_UNCOMMITTED);
+  EXPECT_THROW(lock_mgr.LockTable(dirty_reader, oid, LockMode::INTENTION_SHARED), TransactionAbortException);
+  txn_mgr.Abort(dirty_reader);
+
+  delete reader;
+  delete writer;
+  delete scanner;
+  delete owner;
+  delete dirty_reader;
+}
+
+/** Components of a database with logging on, so that table heaps lock their rows. */
+class LockingDatabase {
+ public:
+  explicit LockingDatabase(size_t pool_size, DeadlockPolicy deadlock_policy = DeadlockPolicy::DETECTION) {
+    RemoveFiles();
+    disk_manager_ = new DiskManager("lock_escalation.db");
+    log_manager_ = new LogManager(disk_manager_);
+    bpm_ = new BufferPoolManager(pool_size, disk_manager_, log_manager_);
+    lock_manager_ = new LockManager(deadlock_policy);
+    txn_manager_ = new TransactionManager(lock_manager_, log_manager_);
+    log_manager_->RunFlushThread();
+  }
+
+  ~LockingDatabase() {
+    log_manager_->StopFlushThread();
+    delete txn_manager_;
+    delete lock_manager_;
+    delete bpm_;
+    delete log_manager_;
+    disk_manager_->ShutDown();
+    delete disk_manager_;
+    RemoveFiles();
+  }
+
+  static void RemoveFiles() {
+    for (const auto &entry : std::filesystem::directory_iterator(".")) {
+      if (entry.path().filename().string().compare(0, 16, "lock_escalation.") == 0) {
+        std::filesystem::remove(entry.path());
+      }
+    }
+  }
+
+  DiskManager *disk_manager_;
+  LogManager *log_manager_;
+  BufferPoolManager *bpm_;
+  LockManager *lock_manager_;
+  TransactionManager *txn_manager_;
+};
+
+TEST(LockManagerTest, LockEscalationTest) {
+  const size_t threshold = 10;
+  const int tuple_count = 50;
+  LockingDatabase db(64);
+  db.lock_manager_->SetEscalationThreshold(threshold);
+  Schema schema{std::vector<Column>{Column{"a", TypeId::INTEGER}}};
+  table_oid_t oid = 0;
+  LockMode held;
+
+  // The inserts take row locks under an intention lock until there are threshold of them.
+  auto *txn = db.txn_manager_->Begin();
+  TableHeap table(db.bpm_, db.lock_manager_, db.log_manager_, txn, oid);
+  std::vector<RID> rids(tuple_count);
+  for (int i = 0; i < tuple_count; i++) {
+    if (i == static_cast<int>(threshold)) {
+      CheckTxnLockSize(txn, 0, threshold);
+      EXPECT_TRUE(txn->GetTableLockMode(oid, &held));
+      EXPECT_EQ(LockMode::INTENTION_EXCLUSIVE, held);
+    }
+    ASSERT_TRUE(table.InsertTuple(Tuple({ValueFactory::GetIntegerValue(i)}, &schema), &rids[i], txn));
+  }
+  // Then they are traded for one exclusive table lock.
+  CheckTxnLockSize(txn, 0, 0);
+  EXPECT_TRUE(txn->GetTableLockMode(oid, &held));
+  EXPECT_EQ(LockMode::EXCLUSIVE, held);
+  EXPECT_TRUE(txn->GetTableRowLockSet()->empty());
+  db.txn_manager_->Commit(txn);
+  delete txn;
+
+  // A reader escalates to a shared table lock, which keeps writers out of the whole table.
+  auto *reader = db.txn_manager_->Begin();
+  Tuple tuple;
+  for (int i = 0; i < tuple_count; i++) {
+    ASSERT_TRUE(table.GetTuple(rids[i], &tuple, reader));
+  }
+  CheckTxnLockSize(reader, 0, 0);
+  EXPECT_TRUE(reader->GetTableLockMode(oid, &held));
+  EXPECT_EQ(LockMode::SHARED, held);
+
+  auto *writer = db.txn_manager_->Begin();
+  std::atomic<bool> written{false};
+  std::thread write([&] {
+    Tuple new_tuple({ValueFactory::GetIntegerValue(-1)}, &schema);
+    EXPECT_TRUE(table.UpdateTuple(new_tuple, rids[tuple_count - 1], writer));
+    written = true;
+    db.txn_manager_->Commit(writer);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(written);
+  db.txn_manager_->Commit(reader);
+  write.join();
+  EXPECT_TRUE(written);
+
+  delete reader;
+  delete writer;
+}
+
+TEST(LockManagerTest, KeyRangeLockTest) {
+  LockingDatabase db(64);
+  page_id_t header_page_id;
+  db.bpm_->NewPage(&header_page_id);
+  db.bpm_->UnpinPage(header_page_id, true);
+  Schema schema{std::vector<Column>{Column{"a", TypeId::BIGINT}}};
+  // the index owns its metadata
+  auto *metadata = new IndexMetadata("key_range_index", "key_range_table", &schema, {0});
+  BPlusTreeIndex<GenericKey<8>, RID, GenericComparator<8>> index(metadata, db.bpm_, db.lock_manager_);
+  auto key = [&](int64_t value) { return Tuple({ValueFactory::GetBigIntValue(value)}, index.GetKeySchema()); };
+  auto rid = [](int64_t value) { return RID(static_cast<page_id_t>(value), 0); };
+
+  auto *loader = db.txn_manager_->Begin();
+  for (int64_t value : {10, 20, 30, 40}) {
+    index.InsertEntry(key(value), rid(value), loader);
+  }
+  db.txn_manager_->Commit(loader);
+
+  // The scan locks 20 and the gap up to 30.
+  auto *scanner = db.txn_manager_->Begin(nullptr, IsolationLevel::SERIALIZABLE);
+  std::vector<RID> result;
+  index.ScanRange(key(15), key(25), &result, scanner);
+  EXPECT_EQ(std::vector<RID>{rid(20)}, result);
+
+  // An insert into the gap waits for the scan to end, whatever its own isolation level.
+  auto *phantom = db.txn_manager_->Begin(nullptr, IsolationLevel::READ_COMMITTED);
+  std::atomic<bool> inserted{false};
+  std::thread insert([&] {
+    index.InsertEntry(key(22), rid(22), phantom);
+    inserted = true;
+    db.txn_manager_->Commit(phantom);
+  });
+
+  // Inserts outside of the locked gaps go ahead.
+  auto *writer = db.txn_manager_->Begin(nullptr, IsolationLevel::SERIALIZABLE);
+  index.InsertEntry(key(5), rid(5), writer);
+  index.InsertEntry(key(45), rid(45), writer);
+  EXPECT_EQ(TransactionState::GROWING, writer->GetState());
+  db.txn_manager_->Commit(writer);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(inserted);
+  // Scanning again finds no phantom.
+  index.ScanRange(key(15), key(25), &result, scanner);
+  EXPECT_EQ(std::vector<RID>{rid(20)}, result);
+  db.txn_manager_->Commit(scanner);
+  insert.join();
+  EXPECT_TRUE(inserted);
+
+  auto *reader = db.txn_manager_->Begin(nullptr, IsolationLevel::SERIALIZABLE);
+  index.ScanRange(key(0), key(50), &result, reader);
+  EXPECT_EQ((std::vector<RID>{rid(5), rid(10), rid(20), rid(22), rid(30), rid(40), rid(45)}), result);
+  db.txn_manager_->Commit(reader);
+
+  // Abort marks the transaction aborted before it undoes its index writes, which must go through without locks. The
+  // catalog cannot hand out this index, so the undo is done here the way Abort does it.
+  auto *aborted = db.txn_manager_->Begin(nullptr, IsolationLevel::SERIALIZABLE);
+  index.InsertEntry(key(25), rid(25), aborted);
+  index.DeleteEntry(key(30), rid(30), aborted);
+  aborted->SetState(TransactionState::ABORTED);
+  index.InsertEntry(key(30), rid(30), aborted);
+  index.DeleteEntry(key(25), rid(25), aborted);
+  db.txn_manager_->Abort(aborted);
+
+  auto *checker = db.txn_manager_->Begin(nullptr, IsolationLevel::SERIALIZABLE);
+  index.ScanRange(key(0), key(50), &result, checker);
+  EXPECT_EQ((std::vector<RID>{rid(5), rid(10), rid(20), rid(22), rid(30), rid(40), rid(45)}), result);
+  db.txn_manager_->Commit(checker);
+
+  delete loader;
+  delete scanner;
+  delete phantom;
+  delete writer;
+  delete reader;
+  delete aborted;
+  delete checker;
+}
 
-TEST(LockManagerTest, DISABLED_GraphEdgeTest) {
+TEST(LockManagerTest, KeyRangeWriterTest) {
+  LockingDatabase db(64, DeadlockPolicy::WAIT_DIE);
+  page_id_t header_page_id;
+  db.bpm_->NewPage(&header_page_id);
+  db.bpm_->UnpinPage(header_page_id, true);
+  Schema schema{std::vector<Column>{Column{"a", TypeId::BIGINT}}};
+  auto *metadata = new IndexMetadata("key_range_index", "key_range_table", &schema, {0});
+  BPlusTreeIndex<GenericKey<8>, RID, GenericComparator<8>> index(metadata, db.bpm_, db.lock_manager_);
+  auto key = [&](int64_t value) { return Tuple({ValueFactory::GetBigIntValue(value)}, index.GetKeySchema()); };
+  auto rid = [](int64_t value) { return RID(static_cast<page_id_t>(value), 0); };
+
+  auto *loader = db.txn_manager_->Begin();
+  for (int64_t value : {10, 20, 30}) {
+    index.InsertEntry(key(value), rid(value), loader);
+  }
+  db.txn_manager_->Commit(loader);
+
+  auto *scanner = db.txn_manager_->Begin(nullptr, IsolationLevel::SERIALIZABLE);
+  std::vector<RID> result;
+  index.ScanRange(key(15), key(25), &result, scanner);
+  EXPECT_EQ(std::vector<RID>{rid(20)}, result);
+
+  // A younger writer dies instead of waiting for the scan, and learns about it instead of losing its write.
+  for (bool insert : {true, false}) {
+    auto *writer = db.txn_manager_->Begin(nullptr, IsolationLevel::REPEATABLE_READ);
+    EXPECT_THROW(insert ? index.InsertEntry(key(22), rid(22), writer) : index.DeleteEntry(key(20), rid(20), writer),
+                 TransactionAbortException);
+    EXPECT_EQ(TransactionState::ABORTED, writer->GetState());
+    db.txn_manager_->Abort(writer);
+    delete writer;
+  }
+
+  // Snapshot and optimistic transactions take no locks while they run, so their writes do not wait.
+  for (auto isolation_level : {IsolationLevel::SNAPSHOT, IsolationLevel::OPTIMISTIC}) {
+    auto *writer = db.txn_manager_->Begin(nullptr, isolation_level);
+    index.InsertEntry(key(22), rid(22), writer);
+    EXPECT_EQ(TransactionState::GROWING, writer->GetState());
+    index.DeleteEntry(key(22), rid(22), writer);
+    db.txn_manager_->Commit(writer);
+    delete writer;
+  }
+
+  db.txn_manager_->Commit(scanner);
+  auto *checker = db.txn_manager_->Begin(nullptr, IsolationLevel::SERIALIZABLE);
+  index.ScanRange(key(0), key(50), &result, checker);
+  EXPECT_EQ((std::vector<RID>{rid(10), rid(20), rid(30)}), result);
+  db.txn_manager_->Commit(checker);
+
+  delete loader;
+  delete scanner;
+  delete checker;
+}
+
+/**
+ * Memory held and time taken by a transaction that updates every row of a large table, with and without lock
+ * escalation. The memory includes the undo copies of the rows in the write set, which are the same in both runs.
+ */
+TEST(LockManagerTest, DISABLED_LockEscalationBenchmark) {
+  const int tuple_count = 200000;
+  Schema schema{std::vector<Column>{Column{"a", TypeId::INTEGER}, Column{"b", TypeId::INTEGER}}};
+
+  for (size_t threshold : {static_cast<size_t>(0), static_cast<size_t>(LOCK_ESCALATION_THRESHOLD)}) {
+    LockingDatabase db(4096);
+    db.lock_manager_->SetEscalationThreshold(threshold);
+    auto *txn = db.txn_manager_->Begin();
+    TableHeap table(db.bpm_, db.lock_manager_, db.log_manager_, txn, 0);
+    std::vector<RID> rids(tuple_count);
+    for (int i = 0; i < tuple_count; i++) {
+      ASSERT_TRUE(table.InsertTuple(
+          Tuple({ValueFactory::GetIntegerValue(i), ValueFactory::GetIntegerValue(0)}, &schema), &rids[i], txn));
+    }
+    db.txn_manager_->Commit(txn);
+    delete txn;
+
+    size_t heap_before = mallinfo2().uordblks;
+    auto start = std::chrono::steady_clock::now();
+    txn = db.txn_manager_->Begin();
+    for (int i = 0; i < tuple_count; i++) {
+      Tuple new_tuple({ValueFactory::GetIntegerValue(i), ValueFactory::GetIntegerValue(1)}, &schema);
+      ASSERT_TRUE(table.UpdateTuple(new_tuple, rids[i], txn));
+    }
+    size_t heap_held = mallinfo2().uordblks - heap_before;
+    size_t row_locks = txn->GetExclusiveLockSet()->size();
+    db.txn_manager_->Commit(txn);
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    delete txn;
+    std::cout << "escalation threshold " << threshold << ": " << row_locks << " row locks and "
+              << (heap_held >> 20) << " MB of heap held before commit, " << tuple_count / elapsed / 1e3
+              << " K updated rows per second" << std::endl;
+  }
+}
+
+/**
+ * Lock and unlock throughput of a striped lock table against one with a single latch. Every thread runs transactions
+ * that lock a few random rows out of many, so the requests hardly ever conflict and what is measured is the latching
+ * of the lock table itself.
+ */
+TEST(LockManagerTest, DISABLED_StripedLockTableBenchmark) {
+  const int num_rows = 1 << 20;
+  const int locks_per_txn = 8;
+  const auto duration = std::chrono::milliseconds(500);
+
+  for (size_t num_stripes : {static_cast<size_t>(1), static_cast<size_t>(LOCK_TABLE_STRIPES)}) {
+    for (int num_threads : {1, 2, 4, 8, 16, 32, 64}) {
+      LockManager lock_mgr{DeadlockPolicy::DETECTION, num_stripes};
+      std::atomic<bool> stop{false};
+      std::atomic<int64_t> total_locks{0};
+      std::atomic<txn_id_t> next_txn_id{0};
+      std::vector<std::thread> threads;
+      for (int i = 0; i < num_threads; i++) {
+        threads.emplace_back([&, i] {
+          std::mt19937 rng(i);
+          std::uniform_int_distribution<int> row(0, num_rows - 1);
+          int64_t locks = 0;
+          while (!stop) {
+            Transaction txn(next_txn_id++);
+            // lock in row order so that the transactions cannot deadlock
+            std::vector<int> rows;
+            for (int j = 0; j < locks_per_txn; j++) {
+              rows.push_back(row(rng));
+            }
+            std::sort(rows.begin(), rows.end());
+            rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+            for (size_t j = 0; j < rows.size(); j++) {
+              RID rid{rows[j] / 64, static_cast<uint32_t>(rows[j] % 64)};
+              if (j % 4 == 0) {
+                lock_mgr.LockExclusive(&txn, rid);
+              } else {
+                lock_mgr.LockShared(&txn, rid);
+              }
+            }
+            for (int row_no : rows) {
+              lock_mgr.Unlock(&txn, RID{row_no / 64, static_cast<uint32_t>(row_no % 64)});
+            }
+            locks += static_cast<int64_t>(rows.size());
+          }
+          total_locks += locks;
+        });
+      }
+      std::this_thread::sleep_for(duration);
+      stop = true;
+      for (auto &thread : threads) {
+        thread.join();
+      }
+      double seconds = std::chrono::duration<double>(duration).count();
+      std::cout << "stripes " << num_stripes << ", threads " << num_threads << ": " << total_locks / seconds / 1e6
+                << " M lock/unlock pairs per second" << std::endl;
+    }
+  }
+}
+
+TEST(LockManagerTest, DeadlockPreventionTest) {
+  RID rid0{0, 0};
+  RID rid1{1, 1};
+
+  // Wound-wait: the younger transaction waits for the older one, the older one wounds the younger one.
+  {
+    LockManager lock_mgr{DeadlockPolicy::WOUND_WAIT};
+    TransactionManager txn_mgr{&lock_mgr};
+    auto *older = txn_mgr.Begin();
+    auto *younger = txn_mgr.Begin();
+    EXPECT_TRUE(lock_mgr.LockExclusive(older, rid0));
+    EXPECT_TRUE(lock_mgr.LockExclusive(younger, rid1));
+
+    std::thread waiter([&] {
+      EXPECT_FALSE(lock_mgr.LockExclusive(younger, rid0));
+      txn_mgr.Abort(younger);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CheckGrowing(younger);
+    // closes the cycle, the waiting younger transaction is aborted and lets go of rid1
+    EXPECT_TRUE(lock_mgr.LockExclusive(older, rid1));
+    waiter.join();
+    CheckAborted(younger);
+    CheckTxnLockSize(younger, 0, 0);
+    txn_mgr.Commit(older);
+    delete older;
+    delete younger;
+  }
+
+  // Wait-die: the older transaction waits for the younger one, the younger one dies instead of waiting.
+  {
+    LockManager lock_mgr{DeadlockPolicy::WAIT_DIE};
+    TransactionManager txn_mgr{&lock_mgr};
+    auto *older = txn_mgr.Begin();
+    auto *younger = txn_mgr.Begin();
+    EXPECT_TRUE(lock_mgr.LockExclusive(older, rid0));
+    EXPECT_TRUE(lock_mgr.LockExclusive(younger, rid1));
+
+    std::thread waiter([&] { EXPECT_TRUE(lock_mgr.LockExclusive(older, rid1)); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CheckGrowing(older);
+    EXPECT_FALSE(lock_mgr.LockExclusive(younger, rid0));
+    CheckAborted(younger);
+    txn_mgr.Abort(younger);
+    waiter.join();
+    CheckTxnLockSize(older, 0, 2);
+    txn_mgr.Commit(older);
+    delete older;
+    delete younger;
+  }
+}
+
+TEST(LockManagerTest, DISABLED_DeadlockPolicyBenchmark) {
+  const int num_rows = 16;
+  const int num_threads = 8;
+  const int locks_per_txn = 4;
+  const auto duration = std::chrono::milliseconds(1000);
+
+  for (auto policy : {DeadlockPolicy::DETECTION, DeadlockPolicy::WOUND_WAIT, DeadlockPolicy::WAIT_DIE}) {
+    LockManager lock_mgr{policy};
+    std::atomic<bool> stop{false};
+    std::atomic<int64_t> commits{0};
+    std::atomic<int64_t> aborts{0};
+    std::atomic<txn_id_t> next_txn_id{0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; i++) {
+      threads.emplace_back([&, i] {
+        std::mt19937 rng(i);
+        std::vector<int> rows(num_rows);
+        for (int j = 0; j < num_rows; j++) {
+          rows[j] = j;
+        }
+        while (!stop) {
+          // a retry is a new transaction with a new, younger id
+          Transaction txn(next_txn_id++);
+          std::shuffle(rows.begin(), rows.end(), rng);
+          bool ok = true;
+          for (int j = 0; j < locks_per_txn && ok; j++) {
+            RID rid{rows[j], 0};
+            try {
+              ok = rng() % 2 == 0 ? lock_mgr.LockShared(&txn, rid) : lock_mgr.LockExclusive(&txn, rid);
+            } catch (TransactionAbortException &e) {
+              ok = false;
+            }
+          }
+          ok = ok && txn.GetState() != TransactionState::ABORTED;
+          (ok ? commits : aborts)++;
+          if (ok) {
+            txn.SetState(TransactionState::COMMITTED);
+          }
+          std::vector<RID> locked(txn.GetSharedLockSet()->begin(), txn.GetSharedLockSet()->end());
+          locked.insert(locked.end(), txn.GetExclusiveLockSet()->begin(), txn.GetExclusiveLockSet()->end());
+          for (const RID &rid : locked) {
+            lock_mgr.Unlock(&txn, rid);
+          }
+        }
+      });
+    }
+    std::this_thread::sleep_for(duration);
+    stop = true;
+    for (auto &thread : threads) {
+      thread.join();
+    }
+
+    const char *name = policy == DeadlockPolicy::DETECTION ? "detection"
+                                                            : policy == DeadlockPolicy::WOUND_WAIT ? "wound-wait"
+                                                                                                    : "wait-die";
+    double seconds = std::chrono::duration<double>(duration).count();
+    std::cout << name << ": " << commits / seconds << " commits per second, "
+              << 100.0 * aborts / std::max<int64_t>(commits + aborts, 1) << "% of the transactions aborted"
+              << std::endl;
+    std::cout << lock_mgr.GetStats()->ToString();
+  }
+}
+
+TEST(LockManagerTest, GraphEdgeTest) {
   LockManager lock_mgr{};
   TransactionManager txn_mgr{&lock_mgr};
   const int num_nodes = 100;
@@ -194,7 +828,7 @@ TEST(LockManagerTest, DISABLED_GraphEdgeTest) {
   }
 }
 
-TEST(LockManagerTest, DISABLED_BasicCycleTest) {
+TEST(LockManagerTest, BasicCycleTest) {
   LockManager lock_mgr{}; /* Use Deadlock detection */
   TransactionManager txn_mgr{&lock_mgr};
 
@@ -211,7 +845,7 @@ TEST(LockManagerTest, DISABLED_BasicCycleTest) {
   EXPECT_EQ(false, lock_mgr.HasCycle(&txn));
 }
 
-TEST(LockManagerTest, DISABLED_BasicDeadlockDetectionTest) {
+TEST(LockManagerTest, BasicDeadlockDetectionTest) {
   LockManager lock_mgr{};
   cycle_detection_interval = std::chrono::milliseconds(500);
   TransactionManager txn_mgr{&lock_mgr};
@@ -267,4 +901,39 @@ TEST(LockManagerTest, DISABLED_BasicDeadlockDetectionTest) {
   delete txn0;
   delete txn1;
 }
+
+TEST(LockManagerTest, WaitsForGraphTest) {
+  // long enough for the background thread not to get involved
+  cycle_detection_interval = std::chrono::milliseconds(500);
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  RID rid0{0, 0};
+  RID rid1{1, 1};
+  auto *txn0 = txn_mgr.Begin();
+  auto *txn1 = txn_mgr.Begin();
+  EXPECT_TRUE(lock_mgr.LockExclusive(txn0, rid0));
+  EXPECT_TRUE(lock_mgr.LockExclusive(txn1, rid1));
+
+  std::thread t0([&] { EXPECT_TRUE(lock_mgr.LockShared(txn0, rid1)); });
+  // the edge shows up as soon as txn0 waits
+  while (lock_mgr.GetEdgeList().empty()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  auto edges = lock_mgr.GetEdgeList();
+  EXPECT_EQ(1, edges.size());
+  EXPECT_EQ(std::make_pair(txn0->GetTransactionId(), txn1->GetTransactionId()), edges[0]);
+
+  // closing the cycle aborts its youngest transaction right away
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_FALSE(lock_mgr.LockShared(txn1, rid0));
+  EXPECT_LT(std::chrono::steady_clock::now() - start, cycle_detection_interval / 2);
+  CheckAborted(txn1);
+  txn_mgr.Abort(txn1);
+  t0.join();
+  EXPECT_TRUE(lock_mgr.GetEdgeList().empty());
+  txn_mgr.Commit(txn0);
+
+  delete txn0;
+  delete txn1;
+}
 }  // namespace bustub
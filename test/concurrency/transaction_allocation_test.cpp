@@ -0,0 +1,109 @@
+/**
+ * transaction_allocation_test.cpp
+ *
+ * Counts the heap allocations of transactions. The counting operator new replaces the global one for the whole
+ * binary, so it lives in a binary of its own and leaves the allocations of the other tests alone.
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include "buffer/buffer_pool_manager.h"
+#include "concurrency/lock_manager.h"
+#include "concurrency/transaction_manager.h"
+#include "gtest/gtest.h"
+#include "recovery/log_manager.h"
+#include "storage/b_plus_tree_test_util.h"  // NOLINT
+#include "storage/index/b_plus_tree.h"
+#include "storage/table/table_heap.h"
+#include "type/value_factory.h"
+
+static std::atomic<size_t> allocation_count{0};
+
+void *operator new(size_t size) {
+  allocation_count++;
+  void *ptr = malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void *ptr) noexcept { free(ptr); }
+
+void operator delete(void *ptr, size_t size) noexcept { free(ptr); }
+
+namespace bustub {
+
+// NOLINTNEXTLINE
+TEST(TransactionPoolTest, DISABLED_TransactionAllocationBenchmark) {
+  // point transactions: read a row, update it and insert its key into an index
+  const int num_rows = 1000;
+  const int num_txns = 20000;
+  remove("transaction_allocation.db");
+  remove("transaction_allocation.log");
+  auto *disk_manager = new DiskManager("transaction_allocation.db");
+  auto *log_manager = new LogManager(disk_manager);
+  auto *bpm = new BufferPoolManager(256, disk_manager, log_manager);
+  auto *lock_manager = new LockManager();
+  auto *txn_manager = new TransactionManager(lock_manager, log_manager);
+  log_manager->RunFlushThread();
+  txn_manager->SetAsyncCommit(true);
+
+  Schema schema{std::vector<Column>{Column("a", TypeId::INTEGER)}};
+  Transaction *loader = txn_manager->Begin();
+  auto *table = new TableHeap(bpm, lock_manager, log_manager, loader);
+  std::vector<RID> rids(num_rows);
+  for (int i = 0; i < num_rows; i++) {
+    EXPECT_TRUE(table->InsertTuple(Tuple({ValueFactory::GetIntegerValue(i)}, &schema), &rids[i], loader));
+  }
+  txn_manager->Commit(loader);
+  txn_manager->Recycle(loader);
+
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator);
+  GenericKey<8> index_key;
+
+  size_t empty_allocations = 0;
+  size_t point_allocations = 0;
+  for (int i = 0; i < num_txns; i++) {
+    size_t before = allocation_count;
+    Transaction *empty = txn_manager->Begin();
+    txn_manager->Commit(empty);
+    txn_manager->Recycle(empty);
+    empty_allocations += allocation_count - before;
+
+    before = allocation_count;
+    Transaction *txn = txn_manager->Begin();
+    size_t row = i % num_rows;
+    Tuple tuple;
+    EXPECT_TRUE(table->GetTuple(rids[row], &tuple, txn));
+    EXPECT_TRUE(table->UpdateTuple(Tuple({ValueFactory::GetIntegerValue(i)}, &schema), rids[row], txn));
+    index_key.SetFromInteger(i);
+    tree.Insert(index_key, rids[row], txn);
+    txn_manager->Commit(txn);
+    txn_manager->Recycle(txn);
+    point_allocations += allocation_count - before;
+  }
+  std::cout << "allocations per transaction: " << static_cast<double>(empty_allocations) / num_txns << " empty, "
+            << static_cast<double>(point_allocations) / num_txns << " point" << std::endl;
+
+  delete key_schema;
+  log_manager->StopFlushThread();
+  delete table;
+  delete txn_manager;
+  delete lock_manager;
+  delete bpm;
+  delete log_manager;
+  disk_manager->ShutDown();
+  delete disk_manager;
+  remove("transaction_allocation.db");
+  remove("transaction_allocation.log");
+}
+
+}  // namespace bustub
@@ -2,16 +2,24 @@
  * transaction_test.cpp
  */
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>  // NOLINT
 #include <cstdio>
+#include <filesystem>
+#include <iostream>
 #include <memory>
+#include <mutex>  // NOLINT
 #include <random>
 #include <string>
+#include <thread>  // NOLINT
 #include <utility>
 #include <vector>
 
 #include "buffer/buffer_pool_manager.h"
 #include "catalog/table_generator.h"
+#include "common/bustub_instance.h"
+#include "concurrency/garbage_collector.h"
 #include "concurrency/transaction.h"
 #include "concurrency/transaction_manager.h"
 #include "execution/execution_engine.h"
@@ -26,6 +34,7 @@
 #include "execution/plans/seq_scan_plan.h"
 #include "gtest/gtest.h"
 #include "storage/b_plus_tree_test_util.h"  // NOLINT
+#include "storage/table/table_heap.h"
 #include "type/value_factory.h"
 
 #define TEST_TIMEOUT_BEGIN                           \
@@ -251,4 +260,589 @@ TEST_F(TransactionTest, DISABLED_DirtyReadsTest) {
   delete key_schema;
 }
 
+/** A table heap of single integer rows with the managers around it, logging and locking if asked to. */
+class VersionedTable {
+ public:
+  VersionedTable(int num_rows, bool logging) : schema_({Column("a", TypeId::INTEGER)}) {
+    RemoveFiles();
+    disk_manager_ = new DiskManager("snapshot_isolation.db");
+    log_manager_ = new LogManager(disk_manager_);
+    bpm_ = new BufferPoolManager(256, disk_manager_, log_manager_);
+    lock_manager_ = new LockManager();
+    txn_manager_ = new TransactionManager(lock_manager_, log_manager_);
+    if (logging) {
+      log_manager_->RunFlushThread();
+    }
+    Transaction *txn = txn_manager_->Begin();
+    table_ = new TableHeap(bpm_, lock_manager_, log_manager_, txn);
+    for (int i = 0; i < num_rows; i++) {
+      RID rid;
+      EXPECT_TRUE(table_->InsertTuple(MakeRow(i), &rid, txn));
+      rids_.push_back(rid);
+    }
+    txn_manager_->Commit(txn);
+    delete txn;
+  }
+
+  ~VersionedTable() {
+    log_manager_->StopFlushThread();
+    delete table_;
+    delete txn_manager_;
+    delete lock_manager_;
+    delete bpm_;
+    delete log_manager_;
+    disk_manager_->ShutDown();
+    delete disk_manager_;
+    RemoveFiles();
+  }
+
+  static void RemoveFiles() {
+    for (const auto &entry : std::filesystem::directory_iterator(".")) {
+      if (entry.path().filename().string().compare(0, 19, "snapshot_isolation.") == 0) {
+        std::filesystem::remove(entry.path());
+      }
+    }
+  }
+
+  Tuple MakeRow(int a) { return Tuple({ValueFactory::GetIntegerValue(a)}, &schema_); }
+
+  /** @return the value of row i seen by txn, -1 if it sees no row */
+  int Read(size_t i, Transaction *txn) {
+    Tuple tuple;
+    return table_->GetTuple(rids_[i], &tuple, txn) ? tuple.GetValue(&schema_, 0).GetAs<int32_t>() : -1;
+  }
+
+  /** @return the values seen by a scan of txn */
+  std::vector<int> Scan(Transaction *txn) {
+    std::vector<int> values;
+    for (auto it = table_->Begin(txn); it != table_->End(); ++it) {
+      values.push_back(it->GetValue(&schema_, 0).GetAs<int32_t>());
+    }
+    return values;
+  }
+
+  Schema schema_;
+  DiskManager *disk_manager_;
+  LogManager *log_manager_;
+  BufferPoolManager *bpm_;
+  LockManager *lock_manager_;
+  TransactionManager *txn_manager_;
+  TableHeap *table_;
+  std::vector<RID> rids_;
+};
+
+// NOLINTNEXTLINE
+TEST(SnapshotIsolationTest, SnapshotReadTest) {
+  VersionedTable table{3, false};
+  auto *reader = table.txn_manager_->Begin(nullptr, IsolationLevel::SNAPSHOT);
+
+  // The writer changes every row and adds one, none of which the snapshot sees, before or after the commit.
+  auto *writer = table.txn_manager_->Begin();
+  EXPECT_TRUE(table.table_->UpdateTuple(table.MakeRow(10), table.rids_[0], writer));
+  EXPECT_TRUE(table.table_->UpdateTuple(table.MakeRow(11), table.rids_[0], writer));
+  EXPECT_TRUE(table.table_->MarkDelete(table.rids_[1], writer));
+  RID rid;
+  EXPECT_TRUE(table.table_->InsertTuple(table.MakeRow(13), &rid, writer));
+  EXPECT_EQ(11, table.Read(0, writer));
+  EXPECT_EQ(0, table.Read(0, reader));
+  EXPECT_EQ(1, table.Read(1, reader));
+  EXPECT_EQ(std::vector<int>({0, 1, 2}), table.Scan(reader));
+  table.txn_manager_->Commit(writer);
+  EXPECT_EQ(0, table.Read(0, reader));
+  EXPECT_EQ(std::vector<int>({0, 1, 2}), table.Scan(reader));
+
+  // A newer snapshot sees the commit, the older one still does not.
+  auto *newer = table.txn_manager_->Begin(nullptr, IsolationLevel::SNAPSHOT);
+  EXPECT_EQ(11, table.Read(0, newer));
+  EXPECT_EQ(-1, table.Read(1, newer));
+  EXPECT_EQ(std::vector<int>({11, 2, 13}), table.Scan(newer));
+  EXPECT_EQ(std::vector<int>({0, 1, 2}), table.Scan(reader));
+
+  // An aborted write is never seen, and the snapshot sees its own writes.
+  auto *aborted = table.txn_manager_->Begin();
+  EXPECT_TRUE(table.table_->UpdateTuple(table.MakeRow(20), table.rids_[2], aborted));
+  EXPECT_EQ(2, table.Read(2, newer));
+  table.txn_manager_->Abort(aborted);
+  EXPECT_TRUE(table.table_->UpdateTuple(table.MakeRow(21), table.rids_[2], newer));
+  EXPECT_EQ(21, table.Read(2, newer));
+  EXPECT_EQ(2, table.Read(2, reader));
+  table.txn_manager_->Commit(newer);
+  table.txn_manager_->Commit(reader);
+
+  delete writer;
+  delete newer;
+  delete aborted;
+  delete reader;
+}
+
+// NOLINTNEXTLINE
+TEST(SnapshotIsolationTest, WriteConflictTest) {
+  VersionedTable table{2, false};
+  auto *first = table.txn_manager_->Begin(nullptr, IsolationLevel::SNAPSHOT);
+  auto *second = table.txn_manager_->Begin(nullptr, IsolationLevel::SNAPSHOT);
+
+  // The first writer wins, the second one writes a row changed since its snapshot and aborts.
+  EXPECT_TRUE(table.table_->UpdateTuple(table.MakeRow(10), table.rids_[0], first));
+  table.txn_manager_->Commit(first);
+  EXPECT_FALSE(table.table_->UpdateTuple(table.MakeRow(20), table.rids_[0], second));
+  EXPECT_EQ(TransactionState::ABORTED, second->GetState());
+  table.txn_manager_->Abort(second);
+
+  // rows nobody else wrote can be written
+  auto *third = table.txn_manager_->Begin(nullptr, IsolationLevel::SNAPSHOT);
+  EXPECT_TRUE(table.table_->MarkDelete(table.rids_[1], third));
+  table.txn_manager_->Commit(third);
+  EXPECT_EQ(TransactionState::COMMITTED, third->GetState());
+
+  delete first;
+  delete second;
+  delete third;
+}
+
+// NOLINTNEXTLINE
+TEST(LockingScanTest, DeleteDuringScanTest) {
+  for (auto isolation_level : {IsolationLevel::REPEATABLE_READ, IsolationLevel::READ_COMMITTED}) {
+    VersionedTable table{3, true};
+    auto *scanner = table.txn_manager_->Begin(nullptr, isolation_level);
+    auto it = table.table_->Begin(scanner);
+    EXPECT_EQ(0, it->GetValue(&table.schema_, 0).GetAs<int32_t>());
+
+    // The scan finds row 1 and then waits for its lock, which the deleter holds until the delete has committed.
+    auto *deleter = table.txn_manager_->Begin();
+    EXPECT_TRUE(table.table_->UpdateTuple(table.MakeRow(10), table.rids_[1], deleter));
+    std::thread scan([&] { ++it; });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_TRUE(table.table_->MarkDelete(table.rids_[1], deleter));
+    table.txn_manager_->Commit(deleter);
+    scan.join();
+
+    // The deleted row is skipped, not read stale, and the scanner goes on.
+    EXPECT_NE(TransactionState::ABORTED, scanner->GetState());
+    ASSERT_TRUE(it != table.table_->End());
+    EXPECT_EQ(table.rids_[2], it->GetRid());
+    EXPECT_EQ(2, it->GetValue(&table.schema_, 0).GetAs<int32_t>());
+    ++it;
+    EXPECT_TRUE(it == table.table_->End());
+    table.txn_manager_->Commit(scanner);
+    delete deleter;
+    delete scanner;
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(SnapshotIsolationTest, GarbageCollectionTest) {
+  VersionedTable table{3, false};
+  // No snapshot was there to read the versions the inserts replaced, their commit dropped them.
+  EXPECT_EQ(0, table.table_->GetVersionCount());
+  auto *reader = table.txn_manager_->Begin(nullptr, IsolationLevel::SNAPSHOT);
+  for (int i = 10; i < 12; i++) {
+    auto *writer = table.txn_manager_->Begin();
+    EXPECT_TRUE(table.table_->UpdateTuple(table.MakeRow(i), table.rids_[0], writer));
+    table.txn_manager_->Commit(writer);
+    delete writer;
+  }
+
+  // The updates stay for the snapshot. The collector only gets to the rows of the load, which were pruned as it
+  // committed.
+  EXPECT_EQ(3, table.txn_manager_->CollectGarbage(100));
+  EXPECT_EQ(2, table.table_->GetVersionCount());
+  EXPECT_EQ(0, table.Read(0, reader));
+  EXPECT_EQ(std::vector<int>({0, 1, 2}), table.Scan(reader));
+  table.txn_manager_->Commit(reader);
+  delete reader;
+
+  // Without snapshots everything goes, also the slot of a deleted row. A commit prunes the rows it wrote, the
+  // collector gets the updates the snapshot held back.
+  auto *deleter = table.txn_manager_->Begin();
+  EXPECT_TRUE(table.table_->MarkDelete(table.rids_[2], deleter));
+  table.txn_manager_->Commit(deleter);
+  delete deleter;
+  EXPECT_EQ(2, table.table_->GetVersionCount());
+  EXPECT_EQ(3, table.txn_manager_->CollectGarbage(100));
+  EXPECT_EQ(0, table.table_->GetVersionCount());
+  auto *newer = table.txn_manager_->Begin(nullptr, IsolationLevel::SNAPSHOT);
+  EXPECT_EQ(11, table.Read(0, newer));
+  EXPECT_EQ(-1, table.Read(2, newer));
+  EXPECT_EQ(std::vector<int>({11, 1}), table.Scan(newer));
+  table.txn_manager_->Commit(newer);
+  delete newer;
+
+  // The collector thread catches up by itself with the garbage a snapshot held back.
+  GarbageCollector garbage_collector{table.txn_manager_};
+  auto *holder = table.txn_manager_->Begin(nullptr, IsolationLevel::SNAPSHOT);
+  auto *writer = table.txn_manager_->Begin();
+  EXPECT_TRUE(table.table_->UpdateTuple(table.MakeRow(20), table.rids_[1], writer));
+  table.txn_manager_->Commit(writer);
+  delete writer;
+  EXPECT_EQ(1, table.table_->GetVersionCount());
+  table.txn_manager_->Commit(holder);
+  delete holder;
+  for (int i = 0; i < 100 && table.table_->GetVersionCount() > 0; i++) {
+    std::this_thread::sleep_for(gc_interval);
+  }
+  EXPECT_EQ(0, table.table_->GetVersionCount());
+}
+
+// NOLINTNEXTLINE
+TEST(SnapshotIsolationTest, DropTableWithGarbageTest) {
+  // A table that goes away while a snapshot holds back its versions leaves the garbage collection first.
+  VersionedTable table{1, false};
+  auto *holder = table.txn_manager_->Begin(nullptr, IsolationLevel::SNAPSHOT);
+  auto *writer = table.txn_manager_->Begin();
+  EXPECT_TRUE(table.table_->UpdateTuple(table.MakeRow(10), table.rids_[0], writer));
+  table.txn_manager_->Commit(writer);
+  delete writer;
+  EXPECT_EQ(1, table.table_->GetVersionCount());
+  delete table.table_;
+  table.table_ = nullptr;
+  table.txn_manager_->Commit(holder);
+  delete holder;
+  EXPECT_EQ(0, table.txn_manager_->CollectGarbage(100));
+}
+
+// NOLINTNEXTLINE
+TEST(SnapshotIsolationTest, InstanceGarbageCollectorTest) {
+  // A database instance collects the garbage of its snapshots from startup to shutdown.
+  remove("instance_gc.db");
+  auto *instance = new BustubInstance("instance_gc.db");
+  Schema schema{std::vector<Column>{Column("a", TypeId::INTEGER)}};
+  auto *txn = instance->transaction_manager_->Begin();
+  auto *table = new TableHeap(instance->buffer_pool_manager_, instance->lock_manager_, instance->log_manager_, txn);
+  RID rid;
+  EXPECT_TRUE(table->InsertTuple(Tuple({ValueFactory::GetIntegerValue(0)}, &schema), &rid, txn));
+  instance->transaction_manager_->Commit(txn);
+  delete txn;
+
+  auto *holder = instance->transaction_manager_->Begin(nullptr, IsolationLevel::SNAPSHOT);
+  auto *writer = instance->transaction_manager_->Begin();
+  EXPECT_TRUE(table->UpdateTuple(Tuple({ValueFactory::GetIntegerValue(1)}, &schema), rid, writer));
+  instance->transaction_manager_->Commit(writer);
+  delete writer;
+  EXPECT_EQ(1, table->GetVersionCount());
+  instance->transaction_manager_->Commit(holder);
+  delete holder;
+  for (int i = 0; i < 100 && table->GetVersionCount() > 0; i++) {
+    std::this_thread::sleep_for(gc_interval);
+  }
+  EXPECT_EQ(0, table->GetVersionCount());
+  EXPECT_FALSE(table->HasGarbage());
+
+  delete table;
+  delete instance;
+  remove("instance_gc.db");
+}
+
+// NOLINTNEXTLINE
+TEST(OptimisticConcurrencyTest, BufferedWriteTest) {
+  VersionedTable table{3, false};
+  auto *txn = table.txn_manager_->Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  auto *other = table.txn_manager_->Begin();
+
+  // The writes stay in the write set, only the writer sees them.
+  EXPECT_EQ(0, table.Read(0, txn));
+  EXPECT_TRUE(table.table_->UpdateTuple(table.MakeRow(10), table.rids_[0], txn));
+  EXPECT_TRUE(table.table_->MarkDelete(table.rids_[1], txn));
+  RID rid;
+  EXPECT_TRUE(table.table_->InsertTuple(table.MakeRow(13), &rid, txn));
+  EXPECT_EQ(10, table.Read(0, txn));
+  EXPECT_EQ(-1, table.Read(1, txn));
+  EXPECT_EQ(std::vector<int>({10, 2}), table.Scan(txn));
+  EXPECT_EQ(std::vector<int>({0, 1, 2}), table.Scan(other));
+
+  table.txn_manager_->Commit(txn);
+  EXPECT_EQ(TransactionState::COMMITTED, txn->GetState());
+  EXPECT_EQ(std::vector<int>({10, 2, 13}), table.Scan(other));
+  table.txn_manager_->Commit(other);
+
+  // Aborting throws the buffered writes away.
+  auto *aborted = table.txn_manager_->Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  EXPECT_TRUE(table.table_->UpdateTuple(table.MakeRow(20), table.rids_[2], aborted));
+  table.txn_manager_->Abort(aborted);
+  auto *reader = table.txn_manager_->Begin();
+  EXPECT_EQ(std::vector<int>({10, 2, 13}), table.Scan(reader));
+  table.txn_manager_->Commit(reader);
+
+  delete txn;
+  delete other;
+  delete aborted;
+  delete reader;
+}
+
+// NOLINTNEXTLINE
+TEST(OptimisticConcurrencyTest, ValidationTest) {
+  VersionedTable table{3, false};
+
+  // A row read and then changed by a commit fails the validation, nothing is written.
+  auto *txn = table.txn_manager_->Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  EXPECT_EQ(0, table.Read(0, txn));
+  auto *writer = table.txn_manager_->Begin();
+  EXPECT_TRUE(table.table_->UpdateTuple(table.MakeRow(10), table.rids_[0], writer));
+  table.txn_manager_->Commit(writer);
+  EXPECT_TRUE(table.table_->UpdateTuple(table.MakeRow(11), table.rids_[1], txn));
+  table.txn_manager_->Commit(txn);
+  EXPECT_EQ(TransactionState::ABORTED, txn->GetState());
+  EXPECT_EQ(1, table.Read(1, writer));
+
+  // A read of a row with a write in flight sees the committed version, and fails too.
+  auto *pending = table.txn_manager_->Begin();
+  EXPECT_TRUE(table.table_->UpdateTuple(table.MakeRow(12), table.rids_[2], pending));
+  auto *reader = table.txn_manager_->Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  EXPECT_EQ(2, table.Read(2, reader));
+  EXPECT_EQ(10, table.Read(0, reader));
+  table.txn_manager_->Commit(reader);
+  EXPECT_EQ(TransactionState::ABORTED, reader->GetState());
+  table.txn_manager_->Abort(pending);
+
+  // Rows written after the read of another row do not matter.
+  auto *valid = table.txn_manager_->Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  EXPECT_EQ(10, table.Read(0, valid));
+  auto *unrelated = table.txn_manager_->Begin();
+  EXPECT_TRUE(table.table_->UpdateTuple(table.MakeRow(21), table.rids_[1], unrelated));
+  table.txn_manager_->Commit(unrelated);
+  EXPECT_TRUE(table.table_->UpdateTuple(table.MakeRow(20), table.rids_[0], valid));
+  table.txn_manager_->Commit(valid);
+  EXPECT_EQ(TransactionState::COMMITTED, valid->GetState());
+  EXPECT_EQ(20, table.Read(0, writer));
+
+  delete txn;
+  delete writer;
+  delete pending;
+  delete reader;
+  delete valid;
+  delete unrelated;
+}
+
+// NOLINTNEXTLINE
+TEST(OptimisticConcurrencyTest, LockWaitValidationTest) {
+  VersionedTable table{2, true};
+  auto *txn = table.txn_manager_->Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  EXPECT_EQ(0, table.Read(0, txn));
+  EXPECT_TRUE(table.table_->UpdateTuple(table.MakeRow(11), table.rids_[1], txn));
+
+  // The commit waits for the lock on the row it writes, and is not committed while it waits.
+  auto *holder = table.txn_manager_->Begin();
+  EXPECT_TRUE(table.table_->UpdateTuple(table.MakeRow(21), table.rids_[1], holder));
+  std::thread commit([&] { table.txn_manager_->Commit(txn); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(TransactionState::GROWING, txn->GetState());
+
+  // The row it read changes meanwhile, so the validation fails once the lock is granted.
+  auto *writer = table.txn_manager_->Begin();
+  EXPECT_TRUE(table.table_->UpdateTuple(table.MakeRow(10), table.rids_[0], writer));
+  table.txn_manager_->Commit(writer);
+  table.txn_manager_->Abort(holder);
+  commit.join();
+  EXPECT_EQ(TransactionState::ABORTED, txn->GetState());
+  EXPECT_EQ(1, table.Read(1, writer));
+
+  delete txn;
+  delete holder;
+  delete writer;
+}
+
+// NOLINTNEXTLINE
+TEST(SnapshotIsolationTest, DISABLED_SnapshotIsolationBenchmark) {
+  const int num_rows = 1000;
+  const int num_writers = 2;
+  const int num_readers = 2;
+  const int rows_per_write = 4;
+  const auto duration = std::chrono::milliseconds(2000);
+
+  // the snapshot run goes once without and once with the garbage collector
+  std::vector<std::pair<IsolationLevel, bool>> runs{{IsolationLevel::REPEATABLE_READ, true},
+                                                    {IsolationLevel::SNAPSHOT, false},
+                                                    {IsolationLevel::SNAPSHOT, true}};
+  for (auto [read_level, collect] : runs) {
+    VersionedTable table{num_rows, true};
+    table.txn_manager_->SetAsyncCommit(true);
+    std::unique_ptr<GarbageCollector> garbage_collector;
+    if (collect) {
+      garbage_collector = std::make_unique<GarbageCollector>(table.txn_manager_);
+    }
+    auto begin = [&](IsolationLevel level) { return table.txn_manager_->Begin(nullptr, level); };
+    std::atomic<bool> stop{false};
+    std::atomic<int64_t> writes{0};
+    std::atomic<int64_t> scans{0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_writers; i++) {
+      threads.emplace_back([&, i] {
+        std::mt19937 rng(i);
+        while (!stop) {
+          // rows are written in scan order, so writers and readers lock them in the same order
+          std::vector<size_t> rows;
+          for (int j = 0; j < rows_per_write; j++) {
+            rows.push_back(rng() % num_rows);
+          }
+          std::sort(rows.begin(), rows.end());
+          rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+          Transaction *txn = begin(IsolationLevel::REPEATABLE_READ);
+          bool ok = true;
+          for (size_t row : rows) {
+            ok = ok && table.table_->UpdateTuple(table.MakeRow(static_cast<int>(rng() % num_rows)), table.rids_[row],
+                                                 txn);
+          }
+          if (ok) {
+            table.txn_manager_->Commit(txn);
+            writes++;
+          } else {
+            table.txn_manager_->Abort(txn);
+          }
+          delete txn;
+        }
+      });
+    }
+    for (int i = 0; i < num_readers; i++) {
+      threads.emplace_back([&] {
+        while (!stop) {
+          Transaction *txn = begin(read_level);
+          bool ok = table.Scan(txn).size() == num_rows && txn->GetState() != TransactionState::ABORTED;
+          if (ok) {
+            table.txn_manager_->Commit(txn);
+            scans++;
+          } else {
+            table.txn_manager_->Abort(txn);
+          }
+          delete txn;
+        }
+      });
+    }
+    std::this_thread::sleep_for(duration);
+    stop = true;
+    for (auto &thread : threads) {
+      thread.join();
+    }
+
+    double seconds = std::chrono::duration<double>(duration).count();
+    std::cout << (read_level == IsolationLevel::SNAPSHOT ? "snapshot" : "repeatable read") << " scans: "
+              << scans / seconds << " scans of " << num_rows << " rows per second, " << writes / seconds
+              << " write transactions per second, " << (collect ? "with" : "without") << " garbage collection, "
+              << table.table_->GetVersionCount() << " row versions kept" << std::endl;
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(OptimisticConcurrencyTest, DISABLED_OptimisticBenchmark) {
+  // YCSB-B: 95% reads and 5% updates of uniformly chosen rows, four per transaction
+  const int num_rows = 10000;
+  const int num_threads = 2;
+  const int ops_per_txn = 4;
+  const int update_percent = 5;
+  const auto duration = std::chrono::milliseconds(2000);
+
+  for (auto level : {IsolationLevel::REPEATABLE_READ, IsolationLevel::OPTIMISTIC}) {
+    VersionedTable table{num_rows, true};
+    table.txn_manager_->SetAsyncCommit(true);
+    GarbageCollector garbage_collector{table.txn_manager_};
+    std::atomic<bool> stop{false};
+    std::atomic<int64_t> commits{0};
+    std::atomic<int64_t> aborts{0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; i++) {
+      threads.emplace_back([&, i] {
+        std::mt19937 rng(i);
+        while (!stop) {
+          Transaction *txn = table.txn_manager_->Begin(nullptr, level);
+          bool ok = true;
+          for (int j = 0; j < ops_per_txn && ok; j++) {
+            size_t row = rng() % num_rows;
+            if (static_cast<int>(rng() % 100) < update_percent) {
+              ok = table.table_->UpdateTuple(table.MakeRow(static_cast<int>(rng())), table.rids_[row], txn);
+            } else {
+              ok = table.Read(row, txn) != -1;
+            }
+          }
+          if (ok) {
+            table.txn_manager_->Commit(txn);
+          } else {
+            table.txn_manager_->Abort(txn);
+          }
+          (txn->GetState() == TransactionState::COMMITTED ? commits : aborts)++;
+          delete txn;
+        }
+      });
+    }
+    std::this_thread::sleep_for(duration);
+    stop = true;
+    for (auto &thread : threads) {
+      thread.join();
+    }
+
+    double seconds = std::chrono::duration<double>(duration).count();
+    std::cout << (level == IsolationLevel::OPTIMISTIC ? "optimistic" : "two-phase locking") << ": "
+              << commits / seconds << " commits per second, " << aborts << " aborts" << std::endl;
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(TransactionPoolTest, RecycleTest) {
+  LockManager lock_manager;
+  TransactionManager txn_mgr(&lock_manager);
+  Transaction *txn = txn_mgr.Begin();
+  txn_id_t first_id = txn->GetTransactionId();
+  // more locks than the sets keep inline
+  for (uint32_t i = 0; i < 2 * TXN_LOCK_SET_SIZE; i++) {
+    EXPECT_TRUE(lock_manager.LockShared(txn, RID(0, i)));
+    EXPECT_TRUE(lock_manager.LockExclusive(txn, RID(1, i)));
+  }
+  EXPECT_TRUE(lock_manager.LockUpgrade(txn, RID(0, 3)));
+  EXPECT_EQ(2 * TXN_LOCK_SET_SIZE - 1, txn->GetSharedLockSet()->size());
+  EXPECT_EQ(2 * TXN_LOCK_SET_SIZE + 1, txn->GetExclusiveLockSet()->size());
+  EXPECT_TRUE(txn->IsExclusiveLocked(RID(0, 3)));
+  EXPECT_FALSE(txn->IsSharedLocked(RID(0, 3)));
+  txn_mgr.Commit(txn);
+  EXPECT_TRUE(txn->GetSharedLockSet()->empty());
+  EXPECT_TRUE(txn->GetExclusiveLockSet()->empty());
+
+  // the object comes back as a fresh transaction
+  txn_mgr.Recycle(txn);
+  Transaction *recycled = txn_mgr.Begin(nullptr, IsolationLevel::READ_COMMITTED);
+  EXPECT_EQ(txn, recycled);
+  EXPECT_NE(first_id, recycled->GetTransactionId());
+  EXPECT_EQ(TransactionState::GROWING, recycled->GetState());
+  EXPECT_EQ(IsolationLevel::READ_COMMITTED, recycled->GetIsolationLevel());
+  EXPECT_TRUE(lock_manager.LockExclusive(recycled, RID(0, 3)));
+  EXPECT_EQ(1, recycled->GetExclusiveLockSet()->size());
+  txn_mgr.Abort(recycled);
+  txn_mgr.Recycle(recycled);
+}
+
+// NOLINTNEXTLINE
+TEST(TransactionRegistryTest, ConcurrentBeginCommitTest) {
+  LockManager lock_manager;
+  TransactionManager txn_mgr(&lock_manager);
+  const int num_threads = 8;
+  const int num_txns = 1000;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_threads; i++) {
+    threads.emplace_back([&txn_mgr, i] {
+      for (int j = 0; j < num_txns; j++) {
+        Transaction *txn = txn_mgr.Begin();
+        EXPECT_EQ(txn, txn_mgr.GetTransaction(txn->GetTransactionId()));
+        txn_id_t txn_id = txn->GetTransactionId();
+        if ((i + j) % 2 == 0) {
+          txn_mgr.Commit(txn);
+        } else {
+          txn_mgr.Abort(txn);
+        }
+        EXPECT_EQ(nullptr, txn_mgr.GetTransaction(txn_id));
+        txn_mgr.Recycle(txn);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  // only running transactions are listed
+  Transaction *running = txn_mgr.Begin();
+  std::vector<std::pair<txn_id_t, lsn_t>> active_txns;
+  txn_mgr.GetActiveTransactionTable(&active_txns);
+  ASSERT_EQ(1, active_txns.size());
+  EXPECT_EQ(running->GetTransactionId(), active_txns[0].first);
+  txn_mgr.Commit(running);
+  txn_mgr.GetActiveTransactionTable(&active_txns);
+  EXPECT_TRUE(active_txns.empty());
+  txn_mgr.Recycle(running);
+}
+
 }  // namespace bustub
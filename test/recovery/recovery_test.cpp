@@ -10,7 +10,18 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
 #include <string>
+#include <thread>  // NOLINT
 #include <vector>
 
 #include "common/bustub_instance.h"
@@ -20,30 +31,101 @@
 #include "gtest/gtest.h"
 #include "logging/common.h"
 #include "recovery/log_recovery.h"
+#include "recovery/log_replica.h"
+#include "recovery/log_shipper.h"
+#include "storage/index/b_plus_tree.h"
 #include "storage/table/table_heap.h"
 #include "storage/table/table_iterator.h"
 #include "storage/table/tuple.h"
+#include "type/value_factory.h"
 
 namespace bustub {
 
+/**
+ * Primary side of the log shipping tests, run in a child process. Ships the log on test.sock while inserting
+ * tuple_count tuples (a, 0) in transactions of batch_size and setting b = 1 on every tenth tuple, with an aborted
+ * insert in the middle. Writes (first page id, last commit LSN) to report_fd, then waits for a byte on done_fd.
+ * @return false if a table operation failed
+ */
+static bool RunShippingPrimary(int tuple_count, int batch_size, int report_fd, int done_fd) {
+  Schema schema{std::vector<Column>{Column{"a", TypeId::INTEGER}, Column{"b", TypeId::INTEGER}}};
+  auto *primary = new BustubInstance("test.db");
+  auto *log_shipper = new LogShipper(primary->disk_manager_, "test.sock");
+  primary->log_manager_->SetLogShipper(log_shipper);
+  primary->log_manager_->RunFlushThread();
+  auto *txn_manager = primary->transaction_manager_;
+
+  bool ok = true;
+  Transaction *txn = txn_manager->Begin();
+  auto *table = new TableHeap(primary->buffer_pool_manager_, primary->lock_manager_, primary->log_manager_, txn);
+  txn_manager->Commit(txn);
+  delete txn;
+  for (int i = 0; i < tuple_count; i += batch_size) {
+    if (i == tuple_count / 2) {
+      txn = txn_manager->Begin();
+      RID rid;
+      ok = ok && table->InsertTuple(
+                     Tuple({ValueFactory::GetIntegerValue(-1), ValueFactory::GetIntegerValue(0)}, &schema), &rid, txn);
+      txn_manager->Abort(txn);
+      delete txn;
+    }
+    txn = txn_manager->Begin();
+    for (int j = i; j < std::min(i + batch_size, tuple_count); j++) {
+      RID rid;
+      ok = ok && table->InsertTuple(
+                     Tuple({ValueFactory::GetIntegerValue(j), ValueFactory::GetIntegerValue(0)}, &schema), &rid, txn);
+      if (j % 10 == 0) {
+        ok = ok && table->UpdateTuple(
+                       Tuple({ValueFactory::GetIntegerValue(j), ValueFactory::GetIntegerValue(1)}, &schema), rid, txn);
+      }
+    }
+    txn_manager->Commit(txn);
+    std::pair<page_id_t, lsn_t> progress{table->GetFirstPageId(), txn->GetPrevLSN()};
+    delete txn;
+    if (i + batch_size >= tuple_count) {
+      ok = ok && write(report_fd, &progress, sizeof(progress)) == sizeof(progress);
+    }
+  }
+
+  char done;
+  ok = ok && read(done_fd, &done, 1) == 1;
+  primary->log_manager_->StopFlushThread();
+  primary->log_manager_->SetLogShipper(nullptr);
+  delete log_shipper;
+  delete table;
+  delete primary;
+  return ok;
+}
+
 class RecoveryTest : public ::testing::Test {
  protected:
   // This function is called before every test.
   void SetUp() override {
     remove("test.db");
-    remove("test.log");
+    RemoveLogSegments();
+    remove("test.master");
   }
 
   // This function is called after every test.
   void TearDown() override {
     LOG_INFO("Tearing down the system..");
     remove("test.db");
-    remove("test.log");
+    RemoveLogSegments();
+    remove("test.master");
   };
+
+  // Remove test.log.<n> and the recycled test.log.spare.<n> files.
+  static void RemoveLogSegments() {
+    for (const auto &entry : std::filesystem::directory_iterator(".")) {
+      if (entry.path().filename().string().compare(0, 9, "test.log.") == 0) {
+        std::filesystem::remove(entry.path());
+      }
+    }
+  }
 };
 
 // NOLINTNEXTLINE
-TEST_F(RecoveryTest, DISABLED_RedoTest) {
+TEST_F(RecoveryTest, RedoTest) {
   BustubInstance *bustub_instance = new BustubInstance("test.db");
 
   ASSERT_FALSE(enable_logging);
@@ -132,7 +214,7 @@ TEST_F(RecoveryTest, DISABLED_RedoTest) {
 }
 
 // NOLINTNEXTLINE
-TEST_F(RecoveryTest, DISABLED_UndoTest) {
+TEST_F(RecoveryTest, UndoTest) {
   BustubInstance *bustub_instance = new BustubInstance("test.db");
 
   ASSERT_FALSE(enable_logging);
@@ -211,7 +293,111 @@ TEST_F(RecoveryTest, DISABLED_UndoTest) {
 }
 
 // NOLINTNEXTLINE
-TEST_F(RecoveryTest, DISABLED_CheckpointTest) {
+TEST_F(RecoveryTest, DeltaUpdateRecordTest) {
+  std::vector<Column> cols;
+  for (int i = 0; i < 16; i++) {
+    cols.emplace_back("c" + std::to_string(i), TypeId::BIGINT);
+  }
+  cols.emplace_back("v", TypeId::VARCHAR, 20);
+  Schema schema{cols};
+
+  std::vector<Value> values;
+  for (int i = 0; i < 16; i++) {
+    values.emplace_back(ValueFactory::GetBigIntValue(i));
+  }
+  values.emplace_back(ValueFactory::GetVarcharValue("short"));
+  Tuple old_tuple(values, &schema);
+
+  // Change a single fixed-size column: the delta must be much smaller than both images.
+  values[7] = ValueFactory::GetBigIntValue(4242);
+  Tuple new_tuple(values, &schema);
+  LogRecord full_record(0, INVALID_LSN, LogRecordType::UPDATE, RID(0, 0), old_tuple, new_tuple);
+  LogRecord delta_record(0, INVALID_LSN, LogRecordType::DELTAUPDATE, RID(0, 0), old_tuple, new_tuple);
+  EXPECT_LT(delta_record.GetSize() * 4, full_record.GetSize());
+
+  Tuple rebuilt;
+  ASSERT_TRUE(LogRecord::ApplyDelta(delta_record.GetUpdateDelta(), old_tuple, true, &rebuilt));
+  EXPECT_EQ(rebuilt.GetValue(&schema, 7).CompareEquals(ValueFactory::GetBigIntValue(4242)), CmpBool::CmpTrue);
+  ASSERT_TRUE(LogRecord::ApplyDelta(delta_record.GetUpdateDelta(), new_tuple, false, &rebuilt));
+  EXPECT_EQ(rebuilt.GetValue(&schema, 7).CompareEquals(ValueFactory::GetBigIntValue(7)), CmpBool::CmpTrue);
+
+  // Growing the varchar changes the tuple size and is carried by the trailing range.
+  values[16] = ValueFactory::GetVarcharValue("a much longer value");
+  Tuple grown_tuple(values, &schema);
+  LogRecord grow_record(0, INVALID_LSN, LogRecordType::DELTAUPDATE, RID(0, 0), new_tuple, grown_tuple);
+  ASSERT_TRUE(LogRecord::ApplyDelta(grow_record.GetUpdateDelta(), new_tuple, true, &rebuilt));
+  ASSERT_EQ(rebuilt.GetLength(), grown_tuple.GetLength());
+  EXPECT_EQ(std::memcmp(rebuilt.GetData(), grown_tuple.GetData(), rebuilt.GetLength()), 0);
+  ASSERT_TRUE(LogRecord::ApplyDelta(grow_record.GetUpdateDelta(), grown_tuple, false, &rebuilt));
+  ASSERT_EQ(rebuilt.GetLength(), new_tuple.GetLength());
+  EXPECT_EQ(std::memcmp(rebuilt.GetData(), new_tuple.GetData(), rebuilt.GetLength()), 0);
+  EXPECT_FALSE(LogRecord::ApplyDelta(grow_record.GetUpdateDelta(), grown_tuple, true, &rebuilt));
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, DeltaUpdateRedoUndoTest) {
+  BustubInstance *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  RID rid;
+  RID rid1;
+  Tuple tuple({ValueFactory::GetVarcharValue("abc"), ValueFactory::GetSmallIntValue(1)}, &schema);
+  ASSERT_TRUE(test_table->InsertTuple(tuple, &rid, txn));
+  ASSERT_TRUE(test_table->InsertTuple(tuple, &rid1, txn));
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+
+  // A committed update that has to be redone.
+  txn = bustub_instance->transaction_manager_->Begin();
+  Tuple committed({ValueFactory::GetVarcharValue("abcdef"), ValueFactory::GetSmallIntValue(2)}, &schema);
+  ASSERT_TRUE(test_table->UpdateTuple(committed, rid, txn));
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+
+  // An update of a loser transaction that reached the disk and has to be undone.
+  txn = bustub_instance->transaction_manager_->Begin();
+  Tuple uncommitted({ValueFactory::GetVarcharValue("ab"), ValueFactory::GetSmallIntValue(3)}, &schema);
+  ASSERT_TRUE(test_table->UpdateTuple(uncommitted, rid1, txn));
+  bustub_instance->log_manager_->Flush(txn->GetPrevLSN());
+  bustub_instance->buffer_pool_manager_->FlushPage(first_page_id);
+  delete txn;
+  delete test_table;
+  delete bustub_instance;
+
+  bustub_instance = new BustubInstance("test.db");
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_);
+  log_recovery->Redo();
+  log_recovery->Undo();
+
+  txn = bustub_instance->transaction_manager_->Begin();
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  Tuple result;
+  ASSERT_TRUE(test_table->GetTuple(rid, &result, txn));
+  EXPECT_EQ(result.GetValue(&schema, 0).CompareEquals(ValueFactory::GetVarcharValue("abcdef")), CmpBool::CmpTrue);
+  EXPECT_EQ(result.GetValue(&schema, 1).CompareEquals(ValueFactory::GetSmallIntValue(2)), CmpBool::CmpTrue);
+  ASSERT_TRUE(test_table->GetTuple(rid1, &result, txn));
+  EXPECT_EQ(result.GetValue(&schema, 0).CompareEquals(ValueFactory::GetVarcharValue("abc")), CmpBool::CmpTrue);
+  EXPECT_EQ(result.GetValue(&schema, 1).CompareEquals(ValueFactory::GetSmallIntValue(1)), CmpBool::CmpTrue);
+  bustub_instance->transaction_manager_->Commit(txn);
+
+  delete txn;
+  delete test_table;
+  delete log_recovery;
+  delete bustub_instance;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, CheckpointTest) {
   BustubInstance *bustub_instance = new BustubInstance("test.db");
 
   EXPECT_FALSE(enable_logging);
@@ -313,4 +499,952 @@ TEST_F(RecoveryTest, DISABLED_CheckpointTest) {
   LOG_INFO("Shutdown System");
   delete bustub_instance;
 }
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, FuzzyCheckpointRecoveryTest) {
+  BustubInstance *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+  const Tuple tuple = ConstructTuple(&schema);
+  auto val_0 = tuple.GetValue(&schema, 0);
+
+  std::vector<RID> committed_rids;
+  std::vector<RID> loser_rids;
+  RID rid;
+  Transaction *txn1 = bustub_instance->transaction_manager_->Begin();
+  for (int i = 0; i < 100; i++) {
+    ASSERT_TRUE(test_table->InsertTuple(tuple, &rid, txn1));
+    committed_rids.push_back(rid);
+  }
+  bustub_instance->transaction_manager_->Commit(txn1);
+
+  // The loser stays active across both checkpoints, which must not wait for it.
+  Transaction *txn2 = bustub_instance->transaction_manager_->Begin();
+  int64_t loser_offset = txn2->GetFirstLogOffset();
+  ASSERT_TRUE(test_table->InsertTuple(tuple, &rid, txn2));
+  loser_rids.push_back(rid);
+
+  bustub_instance->checkpoint_manager_->BeginCheckpoint();
+  bustub_instance->checkpoint_manager_->EndCheckpoint();
+  // Every page has been written back by now, so the second checkpoint only needs the log from txn2 on.
+  bustub_instance->checkpoint_manager_->BeginCheckpoint();
+  bustub_instance->checkpoint_manager_->EndCheckpoint();
+
+  Transaction *txn3 = bustub_instance->transaction_manager_->Begin();
+  for (int i = 0; i < 100; i++) {
+    ASSERT_TRUE(test_table->InsertTuple(tuple, &rid, txn3));
+    committed_rids.push_back(rid);
+  }
+  bustub_instance->transaction_manager_->Commit(txn3);
+  ASSERT_TRUE(test_table->InsertTuple(tuple, &rid, txn2));
+  loser_rids.push_back(rid);
+
+  delete txn1;
+  delete txn2;
+  delete txn3;
+  delete test_table;
+  LOG_INFO("System crash before txn2 commits");
+  delete bustub_instance;
+
+  // Recovery has to seek to the checkpoint, wipe the log before it to make sure nothing there is read.
+  {
+    std::fstream log_io("test.log.0", std::ios::binary | std::ios::in | std::ios::out);
+    std::vector<char> zeros(loser_offset, 0);
+    log_io.write(zeros.data(), loser_offset);
+  }
+
+  bustub_instance = new BustubInstance("test.db");
+  // the tail of the log is found again, so LSNs keep growing after the restart
+  EXPECT_GT(bustub_instance->log_manager_->GetNextLSN(), 0);
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_);
+  log_recovery->Redo();
+  log_recovery->Undo();
+  delete log_recovery;
+
+  txn = bustub_instance->transaction_manager_->Begin();
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  Tuple old_tuple;
+  for (const auto &committed_rid : committed_rids) {
+    ASSERT_TRUE(test_table->GetTuple(committed_rid, &old_tuple, txn));
+    ASSERT_EQ(old_tuple.GetValue(&schema, 0).CompareEquals(val_0), CmpBool::CmpTrue);
+  }
+  for (const auto &loser_rid : loser_rids) {
+    ASSERT_FALSE(test_table->GetTuple(loser_rid, &old_tuple, txn));
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  delete test_table;
+  delete bustub_instance;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, ParallelRedoTest) {
+  BustubInstance *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+
+  Column col1{"a", TypeId::INTEGER};
+  Column col2{"b", TypeId::VARCHAR, 20};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+
+  // Enough tuples to spread over more pages than the buffer pool holds, so redo also has to evict.
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  std::vector<RID> rids;
+  for (int i = 0; i < 2000; i++) {
+    RID rid;
+    ASSERT_TRUE(test_table->InsertTuple(Tuple({ValueFactory::GetIntegerValue(i), ValueFactory::GetVarcharValue("abc")},
+                                              &schema),
+                                        &rid, txn));
+    rids.push_back(rid);
+  }
+  for (int i = 0; i < 2000; i += 3) {
+    ASSERT_TRUE(test_table->UpdateTuple(
+        Tuple({ValueFactory::GetIntegerValue(-i), ValueFactory::GetVarcharValue("xyz")}, &schema), rids[i], txn));
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  delete test_table;
+  delete bustub_instance;
+
+  bustub_instance = new BustubInstance("test.db");
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_, 4);
+  log_recovery->Redo();
+  log_recovery->Undo();
+  delete log_recovery;
+
+  txn = bustub_instance->transaction_manager_->Begin();
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  Tuple result;
+  for (int i = 0; i < 2000; i++) {
+    ASSERT_TRUE(test_table->GetTuple(rids[i], &result, txn));
+    int expected = i % 3 == 0 ? -i : i;
+    EXPECT_EQ(result.GetValue(&schema, 0).CompareEquals(ValueFactory::GetIntegerValue(expected)), CmpBool::CmpTrue);
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  delete test_table;
+  delete bustub_instance;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, DISABLED_ParallelRedoBenchmark) {
+  // The generated log only holds delta updates of a table that fits into the buffer pool, so recovery time is spent
+  // reading and applying the log.
+  const int64_t log_size = 2LL << 30;
+  const size_t pool_size = 4096;
+  const int tuple_count = 100000;
+
+  Column col1{"a", TypeId::INTEGER};
+  Column col2{"b", TypeId::INTEGER};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+
+  auto *disk_manager = new DiskManager("test.db");
+  auto *log_manager = new LogManager(disk_manager);
+  auto *bpm = new BufferPoolManager(pool_size, disk_manager, log_manager);
+  auto *lock_manager = new LockManager();
+  auto *txn_manager = new TransactionManager(lock_manager, log_manager);
+  log_manager->RunFlushThread();
+
+  Transaction *txn = txn_manager->Begin();
+  auto *test_table = new TableHeap(bpm, lock_manager, log_manager, txn);
+  std::vector<RID> rids(tuple_count);
+  std::vector<int32_t> values(tuple_count, 0);
+  for (int i = 0; i < tuple_count; i++) {
+    ASSERT_TRUE(test_table->InsertTuple(
+        Tuple({ValueFactory::GetIntegerValue(i), ValueFactory::GetIntegerValue(0)}, &schema), &rids[i], txn));
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+  bpm->FlushAllPages();
+
+  // Log the updates without applying them, as if the pages had never been written back before a crash.
+  auto start = std::chrono::steady_clock::now();
+  txn = txn_manager->Begin();
+  int64_t log_start = log_manager->GetNextOffset();
+  for (int64_t i = 0; log_manager->GetNextOffset() - log_start < log_size; i++) {
+    int slot = static_cast<int>(i % tuple_count);
+    Tuple old_tuple({ValueFactory::GetIntegerValue(slot), ValueFactory::GetIntegerValue(values[slot])}, &schema);
+    Tuple new_tuple({ValueFactory::GetIntegerValue(slot), ValueFactory::GetIntegerValue(++values[slot])}, &schema);
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::DELTAUPDATE, rids[slot], old_tuple,
+                         new_tuple);
+    txn->SetPrevLSN(log_manager->AppendLogRecord(&log_record));
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+  auto generated = std::chrono::steady_clock::now();
+  std::cout << "generated " << (log_manager->GetNextOffset() >> 20) << " MB of log in "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(generated - start).count() << " ms" << std::endl;
+  log_manager->StopFlushThread();
+  delete test_table;
+  delete txn_manager;
+  delete bpm;
+  delete log_manager;
+
+  for (size_t workers : {1, 2, 4, 8, 16}) {
+    bpm = new BufferPoolManager(pool_size, disk_manager);
+    auto *log_recovery = new LogRecovery(disk_manager, bpm, workers);
+    start = std::chrono::steady_clock::now();
+    log_recovery->Redo();
+    log_recovery->Undo();
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "redo workers: " << workers
+              << ", recovery: " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms"
+              << std::endl;
+
+    txn = new Transaction(0);
+    test_table = new TableHeap(bpm, lock_manager, nullptr, rids[0].GetPageId());
+    Tuple result;
+    ASSERT_TRUE(test_table->GetTuple(rids[tuple_count - 1], &result, txn));
+    EXPECT_EQ(result.GetValue(&schema, 1).CompareEquals(ValueFactory::GetIntegerValue(values[tuple_count - 1])),
+              CmpBool::CmpTrue);
+    delete test_table;
+    delete txn;
+    delete log_recovery;
+    delete bpm;
+  }
+  delete lock_manager;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, AsyncCommitTest) {
+  auto original_timeout = log_timeout;
+  auto original_window = async_commit_window;
+  // Nothing but the commits below may flush the log.
+  log_timeout = std::chrono::seconds(100);
+  async_commit_window = std::chrono::seconds(100);
+
+  BustubInstance *bustub_instance = new BustubInstance("test.db");
+  auto *log_manager = bustub_instance->log_manager_;
+  auto *txn_manager = bustub_instance->transaction_manager_;
+  log_manager->RunFlushThread();
+
+  Column col1{"a", TypeId::INTEGER};
+  std::vector<Column> cols{col1};
+  Schema schema{cols};
+  Transaction *txn = txn_manager->Begin();
+  auto *test_table =
+      new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_, log_manager, txn);
+  txn_manager->Commit(txn);
+  delete txn;
+
+  // An asynchronous commit returns before its record is on disk.
+  txn_manager->SetAsyncCommit(true);
+  Transaction *async_txn = txn_manager->Begin();
+  ASSERT_TRUE(async_txn->IsAsyncCommit());
+  RID rid;
+  ASSERT_TRUE(test_table->InsertTuple(Tuple({ValueFactory::GetIntegerValue(1)}, &schema), &rid, async_txn));
+  txn_manager->Commit(async_txn);
+  lsn_t async_lsn = async_txn->GetPrevLSN();
+  EXPECT_LT(log_manager->GetPersistentLSN(), async_lsn);
+
+  // A durable commit makes everything before it durable, including the asynchronous commit.
+  txn_manager->SetAsyncCommit(false);
+  Transaction *durable_txn = txn_manager->Begin();
+  ASSERT_TRUE(test_table->InsertTuple(Tuple({ValueFactory::GetIntegerValue(2)}, &schema), &rid, durable_txn));
+  txn_manager->Commit(durable_txn);
+  EXPECT_GE(log_manager->GetPersistentLSN(), durable_txn->GetPrevLSN());
+  EXPECT_GT(durable_txn->GetPrevLSN(), async_lsn);
+  delete async_txn;
+  delete durable_txn;
+
+  // Without a durable commit behind it, the flush thread writes an asynchronous commit out within the window.
+  async_commit_window = std::chrono::milliseconds(50);
+  async_txn = txn_manager->Begin();
+  async_txn->SetAsyncCommit(true);
+  ASSERT_TRUE(test_table->InsertTuple(Tuple({ValueFactory::GetIntegerValue(3)}, &schema), &rid, async_txn));
+  auto start = std::chrono::steady_clock::now();
+  txn_manager->Commit(async_txn);
+  while (log_manager->GetPersistentLSN() < async_txn->GetPrevLSN()) {
+    ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(10));
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  delete async_txn;
+
+  delete test_table;
+  delete bustub_instance;
+  log_timeout = original_timeout;
+  async_commit_window = original_window;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, DISABLED_AsyncCommitBenchmark) {
+  const int txn_count = 2000;
+
+  Column col1{"a", TypeId::INTEGER};
+  std::vector<Column> cols{col1};
+  Schema schema{cols};
+
+  for (bool async_commit : {false, true}) {
+    BustubInstance *bustub_instance = new BustubInstance("test.db");
+    auto *txn_manager = bustub_instance->transaction_manager_;
+    bustub_instance->log_manager_->RunFlushThread();
+    Transaction *txn = txn_manager->Begin();
+    auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                     bustub_instance->log_manager_, txn);
+    txn_manager->Commit(txn);
+    delete txn;
+
+    // One small insert per transaction, so commit latency dominates.
+    txn_manager->SetAsyncCommit(async_commit);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < txn_count; i++) {
+      txn = txn_manager->Begin();
+      RID rid;
+      ASSERT_TRUE(test_table->InsertTuple(Tuple({ValueFactory::GetIntegerValue(i)}, &schema), &rid, txn));
+      txn_manager->Commit(txn);
+      delete txn;
+    }
+    auto end = std::chrono::steady_clock::now();
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    std::cout << (async_commit ? "async" : "durable") << " commit: " << txn_count << " txns in " << us / 1000
+              << " ms, " << txn_count * 1000000LL / std::max<int64_t>(us, 1) << " txns/s" << std::endl;
+
+    delete test_table;
+    delete bustub_instance;
+    remove("test.db");
+    RemoveLogSegments();
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, LogShippingTest) {
+  const int tuple_count = 1000;
+  remove("replica.db");
+  int report_pipe[2];
+  int done_pipe[2];
+  ASSERT_EQ(0, pipe(report_pipe));
+  ASSERT_EQ(0, pipe(done_pipe));
+  pid_t pid = fork();
+  ASSERT_NE(-1, pid);
+  if (pid == 0) {
+    _exit(RunShippingPrimary(tuple_count, 10, report_pipe[1], done_pipe[0]) ? 0 : 1);
+  }
+
+  // This process is the follower.
+  auto *replica = new BustubInstance("replica.db");
+  auto *log_replica = new LogReplica(replica->disk_manager_, replica->buffer_pool_manager_, "test.sock");
+  std::pair<page_id_t, lsn_t> progress;
+  ASSERT_EQ(sizeof(progress), read(report_pipe[0], &progress, sizeof(progress)));
+  ASSERT_TRUE(log_replica->WaitForLSN(progress.second, std::chrono::seconds(30)));
+  EXPECT_GE(log_replica->GetAppliedLSN(), progress.second);
+
+  // A read-only transaction on the follower sees every committed tuple, and not the aborted one.
+  Schema schema{std::vector<Column>{Column{"a", TypeId::INTEGER}, Column{"b", TypeId::INTEGER}}};
+  Transaction *txn = replica->transaction_manager_->Begin();
+  TableHeap table(replica->buffer_pool_manager_, replica->lock_manager_, replica->log_manager_, progress.first);
+  std::vector<bool> seen(tuple_count, false);
+  for (auto it = table.Begin(txn); it != table.End(); ++it) {
+    int32_t a = it->GetValue(&schema, 0).GetAs<int32_t>();
+    int32_t b = it->GetValue(&schema, 1).GetAs<int32_t>();
+    ASSERT_TRUE(a >= 0 && a < tuple_count);
+    EXPECT_FALSE(seen[a]);
+    EXPECT_EQ(a % 10 == 0 ? 1 : 0, b);
+    seen[a] = true;
+  }
+  EXPECT_EQ(tuple_count, std::count(seen.begin(), seen.end(), true));
+  replica->transaction_manager_->Commit(txn);
+  delete txn;
+
+  ASSERT_EQ(1, write(done_pipe[1], "x", 1));
+  int status;
+  ASSERT_EQ(pid, waitpid(pid, &status, 0));
+  EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  delete log_replica;
+  delete replica;
+  for (int fd : {report_pipe[0], report_pipe[1], done_pipe[0], done_pipe[1]}) {
+    close(fd);
+  }
+  remove("replica.db");
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, DISABLED_LogShippingLagBenchmark) {
+  const int tuple_count = 20000;
+  remove("replica.db");
+  int report_pipe[2];
+  int done_pipe[2];
+  ASSERT_EQ(0, pipe(report_pipe));
+  ASSERT_EQ(0, pipe(done_pipe));
+  auto start = std::chrono::steady_clock::now();
+  pid_t pid = fork();
+  ASSERT_NE(-1, pid);
+  if (pid == 0) {
+    _exit(RunShippingPrimary(tuple_count, 1, report_pipe[1], done_pipe[0]) ? 0 : 1);
+  }
+
+  auto *replica = new BustubInstance("replica.db");
+  auto *log_replica = new LogReplica(replica->disk_manager_, replica->buffer_pool_manager_, "test.sock");
+  // Sample the replay lag while the primary commits one insert per transaction.
+  std::atomic<bool> writing{true};
+  int64_t lag_sum = 0;
+  int64_t samples = 0;
+  std::thread sampler([&] {
+    while (writing) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      if (log_replica->GetAppliedLSN() != INVALID_LSN) {
+        lag_sum += log_replica->GetReplayLag().count();
+        samples++;
+      }
+    }
+  });
+  std::pair<page_id_t, lsn_t> progress;
+  ASSERT_EQ(sizeof(progress), read(report_pipe[0], &progress, sizeof(progress)));
+  auto written = std::chrono::steady_clock::now();
+  ASSERT_TRUE(log_replica->WaitForLSN(progress.second, std::chrono::seconds(600)));
+  auto caught_up = std::chrono::steady_clock::now();
+  writing = false;
+  sampler.join();
+
+  std::cout << "primary: " << tuple_count << " txns in "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(written - start).count() << " ms" << std::endl;
+  std::cout << "replica caught up " << std::chrono::duration_cast<std::chrono::microseconds>(caught_up - written).count()
+            << " us after the last commit" << std::endl;
+  std::cout << "replay lag: average " << (samples == 0 ? 0 : lag_sum / samples) << " us, max "
+            << log_replica->GetMaxReplayLag().count() << " us" << std::endl;
+
+  ASSERT_EQ(1, write(done_pipe[1], "x", 1));
+  int status;
+  ASSERT_EQ(pid, waitpid(pid, &status, 0));
+  delete log_replica;
+  delete replica;
+  for (int fd : {report_pipe[0], report_pipe[1], done_pipe[0], done_pipe[1]}) {
+    close(fd);
+  }
+  remove("replica.db");
+}
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, InstantRestartTest) {
+  BustubInstance *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+
+  Column col1{"a", TypeId::INTEGER};
+  Column col2{"b", TypeId::INTEGER};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+
+  // More pages than the buffer pool holds, none of them written back after the updates.
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  std::vector<RID> rids(2000);
+  for (int i = 0; i < 2000; i++) {
+    ASSERT_TRUE(test_table->InsertTuple(
+        Tuple({ValueFactory::GetIntegerValue(i), ValueFactory::GetIntegerValue(0)}, &schema), &rids[i], txn));
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  txn = bustub_instance->transaction_manager_->Begin();
+  for (int i = 0; i < 2000; i += 2) {
+    ASSERT_TRUE(test_table->UpdateTuple(
+        Tuple({ValueFactory::GetIntegerValue(i), ValueFactory::GetIntegerValue(1)}, &schema), rids[i], txn));
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+
+  // A loser that updates some of the odd rows and inserts one more.
+  txn = bustub_instance->transaction_manager_->Begin();
+  for (int i = 1; i < 2000; i += 100) {
+    ASSERT_TRUE(test_table->UpdateTuple(
+        Tuple({ValueFactory::GetIntegerValue(i), ValueFactory::GetIntegerValue(-1)}, &schema), rids[i], txn));
+  }
+  RID loser_rid;
+  ASSERT_TRUE(test_table->InsertTuple(
+      Tuple({ValueFactory::GetIntegerValue(-1), ValueFactory::GetIntegerValue(-1)}, &schema), &loser_rid, txn));
+  txn_id_t loser_id = txn->GetTransactionId();
+  delete txn;
+  delete test_table;
+  delete bustub_instance;
+
+  // New transactions log and lock while the restart redoes and undoes pages in the background.
+  bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_);
+  log_recovery->StartInstantRestart(bustub_instance->transaction_manager_, bustub_instance->lock_manager_);
+
+  // The committed rows are right as soon as the database is open, whether or not the background redo got to them.
+  // New transactions do not reuse the ids in the log.
+  txn = bustub_instance->transaction_manager_->Begin();
+  EXPECT_GT(txn->GetTransactionId(), loser_id);
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  Tuple result;
+  for (int i = 1999; i >= 0; i -= 2) {
+    ASSERT_TRUE(test_table->GetTuple(rids[i - 1], &result, txn));
+    EXPECT_EQ(result.GetValue(&schema, 1).CompareEquals(ValueFactory::GetIntegerValue(1)), CmpBool::CmpTrue);
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+
+  log_recovery->WaitForRestart();
+  EXPECT_EQ(0, log_recovery->GetPendingRedoPages());
+  txn = bustub_instance->transaction_manager_->Begin();
+  for (int i = 0; i < 2000; i++) {
+    ASSERT_TRUE(test_table->GetTuple(rids[i], &result, txn));
+    EXPECT_EQ(result.GetValue(&schema, 0).CompareEquals(ValueFactory::GetIntegerValue(i)), CmpBool::CmpTrue);
+    EXPECT_EQ(result.GetValue(&schema, 1).CompareEquals(ValueFactory::GetIntegerValue(i % 2 == 0 ? 1 : 0)),
+              CmpBool::CmpTrue);
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  // reading a missing row aborts the reader
+  txn = bustub_instance->transaction_manager_->Begin();
+  EXPECT_FALSE(test_table->GetTuple(loser_rid, &result, txn));
+  bustub_instance->transaction_manager_->Abort(txn);
+  delete txn;
+
+  // A new row takes the slot the undo freed, then the database crashes again. The next recovery redoes the undo from
+  // its CLRs and finds the loser aborted, so it neither trips over the slot nor undoes the loser a second time.
+  txn = bustub_instance->transaction_manager_->Begin();
+  RID reused_rid;
+  ASSERT_TRUE(test_table->InsertTuple(
+      Tuple({ValueFactory::GetIntegerValue(-2), ValueFactory::GetIntegerValue(-2)}, &schema), &reused_rid, txn));
+  EXPECT_EQ(loser_rid, reused_rid);
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  delete test_table;
+  delete log_recovery;
+  delete bustub_instance;
+
+  bustub_instance = new BustubInstance("test.db");
+  log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_);
+  log_recovery->Redo();
+  log_recovery->Undo();
+  txn = bustub_instance->transaction_manager_->Begin();
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  for (int i = 0; i < 2000; i++) {
+    ASSERT_TRUE(test_table->GetTuple(rids[i], &result, txn));
+    EXPECT_EQ(result.GetValue(&schema, 1).CompareEquals(ValueFactory::GetIntegerValue(i % 2 == 0 ? 1 : 0)),
+              CmpBool::CmpTrue);
+  }
+  ASSERT_TRUE(test_table->GetTuple(reused_rid, &result, txn));
+  EXPECT_EQ(result.GetValue(&schema, 0).CompareEquals(ValueFactory::GetIntegerValue(-2)), CmpBool::CmpTrue);
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  delete test_table;
+  delete log_recovery;
+  delete bustub_instance;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, DISABLED_InstantRestartBenchmark) {
+  // Same setup as the parallel redo benchmark: a table that fits into the buffer pool and a log of delta updates that
+  // never reached the pages. Compares the time until a first query can run with and without an instant restart.
+  const size_t pool_size = 4096;
+  const int tuple_count = 100000;
+
+  Column col1{"a", TypeId::INTEGER};
+  Column col2{"b", TypeId::INTEGER};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+
+  for (int64_t log_size : {64LL << 20, 256LL << 20, 1LL << 30}) {
+    remove("test.db");
+    RemoveLogSegments();
+    auto *disk_manager = new DiskManager("test.db");
+    auto *log_manager = new LogManager(disk_manager);
+    auto *bpm = new BufferPoolManager(pool_size, disk_manager, log_manager);
+    auto *lock_manager = new LockManager();
+    auto *txn_manager = new TransactionManager(lock_manager, log_manager);
+    log_manager->RunFlushThread();
+
+    Transaction *txn = txn_manager->Begin();
+    auto *test_table = new TableHeap(bpm, lock_manager, log_manager, txn);
+    std::vector<RID> rids(tuple_count);
+    std::vector<int32_t> values(tuple_count, 0);
+    for (int i = 0; i < tuple_count; i++) {
+      ASSERT_TRUE(test_table->InsertTuple(
+          Tuple({ValueFactory::GetIntegerValue(i), ValueFactory::GetIntegerValue(0)}, &schema), &rids[i], txn));
+    }
+    txn_manager->Commit(txn);
+    delete txn;
+    bpm->FlushAllPages();
+
+    txn = txn_manager->Begin();
+    int64_t log_start = log_manager->GetNextOffset();
+    for (int64_t i = 0; log_manager->GetNextOffset() - log_start < log_size; i++) {
+      int slot = static_cast<int>(i % tuple_count);
+      Tuple old_tuple({ValueFactory::GetIntegerValue(slot), ValueFactory::GetIntegerValue(values[slot])}, &schema);
+      Tuple new_tuple({ValueFactory::GetIntegerValue(slot), ValueFactory::GetIntegerValue(++values[slot])}, &schema);
+      LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::DELTAUPDATE, rids[slot],
+                           old_tuple, new_tuple);
+      txn->SetPrevLSN(log_manager->AppendLogRecord(&log_record));
+    }
+    txn_manager->Commit(txn);
+    delete txn;
+    log_manager->StopFlushThread();
+    delete test_table;
+    delete txn_manager;
+    delete bpm;
+    delete log_manager;
+
+    for (bool instant : {false, true}) {
+      bpm = new BufferPoolManager(pool_size, disk_manager);
+      txn_manager = new TransactionManager(lock_manager);
+      auto *log_recovery = new LogRecovery(disk_manager, bpm, 1);
+      auto start = std::chrono::steady_clock::now();
+      if (instant) {
+        log_recovery->StartInstantRestart(txn_manager, lock_manager);
+      } else {
+        log_recovery->Redo();
+        log_recovery->Undo();
+      }
+      txn = new Transaction(0);
+      test_table = new TableHeap(bpm, lock_manager, nullptr, rids[0].GetPageId());
+      Tuple result;
+      int slot = tuple_count / 2;
+      ASSERT_TRUE(test_table->GetTuple(rids[slot], &result, txn));
+      auto first_query = std::chrono::steady_clock::now();
+      EXPECT_EQ(result.GetValue(&schema, 1).CompareEquals(ValueFactory::GetIntegerValue(values[slot])),
+                CmpBool::CmpTrue);
+      log_recovery->WaitForRestart();
+      auto end = std::chrono::steady_clock::now();
+      std::cout << "log: " << (log_size >> 20) << " MB, " << (instant ? "instant restart" : "redo and undo")
+                << ", first query: "
+                << std::chrono::duration_cast<std::chrono::milliseconds>(first_query - start).count()
+                << " ms, recovered: " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count()
+                << " ms" << std::endl;
+      delete test_table;
+      delete txn;
+      delete log_recovery;
+      delete txn_manager;
+      delete bpm;
+    }
+    delete lock_manager;
+    delete disk_manager;
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, BPlusTreeRecoveryTest) {
+  // A larger buffer pool than BustubInstance has, the tree pins a page on every level during a split or merge.
+  auto *disk_manager = new DiskManager("test.db");
+  auto *log_manager = new LogManager(disk_manager);
+  auto *bpm = new BufferPoolManager(64, disk_manager, log_manager);
+  auto *lock_manager = new LockManager();
+  auto *txn_manager = new TransactionManager(lock_manager, log_manager);
+  log_manager->RunFlushThread();
+  Schema key_schema{std::vector<Column>{Column{"a", TypeId::BIGINT}}};
+  GenericComparator<8> comparator(&key_schema);
+  GenericKey<8> index_key;
+  std::vector<RID> result;
+
+  page_id_t header_page_id;
+  bpm->NewPage(&header_page_id);
+  ASSERT_EQ(HEADER_PAGE_ID, header_page_id);
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+
+  // Small nodes so that there are many splits and merges, on more pages than the buffer pool holds.
+  auto *tree = new BPlusTree<GenericKey<8>, RID, GenericComparator<8>>("foo_pk", bpm,
+                                                                      comparator, 8, 8);
+  Transaction *txn = txn_manager->Begin();
+  for (int64_t key = 1; key <= 2000; key++) {
+    index_key.SetFromInteger(key);
+    ASSERT_TRUE(tree->Insert(index_key, RID(static_cast<int32_t>(key), 0), txn));
+  }
+  for (int64_t key = 1; key <= 2000; key += 3) {
+    index_key.SetFromInteger(key);
+    tree->Remove(index_key, txn);
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+
+  // A loser that removes a run of keys and inserts new ones.
+  txn = txn_manager->Begin();
+  for (int64_t key = 500; key < 600; key++) {
+    index_key.SetFromInteger(key);
+    tree->Remove(index_key, txn);
+  }
+  for (int64_t key = 3000; key < 3100; key++) {
+    index_key.SetFromInteger(key);
+    ASSERT_TRUE(tree->Insert(index_key, RID(static_cast<int32_t>(key), 0), txn));
+  }
+  delete txn;
+  delete tree;
+  log_manager->StopFlushThread();
+  delete txn_manager;
+  delete lock_manager;
+  delete bpm;
+  delete log_manager;
+  delete disk_manager;
+
+  disk_manager = new DiskManager("test.db");
+  log_manager = new LogManager(disk_manager);
+  bpm = new BufferPoolManager(64, disk_manager, log_manager);
+  lock_manager = new LockManager();
+  txn_manager = new TransactionManager(lock_manager, log_manager);
+  auto *log_recovery = new LogRecovery(disk_manager, bpm);
+  log_recovery->Redo();
+  // undo reverts the changes of the loser by key, through the tree
+  tree = new BPlusTree<GenericKey<8>, RID, GenericComparator<8>>("foo_pk", bpm,
+                                                                comparator, 8, 8);
+  log_recovery->RegisterIndex(tree);
+  log_recovery->Undo();
+  delete log_recovery;
+  ASSERT_TRUE(tree->LoadRootPageId());
+  for (int64_t key = 1; key < 3100; key++) {
+    index_key.SetFromInteger(key);
+    bool found = tree->GetValue(index_key, &result);
+    ASSERT_EQ(key <= 2000 && key % 3 != 1, found) << "key " << key;
+    if (found) {
+      EXPECT_EQ(key, result[0].GetPageId());
+    }
+  }
+
+  // The recovered index keeps working, new pages do not reuse the ones in the log.
+  log_manager->RunFlushThread();
+  txn = txn_manager->Begin();
+  for (int64_t key = 4000; key < 4500; key++) {
+    index_key.SetFromInteger(key);
+    ASSERT_TRUE(tree->Insert(index_key, RID(static_cast<int32_t>(key), 0), txn));
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+  int64_t count = 0;
+  int64_t prev_key = 0;
+  for (auto it = tree->begin(); !it.isEnd(); ++it) {
+    EXPECT_LT(prev_key, (*it).second.GetPageId());
+    prev_key = (*it).second.GetPageId();
+    count++;
+  }
+  EXPECT_EQ(1333 + 500, count);
+  delete tree;
+  log_manager->StopFlushThread();
+  delete txn_manager;
+  delete lock_manager;
+  delete bpm;
+  delete log_manager;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, BPlusTreeInterleavedUndoTest) {
+  using Tree = BPlusTree<GenericKey<8>, RID, GenericComparator<8>>;
+  Schema key_schema{std::vector<Column>{Column{"a", TypeId::BIGINT}}};
+  GenericComparator<8> comparator(&key_schema);
+  GenericKey<8> index_key;
+  auto insert = [&](Tree *tree, int64_t key, Transaction *txn) {
+    index_key.SetFromInteger(key);
+    return tree->Insert(index_key, RID(static_cast<int32_t>(key), 0), txn);
+  };
+  auto remove = [&](Tree *tree, int64_t key, Transaction *txn) {
+    index_key.SetFromInteger(key);
+    tree->Remove(index_key, txn);
+  };
+
+  auto *disk_manager = new DiskManager("test.db");
+  auto *log_manager = new LogManager(disk_manager);
+  auto *bpm = new BufferPoolManager(64, disk_manager, log_manager);
+  auto *lock_manager = new LockManager();
+  auto *txn_manager = new TransactionManager(lock_manager, log_manager);
+  log_manager->RunFlushThread();
+  page_id_t header_page_id;
+  bpm->NewPage(&header_page_id);
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+
+  // Leaves of at most three keys, so that a few inserts split the leaf another transaction changed.
+  auto *tree = new Tree("foo_pk", bpm, comparator, 4, 4);
+  Transaction *txn = txn_manager->Begin();
+  for (int64_t key : {10, 20, 30, 40, 50}) {
+    ASSERT_TRUE(insert(tree, key, txn));
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+
+  // The loser changes a leaf, then a winner splits it and moves the loser's entries to other pages and positions.
+  Transaction *loser = txn_manager->Begin();
+  Transaction *winner = txn_manager->Begin();
+  ASSERT_TRUE(insert(tree, 25, loser));
+  remove(tree, 40, loser);
+  for (int64_t key : {21, 22, 23, 24, 26, 27, 41, 42, 43}) {
+    ASSERT_TRUE(insert(tree, key, winner));
+  }
+  // The loser splits a leaf of its own, and the winner inserts into the new page.
+  for (int64_t key : {51, 52, 53, 54}) {
+    ASSERT_TRUE(insert(tree, key, loser));
+  }
+  ASSERT_TRUE(insert(tree, 55, winner));
+  remove(tree, 22, winner);
+  txn_manager->Commit(winner);
+  delete winner;
+  delete loser;
+  delete tree;
+  log_manager->StopFlushThread();
+  delete txn_manager;
+  delete lock_manager;
+  delete bpm;
+  delete log_manager;
+  delete disk_manager;
+
+  const std::vector<int64_t> expected{10, 20, 21, 23, 24, 26, 27, 30, 40, 41, 42, 43, 50, 55};
+  auto check = [&](Tree *tree) {
+    std::vector<int64_t> keys;
+    for (auto it = tree->begin(); !it.isEnd(); ++it) {
+      keys.push_back((*it).second.GetPageId());
+    }
+    EXPECT_EQ(expected, keys);
+    std::vector<RID> result;
+    for (int64_t key = 0; key < 60; key++) {
+      index_key.SetFromInteger(key);
+      EXPECT_EQ(std::find(expected.begin(), expected.end(), key) != expected.end(), tree->GetValue(index_key, &result))
+          << "key " << key;
+    }
+  };
+
+  // The undo is logged, so a second recovery only redoes it.
+  for (int round = 0; round < 2; round++) {
+    disk_manager = new DiskManager("test.db");
+    log_manager = new LogManager(disk_manager);
+    bpm = new BufferPoolManager(64, disk_manager, log_manager);
+    auto *log_recovery = new LogRecovery(disk_manager, bpm);
+    log_recovery->Redo();
+    tree = new Tree("foo_pk", bpm, comparator, 4, 4);
+    log_recovery->RegisterIndex(tree);
+    log_manager->RunFlushThread();
+    log_recovery->Undo();
+    delete log_recovery;
+    ASSERT_TRUE(tree->LoadRootPageId());
+    check(tree);
+    log_manager->StopFlushThread();
+    delete tree;
+    bpm->FlushAllPages();
+    delete bpm;
+    delete log_manager;
+    delete disk_manager;
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, LogReaderTest) {
+  auto *disk_manager = new DiskManager("test.db");
+  auto *log_manager = new LogManager(disk_manager);
+  log_manager->RunFlushThread();
+  Schema schema{std::vector<Column>{Column{"a", TypeId::INTEGER}, Column{"b", TypeId::VARCHAR, 200}}};
+
+  // More than one segment of records of different lengths, so that some straddle the segment boundaries.
+  std::vector<lsn_t> lsns;
+  std::vector<int64_t> offsets;
+  for (int i = 0; log_manager->GetNextOffset() < LOG_SEGMENT_SIZE + LOG_SEGMENT_SIZE / 4; i++) {
+    Tuple tuple({ValueFactory::GetIntegerValue(i), ValueFactory::GetVarcharValue(std::string(i % 97, 'x'))}, &schema);
+    LogRecord log_record(0, INVALID_LSN, LogRecordType::INSERT, RID(i, 0), tuple);
+    offsets.push_back(log_manager->GetNextOffset());
+    lsns.push_back(log_manager->AppendLogRecord(&log_record));
+  }
+  log_manager->StopFlushThread();
+  delete log_manager;
+  delete disk_manager;
+
+  disk_manager = new DiskManager("test.db");
+  log_manager = new LogManager(disk_manager);
+  auto *log_reader = new LogReader(disk_manager);
+  LogRecovery log_recovery(disk_manager, nullptr);
+  EXPECT_EQ(0, log_reader->GetStart());
+  EXPECT_EQ(disk_manager->GetLogSize(), log_reader->GetEnd());
+  int64_t offset = 0;
+  for (size_t i = 0; i < lsns.size(); i++) {
+    ASSERT_EQ(offsets[i], offset);
+    int32_t size;
+    const char *data = log_reader->GetRecord(offset, &size);
+    ASSERT_NE(nullptr, data);
+    LogRecord log_record;
+    ASSERT_TRUE(log_recovery.DeserializeLogRecord(data, &log_record, false));
+    EXPECT_EQ(lsns[i], log_record.GetLSN());
+    Tuple &tuple = log_record.GetInsertTuple();
+    EXPECT_FALSE(tuple.IsAllocated());
+    EXPECT_EQ(static_cast<int32_t>(i), tuple.GetValue(&schema, 0).GetAs<int32_t>());
+    EXPECT_EQ(std::string(i % 97, 'x'), tuple.GetValue(&schema, 1).ToString());
+    offset += size;
+  }
+  int32_t size;
+  EXPECT_EQ(nullptr, log_reader->GetRecord(offset, &size));
+  delete log_reader;
+  delete log_manager;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, DISABLED_LogReaderBenchmark) {
+  const int64_t log_size = 1LL << 30;
+  Schema schema{std::vector<Column>{Column{"a", TypeId::INTEGER}, Column{"b", TypeId::VARCHAR, 200}}};
+  auto *disk_manager = new DiskManager("test.db");
+  auto *log_manager = new LogManager(disk_manager);
+  log_manager->RunFlushThread();
+  Tuple tuple({ValueFactory::GetIntegerValue(0), ValueFactory::GetVarcharValue(std::string(150, 'x'))}, &schema);
+  for (int i = 0; log_manager->GetNextOffset() < log_size; i++) {
+    LogRecord log_record(0, INVALID_LSN, LogRecordType::INSERT, RID(i, 0), tuple);
+    log_manager->AppendLogRecord(&log_record);
+  }
+  log_manager->StopFlushThread();
+  delete log_manager;
+  delete disk_manager;
+
+  disk_manager = new DiskManager("test.db");
+  log_manager = new LogManager(disk_manager);
+  LogRecovery log_recovery(disk_manager, nullptr);
+  int64_t end = disk_manager->GetLogSize();
+  auto report = [end](const char *name, std::chrono::steady_clock::time_point start, int64_t records) {
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    std::cout << name << ": " << records << " records in " << ms << " ms, " << (end >> 20) * 1000 / std::max<int64_t>(ms, 1)
+              << " MB/s" << std::endl;
+  };
+
+  for (int round = 0; round < 2; round++) {
+    // the bandwidth the log can be read at, without looking at the records
+    std::vector<char> buffer(LOG_BUFFER_SIZE);
+    auto start = std::chrono::steady_clock::now();
+    for (int64_t offset = 0; offset < end; offset += LOG_BUFFER_SIZE) {
+      disk_manager->ReadLog(buffer.data(), LOG_BUFFER_SIZE, offset);
+    }
+    report("sequential ReadLog", start, 0);
+
+    // what recovery did before: read through a buffer, copy every tuple
+    start = std::chrono::steady_clock::now();
+    int64_t records = 0;
+    int64_t buffer_offset = -1;
+    for (int64_t offset = 0; offset < end; records++) {
+      if (buffer_offset == -1 || offset + LOG_BUFFER_SIZE / 2 > buffer_offset + LOG_BUFFER_SIZE) {
+        disk_manager->ReadLog(buffer.data(), LOG_BUFFER_SIZE, offset);
+        buffer_offset = offset;
+      }
+      LogRecord log_record;
+      ASSERT_TRUE(log_recovery.DeserializeLogRecord(buffer.data() + (offset - buffer_offset), &log_record));
+      offset += log_record.GetSize();
+    }
+    report("buffered, copied tuples", start, records);
+
+    start = std::chrono::steady_clock::now();
+    records = 0;
+    LogReader log_reader(disk_manager);
+    for (int64_t offset = 0; offset < end; records++) {
+      int32_t size;
+      const char *data = log_reader.GetRecord(offset, &size);
+      LogRecord log_record;
+      ASSERT_TRUE(data != nullptr && log_recovery.DeserializeLogRecord(data, &log_record, false));
+      offset += size;
+    }
+    report("mapped, tuple views", start, records);
+  }
+  delete log_manager;
+  delete disk_manager;
+}
+
 }  // namespace bustub
@@ -2,11 +2,13 @@
  * grading_b_plus_tree_checkpoint_2_concurrent_test.cpp
  */
 
+#include <algorithm>
 #include <chrono>  // NOLINT
 #include <cstdio>
 #include <functional>
 #include<iostream>
 #include <future>  // NOLINT
+#include <random>
 #include <thread>  // NOLIN
 #include "b_plus_tree_test_util.h"  // NOLINT
 #include "buffer/buffer_pool_manager.h"
@@ -618,4 +620,117 @@ TEST(BPlusTreeConcurrentTest, MixTest3) {
   TEST_TIMEOUT_FAIL_END(1000 * 600)
 }
 
+/*
+ * Description: With optimistic crabbing on and tiny pages, concurrently
+ * insert and remove keys so that leaves keep splitting and merging, first
+ * while the root is still a leaf and then under a root with children.
+ * Check that exactly the keys that were left inserted remain.
+ */
+TEST(BPlusTreeConcurrentTest, OptimisticCrabbingEdgeTest) {
+  TEST_TIMEOUT_BEGIN
+  bool crabbing = enable_optimistic_crabbing;
+  enable_optimistic_crabbing = true;
+  const int num_threads = 4;
+  const int num_rounds = 100;
+  // eight keys never fill a root leaf of 16, two hundred keep splitting and merging leaves of 3
+  for (int64_t num_keys : {int64_t{8}, int64_t{200}}) {
+    Schema *key_schema = ParseCreateStatement("a bigint");
+    GenericComparator<8> comparator(key_schema);
+    DiskManager *disk_manager = new DiskManager("test.db");
+    BufferPoolManager *bpm = new BufferPoolManager(50, disk_manager);
+    int leaf_max_size = num_keys < 16 ? 16 : 3;
+    int internal_max_size = num_keys < 16 ? 16 : 4;
+    BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator, leaf_max_size,
+                                                             internal_max_size);
+    page_id_t page_id;
+    auto header_page = bpm->NewPage(&page_id);
+    (void)header_page;
+
+    // the odd keys stay, the even keys come and go, the multiples of four are inserted last
+    std::vector<int64_t> odd_keys;
+    std::vector<int64_t> even_keys;
+    std::vector<int64_t> final_keys;
+    for (int64_t key = 1; key <= num_keys; key++) {
+      (key % 2 == 0 ? even_keys : odd_keys).push_back(key);
+      if (key % 2 != 0 || key % 4 == 0) {
+        final_keys.push_back(key);
+      }
+    }
+    InsertHelper(&tree, odd_keys, 1);
+    auto churn = [&](uint64_t tid, uint64_t thread_itr) {
+      for (int round = 0; round < num_rounds; round++) {
+        InsertHelperSplit(&tree, even_keys, num_threads, tid, thread_itr);
+        DeleteHelperSplit(&tree, even_keys, num_threads, tid, thread_itr);
+      }
+      std::vector<int64_t> keep;
+      for (auto key : even_keys) {
+        if (key % 4 == 0) {
+          keep.push_back(key);
+        }
+      }
+      InsertHelperSplit(&tree, keep, num_threads, tid, thread_itr);
+    };
+    LaunchParallelTest(num_threads, 2, churn);
+
+    size_t size = 0;
+    for (auto &pair : tree) {
+      if (size < final_keys.size()) {
+        EXPECT_EQ((pair.first).ToString(), final_keys[size]);
+      }
+      size++;
+    }
+    EXPECT_EQ(size, final_keys.size());
+    LookupHelper(&tree, final_keys, 1);
+
+    bpm->UnpinPage(HEADER_PAGE_ID, true);
+    delete key_schema;
+    delete disk_manager;
+    delete bpm;
+    remove("test.db");
+    remove("test.log");
+  }
+  enable_optimistic_crabbing = crabbing;
+  TEST_TIMEOUT_FAIL_END(1000 * 600)
+}
+
+/** Inserts per second of num_threads threads inserting num_keys shuffled keys into an empty tree. */
+double InsertThroughput(int num_threads, int64_t num_keys) {
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManager(4096, disk_manager);
+  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator);
+  page_id_t page_id;
+  bpm->NewPage(&page_id);
+
+  std::vector<int64_t> keys;
+  for (int64_t key = 1; key <= num_keys; key++) {
+    keys.push_back(key);
+  }
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+  auto start = std::chrono::steady_clock::now();
+  LaunchParallelTest(num_threads, 0, InsertHelperSplit, &tree, keys, num_threads);
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete key_schema;
+  delete bpm;
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+  return num_keys / elapsed.count();
+}
+
+TEST(BPlusTreeConcurrentTest, DISABLED_OptimisticCrabbingBenchmark) {
+  const int64_t num_keys = 200000;
+  for (int num_threads : {1, 2, 4, 8, 16, 32}) {
+    enable_optimistic_crabbing = false;
+    double pessimistic = InsertThroughput(num_threads, num_keys);
+    enable_optimistic_crabbing = true;
+    double optimistic = InsertThroughput(num_threads, num_keys);
+    std::cout << num_threads << " threads: pessimistic " << pessimistic << " inserts/s, optimistic " << optimistic
+              << " inserts/s" << std::endl;
+  }
+}
+
 }  // namespace bustub
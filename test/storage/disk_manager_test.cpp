@@ -10,7 +10,11 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <cstdio>
 #include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
 
 #include "common/exception.h"
 #include "gtest/gtest.h"
@@ -23,14 +27,23 @@ class DiskManagerTest : public ::testing::Test {
   // This function is called before every test.
   void SetUp() override {
     remove("test.db");
-    remove("test.log");
+    RemoveLogSegments();
   }
 
   // This function is called after every test.
   void TearDown() override {
     remove("test.db");
-    remove("test.log");
+    RemoveLogSegments();
   };
+
+  // Remove test.log.<n> and the recycled test.log.spare.<n> files.
+  static void RemoveLogSegments() {
+    for (const auto &entry : std::filesystem::directory_iterator(".")) {
+      if (entry.path().filename().string().compare(0, 9, "test.log.") == 0) {
+        std::filesystem::remove(entry.path());
+      }
+    }
+  }
 };
 
 // NOLINTNEXTLINE
@@ -72,6 +85,62 @@ TEST_F(DiskManagerTest, ReadWriteLogTest) {
   dm.ShutDown();
 }
 
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, LogSegmentTest) {
+  const int chunk = 1024 * 1024;
+  // WriteLog expects the two log buffers to alternate
+  std::vector<char> buffers[2] = {std::vector<char>(chunk), std::vector<char>(chunk)};
+  std::vector<char> buf(chunk);
+  std::string db_file("test.db");
+  auto dm = DiskManager(db_file);
+
+  // three and a half segments, every chunk filled with its own number
+  int chunks = 7 * LOG_SEGMENT_SIZE / chunk / 2;
+  for (int i = 0; i < chunks; i++) {
+    std::memset(buffers[i % 2].data(), i, chunk);
+    dm.WriteLog(buffers[i % 2].data(), chunk);
+  }
+  EXPECT_EQ(dm.GetLogSize(), static_cast<int64_t>(chunks) * chunk);
+  EXPECT_TRUE(std::filesystem::exists("test.log.3"));
+
+  // a read across the boundary of two segments
+  int64_t boundary = LOG_SEGMENT_SIZE;
+  ASSERT_TRUE(dm.ReadLog(buf.data(), chunk, boundary - chunk / 2));
+  EXPECT_EQ(buf[0], static_cast<char>(LOG_SEGMENT_SIZE / chunk - 1));
+  EXPECT_EQ(buf[chunk - 1], static_cast<char>(LOG_SEGMENT_SIZE / chunk));
+
+  // recycling keeps the segment holding the offset and renames the older ones
+  dm.RecycleLog(2 * boundary + chunk);
+  EXPECT_EQ(dm.GetLogStart(), 2 * boundary);
+  EXPECT_FALSE(std::filesystem::exists("test.log.0"));
+  EXPECT_FALSE(std::filesystem::exists("test.log.1"));
+  EXPECT_TRUE(std::filesystem::exists("test.log.spare.0"));
+  EXPECT_TRUE(std::filesystem::exists("test.log.spare.1"));
+  EXPECT_FALSE(dm.ReadLog(buf.data(), chunk, 0));
+  ASSERT_TRUE(dm.ReadLog(buf.data(), chunk, 2 * boundary));
+  EXPECT_EQ(buf[0], static_cast<char>(2 * LOG_SEGMENT_SIZE / chunk));
+
+  // growing into the next segment reuses a spare file, stale bytes past the end of the log are never returned
+  for (int i = chunks; i < chunks + LOG_SEGMENT_SIZE / chunk; i++) {
+    std::memset(buffers[i % 2].data(), i, chunk);
+    dm.WriteLog(buffers[i % 2].data(), chunk);
+  }
+  EXPECT_TRUE(std::filesystem::exists("test.log.4"));
+  EXPECT_FALSE(std::filesystem::exists("test.log.spare.0") && std::filesystem::exists("test.log.spare.1"));
+  int64_t end = dm.GetLogSize();
+  ASSERT_TRUE(dm.ReadLog(buf.data(), chunk, end - chunk / 2));
+  EXPECT_EQ(buf[0], static_cast<char>(chunks + LOG_SEGMENT_SIZE / chunk - 1));
+  EXPECT_EQ(buf[chunk - 1], 0);
+  dm.ShutDown();
+
+  // the segment index is rebuilt from the files on disk
+  auto dm2 = DiskManager(db_file);
+  EXPECT_EQ(dm2.GetLogStart(), 2 * boundary);
+  ASSERT_TRUE(dm2.ReadLog(buf.data(), chunk, 3 * boundary));
+  EXPECT_EQ(buf[0], static_cast<char>(3 * LOG_SEGMENT_SIZE / chunk));
+  dm2.ShutDown();
+}
+
 // NOLINTNEXTLINE
 TEST_F(DiskManagerTest, ThrowBadFileTest) { EXPECT_THROW(DiskManager("dev/null\\/foo/bar/baz/test.db"), Exception); }
 